@@ -37,6 +37,8 @@
 %define HAVE_AMD3DNOWEXT 1
 %define HAVE_AVX 1
 %define HAVE_FMA4 1
+%define HAVE_AVX2 1
+%define HAVE_AVX512 1
 %define HAVE_MMX 1
 %define HAVE_MMXEXT 1
 %define HAVE_SSE 1
@@ -58,6 +60,8 @@
 %define HAVE_AMD3DNOWEXT_EXTERNAL 1
 %define HAVE_AVX_EXTERNAL 1
 %define HAVE_FMA4_EXTERNAL 1
+%define HAVE_AVX2_EXTERNAL 1
+%define HAVE_AVX512_EXTERNAL 1
 %define HAVE_MMX_EXTERNAL 1
 %define HAVE_MMXEXT_EXTERNAL 1
 %define HAVE_SSE_EXTERNAL 1
@@ -79,6 +83,8 @@
 %define HAVE_AMD3DNOWEXT_INLINE 1
 %define HAVE_AVX_INLINE 1
 %define HAVE_FMA4_INLINE 1
+%define HAVE_AVX2_INLINE 1
+%define HAVE_AVX512_INLINE 1
 %define HAVE_MMX_INLINE 1
 %define HAVE_MMXEXT_INLINE 1
 %define HAVE_SSE_INLINE 1
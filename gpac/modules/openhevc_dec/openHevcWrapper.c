@@ -19,110 +19,554 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 #include <stdio.h>
+#include "config.h"
+#if HAVE_PTHREADS
+#include <pthread.h>
+#elif HAVE_W32THREADS
+#include "compat/w32pthreads.h"
+#elif HAVE_OS2THREADS
+#include "compat/os2threads.h"
+#endif
 #include "openHevcWrapper.h"
 #include "libavcodec/avcodec.h"
 #include "libavformat/avformat.h"
+#include "libavutil/cpu.h"
+#include "libavutil/mathematics.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
+#include "libavutil/time.h"
 
-#define MAX_DECODERS 2
+#define MAX_DECODERS 8 ///< layers that can be decoded, as MAX_LAYERS in libavcodec
 #define ACTIVE_NAL
+
+#define ADAPT_WINDOW   16   ///< AUs the decoding time is averaged over
+#define ADAPT_MIN_HOLD 64   ///< AUs a dropped layer stays dropped at least
+#define ADAPT_MAX_HOLD 1024
 typedef struct OpenHevcWrapperContext {
     AVCodec *codec;
     AVCodecContext *c;
     AVFrame *picture;
     AVPacket avpkt;
     AVCodecParserContext *parser;
+    int layer_id;
+    OpenHevc_PictureHashCallback picture_hash_cb;
+    void *picture_hash_opaque;
+    int got_picture;
+    int ret;
+#if HAVE_THREADS
+    /* the enhancement layers are decoded on their own thread, started as
+     * soon as the layer below has started its picture */
+    struct OpenHevcWrapperContext *next_layer; ///< layer fed by this one in the current AU
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int             threaded;
+    int             state;
+    int             die;
+#endif
 } OpenHevcWrapperContext;
 
+#if HAVE_THREADS
+enum {
+    LAYER_IDLE,
+    LAYER_WAITING,  ///< the AU is queued, waiting for the picture of the layer below
+    LAYER_RUNNING,
+};
+#endif
+
 typedef struct OpenHevcWrapperContexts {
     OpenHevcWrapperContext **wraper;
     int nb_decoders;
     int active_layer;
     int set_vps;
+    /* the decoders of the enhancement layers are only created once the VPS
+     * has announced their layers, with the settings given so far */
+    int max_layer;          ///< layer requested with libOpenHevcSetActiveDecoders()
+    int nb_pthreads;
+    int thread_type;
+    int check_md5;
+    int temporal_layer_id;  ///< -1 when not set
+    int temporal_layers;    ///< AVCodecContext.temporal_layers
+    int temporal_switch;
+    int keyframes_only;
+    int cpu_flags_mask;     ///< from libOpenHevcSetMaxSimdTier()
+    int no_cropping;        ///< -1 when not set
+    OpenHevc_PictureHashCallback picture_hash_cb;
+    void *picture_hash_opaque;
+    unsigned char *extra_data;
+    int extra_size_alloc;
+    int nal_length_size;    ///< size of the NAL unit lengths, 0 for start codes
+    int started;
+    /* dropping of the enhancement layers when decoding falls behind real
+     * time, see libOpenHevcSetAdaptiveLayers() */
+    int adaptive_layers;
+    int64_t frame_duration; ///< real-time budget of an AU in us, 0 for the frame rate
+    int64_t decode_time;    ///< moving average of the decoding time of an AU in us
+    int layer_cap;          ///< highest layer kept by the adaptation
+    int nb_timed;           ///< AUs decoded since the last layer switch
+    int hold;               ///< AUs to wait before resuming a dropped layer
+    int resumed;            ///< the last layer switch was up
 } OpenHevcWrapperContexts;
 
-OpenHevc_Handle libOpenHevcInit(int nb_pthreads, int thread_type)
+#if HAVE_THREADS
+static void layer_start(OpenHevcWrapperContext *openHevcContext, void *BL_frame)
 {
-    /* register all the codecs */
-    int i;
-    OpenHevcWrapperContexts *openHevcContexts = av_mallocz(sizeof(OpenHevcWrapperContexts));
-    OpenHevcWrapperContext  *openHevcContext;
-    avcodec_register_all();
-    openHevcContexts->nb_decoders = MAX_DECODERS;
-    openHevcContexts->wraper = av_malloc(sizeof(OpenHevcWrapperContext*)*openHevcContexts->nb_decoders);
-    for(i=0; i < openHevcContexts->nb_decoders; i++){
-        openHevcContext = openHevcContexts->wraper[i] = av_malloc(sizeof(OpenHevcWrapperContext));
-        av_init_packet(&openHevcContext->avpkt);
-        openHevcContext->codec = avcodec_find_decoder(AV_CODEC_ID_HEVC);
-        if (!openHevcContext->codec) {
-            fprintf(stderr, "codec not found\n");
-            return NULL;
+    if (!openHevcContext || !openHevcContext->threaded)
+        return;
+
+    pthread_mutex_lock(&openHevcContext->mutex);
+    if (openHevcContext->state == LAYER_WAITING) {
+        openHevcContext->c->BL_frame = BL_frame;
+        openHevcContext->state       = LAYER_RUNNING;
+        pthread_cond_broadcast(&openHevcContext->cond);
+    }
+    pthread_mutex_unlock(&openHevcContext->mutex);
+}
+
+static void BL_frame_cb(AVCodecContext *avctx, void *BL_frame)
+{
+    OpenHevcWrapperContext *openHevcContext = avctx->opaque;
+
+    layer_start(openHevcContext->next_layer, BL_frame);
+}
+#endif
+
+static int decode_layer(OpenHevcWrapperContext *openHevcContext)
+{
+    openHevcContext->got_picture = 0;
+    openHevcContext->ret = avcodec_decode_video2(openHevcContext->c, openHevcContext->picture,
+                                                 &openHevcContext->got_picture, &openHevcContext->avpkt);
+#if HAVE_THREADS
+    /* the layer above still has to be run when this one had no picture */
+    layer_start(openHevcContext->next_layer, openHevcContext->c->BL_frame);
+#endif
+    return openHevcContext->ret;
+}
+
+#if HAVE_THREADS
+static void *layer_worker(void *arg)
+{
+    OpenHevcWrapperContext *openHevcContext = arg;
+
+    pthread_mutex_lock(&openHevcContext->mutex);
+    while (!openHevcContext->die) {
+        if (openHevcContext->state == LAYER_RUNNING) {
+            pthread_mutex_unlock(&openHevcContext->mutex);
+            decode_layer(openHevcContext);
+            pthread_mutex_lock(&openHevcContext->mutex);
+            openHevcContext->state = LAYER_IDLE;
+            pthread_cond_broadcast(&openHevcContext->cond);
+        } else
+            pthread_cond_wait(&openHevcContext->cond, &openHevcContext->mutex);
+    }
+    pthread_mutex_unlock(&openHevcContext->mutex);
+    return NULL;
+}
+
+static void layer_worker_init(OpenHevcWrapperContext *openHevcContext)
+{
+    pthread_mutex_init(&openHevcContext->mutex, NULL);
+    pthread_cond_init(&openHevcContext->cond, NULL);
+    openHevcContext->threaded = !pthread_create(&openHevcContext->thread, NULL,
+                                                layer_worker, openHevcContext);
+    if (!openHevcContext->threaded) {
+        pthread_cond_destroy(&openHevcContext->cond);
+        pthread_mutex_destroy(&openHevcContext->mutex);
+    }
+}
+
+static void layer_worker_uninit(OpenHevcWrapperContext *openHevcContext)
+{
+    if (!openHevcContext->threaded)
+        return;
+
+    pthread_mutex_lock(&openHevcContext->mutex);
+    openHevcContext->die = 1;
+    pthread_cond_broadcast(&openHevcContext->cond);
+    pthread_mutex_unlock(&openHevcContext->mutex);
+    pthread_join(openHevcContext->thread, NULL);
+
+    pthread_cond_destroy(&openHevcContext->cond);
+    pthread_mutex_destroy(&openHevcContext->mutex);
+    openHevcContext->threaded = 0;
+}
+
+static void layer_wait(OpenHevcWrapperContext *openHevcContext)
+{
+    pthread_mutex_lock(&openHevcContext->mutex);
+    while (openHevcContext->state != LAYER_IDLE)
+        pthread_cond_wait(&openHevcContext->cond, &openHevcContext->mutex);
+    pthread_mutex_unlock(&openHevcContext->mutex);
+}
+#endif
+
+static void picture_hash_cb(AVCodecContext *avctx, int poc, int hash_type, int mismatch)
+{
+    OpenHevcWrapperContext *openHevcContext = avctx->opaque;
+
+    openHevcContext->picture_hash_cb(openHevcContext->picture_hash_opaque,
+                                     openHevcContext->layer_id, poc, hash_type, mismatch);
+}
+
+static void set_keyframes_only(AVCodecContext *c, int val)
+{
+    c->skip_frame       = val > 0 ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+    c->skip_loop_filter = val > 1 ? AVDISCARD_ALL    : AVDISCARD_DEFAULT;
+}
+
+static void decoder_free(OpenHevcWrapperContext *openHevcContext)
+{
+#if HAVE_THREADS
+    layer_worker_uninit(openHevcContext);
+#endif
+    avcodec_close(openHevcContext->c);
+    if (openHevcContext->parser)
+        av_parser_close(openHevcContext->parser);
+    if (openHevcContext->c)
+        av_freep(&openHevcContext->c->extradata);
+    av_freep(&openHevcContext->c);
+    av_freep(&openHevcContext->picture);
+    av_freep(&openHevcContext);
+}
+
+static OpenHevcWrapperContext *decoder_create(OpenHevcWrapperContexts *openHevcContexts, int layer_id)
+{
+    OpenHevcWrapperContext *openHevcContext = av_mallocz(sizeof(OpenHevcWrapperContext));
+
+    if (!openHevcContext)
+        return NULL;
+    openHevcContext->layer_id = layer_id;
+    av_init_packet(&openHevcContext->avpkt);
+    openHevcContext->codec = avcodec_find_decoder(AV_CODEC_ID_HEVC);
+    if (!openHevcContext->codec) {
+        fprintf(stderr, "codec not found\n");
+        av_freep(&openHevcContext);
+        return NULL;
+    }
+
+    openHevcContext->parser  = av_parser_init( openHevcContext->codec->id );
+    openHevcContext->c       = avcodec_alloc_context3(openHevcContext->codec);
+    openHevcContext->picture = avcodec_alloc_frame();
+    if (!openHevcContext->c || !openHevcContext->picture) {
+        decoder_free(openHevcContext);
+        return NULL;
+    }
+    openHevcContext->c->opaque = openHevcContext;
+
+    if(openHevcContext->codec->capabilities&CODEC_CAP_TRUNCATED)
+        openHevcContext->c->flags |= CODEC_FLAG_TRUNCATED; /* we do not send complete frames */
+
+    /* For some codecs, such as msmpeg4 and mpeg4, width and height
+     MUST be initialized there because this information is not
+     available in the bitstream. */
+
+    /*      set thread parameters    */
+    if(openHevcContexts->thread_type == 1)
+        av_opt_set(openHevcContext->c, "thread_type", "frame", 0);
+    else if (openHevcContexts->thread_type == 2)
+        av_opt_set(openHevcContext->c, "thread_type", "slice", 0);
+    else
+        av_opt_set(openHevcContext->c, "thread_type", "frameslice", 0);
+
+    av_opt_set_int(openHevcContext->c, "threads", openHevcContexts->nb_pthreads, 0);
+
+    /*  Set the decoder id    */
+    av_opt_set_int(openHevcContext->c->priv_data, "decoder-id", layer_id, 0);
+
+    av_opt_set_int(openHevcContext->c->priv_data, "decode-checksum", openHevcContexts->check_md5, 0);
+    if (openHevcContexts->temporal_layer_id >= 0)
+        av_opt_set_int(openHevcContext->c->priv_data, "temporal-layer-id", openHevcContexts->temporal_layer_id, 0);
+    openHevcContext->c->temporal_layers = openHevcContexts->temporal_layers;
+    openHevcContext->c->temporal_switch = openHevcContexts->temporal_switch;
+    set_keyframes_only(openHevcContext->c, openHevcContexts->keyframes_only);
+    av_opt_set_int(openHevcContext->c->priv_data, "cpu-flags-mask", openHevcContexts->cpu_flags_mask, 0);
+    if (openHevcContexts->no_cropping >= 0)
+        av_opt_set_int(openHevcContext->c->priv_data, "no-cropping", openHevcContexts->no_cropping, 0);
+    openHevcContext->picture_hash_cb     = openHevcContexts->picture_hash_cb;
+    openHevcContext->picture_hash_opaque = openHevcContexts->picture_hash_opaque;
+    openHevcContext->c->picture_hash_cb  = openHevcContexts->picture_hash_cb ? picture_hash_cb : NULL;
+
+    if (openHevcContexts->extra_data) {
+        openHevcContext->c->extradata = av_mallocz(openHevcContexts->extra_size_alloc);
+        if (openHevcContext->c->extradata) {
+            memcpy(openHevcContext->c->extradata, openHevcContexts->extra_data, openHevcContexts->extra_size_alloc);
+            openHevcContext->c->extradata_size = openHevcContexts->extra_size_alloc;
         }
+    }
+    return openHevcContext;
+}
 
-        openHevcContext->parser  = av_parser_init( openHevcContext->codec->id );
-        openHevcContext->c       = avcodec_alloc_context3(openHevcContext->codec);
-        openHevcContext->picture = avcodec_alloc_frame();
+static int decoder_open(OpenHevcWrapperContext *openHevcContext)
+{
+    if (avcodec_open2(openHevcContext->c, openHevcContext->codec, NULL) < 0) {
+        fprintf(stderr, "could not open codec\n");
+        return -1;
+    }
+#if HAVE_THREADS
+    if (openHevcContext->layer_id)
+        layer_worker_init(openHevcContext);
+#endif
+    return 0;
+}
 
-        if(openHevcContext->codec->capabilities&CODEC_CAP_TRUNCATED)
-            openHevcContext->c->flags |= CODEC_FLAG_TRUNCATED; /* we do not send complete frames */
+static int target_layer(OpenHevcWrapperContexts *openHevcContexts)
+{
+    return FFMIN3(openHevcContexts->max_layer, openHevcContexts->layer_cap,
+                  openHevcContexts->nb_decoders - 1);
+}
 
-        /* For some codecs, such as msmpeg4 and mpeg4, width and height
-         MUST be initialized there because this information is not
-         available in the bitstream. */
+/*
+ * Create the decoders of the layers the base layer decoder has found in the
+ * VPS, up to the requested one. They start decoding with the AU of that VPS,
+ * unless the layers below them are dropped.
+ */
+static void update_layers(OpenHevcWrapperContexts *openHevcContexts)
+{
+    int nb_layers = FFMIN(openHevcContexts->wraper[0]->c->nb_layers,
+                          openHevcContexts->max_layer + 1);
+    int top_layer = openHevcContexts->nb_decoders - 1;
+    OpenHevcWrapperContext **wraper;
 
-        /*      set thread parameters    */
-        if(thread_type == 1)
-            av_opt_set(openHevcContext->c, "thread_type", "frame", 0);
-        else if (thread_type == 2)
-            av_opt_set(openHevcContext->c, "thread_type", "slice", 0);
-        else
-            av_opt_set(openHevcContext->c, "thread_type", "frameslice", 0);
+    if (nb_layers <= openHevcContexts->nb_decoders)
+        return;
+    wraper = av_realloc(openHevcContexts->wraper, nb_layers * sizeof(*wraper));
+    if (!wraper)
+        return;
+    openHevcContexts->wraper = wraper;
+
+    while (openHevcContexts->nb_decoders < nb_layers) {
+        OpenHevcWrapperContext *openHevcContext = decoder_create(openHevcContexts,
+                                                                 openHevcContexts->nb_decoders);
+        if (!openHevcContext)
+            break;
+        if (decoder_open(openHevcContext) < 0) {
+            decoder_free(openHevcContext);
+            break;
+        }
+        wraper[openHevcContexts->nb_decoders++] = openHevcContext;
+    }
+    if (openHevcContexts->active_layer == top_layer)
+        openHevcContexts->active_layer = FFMAX(target_layer(openHevcContexts), top_layer);
+}
+
+/*
+ * Whether the AU holds an IRAP picture of the layer, from which the layer
+ * can be decoded without its previous pictures.
+ */
+static int au_has_irap(OpenHevcWrapperContexts *openHevcContexts,
+                       const uint8_t *buf, int len, int layer_id)
+{
+    int nal_length_size = openHevcContexts->nal_length_size;
+    int i = 0, k;
+
+    while (i + 2 < len) {
+        int nal, nal_size = 0;
+
+        if (nal_length_size) {
+            for (k = 0; k < nal_length_size && i + k < len; k++)
+                nal_size = (nal_size << 8) | buf[i + k];
+            nal = i + nal_length_size;
+            i   = nal + nal_size;
+        } else {
+            if (buf[i] || buf[i + 1] || buf[i + 2] != 1) {
+                i++;
+                continue;
+            }
+            nal = i += 3;
+        }
+        if (nal + 1 < len) {
+            int type         = (buf[nal] >> 1) & 0x3f;
+            int nuh_layer_id = ((buf[nal] & 1) << 5) | (buf[nal + 1] >> 3);
+
+            // BLA_W_LP to RSV_IRAP_VCL23
+            if (nuh_layer_id == layer_id && type >= 16 && type <= 23)
+                return 1;
+        }
+    }
+    return 0;
+}
 
-        av_opt_set_int(openHevcContext->c, "threads", nb_pthreads, 0);
+/*
+ * The layers above the target are dropped right away, as the layers below
+ * never reference them. A dropped layer is only resumed at an IRAP picture
+ * of its own, with its DPB flushed, as it has missed the pictures before.
+ */
+static void drop_layers(OpenHevcWrapperContexts *openHevcContexts)
+{
+    int target = target_layer(openHevcContexts);
+
+    if (target < openHevcContexts->active_layer) {
+        openHevcContexts->active_layer = target;
+        openHevcContexts->nb_timed     = 0;
+        openHevcContexts->resumed      = 0;
+    }
+}
+
+static void resume_layers(OpenHevcWrapperContexts *openHevcContexts,
+                          const uint8_t *buf, int len)
+{
+    int target = target_layer(openHevcContexts);
 
-        /*  Set the decoder id    */
-        av_opt_set_int(openHevcContext->c->priv_data, "decoder-id", i, 0);
+    while (openHevcContexts->active_layer < target &&
+           au_has_irap(openHevcContexts, buf, len, openHevcContexts->active_layer + 1)) {
+        avcodec_flush_buffers(openHevcContexts->wraper[++openHevcContexts->active_layer]->c);
+        openHevcContexts->nb_timed = 0;
+        openHevcContexts->resumed  = 1;
     }
+}
+
+/*
+ * Lower the layer cap when the average decoding time of an AU exceeds its
+ * real-time budget, and raise it again once there is a quarter of headroom.
+ * A layer dropped again soon after it was resumed waits twice as long
+ * before the next attempt.
+ */
+static void adapt_layers(OpenHevcWrapperContexts *openHevcContexts, int64_t time)
+{
+    AVCodecContext *c = openHevcContexts->wraper[0]->c;
+    int64_t budget    = openHevcContexts->frame_duration;
+
+    if (!budget && c->time_base.num > 0 && c->time_base.den > 0)
+        budget = av_rescale(AV_TIME_BASE, c->time_base.num, c->time_base.den);
+    if (budget <= 0)
+        return;
+
+    if (!openHevcContexts->decode_time)
+        openHevcContexts->decode_time = time;
+    openHevcContexts->decode_time += (time - openHevcContexts->decode_time) / ADAPT_WINDOW;
+    if (++openHevcContexts->nb_timed < ADAPT_WINDOW)
+        return;
+
+    if (openHevcContexts->decode_time > budget && openHevcContexts->active_layer > 0) {
+        if (openHevcContexts->resumed && openHevcContexts->nb_timed < openHevcContexts->hold)
+            openHevcContexts->hold = FFMIN(openHevcContexts->hold * 2, ADAPT_MAX_HOLD);
+        else if (openHevcContexts->resumed)
+            openHevcContexts->hold = ADAPT_MIN_HOLD;
+        openHevcContexts->layer_cap = openHevcContexts->active_layer - 1;
+        drop_layers(openHevcContexts);
+    } else if (openHevcContexts->decode_time < budget * 3 / 4 &&
+               openHevcContexts->nb_timed >= openHevcContexts->hold &&
+               openHevcContexts->layer_cap < openHevcContexts->active_layer + 1 &&
+               openHevcContexts->active_layer < FFMIN(openHevcContexts->max_layer,
+                                                      openHevcContexts->nb_decoders - 1)) {
+        openHevcContexts->layer_cap = openHevcContexts->active_layer + 1;
+    }
+}
+
+OpenHevc_Handle libOpenHevcInit(int nb_pthreads, int thread_type)
+{
+    /* register all the codecs */
+    OpenHevcWrapperContexts *openHevcContexts = av_mallocz(sizeof(OpenHevcWrapperContexts));
+
+    if (!openHevcContexts)
+        return NULL;
+    avcodec_register_all();
+    openHevcContexts->nb_pthreads       = nb_pthreads;
+    openHevcContexts->thread_type       = thread_type;
+    openHevcContexts->temporal_layer_id = -1;
+    openHevcContexts->no_cropping       = -1;
+    openHevcContexts->cpu_flags_mask    = -1;
+    openHevcContexts->layer_cap         = MAX_DECODERS - 1;
+    openHevcContexts->hold              = ADAPT_MIN_HOLD;
+
+    /* the base layer decoder, the others wait for the VPS */
+    openHevcContexts->wraper = av_malloc(sizeof(OpenHevcWrapperContext*));
+    if (!openHevcContexts->wraper) {
+        av_freep(&openHevcContexts);
+        return NULL;
+    }
+    openHevcContexts->wraper[0] = decoder_create(openHevcContexts, 0);
+    if (!openHevcContexts->wraper[0]) {
+        av_freep(&openHevcContexts->wraper);
+        av_freep(&openHevcContexts);
+        return NULL;
+    }
+    openHevcContexts->nb_decoders = 1;
     return (OpenHevc_Handle) openHevcContexts;
 }
 
 int libOpenHevcStartDecoder(OpenHevc_Handle openHevcHandle)
 {
     OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
-    OpenHevcWrapperContext  *openHevcContext;
     int i;
+
     for(i=0; i < openHevcContexts->nb_decoders; i++) {
-        openHevcContext = openHevcContexts->wraper[i];
-        if (avcodec_open2(openHevcContext->c, openHevcContext->codec, NULL) < 0) {
-            fprintf(stderr, "could not open codec\n");
-            return NULL;
-        }
+        if (decoder_open(openHevcContexts->wraper[i]) < 0)
+            return 0;
     }
+    openHevcContexts->started = 1;
     return 1;
 }
 
+/*
+ * The layers of an AU are decoded as a pipeline: each enhancement layer
+ * decoder is started on its own thread as soon as the layer below has
+ * started its picture, and then waits for the CTB rows of that picture as
+ * they get decoded. The pipeline does not cross AUs: the call returns once
+ * every layer is done with the AU, so the base layer only starts the next
+ * AU after the enhancement layers have finished this one.
+ */
 int libOpenHevcDecode(OpenHevc_Handle openHevcHandle, const unsigned char *buff, int au_len, int64_t pts)
 {
-    int got_picture[MAX_DECODERS], len, i;
     OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
     OpenHevcWrapperContext  *openHevcContext;
-    for(i =0; i <= openHevcContexts->active_layer; i++)  {
-        got_picture[i]              = 0;
+    int64_t start = av_gettime();
+    int active_layer;
+    int i;
+
+    drop_layers(openHevcContexts);
+    active_layer = openHevcContexts->active_layer;
+    for(i =0; i <= active_layer; i++)  {
         openHevcContext             = openHevcContexts->wraper[i];
         openHevcContext->avpkt.size = au_len;
-        openHevcContext->avpkt.data = buff;
+        openHevcContext->avpkt.data = (uint8_t *) buff; // only read by the decoder
         openHevcContext->avpkt.pts  = pts;
-        len                         = avcodec_decode_video2( openHevcContext->c, openHevcContext->picture,
-                                                             &got_picture[i], &openHevcContext->avpkt);
-        if(i+1 < openHevcContexts->nb_decoders)
-            openHevcContexts->wraper[i+1]->c->BL_frame = openHevcContexts->wraper[i]->c->BL_frame;
+#if HAVE_THREADS
+        openHevcContext->next_layer = i < active_layer ? openHevcContexts->wraper[i+1] : NULL;
+        /* a frame threaded decoder may only start its picture once it has
+         * returned, so the layer above is then run after it */
+        openHevcContext->c->BL_frame_cb = openHevcContext->next_layer &&
+                                          openHevcContext->next_layer->threaded &&
+                                          !(openHevcContext->c->active_thread_type & FF_THREAD_FRAME) ? BL_frame_cb : NULL;
+        if (i && openHevcContext->threaded) {
+            pthread_mutex_lock(&openHevcContext->mutex);
+            openHevcContext->state = LAYER_WAITING;
+            pthread_mutex_unlock(&openHevcContext->mutex);
+        }
+#endif
+    }
+
+    decode_layer(openHevcContexts->wraper[0]);
+    /* the layers first announced by the VPS of this AU, or resumed at it,
+     * are run after the layers below them */
+    if (openHevcContexts->started)
+        update_layers(openHevcContexts);
+    if (au_len > 0)
+        resume_layers(openHevcContexts, buff, au_len);
+    for(i = 1; i <= openHevcContexts->active_layer; i++)  {
+        openHevcContext = openHevcContexts->wraper[i];
+#if HAVE_THREADS
+        if (i <= active_layer && openHevcContext->threaded) {
+            layer_wait(openHevcContext);
+            continue;
+        }
+#endif
+        openHevcContext->avpkt.size  = au_len;
+        openHevcContext->avpkt.data  = (uint8_t *) buff;
+        openHevcContext->avpkt.pts   = pts;
+        openHevcContext->c->BL_frame = openHevcContexts->wraper[i-1]->c->BL_frame;
+        decode_layer(openHevcContext);
     }
-    if (len < 0) {
+
+    if (openHevcContexts->adaptive_layers && au_len > 0)
+        adapt_layers(openHevcContexts, av_gettime() - start);
+
+    openHevcContext = openHevcContexts->wraper[openHevcContexts->active_layer];
+    if (openHevcContext->ret < 0) {
         fprintf(stderr, "Error while decoding frame \n");
         return -1;
     }
-    return got_picture[openHevcContexts->active_layer];
+    return openHevcContext->got_picture;
 }
 
 void libOpenHevcCopyExtraData(OpenHevc_Handle openHevcHandle, unsigned char *extra_data, int extra_size_alloc)
@@ -130,9 +574,26 @@ void libOpenHevcCopyExtraData(OpenHevc_Handle openHevcHandle, unsigned char *ext
     int i;
     OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
     OpenHevcWrapperContext  *openHevcContext;
-    for(i =0; i <= openHevcContexts->active_layer; i++)  {
+
+    /* kept for the decoders created later */
+    av_freep(&openHevcContexts->extra_data);
+    openHevcContexts->extra_data = av_malloc(extra_size_alloc);
+    if (!openHevcContexts->extra_data)
+        return;
+    memcpy(openHevcContexts->extra_data, extra_data, extra_size_alloc);
+    openHevcContexts->extra_size_alloc = extra_size_alloc;
+    /* hvcC extradata, as told apart by the decoder */
+    if (extra_size_alloc > 21 && (extra_data[0] || extra_data[1] || extra_data[2] > 1))
+        openHevcContexts->nal_length_size = (extra_data[21] & 3) + 1;
+    else
+        openHevcContexts->nal_length_size = 0;
+
+    for(i =0; i < openHevcContexts->nb_decoders; i++)  {
         openHevcContext = openHevcContexts->wraper[i];
+        av_freep(&openHevcContext->c->extradata);
         openHevcContext->c->extradata = (uint8_t*)av_mallocz(extra_size_alloc);
+        if (!openHevcContext->c->extradata)
+            continue;
         memcpy( openHevcContext->c->extradata, extra_data, extra_size_alloc);
         openHevcContext->c->extradata_size = extra_size_alloc;
 	}
@@ -250,16 +711,59 @@ void libOpenHevcSetDebugMode(OpenHevc_Handle openHevcHandle, int val)
         av_log_set_level(AV_LOG_DEBUG);
 }
 
+void libOpenHevcSetMaxSimdTier(OpenHevc_Handle openHevcHandle, int tier)
+{
+    OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
+    int mask = -1, i;
+
+    switch (tier) {
+    case OPENHEVC_SIMD_C:
+        mask = 0;
+        break;
+    case OPENHEVC_SIMD_SSE4:
+        mask &= ~(AV_CPU_FLAG_AVX | AV_CPU_FLAG_XOP | AV_CPU_FLAG_FMA4 | AV_CPU_FLAG_AVX2);
+        /* fall through */
+    case OPENHEVC_SIMD_AVX2:
+        mask &= ~AV_CPU_FLAG_AVX512;
+        break;
+    case OPENHEVC_SIMD_AVX512:
+        break;
+    default:
+        fprintf(stderr, "Unknown SIMD tier %d, leaving all the CPU features enabled\n", tier);
+        break;
+    }
+    openHevcContexts->cpu_flags_mask = mask;
+    for (i = 0; i < openHevcContexts->nb_decoders; i++)
+        av_opt_set_int(openHevcContexts->wraper[i]->c->priv_data, "cpu-flags-mask", mask, 0);
+}
+
 void libOpenHevcSetActiveDecoders(OpenHevc_Handle openHevcHandle, int val)
 {
     OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
 
-    if (val >= 0 && val < openHevcContexts->nb_decoders)
-        openHevcContexts->active_layer = val;
+    if (val >= 0 && val < MAX_DECODERS)
+        openHevcContexts->max_layer = val;
     else {
-        fprintf(stderr, "The requested layer %d can not be decoded (it exceeds the number of allocated decoders %d ) \n", val, openHevcContexts->nb_decoders);
-        openHevcContexts->active_layer = openHevcContexts->nb_decoders-1;
+        fprintf(stderr, "The requested layer %d can not be decoded (it exceeds the number of decoders %d ) \n", val, MAX_DECODERS);
+        openHevcContexts->max_layer = MAX_DECODERS-1;
     }
+    /* a layer above starts with the VPS that announces it, or at its next
+     * IRAP picture if its decoder was already running */
+    openHevcContexts->active_layer = FFMIN(openHevcContexts->active_layer,
+                                           openHevcContexts->max_layer);
+}
+
+void libOpenHevcSetAdaptiveLayers(OpenHevc_Handle openHevcHandle, int enable, int frame_duration)
+{
+    OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
+
+    openHevcContexts->adaptive_layers = enable;
+    openHevcContexts->frame_duration  = FFMAX(frame_duration, 0);
+    openHevcContexts->decode_time     = 0;
+    openHevcContexts->nb_timed        = 0;
+    openHevcContexts->hold            = ADAPT_MIN_HOLD;
+    if (!enable)
+        openHevcContexts->layer_cap = MAX_DECODERS - 1;
 }
 
 void libOpenHevcSetCheckMD5(OpenHevc_Handle openHevcHandle, int val)
@@ -268,6 +772,7 @@ void libOpenHevcSetCheckMD5(OpenHevc_Handle openHevcHandle, int val)
     OpenHevcWrapperContext  *openHevcContext;
     int i;
 
+    openHevcContexts->check_md5 = val;
     for (i = 0; i < openHevcContexts->nb_decoders; i++) {
         openHevcContext = openHevcContexts->wraper[i];
 
@@ -275,45 +780,96 @@ void libOpenHevcSetCheckMD5(OpenHevc_Handle openHevcHandle, int val)
     }
 }
 
+void libOpenHevcSetPictureHashCallback(OpenHevc_Handle openHevcHandle, OpenHevc_PictureHashCallback cb, void *opaque)
+{
+    OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
+    OpenHevcWrapperContext  *openHevcContext;
+    int i;
+
+    openHevcContexts->picture_hash_cb     = cb;
+    openHevcContexts->picture_hash_opaque = opaque;
+    for (i = 0; i < openHevcContexts->nb_decoders; i++) {
+        openHevcContext = openHevcContexts->wraper[i];
+        openHevcContext->picture_hash_cb     = cb;
+        openHevcContext->picture_hash_opaque = opaque;
+        openHevcContext->c->opaque           = openHevcContext;
+        openHevcContext->c->picture_hash_cb  = cb ? picture_hash_cb : NULL;
+    }
+}
+
 void libOpenHevcSetTemporalLayer_id(OpenHevc_Handle openHevcHandle, int val)
 {
     OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
     OpenHevcWrapperContext  *openHevcContext;
     int i;
 
+    /* HEVC has at most 7 temporal sub-layers, with ids 0 to 6 */
+    val = av_clip(val, 0, 6);
+    openHevcContexts->temporal_layer_id = val;
     for (i = 0; i < openHevcContexts->nb_decoders; i++) {
         openHevcContext = openHevcContexts->wraper[i];
-        av_opt_set_int(openHevcContext->c->priv_data, "temporal-layer-id", val+1, 0);
+        av_opt_set_int(openHevcContext->c->priv_data, "temporal-layer-id", val, 0);
     }
-    
 }
 
-void libOpenHevcSetNoCropping(OpenHevc_Handle openHevcHandle, int val)
+void libOpenHevcSetKeyframesOnly(OpenHevc_Handle openHevcHandle, int val)
+{
+    OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
+    int i;
+
+    openHevcContexts->keyframes_only = val;
+    for (i = 0; i < openHevcContexts->nb_decoders; i++)
+        set_keyframes_only(openHevcContexts->wraper[i]->c, val);
+}
+
+void libOpenHevcSetMaxTemporalLayer(OpenHevc_Handle openHevcHandle, int val, int policy)
 {
     OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
     OpenHevcWrapperContext  *openHevcContext;
     int i;
 
+    /* HEVC has at most 7 temporal sub-layers */
+    openHevcContexts->temporal_layers = val < 0 ? 7 : FFMIN(val, 6) + 1;
+    switch (policy) {
+    case OPENHEVC_TEMPORAL_SWITCH_IRAP:
+        openHevcContexts->temporal_switch = FF_TEMPORAL_SWITCH_IRAP;
+        break;
+    case OPENHEVC_TEMPORAL_SWITCH_ANY:
+        openHevcContexts->temporal_switch = FF_TEMPORAL_SWITCH_ANY;
+        break;
+    default:
+        openHevcContexts->temporal_switch = FF_TEMPORAL_SWITCH_POINT;
+        break;
+    }
     for (i = 0; i < openHevcContexts->nb_decoders; i++) {
         openHevcContext = openHevcContexts->wraper[i];
-        av_opt_set_int(openHevcContext->c->priv_data, "no-cropping", val, 0);
+        openHevcContext->c->temporal_layers = openHevcContexts->temporal_layers;
+        openHevcContext->c->temporal_switch = openHevcContexts->temporal_switch;
     }
 }
 
-void libOpenHevcClose(OpenHevc_Handle openHevcHandle)
+void libOpenHevcSetNoCropping(OpenHevc_Handle openHevcHandle, int val)
 {
     OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
     OpenHevcWrapperContext  *openHevcContext;
     int i;
 
-    for (i = 0; i < openHevcContexts->nb_decoders; i++){
+    openHevcContexts->no_cropping = val;
+    for (i = 0; i < openHevcContexts->nb_decoders; i++) {
         openHevcContext = openHevcContexts->wraper[i];
-        avcodec_close(openHevcContext->c);
-        av_parser_close(openHevcContext->parser);
-        av_freep(&openHevcContext->c);
-        av_freep(&openHevcContext->picture);
-        av_freep(&openHevcContext);
+        av_opt_set_int(openHevcContext->c->priv_data, "no-cropping", val, 0);
     }
+}
+
+void libOpenHevcClose(OpenHevc_Handle openHevcHandle)
+{
+    OpenHevcWrapperContexts *openHevcContexts = (OpenHevcWrapperContexts *) openHevcHandle;
+    int i;
+
+    for (i = 0; i < openHevcContexts->nb_decoders; i++)
+        decoder_free(openHevcContexts->wraper[i]);
+    av_freep(&openHevcContexts->wraper);
+    av_freep(&openHevcContexts->extra_data);
     av_freep(&openHevcContexts);
 }
 
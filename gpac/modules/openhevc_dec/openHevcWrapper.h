@@ -68,8 +68,42 @@ typedef struct OpenHevc_Frame_cpy
    OpenHevc_FrameInfo frameInfo;
 } OpenHevc_Frame_cpy;
 
+/**
+ * Result of the check of a picture against its decoded picture hash SEI.
+ * mismatch is a bitmask of the planes that did not match, 0 if the picture
+ * is correct. May be called from a decoder thread, out of decoding order.
+ */
+typedef void (*OpenHevc_PictureHashCallback)(void *opaque, int layer_id, int poc,
+                                             int hash_type, int mismatch);
+
+/**
+ * Highest SIMD instruction set tier the decoding functions may use, see
+ * libOpenHevcSetMaxSimdTier().
+ */
+typedef enum OpenHevc_SimdTier {
+    OPENHEVC_SIMD_C = 0, ///< plain C functions only
+    OPENHEVC_SIMD_SSE4,  ///< up to SSE4.2
+    OPENHEVC_SIMD_AVX2,  ///< up to AVX2
+    OPENHEVC_SIMD_AVX512 ///< everything the CPU supports (default)
+} OpenHevc_SimdTier;
+
+/**
+ * Pictures at which decoding goes up to more temporal sub-layers, see
+ * libOpenHevcSetMaxTemporalLayer().
+ */
+typedef enum OpenHevc_TemporalSwitch {
+    OPENHEVC_TEMPORAL_SWITCH_POINT = 0, ///< TSA, STSA and IRAP pictures (default)
+    OPENHEVC_TEMPORAL_SWITCH_IRAP,      ///< IRAP pictures only
+    OPENHEVC_TEMPORAL_SWITCH_ANY        ///< the next picture, missing references show as gray
+} OpenHevc_TemporalSwitch;
+
 OpenHevc_Handle libOpenHevcInit(int nb_pthreads, int thread_type);
 int libOpenHevcStartDecoder(OpenHevc_Handle openHevcHandle);
+/**
+ * Decode an AU with every active layer. Within the AU, the enhancement
+ * layers run alongside the layers below them; the call returns once the
+ * highest active layer is done with the AU.
+ */
 int  libOpenHevcDecode(OpenHevc_Handle openHevcHandle, const unsigned char *buff, int nal_len, int64_t pts);
 void libOpenHevcGetPictureInfo(OpenHevc_Handle openHevcHandle, OpenHevc_FrameInfo *openHevcFrameInfo);
 void libOpenHevcCopyExtraData(OpenHevc_Handle openHevcHandle, unsigned char *extra_data, int extra_size_alloc);
@@ -78,10 +112,53 @@ void libOpenHevcGetPictureSize2(OpenHevc_Handle openHevcHandle, OpenHevc_FrameIn
 int  libOpenHevcGetOutput(OpenHevc_Handle openHevcHandle, int got_picture, OpenHevc_Frame *openHevcFrame);
 int  libOpenHevcGetOutputCpy(OpenHevc_Handle openHevcHandle, int got_picture, OpenHevc_Frame_cpy *openHevcFrame);
 void libOpenHevcSetCheckMD5(OpenHevc_Handle openHevcHandle, int val);
+void libOpenHevcSetPictureHashCallback(OpenHevc_Handle openHevcHandle, OpenHevc_PictureHashCallback cb, void *opaque);
 void libOpenHevcSetDebugMode(OpenHevc_Handle openHevcHandle, int val);
+/**
+ * Highest temporal sub-layer id to decode, from 0 to 6; ids out of that
+ * range are clamped.
+ */
 void libOpenHevcSetTemporalLayer_id(OpenHevc_Handle openHevcHandle, int val);
+/**
+ * Set the highest temporal sub-layer to decode, -1 for all of them, e.g. to
+ * decode every 2nd, 4th or 8th picture of a hierarchical-B stream for fast
+ * forward. It may be called at any time: decoding goes down from the next
+ * picture, and up from the next picture the policy, an
+ * OpenHevc_TemporalSwitch, allows. The NAL units of the sub-layers above
+ * are dropped before they are parsed.
+ */
+void libOpenHevcSetMaxTemporalLayer(OpenHevc_Handle openHevcHandle, int val, int policy);
+/**
+ * Decode the IRAP pictures only, e.g. for thumbnails and scrubbing: 0 to
+ * decode all the pictures, 1 for the IRAP pictures only, 2 for the IRAP
+ * pictures only, without the in-loop filters. The other pictures are
+ * dropped before they are parsed and each IRAP picture is output at once.
+ */
+void libOpenHevcSetKeyframesOnly(OpenHevc_Handle openHevcHandle, int val);
 void libOpenHevcSetNoCropping(OpenHevc_Handle openHevcHandle, int val);
+/**
+ * Set the highest layer to decode and output. It may be changed at any time:
+ * the layers above are dropped at once. A layer above starts with the AU of
+ * the VPS that announces it, or at its next IRAP picture once it has been
+ * dropped.
+ */
 void libOpenHevcSetActiveDecoders(OpenHevc_Handle openHevcHandle, int val);
+/**
+ * Drop the enhancement layers, one at a time, when the average decoding time
+ * of an AU exceeds frame_duration (in microseconds, 0 for the frame period
+ * of the stream), and resume them at their IRAP pictures once decoding has
+ * headroom again. The base layer decoder is never flushed. Layers above the
+ * one set with libOpenHevcSetActiveDecoders() are never decoded.
+ */
+void libOpenHevcSetAdaptiveLayers(OpenHevc_Handle openHevcHandle, int enable, int frame_duration);
+/**
+ * Cap the SIMD tier used by the decoder, e.g. to keep AVX-512 off on servers
+ * where its frequency throttling costs more than it gains. The setting only
+ * applies to the decoders of this handle and is picked up when a sequence
+ * parameter set is activated, so it must be set before
+ * libOpenHevcStartDecoder().
+ */
+void libOpenHevcSetMaxSimdTier(OpenHevc_Handle openHevcHandle, int tier);
 
 void libOpenHevcClose(OpenHevc_Handle openHevcHandle);
 void libOpenHevcFlush(OpenHevc_Handle openHevcHandle);
@@ -2740,7 +2740,62 @@ typedef struct AVCodecContext {
      *  this frame is used by the layer (n+1) as refernce frame for inter-layer predictions 
      */
     void* BL_frame;
-    
+
+    /**
+     * Called by the decoder of layer n for SHVC decoding as soon as a
+     * picture has been started, before its CTBs are decoded, with BL_frame
+     * pointing to it. The decoder of layer (n+1) can then be started on the
+     * same access unit: it waits for the CTB rows of BL_frame as they get
+     * decoded, so the two layers are decoded concurrently.
+     * This may be called from a decoder internal thread.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    void (*BL_frame_cb)(struct AVCodecContext *avctx, void *BL_frame);
+
+    /**
+     * Called once per picture carrying a decoded picture hash SEI message,
+     * after the hash has been checked against the decoded samples.
+     * The check runs asynchronously, so this may be called from a decoder
+     * internal thread and out of decoding order.
+     * @param poc        picture order count of the checked picture
+     * @param hash_type  0 for MD5, 1 for CRC, 2 for checksum
+     * @param mismatch   bitmask of the planes that did not match, 0 if the
+     *                   picture is correct
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    void (*picture_hash_cb)(struct AVCodecContext *avctx, int poc, int hash_type, int mismatch);
+
+    /**
+     * Number of layers of the stream for SHVC decoding, base layer included,
+     * as announced by the extension of the last video parameter set; 1 for
+     * a single-layer stream. A decoder is needed per layer to decode.
+     * - encoding: unused
+     * - decoding: Set by libavcodec.
+     */
+    int nb_layers;
+
+    /**
+     * Number of temporal sub-layers to decode, 0 for the decoder default.
+     * It may be changed between packets: fewer sub-layers are decoded from
+     * the next picture on, more from the next picture temporal_switch
+     * allows. The NAL units of the other sub-layers are skipped unparsed.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int temporal_layers;
+
+    /**
+     * Pictures at which decoding goes up to more temporal sub-layers.
+     * - encoding: unused
+     * - decoding: Set by user.
+     */
+    int temporal_switch;
+#define FF_TEMPORAL_SWITCH_POINT 0 ///< TSA, STSA and IRAP pictures
+#define FF_TEMPORAL_SWITCH_IRAP  1 ///< IRAP pictures only
+#define FF_TEMPORAL_SWITCH_ANY   2 ///< any picture, the references missed are replaced with gray pictures
+
 } AVCodecContext;
 
 /**
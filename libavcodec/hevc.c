@@ -23,9 +23,22 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#elif HAVE_W32THREADS
+#include "compat/w32pthreads.h"
+#elif HAVE_OS2THREADS
+#include "compat/os2threads.h"
+#endif
+
 #include "libavutil/atomic.h"
 #include "libavutil/attributes.h"
+#include "libavutil/bswap.h"
+#include "libavutil/cpu.h"
 #include "libavutil/common.h"
+#include "libavutil/crc.h"
 #include "libavutil/internal.h"
 #include "libavutil/md5.h"
 #include "libavutil/opt.h"
@@ -80,31 +93,7 @@ static void display_md5(int poc, uint8_t md5[3][16])
 }
 #endif
 
-static int compare_md5(uint8_t *md5_in1, uint8_t *md5_in2)
-{
-    int i;
-    for (i = 0; i < 16; i++)
-        if (md5_in1[i] != md5_in2[i])
-            return 0;
-    return 1;
-}
-
-static void calc_md5(uint8_t *md5, uint8_t* src, int stride, int width, int height, int pixel_shift)
-{
-    uint8_t *buf;
-    int y, x;
-    int stride_buf = width << pixel_shift;
-    buf = av_malloc(stride_buf * height);
-
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < stride_buf; x++)
-            buf[y * stride_buf + x] = src[x];
-
-        src += stride;
-    }
-    av_md5_sum(md5, buf, stride_buf * height);
-    av_free(buf);
-}
+static const MvField intra_mvf = { { { 0 } }, { 0 }, { 0 }, 1 };
 
 const uint8_t ff_hevc_qpel_extra_before[4] = { 0, 3, 3, 2 };
 const uint8_t ff_hevc_qpel_extra_after[4]  = { 0, 3, 4, 4 };
@@ -123,6 +112,7 @@ const uint8_t ff_hevc_qpel_extra[4]        = { 0, 6, 7, 6 };
 static void pic_arrays_free(HEVCContext *s)
 {
     av_freep(&s->sao);
+    av_freep(&s->sao_no_filter);
     av_freep(&s->deblock);
     av_freep(&s->split_cu_flag);
 
@@ -147,11 +137,7 @@ static void pic_arrays_free(HEVCContext *s)
     av_buffer_pool_uninit(&s->tab_mvf_pool);
     av_buffer_pool_uninit(&s->rpl_tab_pool);
     
-#ifdef SVC_EXTENSION
-    av_freep(&s->buffer_frame[0]);
-    av_freep(&s->buffer_frame[1]);
-    av_freep(&s->buffer_frame[2]);
-#endif
+    ff_hevc_il_free(s);
 }
 
 /* allocate arrays that depend on frame dimensions */
@@ -170,9 +156,10 @@ static int pic_arrays_init(HEVCContext *s, const HEVCSPS *sps)
     s->bs_height = height >> 3;
 
     s->sao           = av_mallocz_array(ctb_count, sizeof(*s->sao));
+    s->sao_no_filter = av_malloc_array(ctb_count, sizeof(*s->sao_no_filter));
     s->deblock       = av_mallocz_array(ctb_count, sizeof(*s->deblock));
     s->split_cu_flag = av_malloc(pic_size);
-    if (!s->sao || !s->deblock || !s->split_cu_flag)
+    if (!s->sao || !s->sao_no_filter || !s->deblock || !s->split_cu_flag)
         goto fail;
 
     s->skip_flag    = av_malloc(pic_size_in_ctb);
@@ -205,7 +192,6 @@ static int pic_arrays_init(HEVCContext *s, const HEVCSPS *sps)
                                           av_buffer_allocz);
     if (!s->tab_mvf_pool || !s->rpl_tab_pool)
         goto fail;
-#ifdef SVC_EXTENSION
     if(s->nuh_layer_id)    {
         int heightBL, widthBL, heightEL, widthEL; 
         if(!s->avctx->BL_frame)    {
@@ -218,8 +204,8 @@ static int pic_arrays_init(HEVCContext *s, const HEVCSPS *sps)
             av_log(s->avctx, AV_LOG_ERROR, "Informations related to the inter layer refrence frame are missing  \n");
             goto fail;
         }
-        heightEL = s->sps->height - s->sps->scaled_ref_layer_window.bottom_offset - s->sps->scaled_ref_layer_window.top_offset;
-        widthEL = s->sps->width   - s->sps->scaled_ref_layer_window.left_offset   - s->sps->scaled_ref_layer_window.right_offset;
+        heightEL = sps->height - sps->scaled_ref_layer_window.bottom_offset - sps->scaled_ref_layer_window.top_offset;
+        widthEL = sps->width   - sps->scaled_ref_layer_window.left_offset   - sps->scaled_ref_layer_window.right_offset;
         
         s->sh.ScalingFactor[s->nuh_layer_id][0] = av_clip(((widthEL  << 8) + (widthBL  >> 1)) / widthBL,  -4096, 4095);
         s->sh.ScalingFactor[s->nuh_layer_id][1] = av_clip(((heightEL << 8) + (heightBL >> 1)) / heightBL, -4096, 4095);
@@ -239,12 +225,11 @@ static int pic_arrays_init(HEVCContext *s, const HEVCSPS *sps)
         s->up_filter_inf.addYCr       = ( ( ( heightBL ) << ( 14 ) ) + ( heightEL >> 1 ) ) / heightEL+ ( 1 << ( 11 ) );
         s->up_filter_inf.scaleXCr     = ( ( widthBL << 16 ) + ( widthEL >> 1 ) ) / widthEL;
         s->up_filter_inf.scaleYCr     = ( ( heightBL << 16 ) + ( heightEL >> 1 ) ) / heightEL;
-        
-        s->buffer_frame[0] = av_malloc(pic_size*sizeof(short));
-        s->buffer_frame[1] = av_malloc((pic_size>>2)*sizeof(short));
-        s->buffer_frame[2] = av_malloc((pic_size>>2)*sizeof(short));
+
+        if (ff_hevc_il_alloc(s, sps, ((HEVCFrame*)s->avctx->BL_frame)->frame->coded_width,
+                                     ((HEVCFrame*)s->avctx->BL_frame)->frame->coded_height) < 0)
+            goto fail;
     }
-#endif
 
     return 0;
 
@@ -253,6 +238,50 @@ fail:
     return AVERROR(ENOMEM);
 }
 
+static void set_weight(HEVCWeight *wp, int denom, int weight, int offset,
+                       int bit_depth)
+{
+    wp->weight = weight;
+    wp->offset = offset * (1 << (bit_depth - 8));
+    wp->shift  = denom + 14 - bit_depth;
+    wp->round  = wp->shift >= 1 ? 1 << (wp->shift - 1) : 0;
+}
+
+/**
+ * Derive the weighted prediction records of the slice from the parsed
+ * weights, and flag the references whose weights are not the default ones
+ * so that the others can use the unweighted prediction.
+ */
+static void init_weight_records(HEVCContext *s)
+{
+    SliceHeader *sh = &s->sh;
+    int bit_depth   = s->sps->bit_depth;
+    int luma_one    = 1 << sh->luma_log2_weight_denom;
+    int chroma_one  = 1 << sh->chroma_log2_weight_denom;
+    int list, i, j;
+
+    for (list = 0; list < 1 + (sh->slice_type == B_SLICE); list++) {
+        const int16_t *luma_weight         = list ? sh->luma_weight_l1   : sh->luma_weight_l0;
+        const int16_t *luma_offset         = list ? sh->luma_offset_l1   : sh->luma_offset_l0;
+        const int16_t (*chroma_weight)[2]  = list ? sh->chroma_weight_l1 : sh->chroma_weight_l0;
+        const int16_t (*chroma_offset)[2]  = list ? sh->chroma_offset_l1 : sh->chroma_offset_l0;
+
+        for (i = 0; i < sh->nb_refs[list]; i++) {
+            set_weight(&sh->luma_wp[list][i], sh->luma_log2_weight_denom,
+                       luma_weight[i], luma_offset[i], bit_depth);
+            sh->wp_explicit[list][i] = luma_weight[i] != luma_one || luma_offset[i];
+            if (s->sps->chroma_format_idc == 0)
+                continue;
+            for (j = 0; j < 2; j++) {
+                set_weight(&sh->chroma_wp[list][i][j], sh->chroma_log2_weight_denom,
+                           chroma_weight[i][j], chroma_offset[i][j], bit_depth);
+                sh->wp_explicit[list][i] |= chroma_weight[i][j] != chroma_one ||
+                                            chroma_offset[i][j];
+            }
+        }
+    }
+}
+
 static void pred_weight_table(HEVCContext *s, GetBitContext *gb)
 {
     int i = 0;
@@ -340,6 +369,7 @@ static void pred_weight_table(HEVCContext *s, GetBitContext *gb)
             }
         }
     }
+    init_weight_records(s);
 }
 
 static int decode_lt_rps(HEVCContext *s, LongTermRPS *rps, GetBitContext *gb)
@@ -393,24 +423,10 @@ static int decode_lt_rps(HEVCContext *s, LongTermRPS *rps, GetBitContext *gb)
 
     return 0;
 }
-#ifdef SVC_EXTENSION
-static void hls_upsample_v_bl_picture(AVCodecContext *avctxt, void *input_ctb_row){
-    HEVCContext *s = avctxt->priv_data;
-    int *channel = input_ctb_row;
-    s->hevcdsp.upsample_v_base_layer_frame( s->EL_frame, s->BL_frame->frame, s->buffer_frame, up_sample_filter_luma, up_sample_filter_chroma, &s->sps->scaled_ref_layer_window, &s->up_filter_inf, *channel);
-
-}
-static void hls_upsample_h_bl_picture(AVCodecContext *avctxt, void *input_ctb_row){
-   HEVCContext *s = avctxt->priv_data;
-    int *channel = input_ctb_row;
-    s->hevcdsp.upsample_h_base_layer_frame( s->EL_frame, s->BL_frame->frame, s->buffer_frame, up_sample_filter_luma, up_sample_filter_chroma, &s->sps->scaled_ref_layer_window, &s->up_filter_inf, *channel);
-    
-}
-#endif
 
 static int set_sps(HEVCContext *s, const HEVCSPS *sps)
 {
-    int ret;
+    int cpu_flags, ret;
 
     pic_arrays_free(s);
     ret = pic_arrays_init(s, sps);
@@ -441,9 +457,10 @@ static int set_sps(HEVCContext *s, const HEVCSPS *sps)
         s->avctx->colorspace      = AVCOL_SPC_UNSPECIFIED;
     }
 
-    ff_hevc_pred_init(&s->hpc,     sps->bit_depth);
-    ff_hevc_dsp_init (&s->hevcdsp, sps->bit_depth);
-    ff_videodsp_init (&s->vdsp,    sps->bit_depth);
+    cpu_flags = av_get_cpu_flags() & s->cpu_flags_mask;
+    ff_hevc_pred_init(&s->hpc,     sps->bit_depth, cpu_flags);
+    ff_hevc_dsp_init (&s->hevcdsp, sps->bit_depth, cpu_flags);
+    ff_videodsp_init (&s->vdsp,    sps->bit_depth, cpu_flags);
 
     if (sps->sao_enabled) {
         av_frame_unref(s->tmp_frame);
@@ -729,6 +746,7 @@ static int hls_slice_header(HEVCContext *s)
                 }
             }
 
+            memset(sh->wp_explicit, 0, sizeof(sh->wp_explicit));
             if ((s->pps->weighted_pred_flag   && sh->slice_type == P_SLICE) ||
                 (s->pps->weighted_bipred_flag && sh->slice_type == B_SLICE)) {
                 pred_weight_table(s, gb);
@@ -783,6 +801,14 @@ static int hls_slice_header(HEVCContext *s)
         } else {
             sh->slice_loop_filter_across_slices_enabled_flag = s->pps->seq_loop_filter_across_slices_enabled_flag;
         }
+
+        if (s->avctx->skip_loop_filter >= AVDISCARD_ALL ||
+            (s->avctx->skip_loop_filter >= AVDISCARD_NONKEY && !IS_IRAP(s))) {
+            sh->disable_deblocking_filter_flag       = 1;
+            sh->slice_sample_adaptive_offset_flag[0] = 0;
+            sh->slice_sample_adaptive_offset_flag[1] = 0;
+            sh->slice_sample_adaptive_offset_flag[2] = 0;
+        }
     } else if (!s->slice_initialized) {
         av_log(s->avctx, AV_LOG_ERROR, "Independent slice segment missing.\n");
         return AVERROR_INVALIDDATA;
@@ -1144,55 +1170,73 @@ static int hls_pcm_sample(HEVCContext *s, int x0, int y0, int log2_cb_size)
 }
 
 /**
- * 8.5.3.2.2.1 Luma sample interpolation process
+ * Locate the reference samples of a luma block, including the samples
+ * needed by the interpolation filter. If they do not fit in the (padded)
+ * reference picture, the picture edges are emulated in the edge buffer.
  *
- * @param s HEVC decoding context
- * @param dst target buffer for block data at block position
- * @param dststride stride of the dst buffer
- * @param ref reference picture buffer at origin (0, 0)
- * @param mv motion vector (relative to block position) to get pixel data from
- * @param x_off horizontal position of block from origin (0, 0)
- * @param y_off vertical position of block from origin (0, 0)
- * @param block_w width of block
- * @param block_h height of block
+ * @param srcstride set to the stride of the returned buffer
+ * @return pointer to the reference sample at the block position
  */
-static void luma_mc(HEVCContext *s, int16_t *dst, ptrdiff_t dststride,
-                    AVFrame *ref, const Mv *mv, int x_off, int y_off,
-                    int block_w, int block_h, int idx)
+static uint8_t *luma_mc_src(HEVCContext *s, AVFrame *ref, const Mv *mv,
+                            int x_off, int y_off, int block_w, int block_h,
+                            ptrdiff_t *srcstride)
 {
     HEVCLocalContext *lc = s->HEVClc;
     uint8_t *src         = ref->data[0];
-    ptrdiff_t srcstride  = ref->linesize[0];
     int pic_width        = s->sps->width;
     int pic_height       = s->sps->height;
-    
+    int edge             = s->edge_width;
+
     int mx         = mv->x & 3;
     int my         = mv->y & 3;
     int extra_left = ff_hevc_qpel_extra_before[mx];
     int extra_top  = ff_hevc_qpel_extra_before[my];
-    
-    x_off += mv->x >> 2;
-    y_off += mv->y >> 2;
-    src   += y_off * srcstride + (x_off << s->sps->pixel_shift);
 
+    *srcstride = ref->linesize[0];
+    x_off     += mv->x >> 2;
+    y_off     += mv->y >> 2;
+    src       += y_off * *srcstride + (x_off << s->sps->pixel_shift);
 
-    if (x_off < extra_left || y_off < extra_top ||
-        x_off >= pic_width - block_w - ff_hevc_qpel_extra_after[mx] ||
-        y_off >= pic_height - block_h - ff_hevc_qpel_extra_after[my]) {
-        //srcstride = ;
-        int offset      = extra_top * srcstride + (extra_left << s->sps->pixel_shift);
+    if (x_off < extra_left - edge || y_off < extra_top - edge ||
+        x_off >= pic_width + edge - block_w - ff_hevc_qpel_extra_after[mx] ||
+        y_off >= pic_height + edge - block_h - ff_hevc_qpel_extra_after[my]) {
+        int offset      = extra_top * *srcstride + (extra_left << s->sps->pixel_shift);
         int offset_edge = extra_top * MAX_EDGE_BUFFER_STRIDE + (extra_left << s->sps->pixel_shift);
-        
+
         s->vdsp.emulated_edge_mc(lc->edge_emu_buffer, src - offset,
-                                 srcstride, MAX_EDGE_BUFFER_STRIDE,
+                                 *srcstride, MAX_EDGE_BUFFER_STRIDE,
                                  block_w + ff_hevc_qpel_extra[mx],
                                  block_h + ff_hevc_qpel_extra[my],
                                  x_off - extra_left, y_off - extra_top,
                                  pic_width, pic_height);
-        src = lc->edge_emu_buffer + offset_edge;
-        srcstride = MAX_EDGE_BUFFER_STRIDE;
-        
+        src        = lc->edge_emu_buffer + offset_edge;
+        *srcstride = MAX_EDGE_BUFFER_STRIDE;
     }
+    return src;
+}
+
+/**
+ * 8.5.3.2.2.1 Luma sample interpolation process
+ *
+ * @param s HEVC decoding context
+ * @param dst target buffer for block data at block position
+ * @param dststride stride of the dst buffer
+ * @param ref reference picture buffer at origin (0, 0)
+ * @param mv motion vector (relative to block position) to get pixel data from
+ * @param x_off horizontal position of block from origin (0, 0)
+ * @param y_off vertical position of block from origin (0, 0)
+ * @param block_w width of block
+ * @param block_h height of block
+ */
+static void luma_mc(HEVCContext *s, int16_t *dst, ptrdiff_t dststride,
+                    AVFrame *ref, const Mv *mv, int x_off, int y_off,
+                    int block_w, int block_h, int idx)
+{
+    ptrdiff_t srcstride;
+    uint8_t *src = luma_mc_src(s, ref, mv, x_off, y_off, block_w, block_h, &srcstride);
+    int mx       = mv->x & 3;
+    int my       = mv->y & 3;
+
     if(!!mx && !!my)
         s->hevcdsp.put_hevc_qpel_hv(dst, dststride, src, srcstride,
                     block_w, block_h, my, mx, s, idx);
@@ -1201,7 +1245,81 @@ static void luma_mc(HEVCContext *s, int16_t *dst, ptrdiff_t dststride,
                                      block_h);
 }
 
+/**
+ * Luma uni-prediction: interpolate the block and store it as pixels.
+ *
+ * @param dst target picture samples at block position
+ */
+static void luma_mc_uni(HEVCContext *s, uint8_t *dst, ptrdiff_t dststride,
+                        AVFrame *ref, const Mv *mv, int x_off, int y_off,
+                        int block_w, int block_h, int idx)
+{
+    ptrdiff_t srcstride;
+    uint8_t *src = luma_mc_src(s, ref, mv, x_off, y_off, block_w, block_h, &srcstride);
+
+    s->hevcdsp.put_hevc_qpel_uni[idx][mv->y & 3][mv->x & 3](dst, dststride,
+                                                            src, srcstride,
+                                                            block_w, block_h);
+}
+
+/**
+ * Luma bi-prediction: interpolate the block from the second reference and
+ * average it with the first list prediction.
+ *
+ * @param dst target picture samples at block position
+ * @param src2 interpolated first list prediction, as output by luma_mc()
+ */
+static void luma_mc_bi(HEVCContext *s, uint8_t *dst, ptrdiff_t dststride,
+                       AVFrame *ref, const Mv *mv, int x_off, int y_off,
+                       int block_w, int block_h,
+                       int16_t *src2, ptrdiff_t src2stride, int idx)
+{
+    ptrdiff_t srcstride;
+    uint8_t *src = luma_mc_src(s, ref, mv, x_off, y_off, block_w, block_h, &srcstride);
 
+    s->hevcdsp.put_hevc_qpel_bi[idx][mv->y & 3][mv->x & 3](dst, dststride,
+                                                           src, srcstride,
+                                                           src2, src2stride,
+                                                           block_w, block_h);
+}
+
+/**
+ * Chroma counterpart of luma_mc_src() for the plane c_idx. The Cb and Cr
+ * blocks are emulated into separate buffers so both can be in use at once.
+ */
+static uint8_t *chroma_mc_src(HEVCContext *s, AVFrame *ref, int c_idx,
+                              const Mv *mv, int x_off, int y_off,
+                              int block_w, int block_h, ptrdiff_t *srcstride)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    uint8_t *edge_buf    = c_idx == 2 ? lc->edge_emu_buffer2 : lc->edge_emu_buffer;
+    uint8_t *src         = ref->data[c_idx];
+    int pic_width        = s->sps->width >> 1;
+    int pic_height       = s->sps->height >> 1;
+    int edge             = s->edge_width >> 1;
+
+    *srcstride = ref->linesize[c_idx];
+    x_off     += mv->x >> 3;
+    y_off     += mv->y >> 3;
+    src       += y_off * *srcstride + (x_off << s->sps->pixel_shift);
+
+    if (x_off < EPEL_EXTRA_BEFORE - edge || y_off < EPEL_EXTRA_AFTER - edge ||
+        x_off >= pic_width + edge - block_w - EPEL_EXTRA_AFTER ||
+        y_off >= pic_height + edge - block_h - EPEL_EXTRA_AFTER) {
+        int offset      = EPEL_EXTRA_BEFORE * (*srcstride + (1 << s->sps->pixel_shift));
+        int offset_edge = EPEL_EXTRA_BEFORE * (MAX_EDGE_BUFFER_STRIDE + (1 << s->sps->pixel_shift));
+
+        s->vdsp.emulated_edge_mc(edge_buf, src - offset,
+                                 *srcstride, MAX_EDGE_BUFFER_STRIDE,
+                                 block_w + EPEL_EXTRA, block_h + EPEL_EXTRA,
+                                 x_off - EPEL_EXTRA_BEFORE,
+                                 y_off - EPEL_EXTRA_BEFORE,
+                                 pic_width, pic_height);
+        src        = edge_buf + offset_edge;
+        *srcstride = MAX_EDGE_BUFFER_STRIDE;
+    }
+    return src;
+}
 
 /**
  * 8.5.3.2.2.2 Chroma sample interpolation process
@@ -1221,109 +1339,182 @@ static void chroma_mc(HEVCContext *s, int16_t *dst1, int16_t *dst2,
                       ptrdiff_t dststride, AVFrame *ref, const Mv *mv,
                       int x_off, int y_off, int block_w, int block_h, int idx)
 {
-    HEVCLocalContext *lc = s->HEVClc;
-    uint8_t *src1        = ref->data[1];
-    uint8_t *src2        = ref->data[2];
-    ptrdiff_t src1stride = ref->linesize[1];
-    ptrdiff_t src2stride = ref->linesize[2];
-    int pic_width        = s->sps->width >> 1;
-    int pic_height       = s->sps->height >> 1;
-    int emulated_edge_mc = 0;
-    int offset_edge      = 0;
-    int mx               = mv->x & 7;
-    int my               = mv->y & 7;
-    
-    x_off += mv->x >> 3;
-    y_off += mv->y >> 3;
-    src1  += y_off * src1stride + (x_off << s->sps->pixel_shift);
-    src2  += y_off * src2stride + (x_off << s->sps->pixel_shift);
-    
-    if (x_off < EPEL_EXTRA_BEFORE || y_off < EPEL_EXTRA_AFTER ||
-        x_off >= pic_width - block_w - EPEL_EXTRA_AFTER ||
-        y_off >= pic_height - block_h - EPEL_EXTRA_AFTER) {
-        offset_edge      = EPEL_EXTRA_BEFORE * (MAX_EDGE_BUFFER_STRIDE + (1 << s->sps->pixel_shift));
-        emulated_edge_mc = 1;
-    }
-    if (emulated_edge_mc == 1) {
-        int offset1     = EPEL_EXTRA_BEFORE * (src1stride + (1 << s->sps->pixel_shift));
-        s->vdsp.emulated_edge_mc(lc->edge_emu_buffer, src1 - offset1,
-                                 src1stride, MAX_EDGE_BUFFER_STRIDE,
-                                 block_w + EPEL_EXTRA, block_h + EPEL_EXTRA,
-                                 x_off - EPEL_EXTRA_BEFORE,
-                                 y_off - EPEL_EXTRA_BEFORE,
-                                 pic_width, pic_height);
-        src1       = lc->edge_emu_buffer + offset_edge;
-        src1stride = MAX_EDGE_BUFFER_STRIDE;
-    }
-    if(!!mx && !!my)
-    {
+    ptrdiff_t src1stride, src2stride;
+    uint8_t *src1 = chroma_mc_src(s, ref, 1, mv, x_off, y_off, block_w, block_h, &src1stride);
+    uint8_t *src2 = chroma_mc_src(s, ref, 2, mv, x_off, y_off, block_w, block_h, &src2stride);
+    int mx        = mv->x & 7;
+    int my        = mv->y & 7;
+
+    if (src1stride == src2stride) {
+        s->hevcdsp.put_hevc_epel_uv[idx][!!my][!!mx](dst1, dst2, dststride,
+                                                     src1, src2, src1stride,
+                                                     block_w, block_h, mx, my);
+    } else if (mx && my) {
         s->hevcdsp.put_hevc_epel_hv(dst1, dststride, src1, src1stride,
-                    block_w, block_h, mx, my,s, idx);
-    }else
-    s->hevcdsp.put_hevc_epel[idx][!!my][!!mx](dst1, dststride, src1, src1stride,
-            block_w, block_h, mx, my);
-
-    if (emulated_edge_mc == 1) {
-        int offset2     = EPEL_EXTRA_BEFORE * (src2stride + (1 << s->sps->pixel_shift));
-        s->vdsp.emulated_edge_mc(lc->edge_emu_buffer, src2 - offset2,
-                                 src2stride, MAX_EDGE_BUFFER_STRIDE,
-                                 block_w + EPEL_EXTRA, block_h + EPEL_EXTRA,
-                                 x_off - EPEL_EXTRA_BEFORE,
-                                 y_off - EPEL_EXTRA_BEFORE,
-                                 pic_width, pic_height);
-        src2       = lc->edge_emu_buffer + offset_edge;
-        src2stride = MAX_EDGE_BUFFER_STRIDE;
-    }
-    if(!!mx && !!my)
-    {
+                                    block_w, block_h, mx, my, s, idx);
         s->hevcdsp.put_hevc_epel_hv(dst2, dststride, src2, src2stride,
-                    block_w, block_h, mx, my,
-                    s, idx);
-    }else
-    s->hevcdsp.put_hevc_epel[idx][!!my][!!mx](dst2, dststride, src2, src2stride,
-            block_w, block_h, mx, my);
+                                    block_w, block_h, mx, my, s, idx);
+    } else {
+        s->hevcdsp.put_hevc_epel[idx][!!my][!!mx](dst1, dststride, src1, src1stride,
+                                                  block_w, block_h, mx, my);
+        s->hevcdsp.put_hevc_epel[idx][!!my][!!mx](dst2, dststride, src2, src2stride,
+                                                  block_w, block_h, mx, my);
+    }
 }
 
+/**
+ * Chroma uni-prediction of both chroma blocks, see luma_mc_uni().
+ */
+static void chroma_mc_uni(HEVCContext *s, uint8_t *dst1, uint8_t *dst2,
+                          AVFrame *ref, const Mv *mv, int x_off, int y_off,
+                          int block_w, int block_h, int idx)
+{
+    ptrdiff_t dst1stride = s->frame->linesize[1];
+    ptrdiff_t dst2stride = s->frame->linesize[2];
+    ptrdiff_t src1stride, src2stride;
+    uint8_t *src1 = chroma_mc_src(s, ref, 1, mv, x_off, y_off, block_w, block_h, &src1stride);
+    uint8_t *src2 = chroma_mc_src(s, ref, 2, mv, x_off, y_off, block_w, block_h, &src2stride);
+    int mx        = mv->x & 7;
+    int my        = mv->y & 7;
+
+    if (src1stride == src2stride && dst1stride == dst2stride) {
+        s->hevcdsp.put_hevc_epel_uni_uv[idx][!!my][!!mx](dst1, dst2, dst1stride,
+                                                         src1, src2, src1stride,
+                                                         block_w, block_h, mx, my);
+    } else {
+        s->hevcdsp.put_hevc_epel_uni[idx][!!my][!!mx](dst1, dst1stride, src1, src1stride,
+                                                      block_w, block_h, mx, my);
+        s->hevcdsp.put_hevc_epel_uni[idx][!!my][!!mx](dst2, dst2stride, src2, src2stride,
+                                                      block_w, block_h, mx, my);
+    }
+}
 
-static void hevc_await_progress(HEVCContext *s, HEVCFrame *ref,
-                                const Mv *mv, int y0, int height)
+/**
+ * Chroma bi-prediction of both chroma blocks, see luma_mc_bi().
+ *
+ * @param tmp1 interpolated first list prediction of the U block
+ * @param tmp2 interpolated first list prediction of the V block
+ */
+static void chroma_mc_bi(HEVCContext *s, uint8_t *dst1, uint8_t *dst2,
+                         AVFrame *ref, const Mv *mv, int x_off, int y_off,
+                         int block_w, int block_h, int16_t *tmp1,
+                         int16_t *tmp2, ptrdiff_t tmpstride, int idx)
+{
+    ptrdiff_t dst1stride = s->frame->linesize[1];
+    ptrdiff_t dst2stride = s->frame->linesize[2];
+    ptrdiff_t src1stride, src2stride;
+    uint8_t *src1 = chroma_mc_src(s, ref, 1, mv, x_off, y_off, block_w, block_h, &src1stride);
+    uint8_t *src2 = chroma_mc_src(s, ref, 2, mv, x_off, y_off, block_w, block_h, &src2stride);
+    int mx        = mv->x & 7;
+    int my        = mv->y & 7;
+
+    if (src1stride == src2stride && dst1stride == dst2stride) {
+        s->hevcdsp.put_hevc_epel_bi_uv[idx][!!my][!!mx](dst1, dst2, dst1stride,
+                                                        src1, src2, src1stride,
+                                                        tmp1, tmp2, tmpstride,
+                                                        block_w, block_h, mx, my);
+    } else {
+        s->hevcdsp.put_hevc_epel_bi[idx][!!my][!!mx](dst1, dst1stride, src1, src1stride,
+                                                     tmp1, tmpstride,
+                                                     block_w, block_h, mx, my);
+        s->hevcdsp.put_hevc_epel_bi[idx][!!my][!!mx](dst2, dst2stride, src2, src2stride,
+                                                     tmp2, tmpstride,
+                                                     block_w, block_h, mx, my);
+    }
+}
+
+static void hevc_await_progress(HEVCContext *s, HEVCFrame *ref, const Mv *mv,
+                                int x0, int y0, int width, int height)
 {
     int y = (mv->y >> 2) + y0 + height + 9;
 
+    /* the interpolation reads at most 8 samples around the block */
+    if (s->il_upsample && ref == s->inter_layer_ref) {
+        int x = (mv->x >> 2) + x0;
+        ff_hevc_il_await_pixels(s, x - 8, (mv->y >> 2) + y0 - 8,
+                                x + width + 9, y);
+        return;
+    }
+
+    /* the top border is only extended once the first CTB row is final */
+    if (s->edge_width)
+        y = FFMAX(y, 1);
+
     if (s->threads_type & FF_THREAD_FRAME )
         ff_thread_await_progress(&ref->tf, y, 0);
 }
 
+static void prefetch_ref_block(HEVCContext *s, AVFrame *ref, int c_idx,
+                               int x, int y, int w, int h)
+{
+    int hshift       = s->sps->hshift[c_idx];
+    int vshift       = s->sps->vshift[c_idx];
+    int pic_width    = s->sps->width  >> hshift;
+    int pic_height   = s->sps->height >> vshift;
+    ptrdiff_t stride = ref->linesize[c_idx];
+    int x1           = av_clip(x + w - 1, 0, pic_width  - 1) << s->sps->pixel_shift;
+    int y1           = av_clip(y + h - 1, 0, pic_height - 1);
+    uint8_t *src, *end;
+
+    x   = av_clip(x, 0, pic_width  - 1) << s->sps->pixel_shift;
+    y   = av_clip(y, 0, pic_height - 1);
+    h   = FFMIN(y1 - y + 1, FFMAX(s->mc_prefetch >> vshift, 1));
+    src = &ref->data[c_idx][y * stride];
+    end = src + x1;
+
+    // every cache line the rows of the block touch
+    for (src = (uint8_t *)((uintptr_t)(src + x) & ~(uintptr_t)63); src <= end; src += 64)
+        s->vdsp.prefetch(src, stride, h);
+}
+
+/**
+ * Prefetch the reference blocks of a prediction unit, including the margins
+ * read by the interpolation filters, so that the loads overlap the parsing
+ * of the rest of the CU.
+ */
+static void hevc_mc_prefetch(HEVCContext *s, const HEVCMCJob *job)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    int list;
+
+    for (list = 0; list < 2; list++) {
+        const Mv *mv = &job->mv.mv[list];
+        AVFrame *ref;
+        int x, y, w, h;
+
+        if (!job->ref[list])
+            continue;
+        ref = job->ref[list]->frame;
+
+        prefetch_ref_block(s, ref, 0, job->x0 + (mv->x >> 2) - 3,
+                           job->y0 + (mv->y >> 2) - 3, job->nPbW + 7, job->nPbH + 7);
+
+        x = (job->x0 >> s->sps->hshift[1]) + (mv->x >> (2 + s->sps->hshift[1])) - EPEL_EXTRA_BEFORE;
+        y = (job->y0 >> s->sps->vshift[1]) + (mv->y >> (2 + s->sps->vshift[1])) - EPEL_EXTRA_BEFORE;
+        w = (job->nPbW >> s->sps->hshift[1]) + EPEL_EXTRA;
+        h = (job->nPbH >> s->sps->vshift[1]) + EPEL_EXTRA;
+        prefetch_ref_block(s, ref, 1, x, y, w, h);
+        prefetch_ref_block(s, ref, 2, x, y, w, h);
+        lc->nb_mc_prefetch++;
+    }
+}
+
 static void hls_prediction_unit(HEVCContext *s, int x0, int y0,
                                 int nPbW, int nPbH,
                                 int log2_cb_size, int partIdx, int idx)
 {
-#define POS(c_idx, x, y)                                                              \
-    &s->frame->data[c_idx][((y) >> s->sps->vshift[c_idx]) * s->frame->linesize[c_idx] + \
-                           (((x) >> s->sps->hshift[c_idx]) << s->sps->pixel_shift)]
     HEVCLocalContext *lc = s->HEVClc;
     int merge_idx = 0;
     struct MvField current_mv;
 
-    int min_pu_width = s->sps->min_pu_width;
-
-    MvField *tab_mvf = s->ref->tab_mvf;
     RefPicList  *refPicList = s->ref->refPicList;
-    HEVCFrame *ref0, *ref1;
-
-    int tmpstride = MAX_PB_SIZE;
-
-    uint8_t *dst0 = POS(0, x0, y0);
-    uint8_t *dst1 = POS(1, x0, y0);
-    uint8_t *dst2 = POS(2, x0, y0);
+    HEVCMCJob *job;
     int log2_min_cb_size = s->sps->log2_min_cb_size;
     int min_cb_width     = s->sps->min_cb_width;
     int x_cb             = x0 >> log2_min_cb_size;
     int y_cb             = y0 >> log2_min_cb_size;
     int ref_idx[2];
     int mvp_flag[2];
-    int x_pu, y_pu;
-    int i, j;
 
     if (SAMPLE_CTB(s->skip_flag, x_cb, y_cb)) {
         if (s->sh.max_num_merge_cand > 1)
@@ -1336,12 +1527,7 @@ static void hls_prediction_unit(HEVCContext *s, int x0, int y0,
                                    1 << log2_cb_size,
                                    log2_cb_size, partIdx,
                                    merge_idx, &current_mv);
-        x_pu = x0 >> s->sps->log2_min_pu_size;
-        y_pu = y0 >> s->sps->log2_min_pu_size;
-
-        for (j = 0; j < nPbH >> s->sps->log2_min_pu_size; j++)
-            for (i = 0; i < nPbW >> s->sps->log2_min_pu_size; i++)
-                tab_mvf[(y_pu + j) * min_pu_width + x_pu + i] = current_mv;
+        ff_hevc_set_mvf(s, x0, y0, nPbW, nPbH, &current_mv);
     } else { /* MODE_INTER */
         lc->pu.merge_flag = ff_hevc_merge_flag_decode(s);
         if (lc->pu.merge_flag) {
@@ -1352,12 +1538,7 @@ static void hls_prediction_unit(HEVCContext *s, int x0, int y0,
 
             ff_hevc_luma_mv_merge_mode(s, x0, y0, nPbW, nPbH, log2_cb_size,
                                        partIdx, merge_idx, &current_mv);
-            x_pu = x0 >> s->sps->log2_min_pu_size;
-            y_pu = y0 >> s->sps->log2_min_pu_size;
-
-            for (i = 0; i < nPbW >> s->sps->log2_min_pu_size; i++)
-                for (j = 0; j < nPbH >> s->sps->log2_min_pu_size; j++)
-                    tab_mvf[(y_pu + j) * min_pu_width + x_pu + i] = current_mv;
+            ff_hevc_set_mvf(s, x0, y0, nPbW, nPbH, &current_mv);
         } else {
             enum InterPredIdc inter_pred_idc = PRED_L0;
             ff_hevc_set_neighbour_available(s, x0, y0, nPbW, nPbH);
@@ -1404,160 +1585,205 @@ static void hls_prediction_unit(HEVCContext *s, int x0, int y0,
                 current_mv.mv[1].y += lc->pu.mvd.y;
             }
 
-            x_pu = x0 >> s->sps->log2_min_pu_size;
-            y_pu = y0 >> s->sps->log2_min_pu_size;
-
-            for (j = 0; j < nPbH >> s->sps->log2_min_pu_size; j++)
-                for (i = 0; i < nPbW >> s->sps->log2_min_pu_size; i++)
-                    tab_mvf[(y_pu + j) * min_pu_width + x_pu + i] = current_mv;
+            ff_hevc_set_mvf(s, x0, y0, nPbW, nPbH, &current_mv);
         }
     }
 
+    job = &lc->mc_job[lc->nb_mc_jobs];
+    job->ref[0] = job->ref[1] = NULL;
     if (current_mv.pred_flag[0]) {
-        ref0 = refPicList[0].ref[current_mv.ref_idx[0]];
-        if (!ref0)
+        job->ref[0] = refPicList[0].ref[current_mv.ref_idx[0]];
+        if (!job->ref[0])
             return;
-        hevc_await_progress(s, ref0, &current_mv.mv[0], y0, nPbH);
+        hevc_await_progress(s, job->ref[0], &current_mv.mv[0], x0, y0, nPbW, nPbH);
     }
     if (current_mv.pred_flag[1]) {
-        ref1 = refPicList[1].ref[current_mv.ref_idx[1]];
-        if (!ref1)
+        job->ref[1] = refPicList[1].ref[current_mv.ref_idx[1]];
+        if (!job->ref[1])
             return;
-        hevc_await_progress(s, ref1, &current_mv.mv[1], y0, nPbH);
+        hevc_await_progress(s, job->ref[1], &current_mv.mv[1], x0, y0, nPbW, nPbH);
+    }
+
+    job->mv   = current_mv;
+    job->x0   = x0;
+    job->y0   = y0;
+    job->nPbW = nPbW;
+    job->nPbH = nPbH;
+    job->idx  = idx;
+    lc->nb_mc_jobs++;
+
+    if (s->mc_prefetch)
+        hevc_mc_prefetch(s, job);
+}
+
+/**
+ * Motion compensation of a prediction block recorded by
+ * hls_prediction_unit(), into the current frame.
+ */
+static void hevc_pu_mc(HEVCContext *s, const HEVCMCJob *job)
+{
+#define POS(c_idx, x, y)                                                              \
+    &s->frame->data[c_idx][((y) >> s->sps->vshift[c_idx]) * s->frame->linesize[c_idx] + \
+                           (((x) >> s->sps->hshift[c_idx]) << s->sps->pixel_shift)]
+    const MvField *mv = &job->mv;
+    HEVCFrame *ref0   = job->ref[0];
+    HEVCFrame *ref1   = job->ref[1];
+    int x0            = job->x0;
+    int y0            = job->y0;
+    int nPbW          = job->nPbW;
+    int nPbH          = job->nPbH;
+    int idx           = job->idx;
+    int tmpstride     = MAX_PB_SIZE;
+    uint8_t *dst0     = POS(0, x0, y0);
+    uint8_t *dst1     = POS(1, x0, y0);
+    uint8_t *dst2     = POS(2, x0, y0);
+
+    if (!((mv->pred_flag[0] && s->sh.wp_explicit[0][mv->ref_idx[0]]) ||
+          (mv->pred_flag[1] && s->sh.wp_explicit[1][mv->ref_idx[1]]))) {
+        /* default weights give the same result as the unweighted
+         * prediction: interpolate straight into the picture */
+        if (mv->pred_flag[0] && mv->pred_flag[1]) {
+            DECLARE_ALIGNED(16, int16_t, tmp [MAX_PB_SIZE * MAX_PB_SIZE]);
+            DECLARE_ALIGNED(16, int16_t, tmp2[MAX_PB_SIZE * MAX_PB_SIZE]);
+
+            luma_mc(s, tmp, tmpstride, ref0->frame,
+                    &mv->mv[0], x0, y0, nPbW, nPbH, idx);
+            luma_mc_bi(s, dst0, s->frame->linesize[0], ref1->frame,
+                       &mv->mv[1], x0, y0, nPbW, nPbH,
+                       tmp, tmpstride, idx);
+
+            chroma_mc(s, tmp, tmp2, tmpstride, ref0->frame,
+                      &mv->mv[0], x0 / 2, y0 / 2, nPbW / 2, nPbH / 2, idx);
+            chroma_mc_bi(s, dst1, dst2, ref1->frame, &mv->mv[1],
+                         x0 / 2, y0 / 2, nPbW / 2, nPbH / 2,
+                         tmp, tmp2, tmpstride, idx);
+        } else {
+            int list       = mv->pred_flag[1];
+            HEVCFrame *ref = list ? ref1 : ref0;
+
+            luma_mc_uni(s, dst0, s->frame->linesize[0], ref->frame,
+                        &mv->mv[list], x0, y0, nPbW, nPbH, idx);
+            chroma_mc_uni(s, dst1, dst2, ref->frame, &mv->mv[list],
+                          x0 / 2, y0 / 2, nPbW / 2, nPbH / 2, idx);
+        }
+        return;
     }
 
-    if (current_mv.pred_flag[0] && !current_mv.pred_flag[1]) {
+    if (mv->pred_flag[0] && !mv->pred_flag[1]) {
         DECLARE_ALIGNED(16, int16_t,  tmp[MAX_PB_SIZE * MAX_PB_SIZE]);
         DECLARE_ALIGNED(16, int16_t, tmp2[MAX_PB_SIZE * MAX_PB_SIZE]);
         luma_mc(s, tmp, tmpstride, ref0->frame,
-                &current_mv.mv[0], x0, y0, nPbW, nPbH, idx);
-
-        if ((s->sh.slice_type == P_SLICE && s->pps->weighted_pred_flag) ||
-            (s->sh.slice_type == B_SLICE && s->pps->weighted_bipred_flag)) {
-            s->hevcdsp.weighted_pred(s->sh.luma_log2_weight_denom,
-                                     s->sh.luma_weight_l0[current_mv.ref_idx[0]],
-                                     s->sh.luma_offset_l0[current_mv.ref_idx[0]],
-                                     dst0, s->frame->linesize[0], tmp,
-                                     tmpstride, nPbW, nPbH);
-        } else {
-            s->hevcdsp.put_unweighted_pred(dst0, s->frame->linesize[0], tmp, tmpstride, nPbW, nPbH);
-        }
+                &mv->mv[0], x0, y0, nPbW, nPbH, idx);
 
-        chroma_mc(s, tmp, tmp2, tmpstride, ref0->frame,
-                  &current_mv.mv[0], x0 / 2, y0 / 2, nPbW / 2, nPbH / 2, idx);
-
-        if ((s->sh.slice_type == P_SLICE && s->pps->weighted_pred_flag) ||
-            (s->sh.slice_type == B_SLICE && s->pps->weighted_bipred_flag)) {
-            s->hevcdsp.weighted_pred(s->sh.chroma_log2_weight_denom,
-                                     s->sh.chroma_weight_l0[current_mv.ref_idx[0]][0],
-                                     s->sh.chroma_offset_l0[current_mv.ref_idx[0]][0],
-                                     dst1, s->frame->linesize[1], tmp, tmpstride,
-                                     nPbW / 2, nPbH / 2);
-            s->hevcdsp.weighted_pred(s->sh.chroma_log2_weight_denom,
-                                     s->sh.chroma_weight_l0[current_mv.ref_idx[0]][1],
-                                     s->sh.chroma_offset_l0[current_mv.ref_idx[0]][1],
-                                     dst2, s->frame->linesize[2], tmp2, tmpstride,
-                                     nPbW / 2, nPbH / 2);
-        } else {
-            s->hevcdsp.put_unweighted_pred(dst1, s->frame->linesize[1], tmp, tmpstride, nPbW/2, nPbH/2);
-            s->hevcdsp.put_unweighted_pred(dst2, s->frame->linesize[2], tmp2, tmpstride, nPbW/2, nPbH/2);
-        }
-    } else if (!current_mv.pred_flag[0] && current_mv.pred_flag[1]) {
+        s->hevcdsp.weighted_pred(&s->sh.luma_wp[0][mv->ref_idx[0]],
+                                 dst0, s->frame->linesize[0], tmp,
+                                 tmpstride, nPbW, nPbH);
 
-        if (!ref1)
-            return;
+        chroma_mc(s, tmp, tmp2, tmpstride, ref0->frame,
+                  &mv->mv[0], x0 / 2, y0 / 2, nPbW / 2, nPbH / 2, idx);
+
+        s->hevcdsp.weighted_pred(&s->sh.chroma_wp[0][mv->ref_idx[0]][0],
+                                 dst1, s->frame->linesize[1], tmp, tmpstride,
+                                 nPbW / 2, nPbH / 2);
+        s->hevcdsp.weighted_pred(&s->sh.chroma_wp[0][mv->ref_idx[0]][1],
+                                 dst2, s->frame->linesize[2], tmp2, tmpstride,
+                                 nPbW / 2, nPbH / 2);
+    } else if (!mv->pred_flag[0] && mv->pred_flag[1]) {
         DECLARE_ALIGNED(16, int16_t, tmp [MAX_PB_SIZE * MAX_PB_SIZE]);
         DECLARE_ALIGNED(16, int16_t, tmp2[MAX_PB_SIZE * MAX_PB_SIZE]);
         luma_mc(s, tmp, tmpstride, ref1->frame,
-                &current_mv.mv[1], x0, y0, nPbW, nPbH, idx);
-
-        if ((s->sh.slice_type == P_SLICE && s->pps->weighted_pred_flag) ||
-            (s->sh.slice_type == B_SLICE && s->pps->weighted_bipred_flag)) {
-            s->hevcdsp.weighted_pred(s->sh.luma_log2_weight_denom,
-                                      s->sh.luma_weight_l1[current_mv.ref_idx[1]],
-                                      s->sh.luma_offset_l1[current_mv.ref_idx[1]],
-                                      dst0, s->frame->linesize[0], tmp, tmpstride,
-                                      nPbW, nPbH);
-        } else {
-            s->hevcdsp.put_unweighted_pred(dst0, s->frame->linesize[0], tmp, tmpstride, nPbW, nPbH);
-        }
+                &mv->mv[1], x0, y0, nPbW, nPbH, idx);
+
+        s->hevcdsp.weighted_pred(&s->sh.luma_wp[1][mv->ref_idx[1]],
+                                 dst0, s->frame->linesize[0], tmp, tmpstride,
+                                 nPbW, nPbH);
         chroma_mc(s, tmp, tmp2, tmpstride, ref1->frame,
-                  &current_mv.mv[1], x0/2, y0/2, nPbW/2, nPbH/2, idx);
-
-        if ((s->sh.slice_type == P_SLICE && s->pps->weighted_pred_flag) ||
-            (s->sh.slice_type == B_SLICE && s->pps->weighted_bipred_flag)) {
-            s->hevcdsp.weighted_pred(s->sh.chroma_log2_weight_denom,
-                                     s->sh.chroma_weight_l1[current_mv.ref_idx[1]][0],
-                                     s->sh.chroma_offset_l1[current_mv.ref_idx[1]][0],
-                                     dst1, s->frame->linesize[1], tmp, tmpstride, nPbW/2, nPbH/2);
-            s->hevcdsp.weighted_pred(s->sh.chroma_log2_weight_denom,
-                                     s->sh.chroma_weight_l1[current_mv.ref_idx[1]][1],
-                                     s->sh.chroma_offset_l1[current_mv.ref_idx[1]][1],
-                                     dst2, s->frame->linesize[2], tmp2, tmpstride, nPbW/2, nPbH/2);
-        } else {
-            s->hevcdsp.put_unweighted_pred(dst1, s->frame->linesize[1], tmp, tmpstride, nPbW/2, nPbH/2);
-            s->hevcdsp.put_unweighted_pred(dst2, s->frame->linesize[2], tmp2, tmpstride, nPbW/2, nPbH/2);
-        }
+                  &mv->mv[1], x0/2, y0/2, nPbW/2, nPbH/2, idx);
 
-    } else if (current_mv.pred_flag[0] && current_mv.pred_flag[1]) {
+        s->hevcdsp.weighted_pred(&s->sh.chroma_wp[1][mv->ref_idx[1]][0],
+                                 dst1, s->frame->linesize[1], tmp, tmpstride, nPbW/2, nPbH/2);
+        s->hevcdsp.weighted_pred(&s->sh.chroma_wp[1][mv->ref_idx[1]][1],
+                                 dst2, s->frame->linesize[2], tmp2, tmpstride, nPbW/2, nPbH/2);
+
+    } else if (mv->pred_flag[0] && mv->pred_flag[1]) {
         DECLARE_ALIGNED(16, int16_t, tmp [MAX_PB_SIZE * MAX_PB_SIZE]);
         DECLARE_ALIGNED(16, int16_t, tmp2[MAX_PB_SIZE * MAX_PB_SIZE]);
-        HEVCFrame *ref0 = refPicList[0].ref[current_mv.ref_idx[0]];
-        HEVCFrame *ref1 = refPicList[1].ref[current_mv.ref_idx[1]];
-
-        if (!ref0 || !ref1)
-            return;
 
         luma_mc(s,
                 tmp, tmpstride,
-                ref0->frame, &current_mv.mv[0],
+                ref0->frame, &mv->mv[0],
                 x0, y0, nPbW, nPbH, idx);
         luma_mc(s, tmp2, tmpstride, ref1->frame,
-                &current_mv.mv[1], x0, y0, nPbW, nPbH, idx);
-
-        if ((s->sh.slice_type == P_SLICE && s->pps->weighted_pred_flag) ||
-            (s->sh.slice_type == B_SLICE && s->pps->weighted_bipred_flag)) {
-            s->hevcdsp.weighted_pred_avg(s->sh.luma_log2_weight_denom,
-                                         s->sh.luma_weight_l0[current_mv.ref_idx[0]],
-                                         s->sh.luma_weight_l1[current_mv.ref_idx[1]],
-                                         s->sh.luma_offset_l0[current_mv.ref_idx[0]],
-                                         s->sh.luma_offset_l1[current_mv.ref_idx[1]],
-                                         dst0, s->frame->linesize[0],
-                                         tmp, tmp2, tmpstride, nPbW, nPbH);
-        } else {
-            s->hevcdsp.put_weighted_pred_avg(dst0, s->frame->linesize[0],
-                                             tmp, tmp2, tmpstride, nPbW, nPbH);
-        }
+                &mv->mv[1], x0, y0, nPbW, nPbH, idx);
+
+        s->hevcdsp.weighted_pred_avg(&s->sh.luma_wp[0][mv->ref_idx[0]],
+                                     &s->sh.luma_wp[1][mv->ref_idx[1]],
+                                     dst0, s->frame->linesize[0],
+                                     tmp, tmp2, tmpstride, nPbW, nPbH);
         chroma_mc(s,
                 tmp, tmp2, tmpstride,
-                ref0->frame, &current_mv.mv[0],
+                ref0->frame, &mv->mv[0],
                 x0 >> 1, y0 >> 1, nPbW >> 1, nPbH >> 1, idx);
         DECLARE_ALIGNED(16, int16_t, tmp3[MAX_PB_SIZE * MAX_PB_SIZE]);
         DECLARE_ALIGNED(16, int16_t, tmp4[MAX_PB_SIZE * MAX_PB_SIZE]);
         chroma_mc(s, tmp3, tmp4, tmpstride, ref1->frame,
-                  &current_mv.mv[1], x0 / 2, y0 / 2, nPbW / 2, nPbH / 2, idx);
-
-        if ((s->sh.slice_type == P_SLICE && s->pps->weighted_pred_flag) ||
-            (s->sh.slice_type == B_SLICE && s->pps->weighted_bipred_flag)) {
-            s->hevcdsp.weighted_pred_avg(s->sh.chroma_log2_weight_denom,
-                                         s->sh.chroma_weight_l0[current_mv.ref_idx[0]][0],
-                                         s->sh.chroma_weight_l1[current_mv.ref_idx[1]][0],
-                                         s->sh.chroma_offset_l0[current_mv.ref_idx[0]][0],
-                                         s->sh.chroma_offset_l1[current_mv.ref_idx[1]][0],
-                                         dst1, s->frame->linesize[1], tmp, tmp3,
-                                         tmpstride, nPbW / 2, nPbH / 2);
-            s->hevcdsp.weighted_pred_avg(s->sh.chroma_log2_weight_denom,
-                                         s->sh.chroma_weight_l0[current_mv.ref_idx[0]][1],
-                                         s->sh.chroma_weight_l1[current_mv.ref_idx[1]][1],
-                                         s->sh.chroma_offset_l0[current_mv.ref_idx[0]][1],
-                                         s->sh.chroma_offset_l1[current_mv.ref_idx[1]][1],
-                                         dst2, s->frame->linesize[2], tmp2, tmp4,
-                                         tmpstride, nPbW / 2, nPbH / 2);
-        } else {
-            s->hevcdsp.put_weighted_pred_avg(dst1, s->frame->linesize[1], tmp, tmp3, tmpstride, nPbW/2, nPbH/2);
-            s->hevcdsp.put_weighted_pred_avg(dst2, s->frame->linesize[2], tmp2, tmp4, tmpstride, nPbW/2, nPbH/2);
+                  &mv->mv[1], x0 / 2, y0 / 2, nPbW / 2, nPbH / 2, idx);
+
+        s->hevcdsp.weighted_pred_avg(&s->sh.chroma_wp[0][mv->ref_idx[0]][0],
+                                     &s->sh.chroma_wp[1][mv->ref_idx[1]][0],
+                                     dst1, s->frame->linesize[1], tmp, tmp3,
+                                     tmpstride, nPbW / 2, nPbH / 2);
+        s->hevcdsp.weighted_pred_avg(&s->sh.chroma_wp[0][mv->ref_idx[0]][1],
+                                     &s->sh.chroma_wp[1][mv->ref_idx[1]][1],
+                                     dst2, s->frame->linesize[2], tmp2, tmp4,
+                                     tmpstride, nPbW / 2, nPbH / 2);
+    }
+}
+
+/**
+ * Whether two jobs read the same reference pictures with the same kind of
+ * luma interpolation filter.
+ */
+static int same_mc_class(const HEVCMCJob *a, const HEVCMCJob *b)
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (a->ref[i] != b->ref[i])
+            return 0;
+        if (a->ref[i] &&
+            (!(a->mv.mv[i].x & 3) != !(b->mv.mv[i].x & 3) ||
+             !(a->mv.mv[i].y & 3) != !(b->mv.mv[i].y & 3)))
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * Run the motion compensation jobs of the current CU. Jobs of the same
+ * class (see same_mc_class()) run back to back.
+ */
+static void hevc_mc_batch(HEVCContext *s)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    HEVCMCJob *order[MAX_MC_JOBS];
+    uint8_t queued[MAX_MC_JOBS] = { 0 };
+    int nb = 0, i, j;
+
+    for (i = 0; i < lc->nb_mc_jobs; i++) {
+        if (queued[i])
+            continue;
+        for (j = i; j < lc->nb_mc_jobs; j++) {
+            if (!queued[j] && same_mc_class(&lc->mc_job[i], &lc->mc_job[j])) {
+                order[nb++] = &lc->mc_job[j];
+                queued[j]   = 1;
+            }
         }
     }
+
+    for (i = 0; i < nb; i++)
+        hevc_pu_mc(s, order[i]);
+    lc->nb_mc_jobs = 0;
 }
 
 /**
@@ -1581,10 +1807,9 @@ static int luma_intra_pred_mode(HEVCContext *s, int x0, int y0, int pu_size,
 
     int y_ctb = (y0 >> (s->sps->log2_ctb_size)) << (s->sps->log2_ctb_size);
 
-    MvField *tab_mvf = s->ref->tab_mvf;
     int intra_pred_mode;
     int candidate[3];
-    int i, j;
+    int i;
 
     // intra_pred_mode prediction does not cross vertical CTB boundaries
     if ((y0 - 1) < y_ctb)
@@ -1631,16 +1856,10 @@ static int luma_intra_pred_mode(HEVCContext *s, int x0, int y0, int pu_size,
     /* write the intra prediction units into the mv array */
     if (!size_in_pus)
         size_in_pus = 1;
-    for (i = 0; i < size_in_pus; i++) {
+    for (i = 0; i < size_in_pus; i++)
         memset(&s->tab_ipm[(y_pu + i) * min_pu_width + x_pu],
                intra_pred_mode, size_in_pus);
-
-        for (j = 0; j < size_in_pus; j++) {
-            tab_mvf[(y_pu + j) * min_pu_width + x_pu + i].is_intra = 1;
-            tab_mvf[(y_pu + j) * min_pu_width + x_pu + i].pred_flag[0] = 0;
-            tab_mvf[(y_pu + j) * min_pu_width + x_pu + i].pred_flag[1] = 0;
-        }
-    }
+    ff_hevc_set_mvf(s, x0, y0, pu_size, pu_size, &intra_mvf);
 
     return intra_pred_mode;
 }
@@ -1706,19 +1925,17 @@ static void intra_prediction_unit_default_value(HEVCContext *s,
     int pb_size          = 1 << log2_cb_size;
     int size_in_pus      = pb_size >> s->sps->log2_min_pu_size;
     int min_pu_width     = s->sps->min_pu_width;
-    MvField *tab_mvf     = s->ref->tab_mvf;
     int x_pu             = x0 >> s->sps->log2_min_pu_size;
     int y_pu             = y0 >> s->sps->log2_min_pu_size;
-    int j, k;
+    int j;
 
     if (size_in_pus == 0)
         size_in_pus = 1;
-    for (j = 0; j < size_in_pus; j++) {
+    for (j = 0; j < size_in_pus; j++)
         memset(&s->tab_ipm[(y_pu + j) * min_pu_width + x_pu], INTRA_DC, size_in_pus);
-        for (k = 0; k < size_in_pus; k++) {
-            tab_mvf[(y_pu + j) * min_pu_width + x_pu + k].is_intra = lc->cu.pred_mode == MODE_INTRA;
-        }
-    }
+    /* inter CUs get their motion from the prediction units */
+    if (lc->cu.pred_mode == MODE_INTRA)
+        ff_hevc_set_mvf(s, x0, y0, pb_size, pb_size, &intra_mvf);
 }
 
 static int hls_coding_unit(HEVCContext *s, int x0, int y0, int log2_cb_size)
@@ -1765,6 +1982,7 @@ static int hls_coding_unit(HEVCContext *s, int x0, int y0, int log2_cb_size)
 
     if (SAMPLE_CTB(s->skip_flag, x_cb, y_cb)) {
         hls_prediction_unit(s, x0, y0, cb_size, cb_size, log2_cb_size, 0, idx);
+        hevc_mc_batch(s);
         intra_prediction_unit_default_value(s, x0, y0, log2_cb_size);
 
         if (!s->sh.disable_deblocking_filter_flag)
@@ -1834,6 +2052,7 @@ static int hls_coding_unit(HEVCContext *s, int x0, int y0, int log2_cb_size)
                 hls_prediction_unit(s, x0 + cb_size / 2, y0 + cb_size / 2, cb_size / 2, cb_size / 2, log2_cb_size, 3, idx - 1);
                 break;
             }
+            hevc_mc_batch(s);
         }
 
         if (!lc->cu.pcm_flag) {
@@ -2005,6 +2224,7 @@ static int hls_decode_entry(AVCodecContext *avctxt, void *isFilterThread)
         hls_decode_neighbour(s, x_ctb, y_ctb, ctb_addr_ts);
 
         ff_hevc_cabac_init(s, ctb_addr_ts);
+        ff_hevc_mvf_cache_load(s, x_ctb, y_ctb);
 
         hls_sao_param(s, x_ctb >> s->sps->log2_ctb_size, y_ctb >> s->sps->log2_ctb_size);
 
@@ -2066,6 +2286,7 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *input_ctb_row, int
         }
 
         ff_hevc_cabac_init(s, ctb_addr_ts);
+        ff_hevc_mvf_cache_load(s, x_ctb, y_ctb);
         hls_sao_param(s, x_ctb >> s->sps->log2_ctb_size, y_ctb >> s->sps->log2_ctb_size);
 
         s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
@@ -2135,6 +2356,7 @@ static int hls_decode_entry_tiles(AVCodecContext *avctxt, int *input_ctb_row, in
 
         hls_decode_neighbour(s,x_ctb, y_ctb, ctb_addr_ts);
         ff_hevc_cabac_init(s, ctb_addr_ts);
+        ff_hevc_mvf_cache_load(s, x_ctb, y_ctb);
         hls_sao_param(s, x_ctb >> s->sps->log2_ctb_size, y_ctb >> s->sps->log2_ctb_size);
 
         s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
@@ -2188,9 +2410,11 @@ static void tiles_filters(HEVCContext *s)
             ff_hevc_hls_filter(s, x0, y0);
 }
 
-static int hls_slice_data(HEVCContext *s, const uint8_t *nal, int length)
+static int hls_slice_data(HEVCContext *s, const HEVCNAL *nal)
 {
     HEVCLocalContext *lc = s->HEVClc;
+    const uint8_t *data = nal->raw_data ? nal->raw_data : nal->data;
+    int length          = nal->raw_data ? nal->raw_size : nal->size;
     int *ret = av_malloc((s->sh.num_entry_point_offsets + 1) * sizeof(int));
     int *arg = av_malloc((s->sh.num_entry_point_offsets + 1) * sizeof(int));
     int offset;
@@ -2200,10 +2424,40 @@ static int hls_slice_data(HEVCContext *s, const uint8_t *nal, int length)
 
     ff_alloc_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
 
-    if(s->sh.num_entry_point_offsets != 0)   {
+    if (nal->raw_data) {
+        /* The slice data is read in place: move the bit reader from the
+         * unescaped header onto the packet. Entry point offsets count the
+         * emulation prevention bytes, so no correction is needed. */
+        int bits = get_bits_count(&lc->gb);
+        int idx  = 0;
+        int margin = ((5 * s->sps->bit_depth) << (2 * s->sps->log2_ctb_size)) / 16 + 64;
+
+        offset = ff_hevc_escape_skip(nal->skipped_bytes_pos, nal->skipped_bytes,
+                                     &idx, 0, bits >> 3);
+        init_get_bits8(&lc->gb, data + offset, length - offset);
+        skip_bits(&lc->gb, bits & 7);
+
+        for (i = 0; i < s->sh.num_entry_point_offsets; i++) {
+            offset += s->sh.entry_point_offset[i];
+            s->sh.offset[i] = offset;
+            s->sh.size[i]   = i + 1 < s->sh.num_entry_point_offsets ?
+                              s->sh.entry_point_offset[i + 1] : length - offset;
+        }
+        for (i = 0; i < s->threads_number; i++) {
+            res = ff_hevc_escape_reader_init(s->HEVClcList[i], data, length,
+                                             nal->skipped_bytes_pos, nal->skipped_bytes,
+                                             margin);
+            if (res < 0)
+                goto fail;
+        }
+        if (s->sh.num_entry_point_offsets != 0) {
+            avpriv_atomic_int_set(&s->wpp_err, 0);
+            ff_reset_entries(s->avctx);
+        }
+    } else if (s->sh.num_entry_point_offsets != 0) {
         offset = (lc->gb.index >> 3);
-        for (j = 0, cmpt = 0, startheader = offset + s->sh.entry_point_offset[0]; j < s->skipped_bytes; j++) {
-            if (s->skipped_bytes_pos[j] >= offset && s->skipped_bytes_pos[j] < startheader) {
+        for (j = 0, cmpt = 0, startheader = offset + s->sh.entry_point_offset[0]; j < nal->skipped_bytes; j++) {
+            if (nal->skipped_bytes_pos[j] >= offset && nal->skipped_bytes_pos[j] < startheader) {
                 startheader--;
                 cmpt++;
             }
@@ -2212,8 +2466,8 @@ static int hls_slice_data(HEVCContext *s, const uint8_t *nal, int length)
         for (i = 1; i < s->sh.num_entry_point_offsets; i++) {
             offset += (s->sh.entry_point_offset[i - 1] - cmpt);
             for (j = 0, cmpt = 0, startheader = offset
-                    + s->sh.entry_point_offset[i]; j < s->skipped_bytes; j++) {
-                if (s->skipped_bytes_pos[j] >= offset && s->skipped_bytes_pos[j] < startheader) {
+                    + s->sh.entry_point_offset[i]; j < nal->skipped_bytes; j++) {
+                if (nal->skipped_bytes_pos[j] >= offset && nal->skipped_bytes_pos[j] < startheader) {
                     startheader--;
                     cmpt++;
                 }
@@ -2228,7 +2482,10 @@ static int hls_slice_data(HEVCContext *s, const uint8_t *nal, int length)
         avpriv_atomic_int_set(&s->wpp_err, 0);
         ff_reset_entries(s->avctx);
     }
-    s->data = nal;
+    if (!nal->raw_data)
+        for (i = 0; i < s->threads_number; i++)
+            s->HEVClcList[i]->er.raw = NULL;
+    s->data = (uint8_t *)data;
 
     for (i = 1; i < s->threads_number; i++) {
         s->sList[i]->HEVClc->first_qp_group = 1;
@@ -2251,6 +2508,7 @@ static int hls_slice_data(HEVCContext *s, const uint8_t *nal, int length)
 
     res = ret[s->threads_number==1 ? 0:s->sh.num_entry_point_offsets];
 
+fail:
     av_free(ret);
     av_free(arg);
     return res;
@@ -2312,10 +2570,7 @@ static void restore_tqb_pixels(HEVCContext *s)
 static int hevc_frame_start(HEVCContext *s)
 {
     HEVCLocalContext *lc = s->HEVClc;
-    int ret, i;
-#ifdef SVC_EXTENSION
-    int *arg, *res, cmpt, ctb_size;
-#endif
+    int ret;
     memset(s->horizontal_bs, 0, 2 * s->bs_width * (s->bs_height + 1));
     memset(s->vertical_bs,   0, 2 * s->bs_width * (s->bs_height + 1));
     memset(s->cbf_luma,      0, s->sps->min_tb_width * s->sps->min_tb_height);
@@ -2327,11 +2582,10 @@ static int hevc_frame_start(HEVCContext *s)
     if (s->pps->tiles_enabled_flag)
         lc->end_of_tiles_x = s->pps->column_width[0] << s->sps->log2_ctb_size;
        
-#ifdef SVC_EXTENSION
     if(s->nuh_layer_id ) {
         /*
          *  Set the BL frame
-         *  and upsample the base layer frame ans scale its MVs 
+         *  and the inter-layer reference
          */
  
         if(s->avctx->BL_frame)
@@ -2344,32 +2598,7 @@ static int hevc_frame_start(HEVCContext *s)
         if ((ret = ff_hevc_set_new_iter_layer_ref(s, &s->EL_frame, s->poc)< 0))
             return ret;
         
-        ctb_size =  1 << s->sps->log2_ctb_size;
-        cmpt   = s->sps->width;
-        cmpt = (cmpt / ctb_size) + (cmpt%ctb_size ? 1:0);
-        
-        arg = av_malloc(cmpt*sizeof(int));
-        res = av_malloc(cmpt*sizeof(int));
-        
-        
-        cmpt   = s->BL_frame->frame->height <= s->sps->height ? s->BL_frame->frame->height:s->sps->height;
-        cmpt = (cmpt / ctb_size) + (cmpt%ctb_size ? 1:0);
-        
-        for(i=0; i < cmpt; i++)
-            arg[i] = i;
-         s->avctx->execute(s->avctx, (void *) hls_upsample_h_bl_picture, arg, res, cmpt, sizeof(int));
-        
-        cmpt   = s->sps->width;
-        cmpt = (cmpt / ctb_size) + (cmpt%ctb_size ? 1:0);
-        
-        for(i=0; i < cmpt; i++)
-            arg[i] = i;
-        
-        s->avctx->execute(s->avctx, (void *) hls_upsample_v_bl_picture, arg, res, cmpt, sizeof(int));
-        av_free(arg);
-        av_free(res);
     }
-#endif
     
     ret = ff_hevc_set_new_ref(s, s->sps->sao_enabled ? &s->sao_frame : &s->frame,
                               s->poc);
@@ -2377,14 +2606,28 @@ static int hevc_frame_start(HEVCContext *s)
         goto fail;
    
     s->avctx->BL_frame = s->ref;
-    ret = ff_hevc_frame_rps(s);
-    if (ret < 0) {
-        av_log(s->avctx, AV_LOG_ERROR, "Error constructing the frame RPS.\n");
-        goto fail;
+    if (s->avctx->BL_frame_cb)
+        s->avctx->BL_frame_cb(s->avctx, s->ref);
+
+    if (s->irap_only && !s->nuh_layer_id) {
+        /* no picture before an IRAP one is referenced again, nor decoded
+         * until the next IRAP one: its RPS is not needed */
+        int i;
+        for (i = 0; i < FF_ARRAY_ELEMS(s->DPB); i++)
+            if (&s->DPB[i] != s->ref)
+                ff_hevc_unref_frame(s, &s->DPB[i],
+                                    HEVC_FRAME_FLAG_SHORT_REF | HEVC_FRAME_FLAG_LONG_REF);
+    } else {
+        ret = ff_hevc_frame_rps(s);
+        if (ret < 0) {
+            av_log(s->avctx, AV_LOG_ERROR, "Error constructing the frame RPS.\n");
+            goto fail;
+        }
     }
 
+    /* a picture of its own is output at once, without reorder delay */
     av_frame_unref(s->output_frame);
-    ret = ff_hevc_output_frame(s, s->output_frame, 0);
+    ret = ff_hevc_output_frame(s, s->output_frame, s->irap_only);
     if (ret < 0)
         goto fail;
 
@@ -2393,19 +2636,68 @@ static int hevc_frame_start(HEVCContext *s)
     return 0;
 
 fail:
-    if (s->ref && (s->threads_type & FF_THREAD_FRAME))
-        ff_thread_report_progress(&s->ref->tf, INT_MAX, 0);
+    if (s->ref)
+        ff_hevc_report_progress(s, s->ref, INT_MAX);
     s->ref = NULL;
     return ret;
 }
 
-static int decode_nal_unit(HEVCContext *s, const uint8_t *nal, int length)
+/**
+ * Copy the RBSP bytes of src, skipping the emulation prevention bytes at the
+ * positions listed in pos, until max bytes are written.
+ */
+static int unescape_rbsp(uint8_t *dst, const uint8_t *src, int size,
+                         const int *pos, int nb_pos, int max)
+{
+    int si = 0, di = 0, k = 0;
+
+    while (di < max && si < size) {
+        int end = k < nb_pos ? pos[k] : size;
+        int len = FFMIN(end - si, max - di);
+
+        memcpy(dst + di, src + si, len);
+        si += len;
+        di += len;
+        if (k < nb_pos && si == pos[k]) {
+            si++;
+            k++;
+        }
+    }
+    return di;
+}
+
+/**
+ * Fall back to a fully unescaped copy of a NAL unit read in place, for
+ * slice headers that do not fit in HEVC_ESCAPE_HEADER_SIZE bytes.
+ */
+static int unescape_nal(HEVCContext *s, HEVCNAL *nal)
+{
+    int i;
+
+    av_fast_malloc(&nal->rbsp_buffer, &nal->rbsp_buffer_size,
+                   nal->raw_size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!nal->rbsp_buffer)
+        return AVERROR(ENOMEM);
+
+    nal->size = unescape_rbsp(nal->rbsp_buffer, nal->raw_data, nal->raw_size,
+                              nal->skipped_bytes_pos, nal->skipped_bytes, nal->raw_size);
+    memset(nal->rbsp_buffer + nal->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    nal->data     = nal->rbsp_buffer;
+    nal->raw_data = NULL;
+
+    /* back to positions in the unescaped buffer, as hls_slice_data expects */
+    for (i = 0; i < nal->skipped_bytes; i++)
+        nal->skipped_bytes_pos[i] -= i + 1;
+    return 0;
+}
+
+static int decode_nal_unit(HEVCContext *s, HEVCNAL *nal)
 {
     HEVCLocalContext *lc = s->HEVClc;
     GetBitContext *gb    = &lc->gb;
     int ctb_addr_ts, ret;
 
-    ret = init_get_bits8(gb, nal, length);
+    ret = init_get_bits8(gb, nal->data, nal->size);
     if (ret < 0)
         return ret;
 
@@ -2419,7 +2711,7 @@ static int decode_nal_unit(HEVCContext *s, const uint8_t *nal, int length)
     } else if (ret != (s->decoder_id) && s->nal_unit_type != NAL_VPS)
         return 0;
     
-    if (s->temporal_id > s->temporal_layer_id)
+    if (s->temporal_id > s->max_temporal_id)
         return 0;
     
     s->nuh_layer_id = ret;
@@ -2462,7 +2754,33 @@ static int decode_nal_unit(HEVCContext *s, const uint8_t *nal, int length)
     case NAL_RADL_R:
     case NAL_RASL_N:
     case NAL_RASL_R:
+        if (nal->raw_data) {
+            uint16_t seq_decode = s->seq_decode;
+            int slice_idx = s->slice_idx;
+            int max_ra    = s->max_ra;
+            int poc       = s->poc;
+            int pocTid0   = s->pocTid0;
+
+            ret = hls_slice_header(s);
+            if (get_bits_left(gb) >= 8)
+                goto slice_header_done;
+
+            s->seq_decode = seq_decode;
+            s->slice_idx  = slice_idx;
+            s->max_ra     = max_ra;
+            s->poc        = poc;
+            s->pocTid0    = pocTid0;
+
+            ret = unescape_nal(s, nal);
+            if (ret < 0)
+                return ret;
+            ret = init_get_bits8(gb, nal->data, nal->size);
+            if (ret < 0)
+                return ret;
+            hls_nal_unit(s);
+        }
         ret = hls_slice_header(s);
+slice_header_done:
         if (ret < 0)
             return ret;
 
@@ -2504,20 +2822,25 @@ static int decode_nal_unit(HEVCContext *s, const uint8_t *nal, int length)
             }
         }
 
-        ctb_addr_ts = hls_slice_data(s, nal, length);
+        ctb_addr_ts = hls_slice_data(s, nal);
 
         if (ctb_addr_ts >= (s->sps->ctb_width * s->sps->ctb_height)) {
+            /* the last two CTB rows were not extended by the row filters */
+            int extend_y = FFMAX(0, (s->sps->ctb_height - 2) << s->sps->log2_ctb_size);
             s->is_decoded = 1;
-            if (s->pps->tiles_enabled_flag && s->threads_number!=1)
+            if (s->pps->tiles_enabled_flag && s->threads_number!=1) {
                 tiles_filters(s);
+                extend_y = 0;
+            }
             if ((s->pps->transquant_bypass_enable_flag ||
                  (s->sps->pcm.loop_filter_disable_flag && s->sps->pcm_enabled_flag)) &&
-                s->sps->sao_enabled)
+                s->sps->sao_enabled) {
                 restore_tqb_pixels(s);
-#ifdef SVC_EXTENSION
+                extend_y = 0;
+            }
+            ff_hevc_extend_edges(s, s->ref->frame, extend_y, s->sps->height);
             if(s->decoder_id > 0)
                 ff_hevc_unref_frame(s, s->inter_layer_ref, ~0);
-#endif
         }
 
         if (ctb_addr_ts < 0)
@@ -2539,15 +2862,79 @@ static int decode_nal_unit(HEVCContext *s, const uint8_t *nal, int length)
     return 0;
 }
 
+static int add_skipped_byte(HEVCNAL *nal, int pos)
+{
+    nal->skipped_bytes++;
+    if (nal->skipped_bytes_pos_size < nal->skipped_bytes) {
+        nal->skipped_bytes_pos_size *= 2;
+        av_reallocp_array(&nal->skipped_bytes_pos,
+                nal->skipped_bytes_pos_size,
+                sizeof(*nal->skipped_bytes_pos));
+        if (!nal->skipped_bytes_pos)
+            return AVERROR(ENOMEM);
+    }
+    if (nal->skipped_bytes_pos)
+        nal->skipped_bytes_pos[nal->skipped_bytes-1] = pos;
+    return 0;
+}
+
+/**
+ * Record the emulation prevention bytes of a slice NAL unit without copying
+ * it, only the beginning holding the slice header is unescaped.
+ * skipped_bytes_pos then holds positions in the escaped buffer.
+ */
+static int extract_rbsp_in_place(HEVCContext *s, const uint8_t *src, int i,
+                                 int length, HEVCNAL *nal)
+{
+    int si = i, size, ret;
+
+    while (si + 2 < length) {
+        if (src[si + 2] > 3) {
+            si += 3;
+        } else if (src[si] == 0 && src[si + 1] == 0) {
+            if (src[si + 2] != 3) // next start code
+                break;
+            ret = add_skipped_byte(nal, si + 2);
+            if (ret < 0)
+                return ret;
+            si += 3;
+        } else
+            si++;
+    }
+    if (si + 2 >= length)
+        si = length;
+
+    size = FFMIN(si - nal->skipped_bytes, HEVC_ESCAPE_HEADER_SIZE);
+    av_fast_malloc(&nal->rbsp_buffer, &nal->rbsp_buffer_size,
+                   size + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!nal->rbsp_buffer)
+        return AVERROR(ENOMEM);
+
+    nal->size = unescape_rbsp(nal->rbsp_buffer, src, si, nal->skipped_bytes_pos,
+                              nal->skipped_bytes, size);
+    memset(nal->rbsp_buffer + nal->size, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+    nal->data = nal->rbsp_buffer;
+
+    if (si - nal->skipped_bytes > HEVC_ESCAPE_HEADER_SIZE) {
+        nal->raw_data = src;
+        nal->raw_size = si;
+    } else {
+        for (i = 0; i < nal->skipped_bytes; i++)
+            nal->skipped_bytes_pos[i] -= i + 1;
+    }
+    return si;
+}
+
 /* FIXME: This is adapted from ff_h264_decode_nal, avoiding duplication
    between these functions would be nice. */
 int ff_hevc_extract_rbsp(HEVCContext *s, const uint8_t *src, int length,
                          HEVCNAL *nal)
 {
-    int i, si, di;
+    int i, si, di, ret;
     uint8_t *dst;
 
-    s->skipped_bytes = 0;
+    nal->skipped_bytes = 0;
+    nal->raw_data    = NULL;
 #define STARTCODE_TEST                                                  \
         if (i + 2 < length && src[i + 1] == 0 && src[i + 2] <= 3) {     \
             if (src[i + 2] != 3) {                                      \
@@ -2599,6 +2986,9 @@ int ff_hevc_extract_rbsp(HEVCContext *s, const uint8_t *src, int length,
         return length;
     }
 
+    if (s->escape_aware && ((src[0] >> 1) & 0x3f) < NAL_VPS)
+        return extract_rbsp_in_place(s, src, i, length, nal);
+
     av_fast_malloc(&nal->rbsp_buffer, &nal->rbsp_buffer_size,
                    length + FF_INPUT_BUFFER_PADDING_SIZE);
     if (!nal->rbsp_buffer)
@@ -2619,17 +3009,9 @@ int ff_hevc_extract_rbsp(HEVCContext *s, const uint8_t *src, int length,
                 dst[di++] = 0;
                 si       += 3;
 
-                s->skipped_bytes++;
-                if (s->skipped_bytes_pos_size < s->skipped_bytes) {
-                    s->skipped_bytes_pos_size *= 2;
-                    av_reallocp_array(&s->skipped_bytes_pos,
-                            s->skipped_bytes_pos_size,
-                            sizeof(*s->skipped_bytes_pos));
-                    if (!s->skipped_bytes_pos)
-                        return AVERROR(ENOMEM);
-                }
-                if (s->skipped_bytes_pos)
-                    s->skipped_bytes_pos[s->skipped_bytes-1] = di - 1;
+                ret = add_skipped_byte(nal, di - 1);
+                if (ret < 0)
+                    return ret;
                 continue;
             } else // next start code
                 goto nsc;
@@ -2648,12 +3030,84 @@ nsc:
     return si;
 }
 
+/**
+ * Return the size of the Annex B NAL unit at buf, i.e. the position of the
+ * next start code, as ff_hevc_extract_rbsp() would find it.
+ */
+static int find_nal_end(const uint8_t *buf, int length)
+{
+    int i;
+
+    for (i = 0; i + 2 < length; i++) {
+        if (buf[i + 2] > 3)
+            i += 2;
+        else if (!buf[i] && !buf[i + 1] && buf[i + 2] < 3)
+            return i;
+    }
+    return length;
+}
+
+/**
+ * Temporal sub-layer switching, on the first slice NAL unit of a picture.
+ * Decoding goes down at once, as the lower sub-layers never reference the
+ * higher ones. It goes up at a TSA picture of the next sub-layer to all
+ * the sub-layers wanted, at an STSA picture to its own sub-layer only, and
+ * at an IRAP picture to all of them.
+ */
+static void switch_temporal_layer(HEVCContext *s, int type, int temporal_id, int target)
+{
+    if (target <= s->max_temporal_id || s->avctx->temporal_switch == FF_TEMPORAL_SWITCH_ANY) {
+        s->max_temporal_id = target;
+    } else if (type >= NAL_BLA_W_LP && type <= NAL_CRA_NUT) {
+        s->max_temporal_id = target;
+    } else if (s->avctx->temporal_switch == FF_TEMPORAL_SWITCH_POINT &&
+               temporal_id == s->max_temporal_id + 1) {
+        if (type == NAL_TSA_N || type == NAL_TSA_R)
+            s->max_temporal_id = target;
+        else if (type == NAL_STSA_N || type == NAL_STSA_R)
+            s->max_temporal_id = temporal_id;
+    }
+}
+
+/**
+ * Whether the NAL unit starting at buf is skipped without being unescaped:
+ * the NAL units of the other layers, left to their own decoders, those of
+ * the temporal sub-layers not decoded, and the slices of the pictures that
+ * are not IRAP when skip_frame asks for key frames only. The decoders of
+ * all the layers are fed the same packets; they all need the VPS and see
+ * the end of sequence and bitstream NAL units.
+ */
+static int skip_nal(HEVCContext *s, const uint8_t *buf, int length, int target)
+{
+    int type, layer_id, temporal_id;
+
+    if (length < 2)
+        return 0;
+    type        = (buf[0] >> 1) & 0x3f;
+    layer_id    = ((buf[0] & 1) << 5) | (buf[1] >> 3);
+    temporal_id = (buf[1] & 7) - 1;
+    if (type == NAL_VPS || type == NAL_EOS_NUT || type == NAL_EOB_NUT)
+        return 0;
+    if (layer_id != s->decoder_id)
+        return 1;
+    if (s->irap_only && type < 32 && !(type >= NAL_BLA_W_LP && type <= NAL_CRA_NUT))
+        return 1;
+    // the first bit of the slice segment header is first_slice_segment_in_pic_flag
+    if (type < 32 && length > 2 && buf[2] & 0x80)
+        switch_temporal_layer(s, type, temporal_id, target);
+    return temporal_id > s->max_temporal_id;
+}
+
 static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
 {
+    int temporal_layers = s->avctx->temporal_layers;
+    int target          = temporal_layers ? FFMIN(temporal_layers, MAX_SUB_LAYERS) - 1 :
+                                            s->temporal_layer_id;
     int i, consumed, ret = 0;
 
-    s->ref = NULL;
-    s->eos = 0;
+    s->ref       = NULL;
+    s->eos       = 0;
+    s->irap_only = s->avctx->skip_frame >= AVDISCARD_NONKEY;
 
     /* split the input packet into NAL units, so we know the upper bound on the
      * number of slices in the frame */
@@ -2694,6 +3148,13 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
         if (!s->is_nalff)
             extract_length = length;
 
+        if (skip_nal(s, buf, extract_length, target)) {
+            consumed = s->is_nalff ? extract_length : find_nal_end(buf, length);
+            buf     += consumed;
+            length  -= consumed;
+            continue;
+        }
+
         if (s->nals_allocated < s->nb_nals + 1) {
             int new_size = s->nals_allocated + 1;
             HEVCNAL *tmp = av_realloc_array(s->nals, new_size, sizeof(*tmp));
@@ -2704,24 +3165,13 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
             s->nals = tmp;
             memset(s->nals + s->nals_allocated, 0,
                    (new_size - s->nals_allocated) * sizeof(*tmp));
-            av_reallocp_array(&s->skipped_bytes_nal, new_size, sizeof(*s->skipped_bytes_nal));
-            av_reallocp_array(&s->skipped_bytes_pos_size_nal, new_size, sizeof(*s->skipped_bytes_pos_size_nal));
-            av_reallocp_array(&s->skipped_bytes_pos_nal, new_size, sizeof(*s->skipped_bytes_pos_nal));
-            s->skipped_bytes_pos_size_nal[s->nals_allocated] = 1024; // initial buffer size
-            s->skipped_bytes_pos_nal[s->nals_allocated] = av_malloc_array(s->skipped_bytes_pos_size_nal[s->nals_allocated], sizeof(*s->skipped_bytes_pos));
+            s->nals[s->nals_allocated].skipped_bytes_pos_size = 1024; // initial buffer size
+            s->nals[s->nals_allocated].skipped_bytes_pos = av_malloc_array(1024, sizeof(*tmp->skipped_bytes_pos));
             s->nals_allocated = new_size;
         }
-        s->skipped_bytes_pos_size = s->skipped_bytes_pos_size_nal[s->nb_nals];
-        s->skipped_bytes_pos = s->skipped_bytes_pos_nal[s->nb_nals];
-        nal = &s->nals[s->nb_nals];
+        nal = &s->nals[s->nb_nals++];
 
         consumed = ff_hevc_extract_rbsp(s, buf, extract_length, nal);
-
-        s->skipped_bytes_nal[s->nb_nals] = s->skipped_bytes;
-        s->skipped_bytes_pos_size_nal[s->nb_nals] = s->skipped_bytes_pos_size;
-        s->skipped_bytes_pos_nal[s->nb_nals++] = s->skipped_bytes_pos;
-
-
         if (consumed < 0) {
             ret = consumed;
             goto fail;
@@ -2742,11 +3192,7 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
 
     /* parse the NAL units */
     for (i = 0; i < s->nb_nals; i++) {
-        int ret;
-        s->skipped_bytes = s->skipped_bytes_nal[i];
-        s->skipped_bytes_pos = s->skipped_bytes_pos_nal[i];
-
-        ret = decode_nal_unit(s, s->nals[i].data, s->nals[i].size);
+        int ret = decode_nal_unit(s, &s->nals[i]);
         if (ret < 0) {
             av_log(s->avctx, AV_LOG_WARNING,
                    "Error parsing NAL unit #%d.\n", i);
@@ -2755,83 +3201,277 @@ static int decode_nal_units(HEVCContext *s, const uint8_t *buf, int length)
         }
     }
 fail:
-    if (s->ref && (s->threads_type & FF_THREAD_FRAME))
-        ff_thread_report_progress(&s->ref->tf, INT_MAX, 0);
+    if (s->ref)
+        ff_hevc_report_progress(s, s->ref, INT_MAX);
 
     return ret;
 }
 
-static void print_md5(void *log_ctx, int level, uint8_t md5[16])
+#define HASH_CHECK_QUEUE_SIZE 8
+
+typedef struct HEVCHashJob {
+    AVFrame *frame;
+    int      poc;
+    int      hash_type;
+    int      pixel_shift;
+    int      width[3];
+    int      height[3];
+    uint8_t  md5[3][16];
+    uint16_t crc[3];
+    uint32_t checksum[3];
+    uint32_t (*picture_checksum)(const uint8_t *src, ptrdiff_t stride,
+                                 int width, int height);
+} HEVCHashJob;
+
+/**
+ * Decoded picture hash verification. The decoding thread queues a reference
+ * to every picture that carries a hash SEI message; the planes are hashed
+ * and the result is reported on a separate thread, so that decoding does not
+ * wait for it. The main context owns it and the frame thread copies share it,
+ * so there is a single worker per decoder.
+ */
+struct HEVCHashCheck {
+    AVCodecContext *avctx;
+    struct AVMD5   *md5_ctx;
+    const AVCRC    *crc_table;
+    void (*bswap16_buf)(uint16_t *dst, const uint16_t *src, int len);
+    uint8_t        *bswap_buf;      ///< used on BE to byteswap the lines
+    unsigned int    bswap_buf_size;
+
+    HEVCHashJob jobs[HASH_CHECK_QUEUE_SIZE];
+    int first;                      ///< oldest queued job
+    int nb_jobs;
+
+#if HAVE_THREADS
+    pthread_t       thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int started;                    ///< the worker is created on first use
+    int threaded;
+    int die;
+#endif
+};
+
+static int hash_check_plane(HEVCHashCheck *hc, const HEVCHashJob *job, int i,
+                            uint8_t md5[16])
 {
-    int i;
-    for (i = 0; i < 16; i++)
-        av_log(log_ctx, level, "%02"PRIx8, md5[i]);
+    const AVFrame *frame = job->frame;
+    int w = job->width[i];
+    int h = job->height[i];
+    uint32_t crc = av_bswap16(0x1D0F);
+    int y;
+
+    if (job->hash_type == 2)
+        return job->picture_checksum(frame->data[i], frame->linesize[i], w, h) !=
+               job->checksum[i];
+
+    /* the MD5 and CRC are computed over LE samples, so we have to byteswap
+     * for >8bpp formats on BE arches */
+#if HAVE_BIGENDIAN
+    if (job->pixel_shift) {
+        av_fast_malloc(&hc->bswap_buf, &hc->bswap_buf_size, w << 1);
+        if (!hc->bswap_buf)
+            return 1;
+    }
+#endif
+
+    if (job->hash_type == 0)
+        av_md5_init(hc->md5_ctx);
+    for (y = 0; y < h; y++) {
+        const uint8_t *src = frame->data[i] + y * frame->linesize[i];
+#if HAVE_BIGENDIAN
+        if (job->pixel_shift) {
+            hc->bswap16_buf((uint16_t *)hc->bswap_buf, (const uint16_t *)src, w);
+            src = hc->bswap_buf;
+        }
+#endif
+        if (job->hash_type == 0)
+            av_md5_update(hc->md5_ctx, src, w << job->pixel_shift);
+        else
+            crc = av_crc(hc->crc_table, crc, src, w << job->pixel_shift);
+    }
+
+    if (job->hash_type == 0) {
+        av_md5_final(hc->md5_ctx, md5);
+        return memcmp(md5, job->md5[i], 16) != 0;
+    }
+    /* the CRC of D.3.19 is augmented with 16 zero bits, which is the same as
+     * starting from 0x1D0F instead of 0xFFFF */
+    return av_bswap16(crc) != job->crc[i];
 }
 
-static int verify_md5(HEVCContext *s, AVFrame *frame)
+static void hash_check_run(HEVCHashCheck *hc, HEVCHashJob *job)
 {
-    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
-    int pixel_shift;
-    int i, j;
+    static const char *const hash_names[] = { "MD5", "CRC", "checksum" };
+    uint8_t md5[3][16];
+    int cIdx, mismatch = 0;
 
-    if (!desc)
-        return AVERROR(EINVAL);
+    for (cIdx = 0; cIdx < 3/*((s->sps->chroma_format_idc == 0) ? 1 : 3)*/; cIdx++)
+        if (hash_check_plane(hc, job, cIdx, md5[cIdx]))
+            mismatch |= 1 << cIdx;
 
-    pixel_shift = desc->comp[0].depth_minus1 > 7;
+    if (hc->avctx->picture_hash_cb) {
+        hc->avctx->picture_hash_cb(hc->avctx, job->poc, job->hash_type, mismatch);
+    } else {
+        for (cIdx = 0; cIdx < 3; cIdx++) {
+            if (mismatch & (1 << cIdx))
+                av_log(hc->avctx, AV_LOG_ERROR, "Incorrect %s (poc: %d, plane: %d)\n",
+                       hash_names[job->hash_type], job->poc, cIdx);
+            else
+                av_log(hc->avctx, AV_LOG_INFO, "Correct %s (poc: %d, plane: %d)\n",
+                       hash_names[job->hash_type], job->poc, cIdx);
+        }
+    }
+#ifdef POC_DISPLAY_MD5
+    if (job->hash_type == 0)
+        display_md5(job->poc, md5);
+#endif
 
-    av_log(s->avctx, AV_LOG_DEBUG, "Verifying checksum for frame with POC %d: ",
-           s->poc);
+    av_frame_unref(job->frame);
+}
 
-    /* the checksums are LE, so we have to byteswap for >8bpp formats
-     * on BE arches */
-#if HAVE_BIGENDIAN
-    if (pixel_shift && !s->checksum_buf) {
-        av_fast_malloc(&s->checksum_buf, &s->checksum_buf_size,
-                       FFMAX3(frame->linesize[0], frame->linesize[1],
-                              frame->linesize[2]));
-        if (!s->checksum_buf)
-            return AVERROR(ENOMEM);
+#if HAVE_THREADS
+static void *hash_check_worker(void *arg)
+{
+    HEVCHashCheck *hc = arg;
+
+    pthread_mutex_lock(&hc->mutex);
+    for (;;) {
+        if (hc->nb_jobs) {
+            HEVCHashJob *job = &hc->jobs[hc->first];
+
+            pthread_mutex_unlock(&hc->mutex);
+            hash_check_run(hc, job);
+            pthread_mutex_lock(&hc->mutex);
+            hc->first = (hc->first + 1) % HASH_CHECK_QUEUE_SIZE;
+            hc->nb_jobs--;
+            pthread_cond_broadcast(&hc->cond);
+        } else if (hc->die) {
+            break;
+        } else
+            pthread_cond_wait(&hc->cond, &hc->mutex);
     }
+    pthread_mutex_unlock(&hc->mutex);
+    return NULL;
+}
 #endif
 
-    for (i = 0; frame->data[i]; i++) {
-        int width  = s->avctx->coded_width;
-        int height = s->avctx->coded_height;
-        int w = (i == 1 || i == 2) ? (width  >> desc->log2_chroma_w) : width;
-        int h = (i == 1 || i == 2) ? (height >> desc->log2_chroma_h) : height;
-        uint8_t md5[16];
+static av_cold void hash_check_uninit(HEVCContext *s)
+{
+    HEVCHashCheck *hc = s->hash_check_ctx;
+    int i;
 
-        av_md5_init(s->md5_ctx);
-        for (j = 0; j < h; j++) {
-            const uint8_t *src = frame->data[i] + j * frame->linesize[i];
-#if HAVE_BIGENDIAN
-            if (pixel_shift) {
-                s->dsp.bswap16_buf((uint16_t*)s->checksum_buf,
-                                   (const uint16_t*)src, w);
-                src = s->checksum_buf;
-            }
-#endif
-            av_md5_update(s->md5_ctx, src, w << pixel_shift);
-        }
-        av_md5_final(s->md5_ctx, md5);
+    if (!hc)
+        return;
 
-        if (!memcmp(md5, s->md5[i], 16)) {
-            av_log   (s->avctx, AV_LOG_DEBUG, "plane %d - correct ", i);
-            print_md5(s->avctx, AV_LOG_DEBUG, md5);
-            av_log   (s->avctx, AV_LOG_DEBUG, "; ");
-        } else {
-            av_log   (s->avctx, AV_LOG_ERROR, "mismatching checksum of plane %d - ", i);
-            print_md5(s->avctx, AV_LOG_ERROR, md5);
-            av_log   (s->avctx, AV_LOG_ERROR, " != ");
-            print_md5(s->avctx, AV_LOG_ERROR, s->md5[i]);
-            av_log   (s->avctx, AV_LOG_ERROR, "\n");
-            return AVERROR_INVALIDDATA;
-        }
+#if HAVE_THREADS
+    if (hc->threaded) {
+        /* the worker drains the queue before exiting */
+        pthread_mutex_lock(&hc->mutex);
+        hc->die = 1;
+        pthread_cond_broadcast(&hc->cond);
+        pthread_mutex_unlock(&hc->mutex);
+        pthread_join(hc->thread, NULL);
     }
+    pthread_cond_destroy(&hc->cond);
+    pthread_mutex_destroy(&hc->mutex);
+#endif
+
+    for (i = 0; i < HASH_CHECK_QUEUE_SIZE; i++)
+        av_frame_free(&hc->jobs[i].frame);
+    av_freep(&hc->md5_ctx);
+    av_freep(&hc->bswap_buf);
+    av_freep(&s->hash_check_ctx);
+}
 
-    av_log(s->avctx, AV_LOG_DEBUG, "\n");
+static av_cold int hash_check_init(HEVCContext *s)
+{
+    HEVCHashCheck *hc = av_mallocz(sizeof(*hc));
+    int i;
 
+    if (!hc)
+        return AVERROR(ENOMEM);
+    s->hash_check_ctx = hc;
+#if HAVE_THREADS
+    pthread_mutex_init(&hc->mutex, NULL);
+    pthread_cond_init(&hc->cond, NULL);
+#endif
+
+    hc->avctx       = s->avctx;
+    hc->crc_table   = av_crc_get_table(AV_CRC_16_CCITT);
+    hc->bswap16_buf = s->dsp.bswap16_buf;
+    hc->md5_ctx     = av_md5_alloc();
+    if (!hc->md5_ctx)
+        goto fail;
+    for (i = 0; i < HASH_CHECK_QUEUE_SIZE; i++) {
+        hc->jobs[i].frame = av_frame_alloc();
+        if (!hc->jobs[i].frame)
+            goto fail;
+    }
     return 0;
+fail:
+    hash_check_uninit(s);
+    return AVERROR(ENOMEM);
+}
+
+/**
+ * Queue the current picture for checking against its hash SEI message.
+ * Blocks only when HASH_CHECK_QUEUE_SIZE pictures are already pending.
+ */
+static int hash_check_submit(HEVCContext *s)
+{
+    HEVCHashCheck *hc = s->hash_check_ctx;
+    HEVCHashJob  *job;
+    int i, ret, idx = 0;
+
+#if HAVE_THREADS
+    /* the frame threads submit concurrently, so the slot is reserved and
+     * filled under the lock */
+    pthread_mutex_lock(&hc->mutex);
+    if (!hc->started) {
+        hc->started  = 1;
+        hc->threaded = !pthread_create(&hc->thread, NULL, hash_check_worker, hc);
+        if (!hc->threaded)
+            av_log(s->avctx, AV_LOG_WARNING,
+                   "Could not start the picture hash thread, checking synchronously.\n");
+    }
+    if (hc->threaded) {
+        while (hc->nb_jobs == HASH_CHECK_QUEUE_SIZE)
+            pthread_cond_wait(&hc->cond, &hc->mutex);
+        idx = (hc->first + hc->nb_jobs) % HASH_CHECK_QUEUE_SIZE;
+    }
+#endif
+    job = &hc->jobs[idx];
+
+    ret = av_frame_ref(job->frame, s->ref->frame);
+    if (ret < 0)
+        goto end;
+
+    job->poc              = s->poc;
+    job->hash_type        = s->hash_type;
+    job->pixel_shift      = s->sps->pixel_shift;
+    job->picture_checksum = s->hevcdsp.picture_checksum;
+    for (i = 0; i < 3; i++) {
+        job->width[i]  = s->sps->width  >> s->sps->hshift[i];
+        job->height[i] = s->sps->height >> s->sps->vshift[i];
+    }
+    memcpy(job->md5,      s->md5,      sizeof(job->md5));
+    memcpy(job->crc,      s->crc,      sizeof(job->crc));
+    memcpy(job->checksum, s->checksum, sizeof(job->checksum));
+
+#if HAVE_THREADS
+    if (hc->threaded) {
+        hc->nb_jobs++;
+        pthread_cond_broadcast(&hc->cond);
+        goto end;
+    }
+#endif
+    hash_check_run(hc, job);
+end:
+#if HAVE_THREADS
+    pthread_mutex_unlock(&hc->mutex);
+#endif
+    return ret;
 }
 
 static int hevc_decode_frame(AVCodecContext *avctx, void *data, int *got_output,
@@ -2856,29 +3496,16 @@ static int hevc_decode_frame(AVCodecContext *avctx, void *data, int *got_output,
 
     /* verify the SEI checksum */
     if (s->decode_checksum_sei && s->is_decoded) {
-        AVFrame *frame = s->ref->frame;
-        int cIdx;
-        uint8_t md5[3][16];
-
-        calc_md5(md5[0], frame->data[0], frame->linesize[0], s->sps->width  , s->sps->height  , s->sps->pixel_shift);
-        calc_md5(md5[1], frame->data[1], frame->linesize[1], s->sps->width/2, s->sps->height/2, s->sps->pixel_shift);
-        calc_md5(md5[2], frame->data[2], frame->linesize[2], s->sps->width/2, s->sps->height/2, s->sps->pixel_shift);
-        if (s->is_md5) {
-            for( cIdx = 0; cIdx < 3/*((s->sps->chroma_format_idc == 0) ? 1 : 3)*/; cIdx++ ) {
-                if (!compare_md5(md5[cIdx], s->md5[cIdx])) {
-                     av_log(s->avctx, AV_LOG_ERROR, "Incorrect MD5 (poc: %d, plane: %d)\n", s->poc, cIdx);
-                 } else {
-                     av_log(s->avctx, AV_LOG_INFO, "Correct MD5 (poc: %d, plane: %d)\n", s->poc, cIdx);
-                 }
-            }
-            s->is_md5 = 0;
-        }
 #ifdef POC_DISPLAY_MD5
         printf_ref_pic_list(s);
-        display_md5(s->poc, md5);
 #endif
+        if (s->is_hash) {
+            ret = hash_check_submit(s);
+            if (ret < 0)
+                return ret;
+        }
     }
-    s->is_md5 = 0;
+    s->is_hash = 0;
 
     if (s->is_decoded) {
         av_log(avctx, AV_LOG_DEBUG, "Decoded frame with POC %d.\n", s->poc);
@@ -2915,6 +3542,12 @@ static int hevc_ref_frame(HEVCContext *s, HEVCFrame *dst, HEVCFrame *src)
     if (!dst->rpl_buf)
         goto fail;
 
+    if (src->il_progress) {
+        dst->il_progress = av_buffer_ref(src->il_progress);
+        if (!dst->il_progress)
+            goto fail;
+    }
+
     dst->poc        = src->poc;
     dst->ctb_count  = src->ctb_count;
     dst->window     = src->window;
@@ -2931,17 +3564,20 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
 {
     HEVCContext       *s = avctx->priv_data;
     HEVCLocalContext *lc = s->HEVClc;
+    uint64_t nb_mc_prefetch = 0;
     int i;
 
-    pic_arrays_free(s);
-    av_freep(&s->md5_ctx);
+    for (i = 0; i < s->threads_number; i++)
+        if (s->HEVClcList[i])
+            nb_mc_prefetch += s->HEVClcList[i]->nb_mc_prefetch;
+    if (s->mc_prefetch)
+        av_log(avctx, AV_LOG_VERBOSE, "%"PRIu64" reference blocks prefetched\n",
+               nb_mc_prefetch);
 
-    for(i=0; i < s->nals_allocated; i++) {
-        av_freep(&s->skipped_bytes_pos_nal[i]);
-    }
-    av_freep(&s->skipped_bytes_pos_size_nal);
-    av_freep(&s->skipped_bytes_nal);
-    av_freep(&s->skipped_bytes_pos_nal);
+    /* shared with the frame thread copies */
+    if (!avctx->internal->is_copy)
+        hash_check_uninit(s);
+    pic_arrays_free(s);
 
     av_freep(&s->cabac_state);
 
@@ -2967,14 +3603,19 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
     for (i = 1; i < s->threads_number; i++) {
         lc = s->HEVClcList[i];
         if (lc) {
+            av_freep(&lc->er.window);
             av_freep(&s->HEVClcList[i]);
             av_freep(&s->sList[i]);
         }
     }
+    if (s->HEVClcList[0])
+        av_freep(&s->HEVClcList[0]->er.window);
     av_freep(&s->HEVClcList[0]);
 
-    for (i = 0; i < s->nals_allocated; i++)
+    for (i = 0; i < s->nals_allocated; i++) {
         av_freep(&s->nals[i].rbsp_buffer);
+        av_freep(&s->nals[i].skipped_bytes_pos);
+    }
     av_freep(&s->nals);
     s->nals_allocated = 0;
 
@@ -3015,12 +3656,17 @@ static av_cold int hevc_init_context(AVCodecContext *avctx)
 
     s->max_ra = INT_MAX;
 
-    s->md5_ctx = av_md5_alloc();
-    if (!s->md5_ctx)
-        goto fail;
+    /* reference pictures can only be extended into a border we allocated */
+    if (!(avctx->flags & CODEC_FLAG_EMU_EDGE) &&
+        avctx->get_buffer2 == avcodec_default_get_buffer2) {
+        /* the default allocator may shift the planes by up to 16 bytes
+         * for alignment, which eats into the chroma border */
+        avctx->internal->edge_width = HEVC_EDGE_WIDTH + 32;
+        s->edge_width               = HEVC_EDGE_WIDTH;
+    }
 
     ff_dsputil_init(&s->dsp, avctx);
-    s->temporal_layer_id   = 8; 
+    s->max_temporal_id     = s->temporal_layer_id;
     s->context_initialized = 1;
     s->threads_type        = avctx->active_thread_type;
     if(avctx->active_thread_type & FF_THREAD_SLICE)
@@ -3091,6 +3737,8 @@ static int hevc_update_thread_context(AVCodecContext *dst,
         }
     }
 
+    s->cpu_flags_mask = s0->cpu_flags_mask;
+
     if (s->sps != s0->sps)
         ret = set_sps(s, s0->sps);
 
@@ -3099,12 +3747,18 @@ static int hevc_update_thread_context(AVCodecContext *dst,
     s->pocTid0    = s0->pocTid0;
     s->max_ra     = s0->max_ra;
 
+    s->max_temporal_id = s0->max_temporal_id;
+
     s->is_nalff        = s0->is_nalff;
     s->nal_length_size = s0->nal_length_size;
 
     s->threads_number      = s0->threads_number;
     s->threads_type        = s0->threads_type;
     s->decode_checksum_sei = s0->decode_checksum_sei;
+    s->apply_defdispwin    = s0->apply_defdispwin;
+    s->temporal_layer_id   = s0->temporal_layer_id;
+    s->escape_aware        = s0->escape_aware;
+    s->mc_prefetch         = s0->mc_prefetch;
 
     if (s0->eos) {
         s->seq_decode = (s->seq_decode + 1) & 0xff;
@@ -3191,6 +3845,12 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
     if (ret < 0)
         return ret;
 
+    ret = hash_check_init(s);
+    if (ret < 0) {
+        hevc_decode_free(avctx);
+        return ret;
+    }
+
     s->picture_struct = 0;
 
     if (avctx->extradata_size > 0 && avctx->extradata) {
@@ -3206,10 +3866,28 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
 static av_cold int hevc_init_thread_copy(AVCodecContext *avctx)
 {
     HEVCContext *s = avctx->priv_data;
+    /* the AVOptions were copied from the main context with the rest */
+    int decode_checksum_sei = s->decode_checksum_sei;
+    int apply_defdispwin    = s->apply_defdispwin;
+    int decoder_id          = s->decoder_id;
+    int temporal_layer_id   = s->temporal_layer_id;
+    int escape_aware        = s->escape_aware;
+    int mc_prefetch         = s->mc_prefetch;
+    int cpu_flags_mask      = s->cpu_flags_mask;
+    HEVCHashCheck *hash_check_ctx = s->hash_check_ctx;
     int ret;
 
     memset(s, 0, sizeof(*s));
 
+    s->decode_checksum_sei = decode_checksum_sei;
+    s->apply_defdispwin    = apply_defdispwin;
+    s->decoder_id          = decoder_id;
+    s->temporal_layer_id   = temporal_layer_id;
+    s->escape_aware        = escape_aware;
+    s->mc_prefetch         = mc_prefetch;
+    s->cpu_flags_mask      = cpu_flags_mask;
+    s->hash_check_ctx      = hash_check_ctx;
+
     ret = hevc_init_context(avctx);
     if (ret < 0)
         return ret;
@@ -3240,9 +3918,15 @@ static const AVOption options[] = {
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, PAR },
     { "decoder-id", "set the decoder id", OFFSET(decoder_id),
-        AV_OPT_TYPE_INT, {.i64 = 0}, 0, 10, PAR },
+        AV_OPT_TYPE_INT, {.i64 = 0}, 0, MAX_LAYERS - 1, PAR },
     { "temporal-layer-id", "set the max temporal id", OFFSET(temporal_layer_id),
-        AV_OPT_TYPE_INT, {.i64 = 0}, 0, 10, PAR },
+        AV_OPT_TYPE_INT, {.i64 = MAX_SUB_LAYERS - 1}, 0, MAX_SUB_LAYERS - 1, PAR },
+    { "escape-aware", "read escaped slice data in place instead of copying it", OFFSET(escape_aware),
+        AV_OPT_TYPE_INT, {.i64 = 0}, 0, 1, PAR },
+    { "mc-prefetch", "reference rows to prefetch per prediction unit once its motion vector is known (0 disables)",
+        OFFSET(mc_prefetch), AV_OPT_TYPE_INT, {.i64 = 0}, 0, MAX_PB_SIZE + 7, PAR },
+    { "cpu-flags-mask", "AV_CPU_FLAG_* the DSP functions of this decoder may use",
+        OFFSET(cpu_flags_mask), AV_OPT_TYPE_INT, {.i64 = -1}, INT_MIN, INT_MAX, PAR },
     { NULL },
 };
 
@@ -60,12 +60,25 @@
 #define MAX_PB_SIZE 64
 #define MAX_EDGE_BUFFER_SIZE    ((MAX_PB_SIZE + 8) * (MAX_PB_SIZE+8) * 2)
 #define MAX_EDGE_BUFFER_STRIDE  ((MAX_PB_SIZE+8) * 2)
+
+/* border around reference pictures that is filled by edge extension, so that
+ * motion compensation can read past the picture without emulating the edge */
+#define HEVC_EDGE_WIDTH 80
+
+/* one 64x64 CTB of 4x4 min PUs, plus the neighbours on each side */
+#define MVF_CACHE_STRIDE ((MAX_PB_SIZE >> 2) + 2)
 #define MAX_LOG2_CTB_SIZE 6
 #define MAX_QP 51
 #define DEFAULT_INTRA_TC_OFFSET 2
 
 #define HEVC_CONTEXTS 183
 
+/**
+ * Number of RBSP bytes unescaped ahead of the slice data when reading
+ * escaped NAL units in place, large enough for any sane slice header.
+ */
+#define HEVC_ESCAPE_HEADER_SIZE 16384
+
 #define MRG_MAX_NUM_CANDS     5
 
 #define L0 0
@@ -259,7 +272,6 @@ enum ScanType {
     SCAN_VERT,
 };
 
-#ifdef SVC_EXTENSION
 typedef struct UpsamplInf {
 	int addXLum;
 	int addYLum;
@@ -270,7 +282,6 @@ typedef struct UpsamplInf {
 	int scaleXCr;
 	int scaleYCr;
 } UpsamplInf;
-#endif
 
 typedef struct ShortTermRPS {
     int num_negative_pics;
@@ -533,6 +544,36 @@ typedef struct HEVCSPS {
 #endif
 } HEVCSPS;
 
+/**
+ * Scan order conversion tables, which only depend on the picture geometry
+ * and the tile layout. They are shared between all the PPSes using the
+ * same layout, so that resending a PPS does not rebuild them.
+ */
+typedef struct HEVCScanOrder {
+    int width;
+    int height;
+    int ctb_width;
+    int ctb_height;
+    int log2_ctb_size;
+    int log2_min_cb_size;
+    int log2_min_tb_size;
+    int num_tile_columns;
+    int num_tile_rows;
+
+    int *column_width;  ///< ColumnWidth
+    int *row_height;    ///< RowHeight
+    int *col_bd;        ///< ColBd
+    int *row_bd;        ///< RowBd
+    int *col_idxX;
+
+    int *ctb_addr_rs_to_ts; ///< CtbAddrRSToTS
+    int *ctb_addr_ts_to_rs; ///< CtbAddrTSToRS
+    int *tile_id;           ///< TileId
+    int *tile_pos_rs;       ///< TilePosRS
+    int *min_cb_addr_zs;    ///< MinCbAddrZS
+    int *min_tb_addr_zs;    ///< MinTbAddrZS
+} HEVCScanOrder;
+
 typedef struct HEVCPPS {
     int sps_id; ///< seq_parameter_set_id
 
@@ -586,7 +627,8 @@ typedef struct HEVCPPS {
     uint8_t pps_extension_flag;
     uint8_t pps_extension_data_flag;
 
-    // Inferred parameters
+    // Inferred parameters, pointing into scan_order_buf
+    AVBufferRef *scan_order_buf;
     int *column_width;  ///< ColumnWidth
     int *row_height;    ///< RowHeight
     int *col_bd;        ///< ColBd
@@ -671,6 +713,10 @@ typedef struct SliceHeader {
     int16_t luma_offset_l1[16];
     int16_t chroma_offset_l1[16][2];
 
+    HEVCWeight luma_wp[2][16];
+    HEVCWeight chroma_wp[2][16][2];
+    uint8_t wp_explicit[2][16];     ///< some weight of the reference differs from the default
+
 #if REF_IDX_FRAMEWORK
     int inter_layer_pred_enabled_flag;
 #endif
@@ -680,10 +726,8 @@ typedef struct SliceHeader {
     int     inter_layer_pred_layer_idc[MAX_VPS_LAYER_ID_PLUS1];
 #endif
 
-#ifdef SVC_EXTENSION
     int ScalingFactor[MAX_LAYERS][2];
     int ScalingPosition[MAX_LAYERS][2];
-#endif
     int slice_ctb_addr_rs;
 } SliceHeader;
 
@@ -729,6 +773,20 @@ typedef struct NeighbourAvailable {
     int cand_up_right_sap;
 } NeighbourAvailable;
 
+/**
+ * Motion field of the current CTB with a one min PU border above and to the
+ * left (and the above right and below left corners), indexed in min PUs from
+ * (x_pu, y_pu). Merge and AMVP candidates are read from here instead of the
+ * picture wide tab_mvf.
+ */
+typedef struct MvFieldCache {
+    MvField mvf[MVF_CACHE_STRIDE * MVF_CACHE_STRIDE];
+    /** 1 if the min PU is available in z-scan order (6.4.1) */
+    uint8_t avail[MVF_CACHE_STRIDE * MVF_CACHE_STRIDE];
+    int x_pu;
+    int y_pu;
+} MvFieldCache;
+
 typedef struct PredictionUnit {
     int mpm_idx;
     int rem_intra_luma_pred_mode;
@@ -792,6 +850,11 @@ typedef struct HEVCFrame {
     AVBufferRef *tab_mvf_buf;
     AVBufferRef *rpl_tab_buf;
     AVBufferRef *rpl_buf;
+    /**
+     * CTB row progress, for the decoder of the layer above which may run on
+     * another thread. Only allocated when that decoder is pipelined.
+     */
+    AVBufferRef *il_progress;
 
     /**
      * A sequence counter, so that old frames are output first
@@ -807,12 +870,60 @@ typedef struct HEVCFrame {
 
 typedef struct HEVCNAL {
     uint8_t *rbsp_buffer;
-    int rbsp_buffer_size;
+    unsigned int rbsp_buffer_size;
 
     int size;
     const uint8_t *data;
+
+    int skipped_bytes;
+    int *skipped_bytes_pos;
+    int skipped_bytes_pos_size;
+
+    /**
+     * When set, data only holds the first HEVC_ESCAPE_HEADER_SIZE unescaped
+     * bytes and the slice data is read in place from raw_data, skipping the
+     * emulation prevention bytes listed in skipped_bytes_pos.
+     */
+    const uint8_t *raw_data;
+    int raw_size;
 } HEVCNAL;
 
+/**
+ * Reads slice data in place from an escaped NAL unit. The CABAC decoder
+ * points directly into the packet as long as no emulation prevention byte
+ * lies within margin bytes ahead; otherwise the next bytes are unescaped
+ * into a small window. The check is done once per CTB.
+ */
+typedef struct HEVCEscapeReader {
+    const uint8_t *raw;     ///< escaped NAL unit, NULL if not reading in place
+    int raw_size;
+    const int *pos;         ///< positions of the emulation prevention bytes in raw
+    int nb_pos;
+    int idx;                ///< first entry of pos not behind the reader
+    int margin;             ///< upper bound of the bytes consumed by one CTB
+
+    uint8_t *window;
+    unsigned int window_size;
+    int window_pos;         ///< raw position of window[2], -1 when reading raw
+    int window_idx;         ///< value of idx at window_pos
+    int window_last;        ///< the window reaches the end of the NAL unit
+} HEVCEscapeReader;
+
+/**
+ * Motion compensation of one prediction block. The jobs of a CU are
+ * recorded while its prediction units are parsed and run together before
+ * the residual is added.
+ */
+typedef struct HEVCMCJob {
+    MvField mv;
+    HEVCFrame *ref[2];
+    int x0, y0;
+    int nPbW, nPbH;
+    int idx;
+} HEVCMCJob;
+
+#define MAX_MC_JOBS 4 ///< prediction units per CU
+
 typedef struct HEVCLocalContext {
     GetBitContext gb;
     CABACContext cc;
@@ -824,6 +935,7 @@ typedef struct HEVCLocalContext {
     NeighbourAvailable na;
 
     uint8_t edge_emu_buffer[MAX_EDGE_BUFFER_SIZE];
+    uint8_t edge_emu_buffer2[MAX_EDGE_BUFFER_SIZE]; ///< Cr block of joint chroma MC
 
     uint8_t cabac_state[HEVC_CONTEXTS];
 
@@ -844,8 +956,18 @@ typedef struct HEVCLocalContext {
 
     uint8_t slice_or_tiles_left_boundary;
     uint8_t slice_or_tiles_up_boundary;
+
+    HEVCEscapeReader er;
+    MvFieldCache mvf_cache;
+
+    HEVCMCJob mc_job[MAX_MC_JOBS];
+    int nb_mc_jobs;
+    uint64_t nb_mc_prefetch;    ///< number of reference blocks prefetched
 } HEVCLocalContext;
 
+typedef struct HEVCILUpsample HEVCILUpsample;
+typedef struct HEVCHashCheck HEVCHashCheck;
+
 typedef struct HEVCContext {
     const AVClass *c;  // needed by private avoptions
     AVCodecContext      *avctx;
@@ -873,6 +995,7 @@ typedef struct HEVCContext {
 
     SliceHeader sh;
     SAOParams *sao;
+    uint16_t *sao_no_filter;    ///< SAO_NO_FILTER() mask of each CTB
     DBParams *deblock;
 
     ///< candidate references for the current frame
@@ -915,10 +1038,6 @@ typedef struct HEVCContext {
     // CTB-level flags affecting loop filter operation
     uint8_t *filter_slice_edges;
 
-    /** used on BE to byteswap the lines for checksumming */
-    uint8_t *checksum_buf;
-    int      checksum_buf_size;
-
     /**
      * Sequence counters for decoded and output frames, so that old
      * frames are output first after a POC reset
@@ -927,13 +1046,6 @@ typedef struct HEVCContext {
     uint16_t seq_output;
 
     int wpp_err;
-    int skipped_bytes;
-    int *skipped_bytes_pos;
-    int skipped_bytes_pos_size;
-
-    int *skipped_bytes_nal;
-    int **skipped_bytes_pos_nal;
-    int *skipped_bytes_pos_size_nal;
 
     uint8_t *data;
 
@@ -941,21 +1053,23 @@ typedef struct HEVCContext {
     int nb_nals;
     int nals_allocated;
 
-    // for checking the frame checksums
-    struct AVMD5 *md5_ctx;
+    // decoded picture hash SEI of the current picture
     uint8_t       md5[3][16];
-    uint8_t is_md5;
+    uint16_t      crc[3];
+    uint32_t      checksum[3];
+    uint8_t       hash_type;
+    uint8_t       is_hash;
 
     int context_initialized;
 
-#ifdef SVC_EXTENSION
     AVFrame     *EL_frame;
-    short       *buffer_frame[3];
+    HEVCILUpsample *il_upsample;  ///< parts of inter_layer_ref materialized
     UpsamplInf  up_filter_inf;
     HEVCFrame   *BL_frame;
     HEVCFrame   *inter_layer_ref;
-#endif
-    int temporal_layer_id;
+    int temporal_layer_id;  ///< highest temporal sub-layer to decode by default
+    int max_temporal_id;    ///< highest temporal sub-layer decoded for now
+    int irap_only;          ///< only the IRAP pictures of the packet are decoded
     int nuh_layer_id;
     int decoder_id;
     int is_nalff;           ///< this flag is != 0 if bitstream is encapsulated
@@ -974,6 +1088,11 @@ typedef struct HEVCContext {
     uint8_t             threads_type;
     uint8_t             threads_number;
     int                 decode_checksum_sei;
+    int                 escape_aware; ///< read escaped slice data in place
+    int                 mc_prefetch;  ///< reference rows prefetched per PU once its MV is known, 0 disables
+    int                 cpu_flags_mask; ///< AV_CPU_FLAG_* the DSP functions may use
+    HEVCHashCheck      *hash_check_ctx;
+    int                 edge_width;   ///< extended border of reference pictures, 0 if edges are emulated
 } HEVCContext;
 
 int ff_hevc_decode_short_term_rps(HEVCContext *s, ShortTermRPS *rps,
@@ -1016,6 +1135,15 @@ int ff_hevc_slice_rpl(HEVCContext *s);
 
 void ff_hevc_save_states(HEVCContext *s, int ctb_addr_ts);
 void ff_hevc_cabac_init(HEVCContext *s, int ctb_addr_ts);
+
+/**
+ * Return the position in an escaped buffer of the nb-th RBSP byte starting
+ * at raw_pos. *idx is the first entry of pos not below raw_pos and is
+ * updated on return.
+ */
+int ff_hevc_escape_skip(const int *pos, int nb_pos, int *idx, int raw_pos, int nb);
+int ff_hevc_escape_reader_init(HEVCLocalContext *lc, const uint8_t *raw, int raw_size,
+                               const int *pos, int nb_pos, int margin);
 int ff_hevc_sao_merge_flag_decode(HEVCContext *s);
 int ff_hevc_sao_type_idx_decode(HEVCContext *s);
 int ff_hevc_sao_band_position_decode(HEVCContext *s);
@@ -1060,8 +1188,58 @@ int ff_hevc_output_frame(HEVCContext *s, AVFrame *frame, int flush);
 
 void ff_hevc_unref_frame(HEVCContext *s, HEVCFrame *frame, int flags);
 
+/**
+ * Announce that the luma rows above progress are final in frame, to the
+ * other frame threads and to the decoder of the layer above.
+ */
+void ff_hevc_report_progress(HEVCContext *s, HEVCFrame *frame, int progress);
+/**
+ * Wait until the luma rows above progress are final in frame, a picture of
+ * the layer below.
+ */
+void ff_hevc_await_layer_progress(HEVCFrame *frame, int progress);
+
+int ff_hevc_il_alloc(HEVCContext *s, const HEVCSPS *sps, int bl_width, int bl_height);
+void ff_hevc_il_free(HEVCContext *s);
+
+/**
+ * Make the samples of the inter-layer reference final in the luma area
+ * [x0, x1) x [y0, y1), clipped to the picture, upsampling the CTBs it
+ * covers that no block has read from yet.
+ */
+void ff_hevc_il_await_pixels(HEVCContext *s, int x0, int y0, int x1, int y1);
+
+/**
+ * Make the motion of the inter-layer reference final at luma position
+ * (x, y), scaling the motion of the base layer for its CTB if needed.
+ */
+void ff_hevc_il_await_motion(HEVCContext *s, int x, int y);
+
+/**
+ * Position, in 1/16 of a base layer row, at which row y of plane c_idx of
+ * the inter-layer reference is interpolated; height is the height of the
+ * plane. The position only grows with y, and the first base layer row read
+ * by the filter is (pos >> 4) - (NTAPS >> 1) + 1.
+ */
+static av_always_inline int ff_hevc_il_ref_pos16_y(const HEVCWindow *win,
+                                                   const UpsamplInf *up,
+                                                   int c_idx, int height, int y)
+{
+    int shift  = !!c_idx;
+    int top    = win->top_offset >> shift;
+    int bottom = height - (win->bottom_offset >> shift);
+
+    y = av_clip(y, top, bottom - 1) - top;
+    if (c_idx)
+        return ((y * up->scaleYCr + up->addYCr) >> 12) - 4;
+    return (y * up->scaleYLum + up->addYLum) >> 12;
+}
+
 void ff_hevc_set_neighbour_available(HEVCContext *s, int x0, int y0,
                                      int nPbW, int nPbH);
+void ff_hevc_mvf_cache_load(HEVCContext *s, int x_ctb, int y_ctb);
+void ff_hevc_set_mvf(HEVCContext *s, int x0, int y0, int nPbW, int nPbH,
+                     const MvField *mvf);
 void ff_hevc_luma_mv_merge_mode(HEVCContext *s, int x0, int y0,
                                 int nPbW, int nPbH, int log2_cb_size,
                                 int part_idx, int merge_idx, MvField *mv);
@@ -1081,6 +1259,21 @@ int ff_hevc_cu_qp_delta_sign_flag(HEVCContext *s);
 int ff_hevc_cu_qp_delta_abs(HEVCContext *s);
 void ff_hevc_hls_filter(HEVCContext *s, int x, int y);
 void ff_hevc_hls_filters(HEVCContext *s, int x_ctb, int y_ctb, int ctb_size);
+
+/**
+ * Extend the luma rows [y0, y1) of a reference picture (and the matching
+ * chroma rows) into its border. The top border is filled when y0 is 0 and
+ * the bottom border when y1 reaches the picture height.
+ */
+void ff_hevc_extend_edges(HEVCContext *s, AVFrame *frame, int y0, int y1);
+
+/**
+ * Extend the luma area [x0, x1) x [y0, y1) of a reference picture (and the
+ * matching chroma area) into the parts of its border next to it, including
+ * the corners when the area touches two edges.
+ */
+void ff_hevc_extend_edges_area(HEVCContext *s, AVFrame *frame,
+                               int x0, int y0, int x1, int y1);
 void ff_hevc_hls_residual_coding(HEVCContext *s, int x0, int y0,
                                  int log2_trafo_size, enum ScanType scan_idx,
                                  int c_idx);
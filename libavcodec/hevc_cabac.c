@@ -515,12 +515,138 @@ static void cabac_reinit(HEVCLocalContext *lc)
     skip_bytes(&lc->cc, 0);
 }
 
+int ff_hevc_escape_skip(const int *pos, int nb_pos, int *idx, int raw_pos, int nb)
+{
+    int k = *idx;
+
+    raw_pos += nb;
+    while (k < nb_pos && pos[k] <= raw_pos) {
+        raw_pos++;
+        k++;
+    }
+    *idx = k;
+    return raw_pos;
+}
+
+int ff_hevc_escape_reader_init(HEVCLocalContext *lc, const uint8_t *raw, int raw_size,
+                               const int *pos, int nb_pos, int margin)
+{
+    HEVCEscapeReader *er = &lc->er;
+
+    av_fast_malloc(&er->window, &er->window_size,
+                   2 + 2 * margin + FF_INPUT_BUFFER_PADDING_SIZE);
+    if (!er->window)
+        return AVERROR(ENOMEM);
+
+    er->raw        = raw;
+    er->raw_size   = raw_size;
+    er->pos        = pos;
+    er->nb_pos     = nb_pos;
+    er->idx        = 0;
+    er->margin     = margin;
+    er->window_pos = -1;
+    return 0;
+}
+
+/**
+ * Make the CABAC decoder continue at raw position raw_pos, either in place
+ * or from a freshly unescaped window. The two bytes before raw_pos are kept
+ * readable since skip_bytes() may step back over them.
+ */
+static const uint8_t *escape_reader_seek(HEVCLocalContext *lc, int raw_pos)
+{
+    HEVCEscapeReader *er = &lc->er;
+    CABACContext     *cc = &lc->cc;
+    const int *pos = er->pos;
+    int k, r, n, b, j;
+
+    if ((er->idx > 0 && pos[er->idx - 1] >= raw_pos) ||
+        (er->idx < er->nb_pos && pos[er->idx] < raw_pos)) {
+        int lo = 0, hi = er->nb_pos;
+        while (lo < hi) {
+            int mid = (lo + hi) >> 1;
+            if (pos[mid] < raw_pos)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        er->idx = lo;
+    }
+
+    if ((er->idx >= er->nb_pos || pos[er->idx] - raw_pos >= er->margin) &&
+        (!er->idx || raw_pos - pos[er->idx - 1] > 2)) {
+        er->window_pos       = -1;
+        cc->bytestream_start = er->raw;
+        cc->bytestream_end   = er->raw + er->raw_size;
+        return er->raw + raw_pos;
+    }
+
+    for (j = 1, b = raw_pos - 1, k = er->idx - 1; j >= 0; j--, b--) {
+        while (k >= 0 && pos[k] == b) {
+            b--;
+            k--;
+        }
+        er->window[j] = b >= 0 ? er->raw[b] : 0;
+    }
+
+    for (r = raw_pos, k = er->idx, n = 0; n < 2 * er->margin && r < er->raw_size;) {
+        int end = k < er->nb_pos ? FFMIN(pos[k], er->raw_size) : er->raw_size;
+        int len = FFMIN(end - r, 2 * er->margin - n);
+
+        memcpy(er->window + 2 + n, er->raw + r, len);
+        n += len;
+        r += len;
+        if (k < er->nb_pos && pos[k] == r) {
+            r++;
+            k++;
+        }
+    }
+    memset(er->window + 2 + n, 0, FF_INPUT_BUFFER_PADDING_SIZE);
+
+    er->window_pos       = raw_pos;
+    er->window_idx       = er->idx;
+    er->window_last      = r >= er->raw_size;
+    cc->bytestream_start = er->window;
+    cc->bytestream_end   = er->window + 2 + n;
+    return er->window + 2;
+}
+
+/**
+ * Called at every CTB start, move the decoder in or out of the window
+ * before it can reach an emulation prevention byte.
+ */
+static void escape_reader_update(HEVCLocalContext *lc)
+{
+    HEVCEscapeReader *er = &lc->er;
+    CABACContext     *cc = &lc->cc;
+    int raw_pos, idx;
+
+    if (er->window_pos < 0) {
+        raw_pos = cc->bytestream - er->raw;
+        if (er->idx >= er->nb_pos || er->pos[er->idx] - raw_pos >= er->margin)
+            return;
+    } else {
+        if (cc->bytestream_end - cc->bytestream >= er->margin || er->window_last)
+            return;
+        idx     = er->window_idx;
+        raw_pos = ff_hevc_escape_skip(er->pos, er->nb_pos, &idx, er->window_pos,
+                                      cc->bytestream - (er->window + 2));
+    }
+    cc->bytestream = escape_reader_seek(lc, raw_pos);
+}
+
 static void cabac_init_decoder(HEVCContext *s)
 {
-    GetBitContext *gb = &s->HEVClc->gb;
+    HEVCLocalContext *lc = s->HEVClc;
+    GetBitContext    *gb = &lc->gb;
     skip_bits(gb, 1);
     align_get_bits(gb);
-    ff_init_cabac_decoder(&s->HEVClc->cc,
+    if (lc->er.raw) {
+        const uint8_t *ptr = escape_reader_seek(lc, gb->buffer + get_bits_count(gb) / 8 - lc->er.raw);
+        ff_init_cabac_decoder(&lc->cc, ptr, lc->cc.bytestream_end - ptr);
+        return;
+    }
+    ff_init_cabac_decoder(&lc->cc,
                           gb->buffer + get_bits_count(gb) / 8,
                           (get_bits_left(gb) + 7) / 8);
 }
@@ -588,6 +714,8 @@ void ff_hevc_cabac_init(HEVCContext *s, int ctb_addr_ts)
             }
         }
     }
+    if (s->HEVClc->er.raw)
+        escape_reader_update(s->HEVClc);
 }
 
 #define GET_CABAC(ctx) get_cabac(&s->HEVClc->cc, &s->HEVClc->cabac_state[ctx])
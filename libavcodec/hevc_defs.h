@@ -23,23 +23,24 @@
 #ifndef AVCODEC_HEVC_DEF_H
 #define AVCODEC_HEVC_DEF_H
 
-//#define SVC_EXTENSION
-
-#ifdef SVC_EXTENSION
-    #define VPS_EXTENSION
-    #define SCALED_REF_LAYER_OFFSETS 1
-    #define MAX_LAYERS  2
-    #define PHASE_DERIVATION_IN_INTEGER 1
-    #define ILP_DECODED_PICTURE 1
-    #define CHROMA_UPSAMPLING   1
-    #define REF_IDX_FRAMEWORK   1
-    #ifdef REF_IDX_FRAMEWORK
-        #define REF_IDX_ME_ZEROMV                1
-        #define REF_IDX_MFM                      1
-        #define JCTVC_M0458_INTERLAYER_RPS_SIG   1
-        #if JCTVC_M0458_INTERLAYER_RPS_SIG
-            #define ZERO_NUM_DIRECT_LAYERS       1
-        #endif
+/*
+ * Scalable (SHVC) decoding is always built in. It only comes into play for
+ * the decoders of the enhancement layers, which see no NAL unit of their
+ * layer in a single-layer stream.
+ */
+#define VPS_EXTENSION
+#define SCALED_REF_LAYER_OFFSETS 1
+#define MAX_LAYERS  8   ///< layers decoded, base layer included
+#define PHASE_DERIVATION_IN_INTEGER 1
+#define ILP_DECODED_PICTURE 1
+#define CHROMA_UPSAMPLING   1
+#define REF_IDX_FRAMEWORK   1
+#ifdef REF_IDX_FRAMEWORK
+    #define REF_IDX_ME_ZEROMV                1
+    #define REF_IDX_MFM                      1
+    #define JCTVC_M0458_INTERLAYER_RPS_SIG   1
+    #if JCTVC_M0458_INTERLAYER_RPS_SIG
+        #define ZERO_NUM_DIRECT_LAYERS       1
     #endif
 #endif
 
@@ -173,144 +173,101 @@ static int get_qPy(HEVCContext *s, int xC, int yC)
     return s->qp_y_tab[x + y * s->sps->min_cb_width];
 }
 
-static void copy_CTB(uint8_t *dst, uint8_t *src,
-                     int width, int height, int stride)
+#define CTB(tab, x, y) ((tab)[(y) * s->sps->ctb_width + (x)])
+
+static int tile_edge(HEVCContext *s, int ctb_addr_rs_a, int ctb_addr_rs_b)
 {
-    int i;
+    return s->pps->tiles_enabled_flag &&
+           !s->pps->loop_filter_across_tiles_enabled_flag &&
+           s->pps->tile_id[s->pps->ctb_addr_rs_to_ts[ctb_addr_rs_a]] !=
+           s->pps->tile_id[s->pps->ctb_addr_rs_to_ts[ctb_addr_rs_b]];
+}
 
-    for (i = 0; i < height; i++) {
-        memcpy(dst, src, width);
-        dst += stride;
-        src += stride;
-    }
+/* CTB (xb, yb) is right of, below or below right of CTB (xa, ya);
+ * whether the slice edge is filtered is decided by the later CTB. */
+static int sao_edge_blocked(HEVCContext *s, int xa, int ya, int xb, int yb)
+{
+    int a = ya * s->sps->ctb_width + xa;
+    int b = yb * s->sps->ctb_width + xb;
+
+    return (!s->filter_slice_edges[b] &&
+            s->tab_slice_address[a] != s->tab_slice_address[b]) ||
+           tile_edge(s, a, b);
 }
 
-#define CTB(tab, x, y) ((tab)[(y) * s->sps->ctb_width + (x)])
+/* CTB (xb, yb) is above right of CTB (xa, ya): the slice coming last in
+ * the bitstream decides whether its edge is filtered. */
+static int sao_diag_blocked(HEVCContext *s, int xa, int ya, int xb, int yb)
+{
+    int a = ya * s->sps->ctb_width + xa;
+    int b = yb * s->sps->ctb_width + xb;
+
+    if (tile_edge(s, a, b))
+        return 1;
+    if (s->tab_slice_address[a] > s->tab_slice_address[b])
+        return !s->filter_slice_edges[a];
+    if (s->tab_slice_address[a] < s->tab_slice_address[b])
+        return !s->filter_slice_edges[b];
+    return 0;
+}
 
-static void sao_filter_CTB(HEVCContext *s, int x, int y)
+/* SAO_NO_FILTER() mask of the neighbours of a CTB, out of picture
+ * neighbours included */
+static int sao_no_filter(HEVCContext *s, int x_ctb, int y_ctb)
 {
-    int c_idx = 0;
-    int class = 1, class_index;
-    int edges[4];  // 0 left 1 top 2 right 3 bottom
-    SAOParams *sao[4];
-    int classes[4];
-    int x_shift = 0, y_shift = 0;
-    int x_ctb = x >> s->sps->log2_ctb_size;
-    int y_ctb = y >> s->sps->log2_ctb_size;
-    int ctb_addr_rs = y_ctb * s->sps->ctb_width + x_ctb;
-    int ctb_addr_ts = s->pps->ctb_addr_rs_to_ts[ctb_addr_rs];
-
-    // flags indicating unfilterable edges
-    uint8_t vert_edge[]  = { 0, 0, 0, 0 };
-    uint8_t horiz_edge[] = { 0, 0, 0, 0 };
-    uint8_t diag_edge[]  = { 0, 0, 0, 0 };
-    uint8_t lfase[3]; // current, above, left
-    uint8_t no_tile_filter = s->pps->tiles_enabled_flag &&
-                             !s->pps->loop_filter_across_tiles_enabled_flag;
-    uint8_t left_tile_edge = 0;
-    uint8_t up_tile_edge = 0;
-
-    sao[0]     = &CTB(s->sao, x_ctb, y_ctb);
-    edges[0]   = x_ctb == 0;
-    edges[1]   = y_ctb == 0;
-    edges[2]   = x_ctb == s->sps->ctb_width  - 1;
-    edges[3]   = y_ctb == s->sps->ctb_height - 1;
-    lfase[0]   = CTB(s->filter_slice_edges, x_ctb, y_ctb);
-    classes[0] = 0;
-
-    if (!edges[0]) {
-        left_tile_edge = no_tile_filter && s->pps->tile_id[ctb_addr_ts] != s->pps->tile_id[s->pps->ctb_addr_rs_to_ts[ctb_addr_rs-1]];
-        sao[class] = &CTB(s->sao, x_ctb - 1, y_ctb);
-        vert_edge[0] = (!lfase[0] && CTB(s->tab_slice_address, x_ctb, y_ctb) != CTB(s->tab_slice_address, x_ctb - 1, y_ctb)) || left_tile_edge;
-        vert_edge[2] = vert_edge[0];
-        lfase[2]     = CTB(s->filter_slice_edges, x_ctb - 1, y_ctb);
-        classes[class] = 2;
-        class++;
-        x_shift = 8;
-    }
+    int w = s->sps->ctb_width, h = s->sps->ctb_height;
+    int left  = x_ctb > 0, right = x_ctb < w - 1;
+    int up    = y_ctb > 0, down  = y_ctb < h - 1;
+    int no_filter = 0;
+
+    if (!left || !up || sao_edge_blocked(s, x_ctb - 1, y_ctb - 1, x_ctb, y_ctb))
+        no_filter |= SAO_NO_FILTER(-1, -1);
+    if (!up || sao_edge_blocked(s, x_ctb, y_ctb - 1, x_ctb, y_ctb))
+        no_filter |= SAO_NO_FILTER( 0, -1);
+    if (!right || !up || sao_diag_blocked(s, x_ctb, y_ctb, x_ctb + 1, y_ctb - 1))
+        no_filter |= SAO_NO_FILTER( 1, -1);
+    if (!left || sao_edge_blocked(s, x_ctb - 1, y_ctb, x_ctb, y_ctb))
+        no_filter |= SAO_NO_FILTER(-1,  0);
+    if (!right || sao_edge_blocked(s, x_ctb, y_ctb, x_ctb + 1, y_ctb))
+        no_filter |= SAO_NO_FILTER( 1,  0);
+    if (!left || !down || sao_diag_blocked(s, x_ctb - 1, y_ctb + 1, x_ctb, y_ctb))
+        no_filter |= SAO_NO_FILTER(-1,  1);
+    if (!down || sao_edge_blocked(s, x_ctb, y_ctb, x_ctb, y_ctb + 1))
+        no_filter |= SAO_NO_FILTER( 0,  1);
+    if (!right || !down || sao_edge_blocked(s, x_ctb, y_ctb, x_ctb + 1, y_ctb + 1))
+        no_filter |= SAO_NO_FILTER( 1,  1);
+    return no_filter;
+}
 
-    if (!edges[1]) {
-        up_tile_edge = no_tile_filter && s->pps->tile_id[ctb_addr_ts] != s->pps->tile_id[s->pps->ctb_addr_rs_to_ts[ctb_addr_rs - s->sps->ctb_width]];
-        sao[class] = &CTB(s->sao, x_ctb, y_ctb - 1);
-        horiz_edge[0] = (!lfase[0] && CTB(s->tab_slice_address, x_ctb, y_ctb) != CTB(s->tab_slice_address, x_ctb, y_ctb - 1)) || up_tile_edge;
-        horiz_edge[1] = horiz_edge[0];
-        lfase[1] = CTB(s->filter_slice_edges, x_ctb, y_ctb - 1);
-        classes[class] = 1;
-        class++;
-        y_shift = 4;
-
-        if (!edges[0]) {
-            classes[class] = 3;
-            sao[class] = &CTB(s->sao, x_ctb - 1, y_ctb - 1);
-            class++;
-
-            // Tile check here is done current CTB row/col, not above/left like you'd expect,
-            //but that is because the tile boundary always extends through the whole pic
-            vert_edge[1] = (!lfase[1] && CTB(s->tab_slice_address, x_ctb, y_ctb - 1) != CTB(s->tab_slice_address, x_ctb - 1, y_ctb - 1)) || left_tile_edge;
-            vert_edge[3] = vert_edge[1];
-            horiz_edge[2] = (!lfase[2] && CTB(s->tab_slice_address, x_ctb - 1, y_ctb) != CTB(s->tab_slice_address, x_ctb - 1, y_ctb - 1)) || up_tile_edge;
-            horiz_edge[3] = horiz_edge[2];
-            diag_edge[0] = (!lfase[0] && CTB(s->tab_slice_address, x_ctb, y_ctb) != CTB(s->tab_slice_address, x_ctb - 1, y_ctb - 1)) || left_tile_edge || up_tile_edge;
-            diag_edge[3] = diag_edge[0];
-
-            // Does left CTB comes after above CTB?
-            if (CTB(s->tab_slice_address, x_ctb - 1, y_ctb) >
-                CTB(s->tab_slice_address, x_ctb, y_ctb - 1)) {
-                diag_edge[2] = !lfase[2] || left_tile_edge || up_tile_edge;
-                diag_edge[1] = diag_edge[2];
-            } else if (CTB(s->tab_slice_address, x_ctb - 1, y_ctb) <
-                       CTB(s->tab_slice_address, x_ctb, y_ctb - 1)) {
-                diag_edge[1] = !lfase[1] || left_tile_edge || up_tile_edge;
-                diag_edge[2] = diag_edge[1];
-            } else {
-                // Same slice, only consider tiles
-                diag_edge[2] = left_tile_edge || up_tile_edge;
-                diag_edge[1] = diag_edge[2];
-            }
-        }
-    }
+/*
+ * Apply SAO to the CTB row starting at luma line y. Each plane is done in
+ * a single call, every CTB with its own parameters; the samples next to an
+ * edge that is not filtered across are masked out by the DSP function
+ * rather than handled by per-boundary passes.
+ */
+static void sao_filter_row(HEVCContext *s, int y)
+{
+    int y_ctb  = y >> s->sps->log2_ctb_size;
+    uint16_t *no_filter = &CTB(s->sao_no_filter, 0, y_ctb);
+    int x_ctb, c_idx;
+
+    for (x_ctb = 0; x_ctb < s->sps->ctb_width; x_ctb++)
+        no_filter[x_ctb] = sao_no_filter(s, x_ctb, y_ctb);
 
     for (c_idx = 0; c_idx < 3; c_idx++) {
-        int chroma = c_idx ? 1 : 0;
-        int x0 = x >> chroma;
-        int y0 = y >> chroma;
-        int stride = s->frame->linesize[c_idx];
-        int ctb_size = (1 << (s->sps->log2_ctb_size)) >> s->sps->hshift[c_idx];
-        int width = FFMIN(ctb_size,
-                          (s->sps->width >> s->sps->hshift[c_idx]) - x0);
-        int height = FFMIN(ctb_size,
-                           (s->sps->height >> s->sps->vshift[c_idx]) - y0);
-
-        uint8_t *src = &s->frame->data[c_idx][y0 * stride + (x0 << s->sps->pixel_shift)];
-        uint8_t *dst = &s->sao_frame->data[c_idx][y0 * stride + (x0 << s->sps->pixel_shift)];
-        int offset = (y_shift >> chroma) * stride + ((x_shift >> chroma) << s->sps->pixel_shift);
-
-        copy_CTB(dst - offset, src - offset,
-                 (edges[2] ? width  + (x_shift >> chroma) : width)  << s->sps->pixel_shift,
-                 (edges[3] ? height + (y_shift >> chroma) : height), stride);
-
-        for (class_index = 0; class_index < class; class_index++) {
-
-            switch (sao[class_index]->type_idx[c_idx]) {
-            case SAO_BAND:
-                s->hevcdsp.sao_band_filter[classes[class_index]](dst, src,
-                                                                 stride,
-                                                                 sao[class_index],
-                                                                 edges, width,
-                                                                 height, c_idx);
-                break;
-            case SAO_EDGE:
-                s->hevcdsp.sao_edge_filter[classes[class_index]](dst, src,
-                                                                 stride,
-                                                                 sao[class_index],
-                                                                 edges, width,
-                                                                 height, c_idx,
-                                                                 vert_edge[classes[class_index]],
-                                                                 horiz_edge[classes[class_index]],
-                                                                 diag_edge[classes[class_index]]);
-                break;
-            }
-        }
+        int hshift   = s->sps->hshift[c_idx];
+        int vshift   = s->sps->vshift[c_idx];
+        int y0       = y >> vshift;
+        int stride   = s->frame->linesize[c_idx];
+        int ctb_size = (1 << s->sps->log2_ctb_size) >> hshift;
+        int height   = FFMIN((1 << s->sps->log2_ctb_size) >> vshift,
+                             (s->sps->height >> vshift) - y0);
+
+        s->hevcdsp.sao_filter_ctb_row(&s->sao_frame->data[c_idx][y0 * stride],
+                                      &s->frame->data[c_idx][y0 * stride],
+                                      stride, &CTB(s->sao, 0, y_ctb), no_filter,
+                                      ctb_size, s->sps->width >> hshift,
+                                      height, c_idx);
     }
 }
 
@@ -771,9 +728,82 @@ void ff_hevc_deblocking_boundary_strengths_v(HEVCContext *s, int x0, int y0, int
 
 void ff_hevc_hls_filter(HEVCContext *s, int x, int y)
 {
+    int ctb_size = 1 << s->sps->log2_ctb_size;
+
     deblocking_filter_CTB(s, x, y);
-    if (s->sps->sao_enabled)
-        sao_filter_CTB(s, x, y);
+
+    /* edge offset reads one line into the next CTB row, so a row is done
+     * once the row below it is deblocked; the last one with the picture */
+    if (s->sps->sao_enabled && x + ctb_size >= s->sps->width) {
+        if (y)
+            sao_filter_row(s, y - ctb_size);
+        if (y + ctb_size >= s->sps->height)
+            sao_filter_row(s, y);
+    }
+}
+
+static void extend_plane(uint8_t *data, ptrdiff_t stride, int width, int height,
+                         int x0, int x1, int y0, int y1, int edge_w, int edge_h,
+                         int pixel_shift)
+{
+    uint8_t *left;
+    int x, y;
+
+    for (y = y0; y < y1; y++) {
+        uint8_t *row = data + y * stride;
+        if (!pixel_shift) {
+            if (!x0)
+                memset(row - edge_w, row[0], edge_w);
+            if (x1 == width)
+                memset(row + width, row[width - 1], edge_w);
+        } else {
+            uint16_t *row16 = (uint16_t *)row;
+            for (x = 1; x <= edge_w; x++) {
+                if (!x0)
+                    row16[-x] = row16[0];
+                if (x1 == width)
+                    row16[width - 1 + x] = row16[width - 1];
+            }
+        }
+    }
+
+    /* the corners go with the columns at the edges */
+    if (!x0)
+        x0 = -edge_w;
+    if (x1 == width)
+        x1 = width + edge_w;
+    left  = data + x0 * (1 << pixel_shift);
+    width = (x1 - x0) << pixel_shift;
+    if (!y0)
+        for (y = 1; y <= edge_h; y++)
+            memcpy(left - y * stride, left, width);
+    if (y1 == height)
+        for (y = 0; y < edge_h; y++)
+            memcpy(left + (height + y) * stride, left + (height - 1) * stride, width);
+}
+
+void ff_hevc_extend_edges(HEVCContext *s, AVFrame *frame, int y0, int y1)
+{
+    ff_hevc_extend_edges_area(s, frame, 0, y0, s->sps->width, y1);
+}
+
+void ff_hevc_extend_edges_area(HEVCContext *s, AVFrame *frame,
+                               int x0, int y0, int x1, int y1)
+{
+    int i;
+
+    if (!s->edge_width || y0 >= y1 || x0 >= x1)
+        return;
+
+    for (i = 0; i < 3 && frame->data[i]; i++) {
+        int hshift = s->sps->hshift[i];
+        int vshift = s->sps->vshift[i];
+        extend_plane(frame->data[i], frame->linesize[i],
+                     s->sps->width >> hshift, s->sps->height >> vshift,
+                     x0 >> hshift, x1 >> hshift, y0 >> vshift, y1 >> vshift,
+                     s->edge_width >> hshift, s->edge_width >> vshift,
+                     s->sps->pixel_shift);
+    }
 }
 
 void ff_hevc_hls_filters(HEVCContext *s, int x_ctb, int y_ctb, int ctb_size)
@@ -782,8 +812,12 @@ void ff_hevc_hls_filters(HEVCContext *s, int x_ctb, int y_ctb, int ctb_size)
         ff_hevc_hls_filter(s, x_ctb - ctb_size, y_ctb - ctb_size);
     if (y_ctb && x_ctb >= s->sps->width - ctb_size) {
         ff_hevc_hls_filter(s, x_ctb, y_ctb - ctb_size);
-        if (s->threads_type & FF_THREAD_FRAME )
-            ff_thread_report_progress(&s->ref->tf, y_ctb - ctb_size, 0);
+        /* the CTB row above the one just filtered is now final: extend it
+         * before announcing it to the threads that reference this picture */
+        if (y_ctb > ctb_size)
+            ff_hevc_extend_edges(s, s->ref->frame, y_ctb - 2 * ctb_size,
+                                 y_ctb - ctb_size);
+        ff_hevc_report_progress(s, s->ref, y_ctb - ctb_size);
     }
     if (x_ctb && y_ctb >= s->sps->height - ctb_size)
         ff_hevc_hls_filter(s, x_ctb - ctb_size, y_ctb);
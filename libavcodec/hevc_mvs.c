@@ -81,6 +81,91 @@ static int z_scan_block_avail(HEVCContext *s, int xCurr, int yCurr,
     return N <= Curr;
 }
 
+#define MVF_CACHE_IDX(x, y)                                             \
+    (((y) - lc->mvf_cache.y_pu) * MVF_CACHE_STRIDE + (x) - lc->mvf_cache.x_pu)
+
+#define MVF_CACHE(x, y)                                                 \
+    lc->mvf_cache.mvf[MVF_CACHE_IDX(x, y)]
+
+#define MVF_CACHE_AVAIL(x, y)                                           \
+    lc->mvf_cache.avail[MVF_CACHE_IDX(x, y)]
+
+static av_always_inline void mvf_cache_load_pu(HEVCContext *s,
+                                               int x_ctb, int y_ctb,
+                                               int xN, int yN)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    int x_pu = xN >> s->sps->log2_min_pu_size;
+    int y_pu = yN >> s->sps->log2_min_pu_size;
+
+    if (z_scan_block_avail(s, x_ctb, y_ctb, xN, yN)) {
+        MVF_CACHE(x_pu, y_pu)       = s->ref->tab_mvf[y_pu * s->sps->min_pu_width + x_pu];
+        MVF_CACHE_AVAIL(x_pu, y_pu) = 1;
+    }
+}
+
+/**
+ * Set up the motion field cache for the CTB at (x_ctb, y_ctb). Only the
+ * neighbouring CTBs that may be referenced (same slice and tile) are read.
+ */
+void ff_hevc_mvf_cache_load(HEVCContext *s, int x_ctb, int y_ctb)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    int ctb_size         = 1 << s->sps->log2_ctb_size;
+    int min_pu_size      = 1 << s->sps->log2_min_pu_size;
+    int i;
+
+    lc->mvf_cache.x_pu = (x_ctb >> s->sps->log2_min_pu_size) - 1;
+    lc->mvf_cache.y_pu = (y_ctb >> s->sps->log2_min_pu_size) - 1;
+    memset(lc->mvf_cache.avail, 0, sizeof(lc->mvf_cache.avail));
+
+    if (lc->ctb_up_left_flag)
+        mvf_cache_load_pu(s, x_ctb, y_ctb, x_ctb - 1, y_ctb - 1);
+    if (lc->ctb_up_flag)
+        for (i = 0; i < ctb_size; i += min_pu_size)
+            mvf_cache_load_pu(s, x_ctb, y_ctb, x_ctb + i, y_ctb - 1);
+    if (lc->ctb_up_right_flag)
+        mvf_cache_load_pu(s, x_ctb, y_ctb, x_ctb + ctb_size, y_ctb - 1);
+    if (lc->ctb_left_flag)
+        for (i = 0; i < ctb_size; i += min_pu_size)
+            mvf_cache_load_pu(s, x_ctb, y_ctb, x_ctb - 1, y_ctb + i);
+}
+
+/**
+ * Store the motion of a block of the current CTB, both in the picture
+ * motion field and in the CTB cache.
+ */
+void ff_hevc_set_mvf(HEVCContext *s, int x0, int y0, int nPbW, int nPbH,
+                     const MvField *mvf)
+{
+    HEVCLocalContext *lc = s->HEVClc;
+    int min_pu_width     = s->sps->min_pu_width;
+    int x_pu             = x0 >> s->sps->log2_min_pu_size;
+    int y_pu             = y0 >> s->sps->log2_min_pu_size;
+    int w_pu             = FFMAX(nPbW >> s->sps->log2_min_pu_size, 1);
+    int h_pu             = FFMAX(nPbH >> s->sps->log2_min_pu_size, 1);
+    MvField *tab_mvf     = &s->ref->tab_mvf[y_pu * min_pu_width + x_pu];
+    MvField *cache       = &MVF_CACHE(x_pu, y_pu);
+    uint8_t *avail       = &MVF_CACHE_AVAIL(x_pu, y_pu);
+    const MvField *row   = tab_mvf;
+    size_t row_size      = w_pu * sizeof(*mvf);
+    int i, j;
+
+    /* fill one row, then replicate it with block copies */
+    for (i = 0; i < w_pu; i++)
+        tab_mvf[i] = *mvf;
+
+    for (j = 0; j < h_pu; j++) {
+        if (j)
+            memcpy(tab_mvf, row, row_size);
+        memcpy(cache, row, row_size);
+        memset(avail, 1, w_pu);
+        tab_mvf += min_pu_width;
+        cache   += MVF_CACHE_STRIDE;
+        avail   += MVF_CACHE_STRIDE;
+    }
+}
+
 static int same_prediction_block(HEVCLocalContext *lc, int log2_cb_size,
                                  int x0, int y0, int nPbW, int nPbH,
                                  int xA1, int yA1, int partIdx)
@@ -106,7 +191,8 @@ static int check_prediction_block_available(HEVCContext *s, int log2_cb_size,
         return same_prediction_block(lc, log2_cb_size, x0, y0,
                                      nPbW, nPbH, xA1, yA1, partIdx);
     else
-        return z_scan_block_avail(s, x0, y0, xA1, yA1);
+        return MVF_CACHE_AVAIL(xA1 >> s->sps->log2_min_pu_size,
+                               yA1 >> s->sps->log2_min_pu_size);
 }
 
 //check if the two luma locations belong to the same mostion estimation region
@@ -229,7 +315,7 @@ static int derive_temporal_colocated_mvs(HEVCContext *s, MvField temp_col,
     tab_mvf[(y) * min_pu_width + x]
 
 #define TAB_MVF_PU(v)                                                   \
-    TAB_MVF(x ## v ## _pu, y ## v ## _pu)
+    MVF_CACHE(x ## v ## _pu, y ## v ## _pu)
 
 #define DERIVE_TEMPORAL_COLOCATED_MVS                                   \
     derive_temporal_colocated_mvs(s, temp_col,                          \
@@ -272,6 +358,8 @@ static int temporal_luma_motion_vector(HEVCContext *s, int x0, int y0,
         y                  = ((y >> 4) << 4);
         x_pu               = x >> s->sps->log2_min_pu_size;
         y_pu               = y >> s->sps->log2_min_pu_size;
+        if (ref == s->inter_layer_ref)
+            ff_hevc_il_await_motion(s, x, y);
         temp_col           = TAB_MVF(x_pu, y_pu);
         availableFlagLXCol = DERIVE_TEMPORAL_COLOCATED_MVS;
     }
@@ -284,6 +372,8 @@ static int temporal_luma_motion_vector(HEVCContext *s, int x0, int y0,
         y                  = ((y >> 4) << 4);
         x_pu               = x >> s->sps->log2_min_pu_size;
         y_pu               = y >> s->sps->log2_min_pu_size;
+        if (ref == s->inter_layer_ref)
+            ff_hevc_il_await_motion(s, x, y);
         temp_col           = TAB_MVF(x_pu, y_pu);
         availableFlagLXCol = DERIVE_TEMPORAL_COLOCATED_MVS;
     }
@@ -312,9 +402,6 @@ static void derive_spatial_merge_candidates(HEVCContext *s, int x0, int y0,
 {
     HEVCLocalContext *lc   = s->HEVClc;
     RefPicList *refPicList = s->ref->refPicList;
-    MvField *tab_mvf       = s->ref->tab_mvf;
-
-    const int min_pu_width = s->sps->min_pu_width;
 
     const int cand_bottom_left = lc->na.cand_bottom_left;
     const int cand_left        = lc->na.cand_left;
@@ -556,12 +643,12 @@ void ff_hevc_luma_mv_merge_mode(HEVCContext *s, int x0, int y0, int nPbW,
 }
 
 static av_always_inline void dist_scale(HEVCContext *s, Mv *mv,
-                                        int min_pu_width, int x, int y,
+                                        int x, int y,
                                         int elist, int ref_idx_curr, int ref_idx)
 {
+    HEVCLocalContext *lc   = s->HEVClc;
     RefPicList *refPicList = s->ref->refPicList;
-    MvField *tab_mvf       = s->ref->tab_mvf;
-    int ref_pic_elist      = refPicList[elist].list[TAB_MVF(x, y).ref_idx[elist]];
+    int ref_pic_elist      = refPicList[elist].list[MVF_CACHE(x, y).ref_idx[elist]];
     int ref_pic_curr       = refPicList[ref_idx_curr].list[ref_idx];
 
     if (ref_pic_elist != ref_pic_curr)
@@ -571,14 +658,14 @@ static av_always_inline void dist_scale(HEVCContext *s, Mv *mv,
 static int mv_mp_mode_mx(HEVCContext *s, int x, int y, int pred_flag_index,
                          Mv *mv, int ref_idx_curr, int ref_idx)
 {
-    MvField *tab_mvf = s->ref->tab_mvf;
-    int min_pu_width = s->sps->min_pu_width;
+    HEVCLocalContext *lc = s->HEVClc;
+    MvField *mvf         = &MVF_CACHE(x, y);
 
     RefPicList *refPicList = s->ref->refPicList;
 
-    if (TAB_MVF(x, y).pred_flag[pred_flag_index] &&
-        refPicList[pred_flag_index].list[TAB_MVF(x, y).ref_idx[pred_flag_index]] == refPicList[ref_idx_curr].list[ref_idx]) {
-        *mv = TAB_MVF(x, y).mv[pred_flag_index];
+    if (mvf->pred_flag[pred_flag_index] &&
+        refPicList[pred_flag_index].list[mvf->ref_idx[pred_flag_index]] == refPicList[ref_idx_curr].list[ref_idx]) {
+        *mv = mvf->mv[pred_flag_index];
         return 1;
     }
     return 0;
@@ -587,21 +674,21 @@ static int mv_mp_mode_mx(HEVCContext *s, int x, int y, int pred_flag_index,
 static int mv_mp_mode_mx_lt(HEVCContext *s, int x, int y, int pred_flag_index,
                             Mv *mv, int ref_idx_curr, int ref_idx)
 {
-    MvField *tab_mvf = s->ref->tab_mvf;
-    int min_pu_width = s->sps->min_pu_width;
+    HEVCLocalContext *lc = s->HEVClc;
+    MvField *mvf         = &MVF_CACHE(x, y);
 
     RefPicList *refPicList = s->ref->refPicList;
 
-    if (TAB_MVF(x, y).pred_flag[pred_flag_index]) {
+    if (mvf->pred_flag[pred_flag_index]) {
         int currIsLongTerm     = refPicList[ref_idx_curr].isLongTerm[ref_idx];
 
         int colIsLongTerm =
-            refPicList[pred_flag_index].isLongTerm[(TAB_MVF(x, y).ref_idx[pred_flag_index])];
+            refPicList[pred_flag_index].isLongTerm[(mvf->ref_idx[pred_flag_index])];
 
         if (colIsLongTerm == currIsLongTerm) {
-            *mv = TAB_MVF(x, y).mv[pred_flag_index];
+            *mv = mvf->mv[pred_flag_index];
             if (!currIsLongTerm)
-                dist_scale(s, mv, min_pu_width, x, y,
+                dist_scale(s, mv, x, y,
                            pred_flag_index, ref_idx_curr, ref_idx);
             return 1;
         }
@@ -623,12 +710,10 @@ void ff_hevc_luma_mv_mvp_mode(HEVCContext *s, int x0, int y0, int nPbW,
                               int mvp_lx_flag, int LX)
 {
     HEVCLocalContext *lc = s->HEVClc;
-    MvField *tab_mvf = s->ref->tab_mvf;
     int isScaledFlag_L0 = 0;
     int availableFlagLXA0 = 0;
     int availableFlagLXB0 = 0;
     int numMVPCandLX = 0;
-    int min_pu_width = s->sps->min_pu_width;
 
     int xA0, yA0;
     int xA0_pu, yA0_pu;
@@ -111,6 +111,7 @@ static inline int parse_nal_units(AVCodecParserContext *s, AVCodecContext *avctx
             return AVERROR(ENOMEM);
         h->nals = tmp;
         memset(h->nals, 0, sizeof(*tmp));
+        h->nals[0].skipped_bytes_pos_size = INT_MAX;
         h->nals_allocated = 1;
     }
 
@@ -311,7 +312,6 @@ static int hevc_init(AVCodecParserContext *s)
 {
     HEVCContext  *h  = &((HEVCParseContext *)s->priv_data)->h;
     h->HEVClc = av_mallocz(sizeof(HEVCLocalContext));
-    h->skipped_bytes_pos_size = INT_MAX;
 
     return 0;
 }
@@ -322,7 +322,6 @@ static void hevc_close(AVCodecParserContext *s)
     HEVCContext  *h  = &((HEVCParseContext *)s->priv_data)->h;
     ParseContext *pc = &((HEVCParseContext *)s->priv_data)->pc;
 
-    av_freep(&h->skipped_bytes_pos);
     av_freep(&h->HEVClc);
     av_freep(&pc->buffer);
 
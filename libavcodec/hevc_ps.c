@@ -324,9 +324,15 @@ static void decode_hrd(HEVCContext *s, int common_inf_present,
 
 
 #ifdef VPS_EXTENSION
-static void parse_vps_extension (HEVCContext *s, HEVCVPS *vps)  {
+static int parse_vps_extension (HEVCContext *s, HEVCVPS *vps)  {
     int i, j;
     GetBitContext *gb = &s->HEVClc->gb;
+
+    if (vps->vps_max_layers > MAX_LAYERS) {
+        av_log(s->avctx, AV_LOG_WARNING, "%d layers, only %d are supported.\n",
+               vps->vps_max_layers, MAX_LAYERS);
+        return AVERROR_PATCHWELCOME;
+    }
 #if VPS_EXTN_MASK_AND_DIM_INFO
     int numScalabilityTypes = 0;
     vps->avc_base_layer_flag = get_bits1(gb);
@@ -372,6 +378,11 @@ static void parse_vps_extension (HEVCContext *s, HEVCVPS *vps)  {
         {
             vps->layer_id_in_nuh[i] = i;
         }
+        if (vps->layer_id_in_nuh[i] >= MAX_LAYERS) {
+            av_log(s->avctx, AV_LOG_WARNING, "Layer id %d is not supported.\n",
+                   vps->layer_id_in_nuh[i]);
+            return AVERROR_PATCHWELCOME;
+        }
         vps->m_layerIdInVps[vps->layer_id_in_nuh[i]] = i;
         for(j = 0; j < numScalabilityTypes; j++)
         {
@@ -452,6 +463,11 @@ static void parse_vps_extension (HEVCContext *s, HEVCVPS *vps)  {
         vps->default_one_target_output_layer_flag = get_bits1(gb);
         
     }
+    if (numOutputLayerSets > FF_ARRAY_ELEMS(vps->profile_level_tier_idx)) {
+        av_log(s->avctx, AV_LOG_ERROR, "Too many output layer sets: %d\n",
+               numOutputLayerSets);
+        return AVERROR_INVALIDDATA;
+    }
     vps->m_numOutputLayerSets = numOutputLayerSets;
     for(i = 1; i < numOutputLayerSets; i++)
     {
@@ -498,6 +514,7 @@ static void parse_vps_extension (HEVCContext *s, HEVCVPS *vps)  {
 #if JCTVC_M0458_INTERLAYER_RPS_SIG
     vps->max_one_active_ref_layer_flag = get_bits1(gb);
 #endif
+    return 0;
 }
 #endif
 
@@ -570,6 +587,11 @@ int ff_hevc_decode_nal_vps(HEVCContext *s)
 
     vps->vps_max_layer_id   = get_bits(gb, 6);
     vps->vps_num_layer_sets = get_ue_golomb_long(gb) + 1;
+    if (vps->vps_num_layer_sets < 1 || vps->vps_num_layer_sets > 1024) {
+        av_log(s->avctx, AV_LOG_ERROR, "vps_num_layer_sets out of range: %d\n",
+               vps->vps_num_layer_sets);
+        goto err;
+    }
     for (i = 1; i < vps->vps_num_layer_sets; i++)
         for (j = 0; j <= vps->vps_max_layer_id; j++)
             skip_bits(gb, 1);  // layer_id_included_flag[i][j]
@@ -595,9 +617,12 @@ int ff_hevc_decode_nal_vps(HEVCContext *s)
     vps->vps_extension_flag = get_bits1(gb);
 #ifdef VPS_EXTENSION
     if(vps->vps_extension_flag){ // vps_extension_flag
-        parse_vps_extension(s, vps);
+        /* the base layer can still be decoded without the extension */
+        if (parse_vps_extension(s, vps) < 0)
+            vps->vps_extension_flag = 0;
     }
 #endif
+    s->avctx->nb_layers = vps->vps_extension_flag ? vps->vps_max_layers : 1;
 
     av_buffer_unref(&s->vps_list[vps_id]);
     s->vps_list[vps_id] = vps_buf;
@@ -1168,32 +1193,257 @@ err:
     return ret;
 }
 
+static void hevc_scan_order_free(void *opaque, uint8_t *data)
+{
+    HEVCScanOrder *so = (HEVCScanOrder*)data;
+
+    av_freep(&so->column_width);
+    av_freep(&so->row_height);
+    av_freep(&so->col_bd);
+    av_freep(&so->row_bd);
+    av_freep(&so->col_idxX);
+    av_freep(&so->ctb_addr_rs_to_ts);
+    av_freep(&so->ctb_addr_ts_to_rs);
+    av_freep(&so->tile_pos_rs);
+    av_freep(&so->tile_id);
+    av_freep(&so->min_cb_addr_zs);
+    av_freep(&so->min_tb_addr_zs);
+
+    av_freep(&so);
+}
+
 static void hevc_pps_free(void *opaque, uint8_t *data)
 {
     HEVCPPS *pps = (HEVCPPS*)data;
 
-    av_freep(&pps->column_width);
-    av_freep(&pps->row_height);
-    av_freep(&pps->col_bd);
-    av_freep(&pps->row_bd);
-    av_freep(&pps->col_idxX);
-    av_freep(&pps->ctb_addr_rs_to_ts);
-    av_freep(&pps->ctb_addr_ts_to_rs);
-    av_freep(&pps->tile_pos_rs);
-    av_freep(&pps->tile_id);
-    av_freep(&pps->min_cb_addr_zs);
-    av_freep(&pps->min_tb_addr_zs);
+    if (pps->scan_order_buf) {
+        av_buffer_unref(&pps->scan_order_buf);
+    } else {
+        av_freep(&pps->column_width);
+        av_freep(&pps->row_height);
+    }
 
     av_freep(&pps);
 }
 
-int ff_hevc_decode_nal_pps(HEVCContext *s)
+static int scan_order_matches(const HEVCScanOrder *so, const HEVCSPS *sps,
+                              const HEVCPPS *pps)
+{
+    return so->width            == sps->width                     &&
+           so->height           == sps->height                    &&
+           so->ctb_width        == sps->ctb_width                 &&
+           so->ctb_height       == sps->ctb_height                &&
+           so->log2_ctb_size    == sps->log2_ctb_size             &&
+           so->log2_min_cb_size == sps->log2_min_cb_size          &&
+           so->log2_min_tb_size == sps->log2_min_tb_size          &&
+           so->num_tile_columns == pps->num_tile_columns          &&
+           so->num_tile_rows    == pps->num_tile_rows             &&
+           !memcmp(so->column_width, pps->column_width,
+                   pps->num_tile_columns * sizeof(*pps->column_width)) &&
+           !memcmp(so->row_height, pps->row_height,
+                   pps->num_tile_rows * sizeof(*pps->row_height));
+}
+
+/**
+ * 6.5
+ */
+static int scan_order_init(HEVCScanOrder *so, const HEVCSPS *sps)
 {
-    GetBitContext *gb = &s->HEVClc->gb;
-    HEVCSPS      *sps = NULL;
     int pic_area_in_ctbs, pic_area_in_min_cbs, pic_area_in_min_tbs;
     int log2_diff_ctb_min_tb_size;
     int i, j, x, y, ctb_addr_rs, tile_id;
+
+    so->col_bd   = av_malloc_array(so->num_tile_columns + 1, sizeof(*so->col_bd));
+    so->row_bd   = av_malloc_array(so->num_tile_rows + 1,    sizeof(*so->row_bd));
+    so->col_idxX = av_malloc_array(sps->ctb_width,    sizeof(*so->col_idxX));
+    if (!so->col_bd || !so->row_bd || !so->col_idxX)
+        return AVERROR(ENOMEM);
+
+    so->col_bd[0] = 0;
+    for (i = 0; i < so->num_tile_columns; i++)
+        so->col_bd[i + 1] = so->col_bd[i] + so->column_width[i];
+
+    so->row_bd[0] = 0;
+    for (i = 0; i < so->num_tile_rows; i++)
+        so->row_bd[i + 1] = so->row_bd[i] + so->row_height[i];
+
+    for (i = 0, j = 0; i < sps->ctb_width; i++) {
+        if (i > so->col_bd[j])
+            j++;
+        so->col_idxX[i] = j;
+    }
+
+    pic_area_in_ctbs     = sps->ctb_width    * sps->ctb_height;
+    pic_area_in_min_cbs  = sps->min_cb_width * sps->min_cb_height;
+    pic_area_in_min_tbs  = sps->min_tb_width * sps->min_tb_height;
+
+    so->ctb_addr_rs_to_ts = av_malloc_array(pic_area_in_ctbs,    sizeof(*so->ctb_addr_rs_to_ts));
+    so->ctb_addr_ts_to_rs = av_malloc_array(pic_area_in_ctbs,    sizeof(*so->ctb_addr_ts_to_rs));
+    so->tile_id           = av_malloc_array(pic_area_in_ctbs,    sizeof(*so->tile_id));
+    so->min_cb_addr_zs    = av_malloc_array(pic_area_in_min_cbs, sizeof(*so->min_cb_addr_zs));
+    so->min_tb_addr_zs    = av_malloc_array(pic_area_in_min_tbs, sizeof(*so->min_tb_addr_zs));
+    if (!so->ctb_addr_rs_to_ts || !so->ctb_addr_ts_to_rs ||
+        !so->tile_id || !so->min_cb_addr_zs || !so->min_tb_addr_zs)
+        return AVERROR(ENOMEM);
+
+    for (ctb_addr_rs = 0; ctb_addr_rs < pic_area_in_ctbs; ctb_addr_rs++) {
+        int tb_x   = ctb_addr_rs % sps->ctb_width;
+        int tb_y   = ctb_addr_rs / sps->ctb_width;
+        int tile_x = 0;
+        int tile_y = 0;
+        int val    = 0;
+
+        for (i = 0; i < so->num_tile_columns; i++) {
+            if (tb_x < so->col_bd[i + 1]) {
+                tile_x = i;
+                break;
+            }
+        }
+
+        for (i = 0; i < so->num_tile_rows; i++) {
+            if (tb_y < so->row_bd[i + 1]) {
+                tile_y = i;
+                break;
+            }
+        }
+
+        for (i = 0; i < tile_x; i++)
+            val += so->row_height[tile_y] * so->column_width[i];
+        for (i = 0; i < tile_y; i++)
+            val += sps->ctb_width * so->row_height[i];
+
+        val += (tb_y - so->row_bd[tile_y]) * so->column_width[tile_x] +
+               tb_x - so->col_bd[tile_x];
+
+        so->ctb_addr_rs_to_ts[ctb_addr_rs] = val;
+        so->ctb_addr_ts_to_rs[val]         = ctb_addr_rs;
+    }
+
+    for (j = 0, tile_id = 0; j < so->num_tile_rows; j++)
+        for (i = 0; i < so->num_tile_columns; i++, tile_id++)
+            for (y = so->row_bd[j]; y < so->row_bd[j + 1]; y++)
+                for (x = so->col_bd[i]; x < so->col_bd[i + 1]; x++)
+                    so->tile_id[so->ctb_addr_rs_to_ts[y * sps->ctb_width + x]] = tile_id;
+
+    so->tile_pos_rs = av_malloc_array(tile_id, sizeof(*so->tile_pos_rs));
+    if (!so->tile_pos_rs)
+        return AVERROR(ENOMEM);
+
+    for (j = 0; j < so->num_tile_rows; j++)
+        for (i = 0; i < so->num_tile_columns; i++)
+            so->tile_pos_rs[j * so->num_tile_columns + i] = so->row_bd[j] * sps->ctb_width + so->col_bd[i];
+
+    for (y = 0; y < sps->min_cb_height; y++) {
+        for (x = 0; x < sps->min_cb_width; x++) {
+            int tb_x        = x >> sps->log2_diff_max_min_coding_block_size;
+            int tb_y        = y >> sps->log2_diff_max_min_coding_block_size;
+            int ctb_addr_rs = sps->ctb_width * tb_y + tb_x;
+            int val         = so->ctb_addr_rs_to_ts[ctb_addr_rs] <<
+                              (sps->log2_diff_max_min_coding_block_size * 2);
+            for (i = 0; i < sps->log2_diff_max_min_coding_block_size; i++) {
+                int m = 1 << i;
+                val += (m & x ? m * m : 0) + (m & y ? 2 * m * m : 0);
+            }
+            so->min_cb_addr_zs[y * sps->min_cb_width + x] = val;
+        }
+    }
+
+    log2_diff_ctb_min_tb_size = sps->log2_ctb_size - sps->log2_min_tb_size;
+    for (y = 0; y < sps->min_tb_height; y++) {
+        for (x = 0; x < sps->min_tb_width; x++) {
+            int tb_x        = x >> log2_diff_ctb_min_tb_size;
+            int tb_y        = y >> log2_diff_ctb_min_tb_size;
+            int ctb_addr_rs = sps->ctb_width * tb_y + tb_x;
+            int val         = so->ctb_addr_rs_to_ts[ctb_addr_rs] <<
+                              (log2_diff_ctb_min_tb_size * 2);
+            for (i = 0; i < log2_diff_ctb_min_tb_size; i++) {
+                int m = 1 << i;
+                val += (m & x ? m * m : 0) + (m & y ? 2 * m * m : 0);
+            }
+            so->min_tb_addr_zs[y * sps->min_tb_width + x] = val;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Attach the scan order tables to the PPS, reusing the ones of an already
+ * received PPS when the geometry and the tile layout are the same.
+ * On success pps->column_width and pps->row_height belong to the tables.
+ */
+static int pps_set_scan_order(HEVCContext *s, HEVCPPS *pps, const HEVCSPS *sps)
+{
+    HEVCScanOrder *so;
+    int i, ret;
+
+    for (i = 0; i < FF_ARRAY_ELEMS(s->pps_list); i++) {
+        const HEVCPPS *p;
+        if (!s->pps_list[i])
+            continue;
+        p = (const HEVCPPS*)s->pps_list[i]->data;
+        if (p->scan_order_buf &&
+            scan_order_matches((const HEVCScanOrder*)p->scan_order_buf->data, sps, pps)) {
+            pps->scan_order_buf = av_buffer_ref(p->scan_order_buf);
+            if (!pps->scan_order_buf)
+                return AVERROR(ENOMEM);
+            av_freep(&pps->column_width);
+            av_freep(&pps->row_height);
+            so = (HEVCScanOrder*)pps->scan_order_buf->data;
+            goto done;
+        }
+    }
+
+    so = av_mallocz(sizeof(*so));
+    if (!so)
+        return AVERROR(ENOMEM);
+    pps->scan_order_buf = av_buffer_create((uint8_t *)so, sizeof(*so),
+                                           hevc_scan_order_free, NULL, 0);
+    if (!pps->scan_order_buf) {
+        av_freep(&so);
+        return AVERROR(ENOMEM);
+    }
+
+    so->width            = sps->width;
+    so->height           = sps->height;
+    so->ctb_width        = sps->ctb_width;
+    so->ctb_height       = sps->ctb_height;
+    so->log2_ctb_size    = sps->log2_ctb_size;
+    so->log2_min_cb_size = sps->log2_min_cb_size;
+    so->log2_min_tb_size = sps->log2_min_tb_size;
+    so->num_tile_columns = pps->num_tile_columns;
+    so->num_tile_rows    = pps->num_tile_rows;
+    so->column_width     = pps->column_width;
+    so->row_height       = pps->row_height;
+
+    ret = scan_order_init(so, sps);
+    if (ret < 0) {
+        av_buffer_unref(&pps->scan_order_buf);
+        pps->column_width = NULL;
+        pps->row_height   = NULL;
+        return ret;
+    }
+
+done:
+    pps->column_width      = so->column_width;
+    pps->row_height        = so->row_height;
+    pps->col_bd            = so->col_bd;
+    pps->row_bd            = so->row_bd;
+    pps->col_idxX          = so->col_idxX;
+    pps->ctb_addr_rs_to_ts = so->ctb_addr_rs_to_ts;
+    pps->ctb_addr_ts_to_rs = so->ctb_addr_ts_to_rs;
+    pps->tile_id           = so->tile_id;
+    pps->tile_pos_rs       = so->tile_pos_rs;
+    pps->min_cb_addr_zs    = so->min_cb_addr_zs;
+    pps->min_tb_addr_zs    = so->min_tb_addr_zs;
+    return 0;
+}
+
+int ff_hevc_decode_nal_pps(HEVCContext *s)
+{
+    GetBitContext *gb = &s->HEVClc->gb;
+    HEVCSPS      *sps = NULL;
+    int i;
     int ret    = 0;
     int pps_id = 0;
 
@@ -1383,14 +1633,6 @@ int ff_hevc_decode_nal_pps(HEVCContext *s)
     pps->pps_extension_flag                  = get_bits1(gb);
 
     // Inferred parameters
-    pps->col_bd   = av_malloc_array(pps->num_tile_columns + 1, sizeof(*pps->col_bd));
-    pps->row_bd   = av_malloc_array(pps->num_tile_rows + 1,    sizeof(*pps->row_bd));
-    pps->col_idxX = av_malloc_array(sps->ctb_width,    sizeof(*pps->col_idxX));
-    if (!pps->col_bd || !pps->row_bd || !pps->col_idxX) {
-        ret = AVERROR(ENOMEM);
-        goto err;
-    }
-
     if (pps->uniform_spacing_flag) {
         if (!pps->column_width) {
             pps->column_width = av_malloc_array(pps->num_tile_columns, sizeof(*pps->column_width));
@@ -1412,117 +1654,9 @@ int ff_hevc_decode_nal_pps(HEVCContext *s)
         }
     }
 
-    pps->col_bd[0] = 0;
-    for (i = 0; i < pps->num_tile_columns; i++)
-        pps->col_bd[i + 1] = pps->col_bd[i] + pps->column_width[i];
-
-    pps->row_bd[0] = 0;
-    for (i = 0; i < pps->num_tile_rows; i++)
-        pps->row_bd[i + 1] = pps->row_bd[i] + pps->row_height[i];
-
-    for (i = 0, j = 0; i < sps->ctb_width; i++) {
-        if (i > pps->col_bd[j])
-            j++;
-        pps->col_idxX[i] = j;
-    }
-
-    /**
-     * 6.5
-     */
-    pic_area_in_ctbs     = sps->ctb_width    * sps->ctb_height;
-    pic_area_in_min_cbs  = sps->min_cb_width * sps->min_cb_height;
-    pic_area_in_min_tbs  = sps->min_tb_width * sps->min_tb_height;
-
-    pps->ctb_addr_rs_to_ts = av_malloc_array(pic_area_in_ctbs,    sizeof(*pps->ctb_addr_rs_to_ts));
-    pps->ctb_addr_ts_to_rs = av_malloc_array(pic_area_in_ctbs,    sizeof(*pps->ctb_addr_ts_to_rs));
-    pps->tile_id           = av_malloc_array(pic_area_in_ctbs,    sizeof(*pps->tile_id));
-    pps->min_cb_addr_zs    = av_malloc_array(pic_area_in_min_cbs, sizeof(*pps->min_cb_addr_zs));
-    pps->min_tb_addr_zs    = av_malloc_array(pic_area_in_min_tbs, sizeof(*pps->min_tb_addr_zs));
-    if (!pps->ctb_addr_rs_to_ts || !pps->ctb_addr_ts_to_rs ||
-        !pps->tile_id || !pps->min_cb_addr_zs || !pps->min_tb_addr_zs) {
-        ret = AVERROR(ENOMEM);
-        goto err;
-    }
-
-    for (ctb_addr_rs = 0; ctb_addr_rs < pic_area_in_ctbs; ctb_addr_rs++) {
-        int tb_x   = ctb_addr_rs % sps->ctb_width;
-        int tb_y   = ctb_addr_rs / sps->ctb_width;
-        int tile_x = 0;
-        int tile_y = 0;
-        int val    = 0;
-
-        for (i = 0; i < pps->num_tile_columns; i++) {
-            if (tb_x < pps->col_bd[i + 1]) {
-                tile_x = i;
-                break;
-            }
-        }
-
-        for (i = 0; i < pps->num_tile_rows; i++) {
-            if (tb_y < pps->row_bd[i + 1]) {
-                tile_y = i;
-                break;
-            }
-        }
-
-        for (i = 0; i < tile_x; i++)
-            val += pps->row_height[tile_y] * pps->column_width[i];
-        for (i = 0; i < tile_y; i++)
-            val += sps->ctb_width * pps->row_height[i];
-
-        val += (tb_y - pps->row_bd[tile_y]) * pps->column_width[tile_x] +
-               tb_x - pps->col_bd[tile_x];
-
-        pps->ctb_addr_rs_to_ts[ctb_addr_rs] = val;
-        pps->ctb_addr_ts_to_rs[val]         = ctb_addr_rs;
-    }
-
-    for (j = 0, tile_id = 0; j < pps->num_tile_rows; j++)
-        for (i = 0; i < pps->num_tile_columns; i++, tile_id++)
-            for (y = pps->row_bd[j]; y < pps->row_bd[j + 1]; y++)
-                for (x = pps->col_bd[i]; x < pps->col_bd[i + 1]; x++)
-                    pps->tile_id[pps->ctb_addr_rs_to_ts[y * sps->ctb_width + x]] = tile_id;
-
-    pps->tile_pos_rs = av_malloc_array(tile_id, sizeof(*pps->tile_pos_rs));
-    if (!pps->tile_pos_rs) {
-        ret = AVERROR(ENOMEM);
+    ret = pps_set_scan_order(s, pps, sps);
+    if (ret < 0)
         goto err;
-    }
-
-    for (j = 0; j < pps->num_tile_rows; j++)
-        for (i = 0; i < pps->num_tile_columns; i++)
-            pps->tile_pos_rs[j * pps->num_tile_columns + i] = pps->row_bd[j] * sps->ctb_width + pps->col_bd[i];
-
-    for (y = 0; y < sps->min_cb_height; y++) {
-        for (x = 0; x < sps->min_cb_width; x++) {
-            int tb_x        = x >> sps->log2_diff_max_min_coding_block_size;
-            int tb_y        = y >> sps->log2_diff_max_min_coding_block_size;
-            int ctb_addr_rs = sps->ctb_width * tb_y + tb_x;
-            int val         = pps->ctb_addr_rs_to_ts[ctb_addr_rs] <<
-                              (sps->log2_diff_max_min_coding_block_size * 2);
-            for (i = 0; i < sps->log2_diff_max_min_coding_block_size; i++) {
-                int m = 1 << i;
-                val += (m & x ? m * m : 0) + (m & y ? 2 * m * m : 0);
-            }
-            pps->min_cb_addr_zs[y * sps->min_cb_width + x] = val;
-        }
-    }
-
-    log2_diff_ctb_min_tb_size = sps->log2_ctb_size - sps->log2_min_tb_size;
-    for (y = 0; y < sps->min_tb_height; y++) {
-        for (x = 0; x < sps->min_tb_width; x++) {
-            int tb_x        = x >> log2_diff_ctb_min_tb_size;
-            int tb_y        = y >> log2_diff_ctb_min_tb_size;
-            int ctb_addr_rs = sps->ctb_width * tb_y + tb_x;
-            int val         = pps->ctb_addr_rs_to_ts[ctb_addr_rs] <<
-                              (log2_diff_ctb_min_tb_size * 2);
-            for (i = 0; i < log2_diff_ctb_min_tb_size; i++) {
-                int m = 1 << i;
-                val += (m & x ? m * m : 0) + (m & y ? 2 * m * m : 0);
-            }
-            pps->min_tb_addr_zs[y * sps->min_tb_width + x] = val;
-        }
-    }
 
     av_buffer_unref(&s->pps_list[pps_id]);
     s->pps_list[pps_id] = pps_buf;
@@ -21,11 +21,119 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#if HAVE_PTHREADS
+#include <pthread.h>
+#elif HAVE_W32THREADS
+#include "compat/w32pthreads.h"
+#elif HAVE_OS2THREADS
+#include "compat/os2threads.h"
+#endif
+
+#include "libavutil/atomic.h"
 #include "libavutil/pixdesc.h"
 
 #include "internal.h"
 #include "thread.h"
 #include "hevc.h"
+#include "hevc_up_sample_filter.h"
+
+#if HAVE_THREADS
+typedef struct HEVCLayerProgress {
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond;
+    int             progress;
+} HEVCLayerProgress;
+
+static void layer_progress_free(void *opaque, uint8_t *data)
+{
+    HEVCLayerProgress *p = (HEVCLayerProgress *)data;
+
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    av_free(p);
+}
+
+static AVBufferRef *layer_progress_alloc(void)
+{
+    HEVCLayerProgress *p = av_mallocz(sizeof(*p));
+    AVBufferRef *buf;
+
+    if (!p)
+        return NULL;
+    p->progress = -1;
+    pthread_mutex_init(&p->mutex, NULL);
+    pthread_cond_init(&p->cond, NULL);
+
+    buf = av_buffer_create((uint8_t *)p, sizeof(*p), layer_progress_free, NULL, 0);
+    if (!buf)
+        layer_progress_free(NULL, (uint8_t *)p);
+    return buf;
+}
+#endif
+
+void ff_hevc_report_progress(HEVCContext *s, HEVCFrame *frame, int progress)
+{
+    if (s->threads_type & FF_THREAD_FRAME)
+        ff_thread_report_progress(&frame->tf, progress, 0);
+#if HAVE_THREADS
+    if (frame->il_progress) {
+        HEVCLayerProgress *p = (HEVCLayerProgress *)frame->il_progress->data;
+
+        pthread_mutex_lock(&p->mutex);
+        if (p->progress < progress) {
+            p->progress = progress;
+            pthread_cond_broadcast(&p->cond);
+        }
+        pthread_mutex_unlock(&p->mutex);
+    }
+#endif
+}
+
+void ff_hevc_await_layer_progress(HEVCFrame *frame, int progress)
+{
+#if HAVE_THREADS
+    if (frame->il_progress) {
+        HEVCLayerProgress *p = (HEVCLayerProgress *)frame->il_progress->data;
+
+        pthread_mutex_lock(&p->mutex);
+        while (p->progress < progress)
+            pthread_cond_wait(&p->cond, &p->mutex);
+        pthread_mutex_unlock(&p->mutex);
+        return;
+    }
+#endif
+    /* the layer below is not pipelined, but may still be frame threaded */
+    ff_thread_await_progress(&frame->tf, progress, 0);
+}
+
+/**
+ * Lazy inter-layer reference. The enhancement layer often predicts only
+ * some of its blocks from the base layer, so inter_layer_ref is built one
+ * CTB at a time on first access: its samples when motion compensation
+ * reads them, its motion when the temporal motion vector prediction does.
+ * The base layer rows filtered horizontally for a CTB go to a scratch ring
+ * of the size of one CTB. The motion has its own lock, so that the threads
+ * scaling it do not queue behind the ones upsampling samples.
+ */
+#define IL_REGION_PIXELS (1 << 0)
+#define IL_REGION_MOTION (1 << 1)
+
+struct HEVCILUpsample {
+#if HAVE_THREADS
+    pthread_mutex_t mutex;
+    pthread_mutex_t motion_mutex;
+#endif
+    int16_t  *stripe[3];
+    ptrdiff_t stripe_stride[3];
+    int       stripe_rows[3];
+    int       bl_width[3];
+    int       bl_height[3];     ///< base layer rows the filter may read
+    int      *region;           ///< IL_REGION_* flags of each CTB
+    int      *mv_col;           ///< base layer min PU column of each 16x16 unit column
+    int      *mv_row;           ///< offset in the base layer tab_mvf of each 16x16 unit row
+};
 
 void ff_hevc_unref_frame(HEVCContext *s, HEVCFrame *frame, int flags)
 {
@@ -44,6 +152,7 @@ void ff_hevc_unref_frame(HEVCContext *s, HEVCFrame *frame, int flags)
         av_buffer_unref(&frame->rpl_tab_buf);
         frame->rpl_tab    = NULL;
         frame->refPicList = NULL;
+        av_buffer_unref(&frame->il_progress);
 
         frame->collocated_ref = NULL;
     }
@@ -103,6 +212,13 @@ static HEVCFrame *alloc_frame(HEVCContext *s)
         frame->ctb_count = s->sps->ctb_width * s->sps->ctb_height;
         for (j = 0; j < frame->ctb_count; j++)
             frame->rpl_tab[j] = (RefPicListTab *)frame->rpl_buf->data;
+#if HAVE_THREADS
+        if (s->avctx->BL_frame_cb) {
+            frame->il_progress = layer_progress_alloc();
+            if (!frame->il_progress)
+                goto fail;
+        }
+#endif
 
         frame->frame->top_field_first  = s->picture_struct == AV_PICTURE_STRUCTURE_TOP_FIELD;
         frame->frame->interlaced_frame = (s->picture_struct == AV_PICTURE_STRUCTURE_TOP_FIELD) || (s->picture_struct == AV_PICTURE_STRUCTURE_BOTTOM_FIELD);
@@ -175,7 +291,12 @@ int ff_hevc_set_new_iter_layer_ref(HEVCContext *s, AVFrame **frame, int poc)
     ref->flags          = HEVC_FRAME_FLAG_LONG_REF;
     ref->sequence       = s->seq_decode;
     ref->window         = s->sps->output_window;
-    
+
+    /* nothing of it is upsampled until it is read, its motion is only
+     * scaled when ff_hevc_frame_rps() asks for it */
+    for (i = 0; i < s->sps->ctb_width * s->sps->ctb_height; i++)
+        s->il_upsample->region[i] = IL_REGION_MOTION;
+
     return 0;
 }
 #endif
@@ -253,7 +374,6 @@ static int init_slice_rpl(HEVCContext *s)
 
     return 0;
 }
-#ifdef SVC_EXTENSION
 static int init_il_slice_rpl(HEVCContext *s)
 {
     HEVCFrame *frame = s->inter_layer_ref;
@@ -271,7 +391,6 @@ static int init_il_slice_rpl(HEVCContext *s)
     
     return 0;
 }
-#endif
 static HEVCFrame *find_ref_idx(HEVCContext *s, int poc)
 {
     int i;
@@ -293,90 +412,268 @@ static HEVCFrame *find_ref_idx(HEVCContext *s, int poc)
         }
     }
     
-    av_log(s->avctx, AV_LOG_ERROR,
-           "Could not find ref with POC %d\n", poc);
     return NULL;
 }
 
-#ifdef SVC_EXTENSION
-static void scale_upsampled_mv_field(AVCodecContext *avctxt, void *input_ctb_row) {
-    HEVCContext *s = avctxt->priv_data;
-    int xEL, yEL, xBL, yBL, list, i, j;
-    HEVCFrame  *refBL, *refEL;
-    int pic_width_in_min_pu = s->sps->width>>s->sps->log2_min_pu_size;
-    int pic_height_in_min_pu = s->sps->height>>s->sps->log2_min_pu_size;
-    int pic_width_in_min_puBL = s->BL_frame->frame->coded_width >> s->sps->log2_min_pu_size;
-    int *index = input_ctb_row;
-    int ctb_size = 1 << s->sps->log2_ctb_size;
-    refBL = s->BL_frame;
-    init_il_slice_rpl(s);
-    refEL = s->inter_layer_ref;
-    if( *index ==0 ) {
-        for( list=0; list < 2; list++) {
-            refEL->refPicList[list].nb_refs = refBL->refPicList[list].nb_refs;
-            for(i=0; i< refBL->refPicList->nb_refs; i++){
-                refEL->refPicList[list].list[i] = refBL->refPicList[list].list[i];
-                refEL->refPicList[list].ref[i] = find_ref_idx(s, refBL->refPicList[list].list[i]);
-                refEL->refPicList[list].isLongTerm[i] = refBL->refPicList[list].isLongTerm[i];
-            }
+/**
+ * Base layer rows [*lo, *hi) of plane c_idx that the rows [y0, y1) of the
+ * same plane of the inter-layer reference are interpolated from.
+ */
+static void il_ref_rows(const HEVCSPS *sps, const UpsamplInf *up,
+                        const HEVCILUpsample *us, int c_idx, int y0, int y1,
+                        int *lo, int *hi)
+{
+    int ntaps  = c_idx ? NTAPS_CHROMA : NTAPS_LUMA;
+    int height = sps->height >> sps->vshift[c_idx];
+    int pos0   = ff_hevc_il_ref_pos16_y(&sps->scaled_ref_layer_window, up,
+                                        c_idx, height, y0);
+    int pos1   = ff_hevc_il_ref_pos16_y(&sps->scaled_ref_layer_window, up,
+                                        c_idx, height, y1 - 1);
+
+    *lo = av_clip((pos0 >> 4) - (ntaps >> 1) + 1, 0, us->bl_height[c_idx] - 1);
+    *hi = av_clip((pos1 >> 4) + (ntaps >> 1),     0, us->bl_height[c_idx] - 1) + 1;
+}
+
+void ff_hevc_il_free(HEVCContext *s)
+{
+    HEVCILUpsample *us = s->il_upsample;
+    int i;
+
+    if (!us)
+        return;
+#if HAVE_THREADS
+    pthread_mutex_destroy(&us->mutex);
+    pthread_mutex_destroy(&us->motion_mutex);
+#endif
+    for (i = 0; i < 3; i++)
+        av_freep(&us->stripe[i]);
+    av_freep(&us->region);
+    av_freep(&us->mv_col);
+    av_freep(&us->mv_row);
+    av_freep(&s->il_upsample);
+}
+
+int ff_hevc_il_alloc(HEVCContext *s, const HEVCSPS *sps, int bl_width, int bl_height)
+{
+    HEVCILUpsample *us = av_mallocz(sizeof(*us));
+    int ctb_size       = 1 << sps->log2_ctb_size;
+    int min_pu_width_bl = bl_width >> sps->log2_min_pu_size;
+    int i, x, y;
+
+    if (!us)
+        return AVERROR(ENOMEM);
+#if HAVE_THREADS
+    pthread_mutex_init(&us->mutex, NULL);
+    pthread_mutex_init(&us->motion_mutex, NULL);
+#endif
+    s->il_upsample = us;
+
+    us->region = av_mallocz_array(sps->ctb_width * sps->ctb_height, sizeof(*us->region));
+    us->mv_col = av_malloc_array((sps->width  + 15) >> 4, sizeof(*us->mv_col));
+    us->mv_row = av_malloc_array((sps->height + 15) >> 4, sizeof(*us->mv_row));
+    if (!us->region || !us->mv_col || !us->mv_row)
+        return AVERROR(ENOMEM);
+
+    /* the base layer motion of a 16x16 unit is the one under its centre,
+     * rounded down to a 16x16 unit of the base layer */
+    for (x = 0; x < sps->width; x += 16) {
+        int x_bl = ((av_clip(x + 8, 0, sps->width - 1) - sps->pic_conf_win.left_offset) *
+                    s->sh.ScalingPosition[s->nuh_layer_id][0] + (1 << 15)) >> 16;
+        us->mv_col[x >> 4] = (x_bl >> 4) << 2;
+    }
+    for (y = 0; y < sps->height; y += 16) {
+        int y_bl = ((av_clip(y + 8, 0, sps->height - 1) - sps->pic_conf_win.top_offset) *
+                    s->sh.ScalingPosition[s->nuh_layer_id][1] + (1 << 15)) >> 16;
+        us->mv_row[y >> 4] = ((y_bl >> 4) << 2) * min_pu_width_bl;
+    }
+
+    for (i = 0; i < 3; i++) {
+        int hshift = sps->hshift[i];
+        int vshift = sps->vshift[i];
+
+        us->bl_width[i]      = bl_width >> hshift;
+        us->bl_height[i]     = i ? bl_height >> vshift : FFMIN(bl_height, sps->height);
+        us->stripe_stride[i] = FFALIGN(ctb_size >> hshift, 16);
+        for (y = 0; y < sps->height; y += ctb_size) {
+            int lo, hi;
+            il_ref_rows(sps, &s->up_filter_inf, us, i, y >> vshift,
+                        FFMIN(y + ctb_size, sps->height) >> vshift, &lo, &hi);
+            us->stripe_rows[i] = FFMAX(us->stripe_rows[i], hi - lo);
         }
+        us->stripe[i] = av_malloc_array(us->stripe_rows[i] * us->stripe_stride[i],
+                                        sizeof(*us->stripe[i]));
+        if (!us->stripe[i])
+            return AVERROR(ENOMEM);
     }
+    return 0;
+}
 
-    int start = (*index) * ctb_size;
-    int end = ((*index)+1) * ctb_size;
-    
-    end = end > s->sps->height? s->sps->height:end ;
-    for(yEL=start; yEL < end; yEL+=16){
-        for(xEL=0; xEL < s->sps->width ; xEL+=16) {
-            int xELIndex = xEL>>2;
-            int yELIndex = yEL>>2;
-            
-            int xELtmp = av_clip(xEL+8, 0, s->sps->width -1);
-            int yELtmp = av_clip(yEL+8, 0, s->sps->height -1);
-            xBL = (((xELtmp) - s->sps->pic_conf_win.left_offset)*s->sh.ScalingPosition[s->nuh_layer_id][0] + (1<<15)) >> 16;
-            yBL = (((yELtmp) - s->sps->pic_conf_win.top_offset )*s->sh.ScalingPosition[s->nuh_layer_id][1] + (1<<15)) >> 16;
-            
-            
-            xBL = (xBL >>=4)<<2; //xBL & 0xFFFFFFF0
-            yBL = (yBL >>=4)<<2;  //yBL & 0xFFFFFFF0
-            
-            if(!refBL->tab_mvf[(yBL*pic_width_in_min_puBL)+xBL].is_intra) {
-                refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].is_intra = 0;
-                
-                for( list=0; list < 2; list++) {
-                    int x = refBL->tab_mvf[(yBL*pic_width_in_min_puBL)+xBL].mv[list].x;
-                    int y = refBL->tab_mvf[(yBL*pic_width_in_min_puBL)+xBL].mv[list].y;
-                    refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].mv[list].x  = av_clip( (s->sh.ScalingFactor[s->nuh_layer_id][0] * x + 127 + (s->sh.ScalingFactor[s->nuh_layer_id][0] * x < 0)) >> 8 , -32768, 32767);
-                    refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].mv[list].y = av_clip( (s->sh.ScalingFactor[s->nuh_layer_id][1] * y + 127 + (s->sh.ScalingFactor[s->nuh_layer_id][1] * y < 0)) >> 8, -32768, 32767);
-                    refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].ref_idx[list] = refBL->tab_mvf[yBL*pic_width_in_min_puBL+xBL].ref_idx[list];
-                    refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].pred_flag[list] = refBL->tab_mvf[yBL*pic_width_in_min_puBL+xBL].pred_flag[list];
-                }
-            } else {
-                refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].is_intra = 1;
-                for( list=0; list < 2; list++) {
-                    refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].mv[list].x  = 0;
-                    refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].mv[list].y = 0;
-                    refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].ref_idx[list] = refBL->tab_mvf[yBL*pic_width_in_min_puBL+xBL].ref_idx[list];
-                    refEL->tab_mvf[(yELIndex*pic_width_in_min_pu)+xELIndex].pred_flag[list] = refBL->tab_mvf[yBL*pic_width_in_min_puBL+xBL].pred_flag[list];
-                }
-            }
-            for(i =0; i < 4; i++)
-                for(j =0; j < 4; j++)   {
-                    if((i || j) && (yELIndex+i)<pic_height_in_min_pu && (xELIndex+j)<pic_width_in_min_pu) {
-                        refEL->tab_mvf[((yELIndex+i) *pic_width_in_min_pu)+xELIndex+j].is_intra = refEL->tab_mvf[yELIndex*pic_width_in_min_pu+xELIndex].is_intra;
-                        for(list=0; list < 2; list++) {
-                            refEL->tab_mvf[((yELIndex+i) *pic_width_in_min_pu)+xELIndex+j].mv[list].x  = refEL->tab_mvf[yELIndex*pic_width_in_min_pu+xELIndex].mv[list].x;
-                            refEL->tab_mvf[((yELIndex+i) *pic_width_in_min_pu)+xELIndex+j].mv[list].y = refEL->tab_mvf[yELIndex*pic_width_in_min_pu+xELIndex].mv[list].y;
-                            refEL->tab_mvf[((yELIndex+i) *pic_width_in_min_pu)+xELIndex+j].ref_idx[list] = refEL->tab_mvf[yELIndex*pic_width_in_min_pu+xELIndex].ref_idx[list];
-                            refEL->tab_mvf[((yELIndex+i) *pic_width_in_min_pu)+xELIndex+j].pred_flag[list] = refEL->tab_mvf[yELIndex*pic_width_in_min_pu+xELIndex].pred_flag[list];
-                        }
-                    }
-                }
+static void upsample_region(HEVCContext *s, int ctb_x, int ctb_y)
+{
+    HEVCILUpsample *us    = s->il_upsample;
+    const HEVCSPS *sps    = s->sps;
+    const HEVCWindow *win = &sps->scaled_ref_layer_window;
+    AVFrame *bl           = s->BL_frame->frame;
+    AVFrame *el           = s->inter_layer_ref->frame;
+    int ctb_size          = 1 << sps->log2_ctb_size;
+    int x0 = ctb_x << sps->log2_ctb_size;
+    int y0 = ctb_y << sps->log2_ctb_size;
+    int x1 = FFMIN(x0 + ctb_size, sps->width);
+    int y1 = FFMIN(y0 + ctb_size, sps->height);
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        int hshift = sps->hshift[i];
+        int vshift = sps->vshift[i];
+        int width  = sps->width >> hshift;
+        int left   = win->left_offset >> hshift;
+        int right  = width - (win->right_offset >> hshift);
+        // columns of the ring read by the vertical filter
+        int tx0    = av_clip((x0 >> hshift) - left,     0, right - 1 - left);
+        int tx1    = av_clip((x1 >> hshift) - 1 - left, 0, right - 1 - left) + 1;
+        int16_t *stripe = us->stripe[i] - tx0;
+        int lo, hi;
+
+        il_ref_rows(sps, &s->up_filter_inf, us, i, y0 >> vshift, y1 >> vshift,
+                    &lo, &hi);
+        ff_hevc_await_layer_progress(s->BL_frame, hi << vshift);
+        s->hevcdsp.upsample_h_base_layer_rows(stripe, us->stripe_stride[i], us->stripe_rows[i],
+                                              bl->data[i], bl->linesize[i],
+                                              us->bl_width[i], width, win, &s->up_filter_inf,
+                                              up_sample_filter_luma, up_sample_filter_chroma,
+                                              i, tx0, tx1, lo, hi);
+        s->hevcdsp.upsample_v_base_layer_rows(el->data[i], el->linesize[i],
+                                              stripe, us->stripe_stride[i], us->stripe_rows[i],
+                                              us->bl_height[i], width, sps->height >> vshift,
+                                              win, &s->up_filter_inf,
+                                              up_sample_filter_luma, up_sample_filter_chroma,
+                                              i, x0 >> hshift, x1 >> hshift,
+                                              y0 >> vshift, y1 >> vshift);
+    }
+    ff_hevc_extend_edges_area(s, el, x0, y0, x1, y1);
+}
+
+static av_always_inline int scale_il_mv(int scale, int mv)
+{
+    int v = scale * mv;
+    return av_clip_int16((v + 127 + (v < 0)) >> 8);
+}
+
+static void scale_motion_region(HEVCContext *s, int ctb_x, int ctb_y)
+{
+    HEVCILUpsample *us   = s->il_upsample;
+    HEVCFrame *refBL     = s->BL_frame;
+    HEVCFrame *refEL     = s->inter_layer_ref;
+    int min_pu_width     = s->sps->min_pu_width;
+    int min_pu_height    = s->sps->min_pu_height;
+    int scale_x          = s->sh.ScalingFactor[s->nuh_layer_id][0];
+    int scale_y          = s->sh.ScalingFactor[s->nuh_layer_id][1];
+    int ctb_size         = 1 << s->sps->log2_ctb_size;
+    int start_x          = ctb_x * ctb_size;
+    int start_y          = ctb_y * ctb_size;
+    int end_x            = FFMIN(start_x + ctb_size, s->sps->width);
+    int end_y            = FFMIN(start_y + ctb_size, s->sps->height);
+    int xEL, yEL, yBL, i, j;
+
+    /* wait for the base layer motion under the centres of the 16x16 blocks
+     * of this CTB, the lowest one being at most 7 rows below it */
+    yBL = ((av_clip(end_y + 7, 0, s->sps->height - 1) - s->sps->pic_conf_win.top_offset) *
+           s->sh.ScalingPosition[s->nuh_layer_id][1] + (1 << 15)) >> 16;
+    ff_hevc_await_layer_progress(refBL, yBL + 4);
+
+    for (yEL = start_y; yEL < end_y; yEL += 16) {
+        const MvField *bl = refBL->tab_mvf + us->mv_row[yEL >> 4];
+        MvField *el       = refEL->tab_mvf + (yEL >> 2) * min_pu_width;
+        int rows          = FFMIN(4, min_pu_height - (yEL >> 2));
+
+        for (xEL = start_x; xEL < end_x; xEL += 16) {
+            /* the reference indices and prediction flags are kept, the
+             * vectors scaled unless the block is intra */
+            MvField mvf = bl[us->mv_col[xEL >> 4]];
+            int cols    = FFMIN(4, min_pu_width - (xEL >> 2));
+            MvField *dst = el + (xEL >> 2);
+
+            mvf.mv[0].x = mvf.is_intra ? 0 : scale_il_mv(scale_x, mvf.mv[0].x);
+            mvf.mv[0].y = mvf.is_intra ? 0 : scale_il_mv(scale_y, mvf.mv[0].y);
+            mvf.mv[1].x = mvf.is_intra ? 0 : scale_il_mv(scale_x, mvf.mv[1].x);
+            mvf.mv[1].y = mvf.is_intra ? 0 : scale_il_mv(scale_y, mvf.mv[1].y);
+            mvf.is_intra = !!mvf.is_intra;
+
+            for (i = 0; i < rows; i++, dst += min_pu_width)
+                for (j = 0; j < cols; j++)
+                    dst[j] = mvf;
+        }
+    }
+}
+
+/*
+ * The reference lists of the base layer picture, which the scaled motion
+ * refers to, are those of its first slice: they are set once per picture,
+ * before any CTB reads the motion.
+ */
+static void init_il_motion(HEVCContext *s)
+{
+    HEVCFrame *refBL = s->BL_frame;
+    HEVCFrame *refEL = s->inter_layer_ref;
+    int list, i;
+
+    ff_hevc_await_layer_progress(refBL, 0);
+    for (list = 0; list < 2; list++) {
+        refEL->refPicList[list].nb_refs = refBL->refPicList[list].nb_refs;
+        for (i = 0; i < refBL->refPicList->nb_refs; i++) {
+            refEL->refPicList[list].list[i]       = refBL->refPicList[list].list[i];
+            refEL->refPicList[list].ref[i]        = find_ref_idx(s, refBL->refPicList[list].list[i]);
+            refEL->refPicList[list].isLongTerm[i] = refBL->refPicList[list].isLongTerm[i];
         }
     }
 }
 
+static void il_await_region(HEVCContext *s, int ctb_x, int ctb_y, int flag)
+{
+    HEVCILUpsample *us = s->il_upsample;
+    int *region        = &us->region[ctb_y * s->sps->ctb_width + ctb_x];
+#if HAVE_THREADS
+    pthread_mutex_t *mutex = flag == IL_REGION_PIXELS ? &us->mutex : &us->motion_mutex;
+#endif
+
+    if (avpriv_atomic_int_get(region) & flag)
+        return;
+
+#if HAVE_THREADS
+    pthread_mutex_lock(mutex);
+#endif
+    if (!(avpriv_atomic_int_get(region) & flag)) {
+        if (flag == IL_REGION_PIXELS)
+            upsample_region(s, ctb_x, ctb_y);
+        else
+            scale_motion_region(s, ctb_x, ctb_y);
+        // the other flag may be set concurrently under the other lock
+        avpriv_atomic_int_add_and_fetch(region, flag);
+    }
+#if HAVE_THREADS
+    pthread_mutex_unlock(mutex);
 #endif
+}
+
+void ff_hevc_il_await_pixels(HEVCContext *s, int x0, int y0, int x1, int y1)
+{
+    int log2_ctb_size = s->sps->log2_ctb_size;
+    int ctb_x0 = av_clip(x0,     0, s->sps->width  - 1) >> log2_ctb_size;
+    int ctb_y0 = av_clip(y0,     0, s->sps->height - 1) >> log2_ctb_size;
+    int ctb_x1 = av_clip(x1 - 1, 0, s->sps->width  - 1) >> log2_ctb_size;
+    int ctb_y1 = av_clip(y1 - 1, 0, s->sps->height - 1) >> log2_ctb_size;
+    int x, y;
+
+    for (y = ctb_y0; y <= ctb_y1; y++)
+        for (x = ctb_x0; x <= ctb_x1; x++)
+            il_await_region(s, x, y, IL_REGION_PIXELS);
+}
+
+void ff_hevc_il_await_motion(HEVCContext *s, int x, int y)
+{
+    il_await_region(s, x >> s->sps->log2_ctb_size, y >> s->sps->log2_ctb_size,
+                    IL_REGION_MOTION);
+}
 
 int ff_hevc_slice_rpl(HEVCContext *s)
 {
@@ -476,12 +773,13 @@ static HEVCFrame *generate_missing_ref(HEVCContext *s, int poc)
                 }
     }
 
+    ff_hevc_extend_edges(s, frame->frame, 0, s->sps->height);
+
     frame->poc      = poc;
     frame->sequence = s->seq_decode;
     frame->flags    = 0;
 
-    if (s->threads_type & FF_THREAD_FRAME)
-        ff_thread_report_progress(&frame->tf, INT_MAX, 0);
+    ff_hevc_report_progress(s, frame, INT_MAX);
 
     return frame;
 }
@@ -496,6 +794,12 @@ static int add_candidate_ref(HEVCContext *s, RefPicList *list,
         return AVERROR_INVALIDDATA;
 
     if (!ref) {
+        /* a picture only kept for later ones may be missing for good, e.g.
+         * when its temporal sub-layer is not decoded */
+        if (list == &s->rps[ST_FOLL] || list == &s->rps[LT_FOLL])
+            return 0;
+        av_log(s->avctx, AV_LOG_ERROR,
+               "Could not find ref with POC %d\n", poc);
         ref = generate_missing_ref(s, poc);
         if (!ref)
             return AVERROR(ENOMEM);
@@ -558,14 +862,12 @@ int ff_hevc_frame_rps(HEVCContext *s)
 #endif
     {
         if(!(s->nal_unit_type >= NAL_BLA_W_LP && s->nal_unit_type <= NAL_CRA_NUT) && s->sps->set_mfm_enabled_flag)  {
-            int *arg, *ret, cmpt = (s->sps->height / ctb_size) + (s->sps->height%ctb_size ? 1:0);
-            arg = av_malloc(cmpt*sizeof(int));
-            ret = av_malloc(cmpt*sizeof(int));
-            for(i=0; i < cmpt; i++)
-                arg[i] = i;
-            s->avctx->execute(s->avctx, (void *) scale_upsampled_mv_field, arg, ret, cmpt, sizeof(int));
-            av_free(arg);
-            av_free(ret);
+            /* the motion of the base layer is scaled CTB by CTB, when the
+             * temporal motion vector prediction reads it */
+            init_il_slice_rpl(s);
+            init_il_motion(s);
+            for (i = 0; i < s->sps->ctb_width * s->sps->ctb_height; i++)
+                s->il_upsample->region[i] &= ~IL_REGION_MOTION;
             }   else    {
                 init_upsampled_mv_fields(s);
             }
@@ -585,9 +887,7 @@ int ff_hevc_frame_rps(HEVCContext *s)
 
     for (i = 0; i < NB_RPS_TYPE; i++)
         rps[i].nb_refs = 0;
-#ifdef SVC_EXTENSION
-    if(!s->nuh_layer_id || !(s->nal_unit_type >= NAL_BLA_W_LP && s->nal_unit_type <= NAL_CRA_NUT) && s->sps->set_mfm_enabled_flag)  {
-#endif
+    if(!s->nuh_layer_id || (!(s->nal_unit_type >= NAL_BLA_W_LP && s->nal_unit_type <= NAL_CRA_NUT) && s->sps->set_mfm_enabled_flag))  {
         /* add the short refs */
         for (i = 0; short_rps && i < short_rps->num_delta_pocs; i++) {
             int poc = s->poc + short_rps->delta_poc[i];
@@ -614,7 +914,6 @@ int ff_hevc_frame_rps(HEVCContext *s)
             if (ret < 0)
                 return ret;
         }
-#ifdef SVC_EXTENSION
     } else {
         for (i = 0; short_rps && i < short_rps->num_delta_pocs; i++) {
             int poc = s->poc + short_rps->delta_poc[i];
@@ -627,7 +926,6 @@ int ff_hevc_frame_rps(HEVCContext *s)
             mark_ref(ref, HEVC_FRAME_FLAG_LONG_REF);
         }
     }
-#endif
 
     
 #if REF_IDX_FRAMEWORK
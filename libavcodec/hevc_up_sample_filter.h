@@ -24,12 +24,9 @@
 #define AVCODEC_HEVC_UP_SAMPLE_FILTER_H
 
 #include "hevc.h"
-//#ifdef SVC_EXTENSION
 #define NTAPS_LUMA 8
 #define NTAPS_CHROMA 4
 #define US_FILTER_PREC  6
-//#endif
-#ifdef SVC_EXTENSION
 #if PHASE_DERIVATION_IN_INTEGER
 DECLARE_ALIGNED(16, static const int32_t, up_sample_filter_chroma[16][NTAPS_CHROMA])=
 {
@@ -134,7 +131,6 @@ DECLARE_ALIGNED(16, static const int32_t, up_sample_filter_chroma20[8][NTAPS_CHR
     { -2, 10, 58, -2 }
 };
 #endif
-#endif
 
 
 #endif /* AVCODEC_HEVC_UP_SAMPLE_FILTER_H */
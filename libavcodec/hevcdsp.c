@@ -112,8 +112,10 @@ DECLARE_ALIGNED(16, const int8_t, ff_hevc_epel_filters[7][16]) = {
 #include "hevcdsp_template.c"
 #undef BIT_DEPTH
 
-void ff_hevc_dsp_init(HEVCDSPContext *hevcdsp, int bit_depth)
+void ff_hevc_dsp_init(HEVCDSPContext *hevcdsp, int bit_depth, int cpu_flags)
 {
+    int i;
+
 #undef FUNC
 #define FUNC(a, depth) a ## _ ## depth
 
@@ -150,6 +152,43 @@ void ff_hevc_dsp_init(HEVCDSPContext *hevcdsp, int bit_depth)
     EPEL_FUNC(put_hevc_epel, put_hevc_epel_w, 0, 1, put_hevc_epel_h, depth);   \
     EPEL_FUNC(put_hevc_epel, put_hevc_epel_w, 1, 0, put_hevc_epel_v, depth)
 
+#define QPEL_FUSED_FUNC(V, H, depth)                                           \
+    for (i = 0; i < 5; i++) {                                                  \
+        hevcdsp->put_hevc_qpel_uni[i][V][H] = FUNC(put_hevc_qpel_uni_h ## H ## v ## V, depth); \
+        hevcdsp->put_hevc_qpel_bi[i][V][H]  = FUNC(put_hevc_qpel_bi_h ## H ## v ## V, depth);  \
+    }
+
+#define QPEL_FUSED_FUNCS(depth)                                                \
+    QPEL_FUSED_FUNC(0, 0, depth); QPEL_FUSED_FUNC(0, 1, depth);                \
+    QPEL_FUSED_FUNC(0, 2, depth); QPEL_FUSED_FUNC(0, 3, depth);                \
+    QPEL_FUSED_FUNC(1, 0, depth); QPEL_FUSED_FUNC(1, 1, depth);                \
+    QPEL_FUSED_FUNC(1, 2, depth); QPEL_FUSED_FUNC(1, 3, depth);                \
+    QPEL_FUSED_FUNC(2, 0, depth); QPEL_FUSED_FUNC(2, 1, depth);                \
+    QPEL_FUSED_FUNC(2, 2, depth); QPEL_FUSED_FUNC(2, 3, depth);                \
+    QPEL_FUSED_FUNC(3, 0, depth); QPEL_FUSED_FUNC(3, 1, depth);                \
+    QPEL_FUSED_FUNC(3, 2, depth); QPEL_FUSED_FUNC(3, 3, depth)
+
+#define EPEL_FUSED_FUNC(V, H, depth)                                           \
+    for (i = 0; i < 5; i++) {                                                  \
+        hevcdsp->put_hevc_epel_uni[i][V][H] = FUNC(put_hevc_epel_uni_h ## H ## v ## V, depth); \
+        hevcdsp->put_hevc_epel_bi[i][V][H]  = FUNC(put_hevc_epel_bi_h ## H ## v ## V, depth);  \
+    }
+
+#define EPEL_FUSED_FUNCS(depth)                                                \
+    EPEL_FUSED_FUNC(0, 0, depth); EPEL_FUSED_FUNC(0, 1, depth);                \
+    EPEL_FUSED_FUNC(1, 0, depth); EPEL_FUSED_FUNC(1, 1, depth)
+
+#define EPEL_UV_FUNC(V, H, depth)                                              \
+    for (i = 0; i < 5; i++) {                                                  \
+        hevcdsp->put_hevc_epel_uv[i][V][H]     = FUNC(put_hevc_epel_uv_h ## H ## v ## V, depth);     \
+        hevcdsp->put_hevc_epel_uni_uv[i][V][H] = FUNC(put_hevc_epel_uni_uv_h ## H ## v ## V, depth); \
+        hevcdsp->put_hevc_epel_bi_uv[i][V][H]  = FUNC(put_hevc_epel_bi_uv_h ## H ## v ## V, depth);  \
+    }
+
+#define EPEL_UV_FUNCS(depth)                                                   \
+    EPEL_UV_FUNC(0, 0, depth); EPEL_UV_FUNC(0, 1, depth);                      \
+    EPEL_UV_FUNC(1, 0, depth); EPEL_UV_FUNC(1, 1, depth)
+
 #define EPEL_V14(depth)                                                        \
     hevcdsp->put_hevc_epel_v_14[0]     = hevcdsp->put_hevc_epel_v_14[1] = hevcdsp->put_hevc_epel_v_14[2] = hevcdsp->put_hevc_epel_v_14[3] = hevcdsp->put_hevc_epel_v_14[4] = FUNC(put_hevc_epel_v_14,depth)
 
@@ -185,18 +224,15 @@ void ff_hevc_dsp_init(HEVCDSPContext *hevcdsp, int bit_depth)
     hevcdsp->put_hevc_qpel_v_14[3][3]     = FUNC(put_hevc_qpel_v_14_3,depth);    \
     hevcdsp->put_hevc_qpel_v_14[4][3]     = FUNC(put_hevc_qpel_v_14_3,depth);    \
                                                                             \
-    hevcdsp->sao_band_filter[0] = FUNC(sao_band_filter_0, depth);           \
-    hevcdsp->sao_band_filter[1] = FUNC(sao_band_filter_1, depth);           \
-    hevcdsp->sao_band_filter[2] = FUNC(sao_band_filter_2, depth);           \
-    hevcdsp->sao_band_filter[3] = FUNC(sao_band_filter_3, depth);           \
+    hevcdsp->sao_filter_ctb_row = FUNC(sao_filter_ctb_row, depth);          \
                                                                             \
-    hevcdsp->sao_edge_filter[0] = FUNC(sao_edge_filter_0, depth);           \
-    hevcdsp->sao_edge_filter[1] = FUNC(sao_edge_filter_1, depth);           \
-    hevcdsp->sao_edge_filter[2] = FUNC(sao_edge_filter_2, depth);           \
-    hevcdsp->sao_edge_filter[3] = FUNC(sao_edge_filter_3, depth);           \
+    hevcdsp->picture_checksum   = FUNC(picture_checksum, depth);            \
                                                                             \
     QPEL_FUNCS(depth);                                                      \
     EPEL_FUNCS(depth);                                                      \
+    QPEL_FUSED_FUNCS(depth);                                                \
+    EPEL_FUSED_FUNCS(depth);                                                \
+    EPEL_UV_FUNCS(depth);                                                   \
     hevcdsp->put_unweighted_pred = FUNC(put_unweighted_pred, depth);           \
    hevcdsp->put_weighted_pred_avg = FUNC(put_weighted_pred_avg, depth);        \
                                                                                \
@@ -225,11 +261,9 @@ void ff_hevc_dsp_init(HEVCDSPContext *hevcdsp, int bit_depth)
         break;
     }
     
-#ifdef SVC_EXTENSION
 #define HEVC_DSP_UP(depth)                                                 \
-    hevcdsp->upsample_base_layer_frame   = FUNC(upsample_base_layer_frame, depth); \
-    hevcdsp->upsample_h_base_layer_frame = FUNC(upsample_h_base_layer_frame, depth);\
-    hevcdsp->upsample_v_base_layer_frame = FUNC(upsample_v_base_layer_frame, depth);
+    hevcdsp->upsample_h_base_layer_rows = FUNC(upsample_h_base_layer_rows, depth); \
+    hevcdsp->upsample_v_base_layer_rows = FUNC(upsample_v_base_layer_rows, depth);
     switch (bit_depth) {
     case 9:
         HEVC_DSP_UP(9);
@@ -241,8 +275,7 @@ void ff_hevc_dsp_init(HEVCDSPContext *hevcdsp, int bit_depth)
         HEVC_DSP_UP(8);        
         break;
     }
-#endif
 
-    if (ARCH_X86) ff_hevcdsp_init_x86(hevcdsp, bit_depth);
-    if (ARCH_ARM) ff_hevcdsp_init_arm(hevcdsp, bit_depth);
+    if (ARCH_X86) ff_hevcdsp_init_x86(hevcdsp, bit_depth, cpu_flags);
+    if (ARCH_ARM) ff_hevcdsp_init_arm(hevcdsp, bit_depth, cpu_flags);
 }
@@ -31,6 +31,31 @@ struct UpsamplInf;
 struct HEVCWindow;
 struct HEVCContext;
 
+/**
+ * Explicit weighted prediction parameters of one reference picture and
+ * colour component, derived once per slice for the sample bit depth.
+ */
+typedef struct HEVCWeight {
+    int weight;
+    int offset;     ///< offset scaled to the sample bit depth
+    int shift;      ///< log2Wd, denominator + 14 - bit depth
+    int round;      ///< rounding of the uni-directional prediction
+} HEVCWeight;
+
+/**
+ * Bit of the per-CTB SAO neighbour mask telling that edge offset must not
+ * read the samples of the neighbouring CTB at (dx, dy), because it is out
+ * of the picture or across a slice or tile boundary that is not filtered.
+ */
+#define SAO_NO_FILTER(dx, dy) (1 << (((dy) + 1) * 3 + (dx) + 1))
+
+/**
+ * SAO_NO_FILTER() bit of the CTB holding sample (x, y), in coordinates
+ * relative to a CTB of w x h samples.
+ */
+#define SAO_NO_FILTER_AT(x, y, w, h) \
+    SAO_NO_FILTER((x) < 0 ? -1 : (x) >= (w), (y) < 0 ? -1 : (y) >= (h))
+
 typedef struct HEVCDSPContext {
     void (*put_pcm)(uint8_t *_dst, ptrdiff_t _stride, int size,
                     GetBitContext *gb, int pcm_bit_depth);
@@ -43,9 +68,15 @@ typedef struct HEVCDSPContext {
 
     void (*transform_add[4])(uint8_t *dst, int16_t *coeffs, ptrdiff_t _stride);
 
-    void (*sao_band_filter[4])( uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao, int *borders, int width, int height, int c_idx);
-
-    void (*sao_edge_filter[4])(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride,  struct SAOParams *sao, int *borders, int _width, int _height, int c_idx, uint8_t vert_edge, uint8_t horiz_edge, uint8_t diag_edge);
+    /**
+     * Apply SAO to one CTB row of a plane, from src into dst.
+     * sao and no_filter hold the parameters and SAO_NO_FILTER() masks of
+     * the CTBs of the row, ctb_size is the CTB width in samples of the
+     * plane, width the plane width and height the height of the row.
+     */
+    void (*sao_filter_ctb_row)(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride,
+                               struct SAOParams *sao, const uint16_t *no_filter,
+                               int ctb_size, int width, int height, int c_idx);
 
 
     void (*put_hevc_qpel[5][4][4])(int16_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride,
@@ -68,16 +99,47 @@ typedef struct HEVCDSPContext {
                                     int width, int height, int mx, int my);
 
 
+    /**
+     * Interpolate a block and round it straight into the picture
+     * (uni-prediction), or average it with the interpolated first list in
+     * src2 (bi-prediction). Indexed like put_hevc_qpel and put_hevc_epel,
+     * the hv case included.
+     */
+    void (*put_hevc_qpel_uni[5][4][4])(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride,
+                                       int width, int height);
+    void (*put_hevc_qpel_bi[5][4][4])(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride,
+                                      int16_t *src2, ptrdiff_t src2stride, int width, int height);
+    void (*put_hevc_epel_uni[5][2][2])(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride,
+                                       int width, int height, int mx, int my);
+    void (*put_hevc_epel_bi[5][2][2])(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride,
+                                      int16_t *src2, ptrdiff_t src2stride, int width, int height, int mx, int my);
+
+    /**
+     * Chroma MC of the Cb and Cr blocks in one call, sharing the motion
+     * vector, the block size and the strides. Counterparts of
+     * put_hevc_epel (hv included), put_hevc_epel_uni and put_hevc_epel_bi.
+     */
+    void (*put_hevc_epel_uv[5][2][2])(int16_t *dst1, int16_t *dst2, ptrdiff_t dststride,
+                                      uint8_t *src1, uint8_t *src2, ptrdiff_t srcstride,
+                                      int width, int height, int mx, int my);
+    void (*put_hevc_epel_uni_uv[5][2][2])(uint8_t *dst1, uint8_t *dst2, ptrdiff_t dststride,
+                                          uint8_t *src1, uint8_t *src2, ptrdiff_t srcstride,
+                                          int width, int height, int mx, int my);
+    void (*put_hevc_epel_bi_uv[5][2][2])(uint8_t *dst1, uint8_t *dst2, ptrdiff_t dststride,
+                                         uint8_t *src1, uint8_t *src2, ptrdiff_t srcstride,
+                                         int16_t *src21, int16_t *src22, ptrdiff_t src2stride,
+                                         int width, int height, int mx, int my);
+
     void (*put_unweighted_pred)(uint8_t *dst, ptrdiff_t dststride, int16_t *src, ptrdiff_t srcstride,
                                 int width, int height);
 
     void (*put_weighted_pred_avg)(uint8_t *dst, ptrdiff_t dststride, int16_t *src1, int16_t *src2,
                                   ptrdiff_t srcstride, int width, int height);
-    void (*weighted_pred)(uint8_t denom, int16_t wlxFlag, int16_t olxFlag, uint8_t *dst, ptrdiff_t dststride, int16_t *src,
-                                  ptrdiff_t srcstride, int width, int height);
-    void (*weighted_pred_avg)(uint8_t denom, int16_t wl0Flag, int16_t wl1Flag, int16_t ol0Flag, int16_t ol1Flag,
-                                   uint8_t *dst, ptrdiff_t dststride, int16_t *src1, int16_t *src2,
-                                   ptrdiff_t srcstride, int width, int height);
+    void (*weighted_pred)(const HEVCWeight *wp, uint8_t *dst, ptrdiff_t dststride, int16_t *src,
+                          ptrdiff_t srcstride, int width, int height);
+    void (*weighted_pred_avg)(const HEVCWeight *wp0, const HEVCWeight *wp1,
+                              uint8_t *dst, ptrdiff_t dststride, int16_t *src1, int16_t *src2,
+                              ptrdiff_t srcstride, int width, int height);
 
     void (*hevc_h_loop_filter_luma)(uint8_t *_pix, ptrdiff_t _stride, int *_beta, int *_tc, uint8_t *_no_p, uint8_t *_no_q);
     void (*hevc_v_loop_filter_luma)(uint8_t *_pix, ptrdiff_t _stride, int *_beta, int *_tc, uint8_t *_no_p, uint8_t *_no_q);
@@ -88,15 +150,46 @@ typedef struct HEVCDSPContext {
     void (*hevc_h_loop_filter_chroma_c)(uint8_t *_pix, ptrdiff_t _stride, int *_tc, uint8_t *_no_p, uint8_t *_no_q);
     void (*hevc_v_loop_filter_chroma_c)(uint8_t *_pix, ptrdiff_t _stride, int *_tc, uint8_t *_no_p, uint8_t *_no_q);
 
-    void (*upsample_base_layer_frame)  (struct AVFrame *FrameEL, struct AVFrame *FrameBL, short *Buffer[3], const int32_t enabled_up_sample_filter_luma[16][8], const int32_t enabled_up_sample_filter_chroma[16][4], struct HEVCWindow *Enhscal, struct UpsamplInf *up_info, int channel);
-    void (*upsample_v_base_layer_frame)(struct AVFrame *FrameEL, struct AVFrame *FrameBL, short *Buffer[3], const int32_t enabled_up_sample_filter_luma[16][8], const int32_t enabled_up_sample_filter_chroma[16][4], struct HEVCWindow *Enhscal, struct UpsamplInf *up_info, int channel);
-    void (*upsample_h_base_layer_frame)(struct AVFrame *FrameEL, struct AVFrame *FrameBL, short *Buffer[3], const int32_t enabled_up_sample_filter_luma[16][8], const int32_t enabled_up_sample_filter_chroma[16][4], struct HEVCWindow *Enhscal, struct UpsamplInf *up_info, int channel);
+    /**
+     * Filter horizontally the base layer rows [y0, y1) of plane c_idx into
+     * the columns [x0, x1) of a ring of stripe_rows rows, base layer row y
+     * going to row y % stripe_rows. The ring has the el_width columns of the
+     * plane of the inter-layer reference, stripe may point before the
+     * allocated ones when only a range of them is kept. The sums are
+     * shifted right by bit_depth - 8 so that they fit in 16 bits.
+     */
+    void (*upsample_h_base_layer_rows)(int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                       const uint8_t *src, ptrdiff_t src_stride,
+                                       int bl_width, int el_width,
+                                       const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                       const int32_t up_sample_filter_luma[16][8],
+                                       const int32_t up_sample_filter_chroma[16][4],
+                                       int c_idx, int x0, int x1, int y0, int y1);
+    /**
+     * Filter vertically the area [x0, x1) x [y0, y1) of plane c_idx of the
+     * inter-layer reference out of the ring filled by
+     * upsample_h_base_layer_rows, which must hold the rows and columns it is
+     * interpolated from.
+     */
+    void (*upsample_v_base_layer_rows)(uint8_t *dst, ptrdiff_t dst_stride,
+                                       const int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                       int bl_height, int el_width, int el_height,
+                                       const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                       const int32_t up_sample_filter_luma[16][8],
+                                       const int32_t up_sample_filter_chroma[16][4],
+                                       int c_idx, int x0, int x1, int y0, int y1);
+
+    /** 32-bit picture checksum of a plane (decoded picture hash SEI, hash_type 2) */
+    uint32_t (*picture_checksum)(const uint8_t *src, ptrdiff_t stride, int width, int height);
 } HEVCDSPContext;
 
-void ff_hevc_dsp_init(HEVCDSPContext *hpc, int bit_depth);
+/**
+ * @param cpu_flags the AV_CPU_FLAG_* the functions may use
+ */
+void ff_hevc_dsp_init(HEVCDSPContext *hpc, int bit_depth, int cpu_flags);
 
 extern const int8_t ff_hevc_epel_filters[7][16];
 
-void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth);
-void ff_hevcdsp_init_arm(HEVCDSPContext *c, const int bit_depth);
+void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth, int mm_flags);
+void ff_hevcdsp_init_arm(HEVCDSPContext *c, const int bit_depth, int cpu_flags);
 #endif /* AVCODEC_HEVCDSP_H */
@@ -297,103 +297,13 @@ TRANSFORM_ADD(32)
 ////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////
-static void FUNC(sao_band_filter)(uint8_t *_dst, uint8_t *_src,
-                                  ptrdiff_t stride, SAOParams *sao,
-                                  int *borders, int width, int height,
-                                  int c_idx, int class)
-{
-    pixel *dst = (pixel *)_dst;
-    pixel *src = (pixel *)_src;
-    int offset_table[32] = { 0 };
-    int k, y, x;
-    int chroma = !!c_idx;
-    int shift  = BIT_DEPTH - 5;
-    int *sao_offset_val = sao->offset_val[c_idx];
-    int sao_left_class  = sao->band_position[c_idx];
-    int init_y = 0, init_x = 0;
-
-    stride /= sizeof(pixel);
-
-    switch (class) {
-    case 0:
-        if (!borders[2])
-            width -= (8 >> chroma) + 2;
-        if (!borders[3])
-            height -= (4 >> chroma) + 2;
-        break;
-    case 1:
-        init_y = -(4 >> chroma) - 2;
-        if (!borders[2])
-            width -= (8 >> chroma) + 2;
-        height = (4 >> chroma) + 2;
-        break;
-    case 2:
-        init_x = -(8 >> chroma) - 2;
-        width  =  (8 >> chroma) + 2;
-        if (!borders[3])
-            height -= (4 >> chroma) + 2;
-        break;
-    case 3:
-        init_y = -(4 >> chroma) - 2;
-        init_x = -(8 >> chroma) - 2;
-        width  =  (8 >> chroma) + 2;
-        height =  (4 >> chroma) + 2;
-        break;
-    }
-
-    dst = dst + (init_y * stride + init_x);
-    src = src + (init_y * stride + init_x);
-    for (k = 0; k < 4; k++)
-        offset_table[(k + sao_left_class) & 31] = sao_offset_val[k + 1];
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++)
-            dst[x] = av_clip_pixel(src[x] + offset_table[av_clip_pixel(src[x] >> shift)]);
-        dst += stride;
-        src += stride;
-    }
-}
-
-static void FUNC(sao_band_filter_0)(uint8_t *dst, uint8_t *src,
-                                    ptrdiff_t stride, SAOParams *sao,
-                                    int *borders, int width, int height,
-                                    int c_idx)
-{
-    FUNC(sao_band_filter)(dst, src, stride, sao, borders,
-                          width, height, c_idx, 0);
-}
-
-static void FUNC(sao_band_filter_1)(uint8_t *dst, uint8_t *src,
-                                    ptrdiff_t stride, SAOParams *sao,
-                                    int *borders, int width, int height,
-                                    int c_idx)
-{
-    FUNC(sao_band_filter)(dst, src, stride, sao, borders,
-                          width, height, c_idx, 1);
-}
-
-static void FUNC(sao_band_filter_2)(uint8_t *dst, uint8_t *src,
-                                    ptrdiff_t stride, SAOParams *sao,
-                                    int *borders, int width, int height,
-                                    int c_idx)
-{
-    FUNC(sao_band_filter)(dst, src, stride, sao, borders,
-                          width, height, c_idx, 2);
-}
+#define CMP(a, b) ((a) > (b) ? 1 : ((a) == (b) ? 0 : -1))
 
-static void FUNC(sao_band_filter_3)(uint8_t *_dst, uint8_t *_src,
-                                    ptrdiff_t stride, SAOParams *sao,
-                                    int *borders, int width, int height,
-                                    int c_idx)
+static void FUNC(sao_filter_ctb_row)(uint8_t *_dst, uint8_t *_src,
+                                     ptrdiff_t stride, SAOParams *sao,
+                                     const uint16_t *no_filter, int ctb_size,
+                                     int width, int height, int c_idx)
 {
-    FUNC(sao_band_filter)(_dst, _src, stride, sao, borders,
-                          width, height, c_idx, 3);
-}
-
-static void FUNC(sao_edge_filter)(uint8_t *_dst, uint8_t *_src,
-                                  ptrdiff_t stride, SAOParams *sao,
-                                  int width, int height,
-                                  int c_idx, int init_x, int init_y) {
-
     static const uint8_t edge_idx[] = { 1, 2, 0, 3, 4 };
     static const int8_t pos[4][2][2] = {
         { { -1,  0 }, {  1, 0 } }, // horizontal
@@ -401,283 +311,103 @@ static void FUNC(sao_edge_filter)(uint8_t *_dst, uint8_t *_src,
         { { -1, -1 }, {  1, 1 } }, // 45 degree
         { {  1, -1 }, { -1, 1 } }, // 135 degree
     };
-    int *sao_offset_val = sao->offset_val[c_idx];
-    int sao_eo_class    = sao->eo_class[c_idx];
-    pixel *dst = (pixel *)_dst;
-    pixel *src = (pixel *)_src;
-#define CMP(a, b) ((a) > (b) ? 1 : ((a) == (b) ? 0 : -1))
-
-    int y_stride = init_y * stride;
-    int pos_0_0  = pos[sao_eo_class][0][0];
-    int pos_0_1  = pos[sao_eo_class][0][1];
-    int pos_1_0  = pos[sao_eo_class][1][0];
-    int pos_1_1  = pos[sao_eo_class][1][1];
-    int x, y;
-
-    int y_stride_0_1 = (init_y + pos_0_1) * stride;
-    int y_stride_1_1 = (init_y + pos_1_1) * stride;
-    for (y = init_y; y < height; y++) {
-        for (x = init_x; x < width; x++) {
-            int diff0         = CMP(src[x + y_stride], src[x + pos_0_0 + y_stride_0_1]);
-            int diff1         = CMP(src[x + y_stride], src[x + pos_1_0 + y_stride_1_1]);
-            int offset_val    = edge_idx[2 + diff0 + diff1];
-            dst[x + y_stride] = av_clip_pixel(src[x + y_stride] + sao_offset_val[offset_val]);
-        }
-        y_stride     += stride;
-        y_stride_0_1 += stride;
-        y_stride_1_1 += stride;
-    }
-}
-
-static void FUNC(sao_edge_filter_0)(uint8_t *_dst, uint8_t *_src,
-                                    ptrdiff_t stride, SAOParams *sao,
-                                    int *borders, int _width, int _height,
-                                    int c_idx, uint8_t vert_edge,
-                                    uint8_t horiz_edge, uint8_t diag_edge)
-{
     pixel *dst = (pixel *)_dst;
     pixel *src = (pixel *)_src;
-    int chroma = !!c_idx;
-    int *sao_offset_val = sao->offset_val[c_idx];
-    int sao_eo_class    = sao->eo_class[c_idx];
-    int init_x = 0, init_y = 0, width = _width, height = _height;
-
-    int x, y;
-
+    int shift  = BIT_DEPTH - 5;
+    int x0, x, y, k;
 
     stride /= sizeof(pixel);
 
-    if (!borders[2])
-        width -= (8 >> chroma) + 2;
-    if (!borders[3])
-        height -= (4 >> chroma) + 2;
-
-    dst = dst + (init_y * stride + init_x);
-    src = src + (init_y * stride + init_x);
-    init_y = init_x = 0;
+    for (x0 = 0; x0 < width; x0 += ctb_size, sao++, no_filter++) {
+        int w = FFMIN(ctb_size, width - x0);
+        int *sao_offset_val = sao->offset_val[c_idx];
+        pixel *d = dst + x0;
+        pixel *s = src + x0;
 
-    FUNC(sao_edge_filter)((uint8_t *)dst, (uint8_t *)src, stride, sao, width, height, c_idx, init_x, init_y);
+        switch (sao->type_idx[c_idx]) {
+        case SAO_BAND: {
+            int offset_table[32] = { 0 };
 
-    if (sao_eo_class != SAO_EO_VERT) {
-        if (borders[0]) {
-            int offset_val = sao_offset_val[0];
-            int y_stride   = 0;
+            for (k = 0; k < 4; k++)
+                offset_table[(k + sao->band_position[c_idx]) & 31] = sao_offset_val[k + 1];
             for (y = 0; y < height; y++) {
-                dst[y_stride] = av_clip_pixel(src[y_stride] + offset_val);
-                y_stride     += stride;
-            }
-            init_x = 1;
-        }
-        if (borders[2]) {
-            int offset_val = sao_offset_val[0];
-            int x_stride   = width - 1;
-            for (x = 0; x < height; x++) {
-                dst[x_stride] = av_clip_pixel(src[x_stride] + offset_val);
-                x_stride     += stride;
+                for (x = 0; x < w; x++)
+                    d[x] = av_clip_pixel(s[x] + offset_table[s[x] >> shift]);
+                d += stride;
+                s += stride;
             }
-            width--;
-        }
-    }
-    if (sao_eo_class != SAO_EO_HORIZ) {
-        if (borders[1]) {
-            int offset_val = sao_offset_val[0];
-            for (x = init_x; x < width; x++)
-                dst[x] = av_clip_pixel(src[x] + offset_val);
-            init_y = 1;
+            break;
         }
-        if (borders[3]) {
-            int offset_val = sao_offset_val[0];
-            int y_stride   = stride * (height - 1);
-            for (x = init_x; x < width; x++)
-                dst[x + y_stride] = av_clip_pixel(src[x + y_stride] + offset_val);
-            height--;
-        }
-    }
-
-    {
-        // Restore pixels that can't be modified
-        int save_upper_left = !diag_edge && sao_eo_class == SAO_EO_135D && !borders[0] && !borders[1];
-        if (vert_edge && sao_eo_class != SAO_EO_VERT)
-            for (y = init_y+save_upper_left; y< height; y++)
-                dst[y*stride] = src[y*stride];
-        if(horiz_edge && sao_eo_class != SAO_EO_HORIZ)
-            for(x = init_x+save_upper_left; x<width; x++)
-                dst[x] = src[x];
-        if(diag_edge && sao_eo_class == SAO_EO_135D)
-            dst[0] = src[0];
-    }
-
-}
-
-static void FUNC(sao_edge_filter_1)(uint8_t *_dst, uint8_t *_src,
-                                    ptrdiff_t stride, SAOParams *sao,
-                                    int *borders, int _width, int _height,
-                                    int c_idx, uint8_t vert_edge,
-                                    uint8_t horiz_edge, uint8_t diag_edge)
-{
-    int x, y;
-    pixel *dst = (pixel *)_dst;
-    pixel *src = (pixel *)_src;
-    int chroma = !!c_idx;
-    int *sao_offset_val = sao->offset_val[c_idx];
-    int sao_eo_class    = sao->eo_class[c_idx];
-    int init_x = 0, init_y = 0, width = _width, height = _height;
-
-#define CMP(a, b) ((a) > (b) ? 1 : ((a) == (b) ? 0 : -1))
-
-    stride /= sizeof(pixel);
-
-    init_y = -(4 >> chroma) - 2;
-    if (!borders[2])
-        width -= (8 >> chroma) + 2;
-    height = (4 >> chroma) + 2;
-
-    dst = dst + (init_y * stride + init_x);
-    src = src + (init_y * stride + init_x);
-    init_y = init_x = 0;
-
-    FUNC(sao_edge_filter)((uint8_t *)dst, (uint8_t *)src, stride, sao, width, height, c_idx, init_x, init_y);
+        case SAO_EDGE: {
+            int sao_eo_class = sao->eo_class[c_idx];
+            int a_x = pos[sao_eo_class][0][0], a_y = pos[sao_eo_class][0][1];
+            int b_x = pos[sao_eo_class][1][0], b_y = pos[sao_eo_class][1][1];
+            ptrdiff_t a_off = a_y * stride + a_x;
+            ptrdiff_t b_off = b_y * stride + b_x;
 
-    if (sao_eo_class != SAO_EO_VERT) {
-        if (borders[0]) {
-            int offset_val = sao_offset_val[0];
-            int y_stride   = 0;
             for (y = 0; y < height; y++) {
-                dst[y_stride] = av_clip_pixel(src[y_stride] + offset_val);
-                y_stride     += stride;
+                // samples with a neighbour in a CTB that is not filtered
+                // across are kept; the first and last columns have the
+                // corner CTBs as neighbours, the inner ones do not
+                int keep_first = *no_filter & (SAO_NO_FILTER_AT(a_x, y + a_y, w, height) |
+                                               SAO_NO_FILTER_AT(b_x, y + b_y, w, height));
+                int keep_mid   = *no_filter & (SAO_NO_FILTER_AT(0, y + a_y, w, height) |
+                                               SAO_NO_FILTER_AT(0, y + b_y, w, height));
+                int keep_last  = *no_filter & (SAO_NO_FILTER_AT(w - 1 + a_x, y + a_y, w, height) |
+                                               SAO_NO_FILTER_AT(w - 1 + b_x, y + b_y, w, height));
+
+                for (x = 0; x < w; x++) {
+                    int keep = !x ? keep_first : x == w - 1 ? keep_last : keep_mid;
+                    if (keep) {
+                        d[x] = s[x];
+                    } else {
+                        int diff0 = CMP(s[x], s[x + a_off]);
+                        int diff1 = CMP(s[x], s[x + b_off]);
+                        d[x] = av_clip_pixel(s[x] + sao_offset_val[edge_idx[2 + diff0 + diff1]]);
+                    }
+                }
+                d += stride;
+                s += stride;
             }
-            init_x = 1;
+            break;
         }
-        if (borders[2]) {
-            int offset_val = sao_offset_val[0];
-            int x_stride   = width - 1;
-            for (x = 0; x < height; x++) {
-                dst[x_stride] = av_clip_pixel(src[x_stride] + offset_val);
-                x_stride     += stride;
+        default:
+            for (y = 0; y < height; y++) {
+                memcpy(d, s, w * sizeof(pixel));
+                d += stride;
+                s += stride;
             }
-            width--;
+            break;
         }
     }
-
-    {
-        // Restore pixels that can't be modified
-        int save_lower_left = !diag_edge && sao_eo_class == SAO_EO_45D && !borders[0];
-        if(vert_edge && sao_eo_class != SAO_EO_VERT)
-            for(y = init_y; y< height-save_lower_left; y++)
-                dst[y*stride] = src[y*stride];
-        if(horiz_edge && sao_eo_class != SAO_EO_HORIZ)
-            for(x = init_x+save_lower_left; x<width; x++)
-                dst[(height-1)*stride+x] = src[(height-1)*stride+x];
-        if(diag_edge && sao_eo_class == SAO_EO_45D)
-            dst[stride*(height-1)] = src[stride*(height-1)];
-    }
-
 }
 
-static void FUNC(sao_edge_filter_2)(uint8_t *_dst, uint8_t *_src,
-                                    ptrdiff_t stride, SAOParams *sao,
-                                    int *borders, int _width, int _height,
-                                    int c_idx, uint8_t vert_edge,
-                                    uint8_t horiz_edge, uint8_t diag_edge)
-{
-    int x, y;
-    pixel *dst = (pixel *)_dst;
-    pixel *src = (pixel *)_src;
-    int chroma = !!c_idx;
-    int *sao_offset_val = sao->offset_val[c_idx];
-    int sao_eo_class    = sao->eo_class[c_idx];
-
-    int init_x = 0, init_y = 0, width = _width, height = _height;
-
-    stride /= sizeof(pixel);
-
-    init_x = -(8 >> chroma) - 2;
-    width  =  (8 >> chroma) + 2;
-    if (!borders[3])
-        height -= (4 >> chroma) + 2;
-
-    dst = dst + (init_y * stride + init_x);
-    src = src + (init_y * stride + init_x);
-    init_y = init_x = 0;
-
-    FUNC(sao_edge_filter)((uint8_t *)dst, (uint8_t *)src, stride, sao, width, height, c_idx, init_x, init_y);
-
-    if (sao_eo_class != SAO_EO_HORIZ) {
-        if (borders[1]) {
-            int offset_val = sao_offset_val[0];
-            for (x = init_x; x < width; x++)
-                dst[x] = av_clip_pixel(src[x] + offset_val);
-            init_y = 1;
-        }
-        if (borders[3]) {
-            int offset_val = sao_offset_val[0];
-            int y_stride   = stride * (height - 1);
-            for (x = init_x; x < width; x++)
-                dst[x + y_stride] = av_clip_pixel(src[x + y_stride] + offset_val);
-            height--;
-        }
-    }
-
-    {
-        // Restore pixels that can't be modified
-        int save_upper_right = !diag_edge && sao_eo_class == SAO_EO_45D && !borders[1];
-        if(vert_edge && sao_eo_class != SAO_EO_VERT)
-            for(y = init_y+save_upper_right; y< height; y++)
-                dst[y*stride+width-1] = src[y*stride+width-1];
-        if(horiz_edge && sao_eo_class != SAO_EO_HORIZ)
-            for(x = init_x; x<width-save_upper_right; x++)
-                dst[x] = src[x];
-        if(diag_edge && sao_eo_class == SAO_EO_45D)
-            dst[width-1] = src[width-1];
-    }
-}
+#undef CMP
+#undef SET
+#undef SCALE
+#undef ADD_AND_SCALE
 
-static void FUNC(sao_edge_filter_3)(uint8_t *_dst, uint8_t *_src,
-                                    ptrdiff_t stride, SAOParams *sao,
-                                    int *borders, int _width, int _height,
-                                    int c_idx, uint8_t vert_edge,
-                                    uint8_t horiz_edge, uint8_t diag_edge)
+static uint32_t FUNC(picture_checksum)(const uint8_t *_src, ptrdiff_t _stride,
+                                       int width, int height)
 {
+    const pixel *src = (const pixel *)_src;
+    ptrdiff_t stride = _stride / sizeof(pixel);
+    uint32_t sum = 0;
     int x, y;
-    pixel *dst = (pixel *)_dst;
-    pixel *src = (pixel *)_src;
-    int chroma = !!c_idx;
-    int sao_eo_class    = sao->eo_class[c_idx];
-    int init_x = 0, init_y = 0, width = _width, height = _height;
-
-    stride /= sizeof(pixel);
 
-    init_y = -(4 >> chroma) - 2;
-    init_x = -(8 >> chroma) - 2;
-    width  =  (8 >> chroma) + 2;
-    height =  (4 >> chroma) + 2;
-
-
-    dst    = dst + (init_y * stride + init_x);
-    src    = src + (init_y * stride + init_x);
-    init_y = init_x = 0;
-
-    FUNC(sao_edge_filter)((uint8_t *)dst, (uint8_t *)src, stride, sao, width, height, c_idx, init_x, init_y);
-
-    {
-        // Restore pixels that can't be modified
-        int save_lower_right = !diag_edge && sao_eo_class == SAO_EO_135D;
-        if(vert_edge && sao_eo_class != SAO_EO_VERT)
-            for(y = init_y; y< height-save_lower_right; y++)
-                dst[y*stride+width-1] = src[y*stride+width-1];
-        if(horiz_edge && sao_eo_class != SAO_EO_HORIZ)
-            for(x = init_x; x<width-save_lower_right; x++)
-                dst[(height-1)*stride+x] = src[(height-1)*stride+x];
-        if(diag_edge && sao_eo_class == SAO_EO_135D)
-            dst[stride*(height-1)+width-1] = src[stride*(height-1)+width-1];
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            int mask = (x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8);
+            sum += (src[x] & 0xff) ^ mask;
+#if BIT_DEPTH > 8
+            sum += (src[x] >> 8) ^ mask;
+#endif
+        }
+        src += stride;
     }
+    return sum;
 }
 
-#undef CMP
-#undef SET
-#undef SCALE
-#undef ADD_AND_SCALE
-
 #define QPEL_FILTER_1(src, stride)      \
     (1 * -src[x - 3 * stride] +         \
      4 *  src[x - 2 * stride] -         \
@@ -1018,24 +748,18 @@ static void FUNC(put_weighted_pred_avg)(uint8_t *_dst, ptrdiff_t _dststride,
     }
 }
 
-static void FUNC(weighted_pred)(uint8_t denom, int16_t wlxFlag, int16_t olxFlag,
+static void FUNC(weighted_pred)(const HEVCWeight *wp,
                                 uint8_t *_dst, ptrdiff_t _dststride,
                                 int16_t *src, ptrdiff_t srcstride,
                                 int width, int height)
 {
-    int shift, wx, ox, x, y, offset;
+    int x, y;
     pixel *dst          = (pixel *)_dst;
     ptrdiff_t dststride = _dststride / sizeof(pixel);
-
-    shift  = denom + 14 - BIT_DEPTH;
-    if (shift >= 1) {
-        offset = 1 << (shift - 1);
-    } else {
-        shift  = 0;
-        offset = 0;
-    }
-    wx     = wlxFlag;
-    ox     = olxFlag * (1 << (BIT_DEPTH - 8));
+    int shift           = wp->shift;
+    int offset          = wp->round;
+    int wx              = wp->weight;
+    int ox              = wp->offset;
 
     for (y = 0; y < height; y++) {
         for (x = 0; x < width; x++) {
@@ -1046,35 +770,277 @@ static void FUNC(weighted_pred)(uint8_t denom, int16_t wlxFlag, int16_t olxFlag,
     }
 }
 
-static void FUNC(weighted_pred_avg)(uint8_t denom,
-                                    int16_t wl0Flag, int16_t wl1Flag,
-                                    int16_t ol0Flag, int16_t ol1Flag,
+static void FUNC(weighted_pred_avg)(const HEVCWeight *wp0, const HEVCWeight *wp1,
                                     uint8_t *_dst, ptrdiff_t _dststride,
                                     int16_t *src1, int16_t *src2,
                                     ptrdiff_t srcstride,
                                     int width, int height)
 {
-    int shift, log2Wd, w0, w1, o0, o1, x, y;
-    pixel *dst = (pixel *)_dst;
+    int x, y;
+    pixel *dst          = (pixel *)_dst;
     ptrdiff_t dststride = _dststride / sizeof(pixel);
-
-    shift  = 14 - BIT_DEPTH;
-    log2Wd = denom + shift;
-    w0     = wl0Flag;
-    w1     = wl1Flag;
-    o0     = ol0Flag * (1 << (BIT_DEPTH - 8));
-    o1     = ol1Flag * (1 << (BIT_DEPTH - 8));
+    int log2Wd          = wp0->shift;
+    int w0              = wp0->weight;
+    int w1              = wp1->weight;
+    int offset          = (wp0->offset + wp1->offset + 1) << log2Wd;
 
     for (y = 0; y < height; y++) {
         for (x = 0; x < width; x++)
             dst[x] = av_clip_pixel((src1[x] * w0 + src2[x] * w1 +
-                                    ((o0 + o1 + 1) << log2Wd)) >> (log2Wd + 1));
+                                    offset) >> (log2Wd + 1));
         dst  += dststride;
         src1 += srcstride;
         src2 += srcstride;
     }
 }
 
+/* Fused interpolation and rounding to pixels: the uni variants replace
+ * put_hevc_qpel/epel followed by put_unweighted_pred, the bi variants
+ * interpolate the second list and average it with the first one (src2) as
+ * put_weighted_pred_avg would. Only the hv case still goes through a
+ * temporary array, for the horizontal pass. */
+#define QPEL_FILTER(src, stride, f)                                            \
+    ((f) == 1 ? QPEL_FILTER_1(src, stride) :                                   \
+     (f) == 2 ? QPEL_FILTER_2(src, stride) : QPEL_FILTER_3(src, stride))
+
+static av_always_inline void FUNC(put_hevc_qpel_fused)(uint8_t *_dst, ptrdiff_t _dststride,
+                                                      uint8_t *_src, ptrdiff_t _srcstride,
+                                                      int16_t *src2, ptrdiff_t src2stride,
+                                                      int width, int height,
+                                                      int mx, int my, int bi)
+{
+    int x, y;
+    pixel *src          = (pixel *)_src;
+    ptrdiff_t srcstride = _srcstride / sizeof(pixel);
+    pixel *dst          = (pixel *)_dst;
+    ptrdiff_t dststride = _dststride / sizeof(pixel);
+    int16_t tmp_array[(MAX_PB_SIZE + 7) * MAX_PB_SIZE];
+    int16_t *tmp        = tmp_array;
+    int shift           = 14 - BIT_DEPTH + bi;
+    int offset          = 1 << (shift - 1);
+
+    if (mx && my) {
+        src -= ff_hevc_qpel_extra_before[my] * srcstride;
+        for (y = 0; y < height + ff_hevc_qpel_extra[my]; y++) {
+            for (x = 0; x < width; x++)
+                tmp[x] = QPEL_FILTER(src, 1, mx) >> (BIT_DEPTH - 8);
+            src += srcstride;
+            tmp += MAX_PB_SIZE;
+        }
+        tmp = tmp_array + ff_hevc_qpel_extra_before[my] * MAX_PB_SIZE;
+    }
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            int val;
+            if (mx && my)
+                val = QPEL_FILTER(tmp, MAX_PB_SIZE, my) >> 6;
+            else if (mx)
+                val = QPEL_FILTER(src, 1, mx) >> (BIT_DEPTH - 8);
+            else if (my)
+                val = QPEL_FILTER(src, srcstride, my) >> (BIT_DEPTH - 8);
+            else
+                val = src[x] << (14 - BIT_DEPTH);
+            if (bi)
+                val += src2[x];
+            dst[x] = av_clip_pixel((val + offset) >> shift);
+        }
+        src  += srcstride;
+        tmp  += MAX_PB_SIZE;
+        dst  += dststride;
+        src2 += src2stride;
+    }
+}
+
+#define PUT_HEVC_QPEL_FUSED(V, H)                                              \
+static void FUNC(put_hevc_qpel_uni_h ## H ## v ## V)(uint8_t *dst,             \
+                                                    ptrdiff_t dststride,       \
+                                                    uint8_t *src,              \
+                                                    ptrdiff_t srcstride,       \
+                                                    int width, int height)     \
+{                                                                              \
+    FUNC(put_hevc_qpel_fused)(dst, dststride, src, srcstride, NULL, 0,         \
+                              width, height, H, V, 0);                         \
+}                                                                              \
+static void FUNC(put_hevc_qpel_bi_h ## H ## v ## V)(uint8_t *dst,              \
+                                                   ptrdiff_t dststride,        \
+                                                   uint8_t *src,               \
+                                                   ptrdiff_t srcstride,        \
+                                                   int16_t *src2,              \
+                                                   ptrdiff_t src2stride,       \
+                                                   int width, int height)      \
+{                                                                              \
+    FUNC(put_hevc_qpel_fused)(dst, dststride, src, srcstride, src2, src2stride,\
+                              width, height, H, V, 1);                         \
+}
+
+PUT_HEVC_QPEL_FUSED(0, 0)
+PUT_HEVC_QPEL_FUSED(0, 1)
+PUT_HEVC_QPEL_FUSED(0, 2)
+PUT_HEVC_QPEL_FUSED(0, 3)
+PUT_HEVC_QPEL_FUSED(1, 0)
+PUT_HEVC_QPEL_FUSED(1, 1)
+PUT_HEVC_QPEL_FUSED(1, 2)
+PUT_HEVC_QPEL_FUSED(1, 3)
+PUT_HEVC_QPEL_FUSED(2, 0)
+PUT_HEVC_QPEL_FUSED(2, 1)
+PUT_HEVC_QPEL_FUSED(2, 2)
+PUT_HEVC_QPEL_FUSED(2, 3)
+PUT_HEVC_QPEL_FUSED(3, 0)
+PUT_HEVC_QPEL_FUSED(3, 1)
+PUT_HEVC_QPEL_FUSED(3, 2)
+PUT_HEVC_QPEL_FUSED(3, 3)
+
+/* With dst16 set, the interpolated samples are stored at their intermediate
+ * precision instead, as put_hevc_epel does, and _dststride is in int16 units. */
+static av_always_inline void FUNC(put_hevc_epel_fused)(uint8_t *_dst, int16_t *dst16,
+                                                      ptrdiff_t _dststride,
+                                                      uint8_t *_src, ptrdiff_t _srcstride,
+                                                      int16_t *src2, ptrdiff_t src2stride,
+                                                      int width, int height,
+                                                      int mx, int my,
+                                                      int hfilter, int vfilter, int bi)
+{
+    int x, y;
+    pixel *src          = (pixel *)_src;
+    ptrdiff_t srcstride = _srcstride / sizeof(pixel);
+    pixel *dst          = (pixel *)_dst;
+    ptrdiff_t dststride = dst16 ? _dststride : _dststride / sizeof(pixel);
+    const int8_t *fh    = ff_hevc_epel_filters[FFMAX(mx, 1) - 1];
+    const int8_t *fv    = ff_hevc_epel_filters[FFMAX(my, 1) - 1];
+    int16_t tmp_array[(MAX_PB_SIZE + 3) * MAX_PB_SIZE];
+    int16_t *tmp        = tmp_array;
+    int shift           = 14 - BIT_DEPTH + bi;
+    int offset          = 1 << (shift - 1);
+
+#define EPEL_TAPS(src, stride, f)                                              \
+    (f[0] * src[x - stride] + f[1] * src[x] +                                  \
+     f[2] * src[x + stride] + f[3] * src[x + 2 * stride])
+
+    if (hfilter && vfilter) {
+        src -= EPEL_EXTRA_BEFORE * srcstride;
+        for (y = 0; y < height + EPEL_EXTRA; y++) {
+            for (x = 0; x < width; x++)
+                tmp[x] = EPEL_TAPS(src, 1, fh) >> (BIT_DEPTH - 8);
+            src += srcstride;
+            tmp += MAX_PB_SIZE;
+        }
+        tmp = tmp_array + EPEL_EXTRA_BEFORE * MAX_PB_SIZE;
+    }
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x++) {
+            int val;
+            if (hfilter && vfilter)
+                val = EPEL_TAPS(tmp, MAX_PB_SIZE, fv) >> 6;
+            else if (hfilter)
+                val = EPEL_TAPS(src, 1, fh) >> (BIT_DEPTH - 8);
+            else if (vfilter)
+                val = EPEL_TAPS(src, srcstride, fv) >> (BIT_DEPTH - 8);
+            else
+                val = src[x] << (14 - BIT_DEPTH);
+            if (dst16) {
+                dst16[x] = val;
+                continue;
+            }
+            if (bi)
+                val += src2[x];
+            dst[x] = av_clip_pixel((val + offset) >> shift);
+        }
+        src  += srcstride;
+        tmp  += MAX_PB_SIZE;
+        if (dst16)
+            dst16 += dststride;
+        else
+            dst   += dststride;
+        src2 += src2stride;
+    }
+#undef EPEL_TAPS
+}
+
+#define PUT_HEVC_EPEL_FUSED(V, H)                                              \
+static void FUNC(put_hevc_epel_uni_h ## H ## v ## V)(uint8_t *dst,             \
+                                                    ptrdiff_t dststride,       \
+                                                    uint8_t *src,              \
+                                                    ptrdiff_t srcstride,       \
+                                                    int width, int height,     \
+                                                    int mx, int my)            \
+{                                                                              \
+    FUNC(put_hevc_epel_fused)(dst, NULL, dststride, src, srcstride, NULL, 0,   \
+                              width, height, mx, my, H, V, 0);                 \
+}                                                                              \
+static void FUNC(put_hevc_epel_bi_h ## H ## v ## V)(uint8_t *dst,              \
+                                                   ptrdiff_t dststride,        \
+                                                   uint8_t *src,               \
+                                                   ptrdiff_t srcstride,        \
+                                                   int16_t *src2,              \
+                                                   ptrdiff_t src2stride,       \
+                                                   int width, int height,      \
+                                                   int mx, int my)             \
+{                                                                              \
+    FUNC(put_hevc_epel_fused)(dst, NULL, dststride, src, srcstride,            \
+                              src2, src2stride, width, height, mx, my, H, V, 1);\
+}
+
+PUT_HEVC_EPEL_FUSED(0, 0)
+PUT_HEVC_EPEL_FUSED(0, 1)
+PUT_HEVC_EPEL_FUSED(1, 0)
+PUT_HEVC_EPEL_FUSED(1, 1)
+
+/* Joint Cb/Cr chroma MC: both planes share the motion vector, the block size
+ * and the strides. */
+#define PUT_HEVC_EPEL_UV(V, H)                                                 \
+static void FUNC(put_hevc_epel_uv_h ## H ## v ## V)(int16_t *dst1,             \
+                                                   int16_t *dst2,              \
+                                                   ptrdiff_t dststride,        \
+                                                   uint8_t *src1,              \
+                                                   uint8_t *src2,              \
+                                                   ptrdiff_t srcstride,        \
+                                                   int width, int height,      \
+                                                   int mx, int my)             \
+{                                                                              \
+    FUNC(put_hevc_epel_fused)(NULL, dst1, dststride, src1, srcstride, NULL, 0, \
+                              width, height, mx, my, H, V, 0);                 \
+    FUNC(put_hevc_epel_fused)(NULL, dst2, dststride, src2, srcstride, NULL, 0, \
+                              width, height, mx, my, H, V, 0);                 \
+}                                                                              \
+static void FUNC(put_hevc_epel_uni_uv_h ## H ## v ## V)(uint8_t *dst1,         \
+                                                       uint8_t *dst2,          \
+                                                       ptrdiff_t dststride,    \
+                                                       uint8_t *src1,          \
+                                                       uint8_t *src2,          \
+                                                       ptrdiff_t srcstride,    \
+                                                       int width, int height,  \
+                                                       int mx, int my)         \
+{                                                                              \
+    FUNC(put_hevc_epel_fused)(dst1, NULL, dststride, src1, srcstride, NULL, 0, \
+                              width, height, mx, my, H, V, 0);                 \
+    FUNC(put_hevc_epel_fused)(dst2, NULL, dststride, src2, srcstride, NULL, 0, \
+                              width, height, mx, my, H, V, 0);                 \
+}                                                                              \
+static void FUNC(put_hevc_epel_bi_uv_h ## H ## v ## V)(uint8_t *dst1,          \
+                                                      uint8_t *dst2,           \
+                                                      ptrdiff_t dststride,     \
+                                                      uint8_t *src1,           \
+                                                      uint8_t *src2,           \
+                                                      ptrdiff_t srcstride,     \
+                                                      int16_t *src21,          \
+                                                      int16_t *src22,          \
+                                                      ptrdiff_t src2stride,    \
+                                                      int width, int height,   \
+                                                      int mx, int my)          \
+{                                                                              \
+    FUNC(put_hevc_epel_fused)(dst1, NULL, dststride, src1, srcstride,          \
+                              src21, src2stride, width, height, mx, my, H, V, 1);\
+    FUNC(put_hevc_epel_fused)(dst2, NULL, dststride, src2, srcstride,          \
+                              src22, src2stride, width, height, mx, my, H, V, 1);\
+}
+
+PUT_HEVC_EPEL_UV(0, 0)
+PUT_HEVC_EPEL_UV(0, 1)
+PUT_HEVC_EPEL_UV(1, 0)
+PUT_HEVC_EPEL_UV(1, 1)
+
 // line zero
 #define P3 pix[-4 * xstride]
 #define P2 pix[-3 * xstride]
@@ -1272,329 +1238,89 @@ static void FUNC(hevc_v_loop_filter_luma)(uint8_t *pix, ptrdiff_t stride,
 #undef TQ2
 #undef TQ3
 
-#ifdef SVC_EXTENSION
-#define LumHor_FILTER(pel, coeff) \
-(pel[0]*coeff[0] + pel[1]*coeff[1] + pel[2]*coeff[2] + coeff[3]*pel[3] + pel[4]*coeff[4] + pel[5]*coeff[5] + pel[6]*coeff[6] + pel[7]*coeff[7])
-
-#define CroHor_FILTER(pel, coeff) \
-(pel[0]*coeff[0] + pel[1]*coeff[1] + pel[2]*coeff[2] + pel[3]*coeff[3])
-
-#define LumVer_FILTER(pel, coeff) \
-(pel[0]*coeff[0] + pel[1]*coeff[1] + pel[2]*coeff[2] + pel[3]*coeff[3] + pel[4]*coeff[4] + pel[5]*coeff[5] + pel[6]*coeff[6] + pel[7]*coeff[7])
-
-#define CroVer_FILTER(pel, coeff) \
-(pel[0]*coeff[0] + pel[1]*coeff[1] + pel[2]*coeff[2] + pel[3]*coeff[3])
-
-#define LumVer_FILTER1(pel, coeff, width) \
-(pel[0]*coeff[0] + pel[width]*coeff[1] + pel[width*2]*coeff[2] + pel[width*3]*coeff[3] + pel[width*4]*coeff[4] + pel[width*5]*coeff[5] + pel[width*6]*coeff[6] + pel[width*7]*coeff[7])
-// Define the function for up-sampling
-#define CroVer_FILTER1(pel, coeff, widthEL) \
-(pel[0]*coeff[0] + pel[widthEL]*coeff[1] + pel[widthEL*2]*coeff[2] + pel[widthEL*3]*coeff[3])
-
-static void FUNC(upsample_h_base_layer_frame)(struct AVFrame *FrameEL, struct AVFrame *FrameBL, short *Buffer[3], const int32_t enabled_up_sample_filter_luma[16][8], const int32_t enabled_up_sample_filter_chroma[16][4], struct HEVCWindow *Enhscal, struct UpsamplInf *up_info, int channel){
-    return;
-}
-
-static void FUNC(upsample_v_base_layer_frame)(struct AVFrame *FrameEL, struct AVFrame *FrameBL, short *Buffer[3], const int32_t enabled_up_sample_filter_luma[16][8], const int32_t enabled_up_sample_filter_chroma[16][4], struct HEVCWindow *Enhscal, struct UpsamplInf *up_info, int channel) {
-    return;
+static void FUNC(upsample_h_base_layer_rows)(int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                             const uint8_t *_src, ptrdiff_t _src_stride,
+                                             int bl_width, int el_width,
+                                             const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                             const int32_t up_sample_filter_luma[16][8],
+                                             const int32_t up_sample_filter_chroma[16][4],
+                                             int c_idx, int x0, int x1, int y0, int y1)
+{
+    const pixel *src     = (const pixel *)_src;
+    ptrdiff_t src_stride = _src_stride / sizeof(pixel);
+    int shift = !!c_idx;
+    int ntaps = c_idx ? NTAPS_CHROMA : NTAPS_LUMA;
+    int scale = c_idx ? up_info->scaleXCr : up_info->scaleXLum;
+    int add   = c_idx ? up_info->addXCr   : up_info->addXLum;
+    int left  = win->left_offset >> shift;
+    // the luma position is clipped to the right end of the window included
+    int right = el_width - (win->right_offset >> shift) - shift;
+    int x, y, k;
+
+    for (y = y0; y < y1; y++) {
+        const pixel *s = src + y * src_stride;
+        int16_t *dst   = stripe + (y % stripe_rows) * stripe_stride;
+
+        for (x = x0; x < x1; x++) {
+            int pos16 = ((av_clip(x, left, right) - left) * scale + add) >> 12;
+            int ref   = (pos16 >> 4) - (ntaps >> 1) + 1;
+            const int32_t *coeff = c_idx ? up_sample_filter_chroma[pos16 & 15] :
+                                           up_sample_filter_luma[pos16 & 15];
+            int sum = 0;
+
+            if (ref >= 0 && ref + ntaps <= bl_width) {
+                for (k = 0; k < ntaps; k++)
+                    sum += s[ref + k] * coeff[k];
+            } else {
+                for (k = 0; k < ntaps; k++)
+                    sum += s[av_clip(ref + k, 0, bl_width - 1)] * coeff[k];
+            }
+            // keeps the intermediate within 16 bits above 8 bits per sample
+            dst[x] = sum >> (BIT_DEPTH - 8);
+        }
+    }
 }
 
-static void FUNC(upsample_base_layer_frame)(struct AVFrame *FrameEL, struct AVFrame *FrameBL, short *Buffer[3], const int32_t enabled_up_sample_filter_luma[16][8], const int32_t enabled_up_sample_filter_chroma[16][4], struct HEVCWindow *Enhscal, struct UpsamplInf *up_info, int channel)
+static void FUNC(upsample_v_base_layer_rows)(uint8_t *_dst, ptrdiff_t _dst_stride,
+                                             const int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                             int bl_height, int el_width, int el_height,
+                                             const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                             const int32_t up_sample_filter_luma[16][8],
+                                             const int32_t up_sample_filter_chroma[16][4],
+                                             int c_idx, int x0, int x1, int y0, int y1)
 {
-    int i,j, k;
-    
-    int widthBL =  FrameBL->width;
-    int heightBL = FrameBL->height;
-    int strideBL = FrameBL->linesize[0];
-    int widthEL =  FrameEL->width - Enhscal->left_offset - Enhscal->right_offset;
-    int heightEL = FrameEL->height - Enhscal->top_offset - Enhscal->bottom_offset;
-    int strideEL = FrameEL->linesize[0];
-    
-    pixel *srcBufY = (pixel*)FrameBL->data[0];
-    pixel *dstBufY = (pixel*)FrameEL->data[0];
-    short *tempBufY = Buffer[0];
-    pixel *srcY;
-    pixel *dstY;
-    short *dstY1;
-    short *srcY1;
-    pixel *srcBufU = (pixel*)FrameBL->data[1];
-    pixel *dstBufU = (pixel*)FrameEL->data[1];
-    short *tempBufU = Buffer[1];
-    pixel *srcU;
-    pixel *dstU;
-    short *dstU1;
-    short *srcU1;
-    
-    pixel *srcBufV = (pixel*)FrameBL->data[2];
-    pixel *dstBufV = (pixel*)FrameEL->data[2];
-    short *tempBufV = Buffer[2];
-    pixel *srcV;
-    pixel *dstV;
-    short *dstV1;
-    short *srcV1;
-    
-    int refPos16 = 0;
-    int phase    = 0;
-    int refPos   = 0;
-    const int32_t* coeff;
-    widthEL   = FrameEL->width;  //pcUsPic->getWidth ();
-    heightEL  = FrameEL->height; //pcUsPic->getHeight();
-    
-    widthBL   = FrameBL->width;
-    heightBL  = FrameBL->height <= heightEL ? FrameBL->height:heightEL;  // min( FrameBL->height, heightEL);
-    int leftStartL = Enhscal->left_offset;
-    int rightEndL  = FrameEL->width - Enhscal->right_offset;
-    int topStartL  = Enhscal->top_offset;
-    int bottomEndL = FrameEL->height - Enhscal->bottom_offset;
-    
-    pixel buffer[8];
-    for( i = 0; i < widthEL; i++ )	{
-    	int x = av_clip_c(i, leftStartL, rightEndL);
-        refPos16 = (((x - leftStartL)*up_info->scaleXLum + up_info->addXLum) >> 12);
-        phase    = refPos16 & 15;
-        refPos   = refPos16 >> 4;
-        coeff = enabled_up_sample_filter_luma[phase];
-        refPos -= ((NTAPS_LUMA>>1) - 1);
-        srcY = srcBufY + refPos;
-        dstY1 = tempBufY + i;
-        if(refPos < 0)
-            for( j = 0; j < heightBL ; j++ )	{
-                
-        		memset(buffer, srcY[-refPos], -refPos);
-                memcpy(buffer-refPos, srcY-refPos, 8+refPos);
-                *dstY1 = LumHor_FILTER(buffer, coeff);
-                
-                srcY += strideBL;
-                dstY1 += widthEL;//strideEL;
-            }else if(refPos+8 > widthBL )
-                for( j = 0; j < heightBL ; j++ )	{
-                    
-            		memcpy(buffer, srcY, widthBL-refPos);
-                    memset(buffer+(widthBL-refPos), srcY[widthBL-refPos-1], 8-(widthBL-refPos));
-                    *dstY1 = LumHor_FILTER(buffer, coeff);
-                    
-                    srcY += strideBL;
-                    dstY1 += widthEL;//strideEL;
-                }else
-                    for( j = 0; j < heightBL ; j++ )	{
-                        
-                        *dstY1 = LumHor_FILTER(srcY, coeff);
-                        srcY += strideBL;
-                        dstY1 += widthEL;//strideEL;
-                    }
-        
-    }
-    const int nShift = US_FILTER_PREC*2;
-    int iOffset = 1 << (nShift - 1);
-    short buffer1[8];
-    for( j = 0; j < heightEL; j++ )	{
-    	int y = av_clip_c(j, topStartL, bottomEndL-1);
-    	refPos16 = ((( y - topStartL )*up_info->scaleYLum + up_info->addYLum) >> 12);
-        phase    = refPos16 & 15;
-        refPos   = refPos16 >> 4;
-        coeff = enabled_up_sample_filter_luma[phase];
-        refPos -= ((NTAPS_LUMA>>1) - 1);
-        srcY1 = tempBufY + refPos *widthEL;
-        dstY = dstBufY + j * strideEL;
-        if(refPos < 0)
-            for( i = 0; i < widthEL; i++ )	{
-                
-        		for(k= 0; k<-refPos ; k++)
-        			buffer1[k] = srcY1[-refPos*widthEL]; //srcY1[(-refPos+k)*strideEL];
-                for(k= 0; k<8+refPos ; k++)
-                	buffer1[-refPos+k] = srcY1[(-refPos+k)*widthEL];
-                *dstY = av_clip_pixel( (LumVer_FILTER(buffer1, coeff) + iOffset) >> (nShift));
-                
-                if( (i >= leftStartL) && (i <= rightEndL-2) )
-                    srcY1++;
-                dstY++;
-            }else if(refPos+8 > heightBL )
-                for( i = 0; i < widthEL; i++ )	{
-                    
-                    for(k= 0; k<heightBL-refPos ; k++)
-                        buffer1[k] = srcY1[k*widthEL];
-                    for(k= 0; k<8-(heightBL-refPos) ; k++)
-                        buffer1[heightBL-refPos+k] = srcY1[(heightBL-refPos-1)*widthEL];
-                    *dstY = av_clip_pixel( (LumVer_FILTER(buffer1, coeff) + iOffset) >> (nShift));
-                    
-                    if( (i >= leftStartL) && (i <= rightEndL-2) )
-                        srcY1++;
-                    dstY++;
-                }else
-                    for( i = 0; i < widthEL; i++ )	{
-                        
-                        *dstY = av_clip_pixel( (LumVer_FILTER1(srcY1, coeff, widthEL) + iOffset) >> (nShift));
-                        
-                        if( (i >= leftStartL) && (i <= rightEndL-2) )
-                            srcY1++;
-                        dstY++;
-                    }
-    }
-    widthBL   = FrameBL->width;
-    heightBL  = FrameBL->height;
-    
-    widthEL   = FrameEL->width - Enhscal->right_offset - Enhscal->left_offset;
-    heightEL  = FrameEL->height - Enhscal->top_offset - Enhscal->bottom_offset;
-    
-    widthEL  >>= 1;
-    heightEL >>= 1;
-    widthBL  >>= 1;
-    heightBL >>= 1;
-    strideBL  = FrameBL->linesize[1];
-    strideEL  = FrameEL->linesize[1];
-    int leftStartC = Enhscal->left_offset>>1;
-    int rightEndC  = (FrameEL->width>>1) - (Enhscal->right_offset>>1);
-    int topStartC  = Enhscal->top_offset>>1;
-    int bottomEndC = (FrameEL->height>>1) - (Enhscal->bottom_offset>>1);
-    
-    
-    widthEL   = FrameEL->width >> 1;
-    heightEL  = FrameEL->height >> 1;
-    widthBL   = FrameBL->width >> 1;
-    heightBL  = FrameBL->height > heightEL ? FrameBL->height:heightEL;
-    
-    
-    heightBL >>= 1;
-    
-    //========== horizontal upsampling ===========
-    for( i = 0; i < widthEL; i++ )	{
-    	int x = av_clip_c(i, leftStartC, rightEndC - 1);
-        refPos16 = (((x - leftStartC)*up_info->scaleXCr + up_info->addXCr) >> 12);
-        phase    = refPos16 & 15;
-        refPos   = refPos16 >> 4;
-        coeff = enabled_up_sample_filter_chroma[phase];
-        
-        refPos -= ((NTAPS_CHROMA>>1) - 1);
-        srcU = srcBufU + refPos; // -((NTAPS_CHROMA>>1) - 1);
-        srcV = srcBufV + refPos; // -((NTAPS_CHROMA>>1) - 1);
-        dstU1 = tempBufU + i;
-        dstV1 = tempBufV + i;
-        
-        if(refPos < 0)
-            for( j = 0; j < heightBL ; j++ )	{
-                
-        		memset(buffer, srcU[-refPos], -refPos);
-                memcpy(buffer-refPos, srcU-refPos, 4+refPos);
-                memset(buffer+4, srcV[-refPos], -refPos);
-                memcpy(buffer-refPos+4, srcV-refPos, 4+refPos);
-                
-                *dstU1 = CroHor_FILTER(buffer, coeff);
-                
-                *dstV1 = CroHor_FILTER((buffer+4), coeff);
-                
-                
-                srcU += strideBL;
-                srcV += strideBL;
-                dstU1 += widthEL;
-                dstV1 += widthEL;
-        	}else if(refPos+4 > widthBL )
-                for( j = 0; j < heightBL ; j++ )	{
-                    
-                    memcpy(buffer, srcU, widthBL-refPos);
-                    memset(buffer+(widthBL-refPos), srcU[widthBL-refPos-1], 4-(widthBL-refPos));
-                    
-                    memcpy(buffer+4, srcV, widthBL-refPos);
-                    memset(buffer+(widthBL-refPos)+4, srcV[widthBL-refPos-1], 4-(widthBL-refPos));
-                    
-                    *dstU1 = CroHor_FILTER(buffer, coeff);
-                    
-                    *dstV1 = CroHor_FILTER((buffer+4), coeff);
-                    
-                	srcU += strideBL;
-                    srcV += strideBL;
-                    dstU1 += widthEL;
-                    dstV1 += widthEL;
-                }else
-                    for( j = 0; j < heightBL ; j++ )	{
-                        
-                		*dstU1 = CroHor_FILTER(srcU, coeff);
-                        
-                		*dstV1 = CroHor_FILTER(srcV, coeff);
-                        
-                        
-                        srcU += strideBL;
-                        srcV += strideBL;
-                        dstU1 += widthEL;
-                        dstV1 += widthEL;
-                	}
-    }
-    
-    
-    for( j = 0; j < heightEL; j++ )	{
-        int y = av_clip_c(j, topStartC, bottomEndC - 1);
-        refPos16 = (((y - topStartC)*up_info->scaleYCr + up_info->addYCr) >> 12) - 4;
-        phase    = refPos16 & 15;
-        refPos   = refPos16 >> 4;
-        coeff = enabled_up_sample_filter_chroma[phase];
-        refPos -= ((NTAPS_CHROMA>>1) - 1);
-        srcU1 = tempBufU  + refPos *widthEL;
-        srcV1 = tempBufV  + refPos *widthEL;
-        dstU = dstBufU + j*strideEL;
-        dstV = dstBufV + j*strideEL;
-        if(refPos < 0)
-            for( i = 0; i < widthEL; i++ )	{
-                
-                for(k= 0; k<-refPos ; k++){
-                    buffer1[k] = srcU1[(-refPos)*widthEL];
-                    buffer1[k+4] = srcV1[(-refPos)*widthEL];
-                }
-                for(k= 0; k<4+refPos ; k++){
-                    buffer1[-refPos+k] = srcU1[(-refPos+k)*widthEL];
-                    buffer1[-refPos+k+4] = srcV1[(-refPos+k)*widthEL];
-                }
-                *dstU = av_clip_pixel( (CroVer_FILTER(buffer1, coeff) + iOffset) >> (nShift));
-                *dstV = av_clip_pixel( (CroVer_FILTER((buffer1+4), coeff) + iOffset) >> (nShift));
-                
-                if( (i >= leftStartC) && (i <= rightEndC-2) )	{
-                    srcU1++;
-                    srcV1++;
-                }
-                dstU++;
-                dstV++;
-            }else if(refPos+4 > heightBL )
-                for( i = 0; i < widthEL; i++ )	{
-                    
-                    for(k= 0; k< heightBL-refPos ; k++) {
-                        buffer1[k] = srcU1[k*widthEL];
-                        buffer1[k+4] = srcV1[k*widthEL];
-                    }
-                    for(k= 0; k<4-(heightBL-refPos) ; k++) {
-                        buffer1[heightBL-refPos+k] = srcU1[(heightBL-refPos-1)*widthEL];
-                        buffer1[heightBL-refPos+k+4] = srcV1[(heightBL-refPos-1)*widthEL];
-                    }
-                    *dstU = av_clip_pixel( (CroVer_FILTER(buffer1, coeff) + iOffset) >> (nShift));
-                    
-                    
-                    *dstV = av_clip_pixel( (CroVer_FILTER((buffer1+4), coeff) + iOffset) >> (nShift));
-                    
-                    if( (i >= leftStartC) && (i <= rightEndC-2) )	{
-                        srcU1++;
-                        srcV1++;
-                    }
-                    dstU++;
-                    dstV++;
-                }else
-                    for( i = 0; i < widthEL; i++ )	{
-                        *dstU = av_clip_pixel( (CroVer_FILTER1(srcU1, coeff, widthEL) + iOffset) >> (nShift));
-                        
-                        
-                        *dstV = av_clip_pixel( (CroVer_FILTER1(srcV1, coeff, widthEL) + iOffset) >> (nShift));
-                        
-                        if( (i >= leftStartC) && (i <= rightEndC-2) )	{
-                            srcU1++;
-                            srcV1++;
-                        }
-                        dstU++;
-                        dstV++;
-                    }
+    pixel *dst           = (pixel *)_dst;
+    ptrdiff_t dst_stride = _dst_stride / sizeof(pixel);
+    const int nshift     = US_FILTER_PREC * 2 - (BIT_DEPTH - 8);
+    const int offset     = 1 << (nshift - 1);
+    int shift = !!c_idx;
+    int ntaps = c_idx ? NTAPS_CHROMA : NTAPS_LUMA;
+    int left  = win->left_offset >> shift;
+    int right = el_width - (win->right_offset >> shift);
+    const int16_t *src[NTAPS_LUMA];
+    int x, y, k;
+
+    for (y = y0; y < y1; y++) {
+        int pos16 = ff_hevc_il_ref_pos16_y(win, up_info, c_idx, el_height, y);
+        int ref   = (pos16 >> 4) - (ntaps >> 1) + 1;
+        const int32_t *coeff = c_idx ? up_sample_filter_chroma[pos16 & 15] :
+                                       up_sample_filter_luma[pos16 & 15];
+        pixel *d = dst + y * dst_stride;
+
+        for (k = 0; k < ntaps; k++)
+            src[k] = stripe + (av_clip(ref + k, 0, bl_height - 1) % stripe_rows) * stripe_stride;
+
+        for (x = x0; x < x1; x++) {
+            // the columns left and right of the window repeat its edges
+            int col = av_clip(x - left, 0, right - 1 - left);
+            int sum = 0;
+
+            for (k = 0; k < ntaps; k++)
+                sum += src[k][col] * coeff[k];
+            d[x] = av_clip_pixel((sum + offset) >> nshift);
+        }
     }
 }
 
-#undef LumHor_FILTER
-#undef LumCro_FILTER
-#undef LumVer_FILTER
-#undef CroVer_FILTER
-#endif
-
 
 
@@ -36,7 +36,7 @@
 #include "hevcpred_template.c"
 #undef BIT_DEPTH
 
-void ff_hevc_pred_init(HEVCPredContext *hpc, int bit_depth)
+void ff_hevc_pred_init(HEVCPredContext *hpc, int bit_depth, int cpu_flags)
 {
 #undef FUNC
 #define FUNC(a, depth) a ## _ ## depth
@@ -51,7 +51,9 @@ void ff_hevc_pred_init(HEVCPredContext *hpc, int bit_depth)
     hpc->pred_angular[0] = FUNC(pred_angular_0, depth); \
     hpc->pred_angular[1] = FUNC(pred_angular_1, depth); \
     hpc->pred_angular[2] = FUNC(pred_angular_2, depth); \
-    hpc->pred_angular[3] = FUNC(pred_angular_3, depth);
+    hpc->pred_angular[3] = FUNC(pred_angular_3, depth); \
+    hpc->ref_filter        = FUNC(ref_filter, depth);        \
+    hpc->ref_filter_strong = FUNC(ref_filter_strong, depth);
 
     switch (bit_depth) {
     case 9:
@@ -64,6 +66,6 @@ void ff_hevc_pred_init(HEVCPredContext *hpc, int bit_depth)
         HEVC_PRED(8);
         break;
     }
-    if (ARCH_X86) ff_hevcpred_init_x86(hpc, bit_depth);
+    if (ARCH_X86) ff_hevcpred_init_x86(hpc, bit_depth, cpu_flags);
 
 }
@@ -36,9 +36,20 @@ typedef struct HEVCPredContext {
                    int log2_size, int c_idx);
     void(*pred_angular[4])(uint8_t *src, const uint8_t *top, const uint8_t *left, ptrdiff_t stride,
                          int c_idx, int mode);
+
+    /**
+     * [1 2 1] smoothing of len reference samples; src[-1] is read,
+     * the last sample is copied unfiltered.
+     */
+    void (*ref_filter)(uint8_t *dst, const uint8_t *src, int len);
+    /**
+     * Bilinear interpolation of 64 reference samples between src[-1]
+     * and src[63] (strong intra smoothing); dst may be equal to src.
+     */
+    void (*ref_filter_strong)(uint8_t *dst, const uint8_t *src);
 } HEVCPredContext;
 
-void ff_hevc_pred_init(HEVCPredContext *hpc, int bit_depth);
-void ff_hevcpred_init_x86(HEVCPredContext *c, const int bit_depth);
+void ff_hevc_pred_init(HEVCPredContext *hpc, int bit_depth, int cpu_flags);
+void ff_hevcpred_init_x86(HEVCPredContext *c, const int bit_depth, int mm_flags);
 
 #endif /* AVCODEC_HEVCPRED_H */
@@ -27,6 +27,18 @@
 
 #define POS(x, y) src[(x) + stride * (y)]
 
+/* fill length reference samples with the splatted sample a */
+static av_always_inline void FUNC(extend_ref)(pixel *ptr, pixel4 a, int length)
+{
+#if BIT_DEPTH == 8
+    memset(ptr, a & 0xff, length);
+#else
+    int i;
+    for (i = 0; i < length; i += 4)
+        AV_WN4PA(&ptr[i], a);
+#endif
+}
+
 static void FUNC(intra_pred)(HEVCContext *s, int x0, int y0, int log2_size, int c_idx)
 {
 #define PU(x) \
@@ -40,29 +52,33 @@ static void FUNC(intra_pred)(HEVCContext *s, int x0, int y0, int log2_size, int
 #define MIN_TB_ADDR_ZS(x, y) \
     s->pps->min_tb_addr_zs[(y) * s->sps->min_tb_width + (x)]
 #define EXTEND(ptr, start, length)                                             \
-        for (i = start; i < (start) + (length); i+=4)                          \
-            AV_WN4PA(&(ptr[i]), a)
+        FUNC(extend_ref)(&ptr[start], a, length)
+/* bit n of top_intra / left_intra: reference samples 4n..4n+3 are intra */
+#define TOP_INTRA(i)                                                           \
+    ((top_intra >> ((i) >> 2)) & 1)
+#define LEFT_INTRA(i)                                                          \
+    ((left_intra >> ((i) >> 2)) & 1)
 #define EXTEND_RIGHT_CIP(ptr, start, length)                                   \
         for (i = start; i < (start) + (length); i+=4)                          \
-            if (!IS_INTRA(i, -1))                                              \
+            if (!TOP_INTRA(i))                                                 \
                 AV_WN4PA(&ptr[i], a);                                          \
             else                                                               \
                 a = PIXEL_SPLAT_X4(ptr[i+3])
 #define EXTEND_LEFT_CIP(ptr, start, length)                                    \
         for (i = (start); i > (start) - (length); i-=4)                        \
-            if (!IS_INTRA(i - 3, -1))                                          \
-                AV_WN4PA(&ptr[i-3], a);                                         \
+            if (!TOP_INTRA(i - 3))                                             \
+                AV_WN4PA(&ptr[i-3], a);                                        \
             else                                                               \
                 a = PIXEL_SPLAT_X4(ptr[i-3])
 #define EXTEND_UP_CIP(ptr, start, length)                                      \
         for (i = (start); i > (start) - (length); i-=4)                        \
-            if (!IS_INTRA(-1, i - 3))                                          \
+            if (!LEFT_INTRA(i - 3))                                            \
                 AV_WN4PA(&ptr[i-3], a);                                        \
             else                                                               \
                 a = PIXEL_SPLAT_X4(ptr[i-3])
 #define EXTEND_DOWN_CIP(ptr, start, length)                                   \
         for (i = start; i < (start) + (length); i+=4)                          \
-            if (!IS_INTRA(-1, i))                                              \
+            if (!LEFT_INTRA(i))                                                \
                 AV_WN4PA(&ptr[i], a);                                          \
             else                                                               \
                 a = PIXEL_SPLAT_X4(ptr[i+3])
@@ -88,6 +104,8 @@ static void FUNC(intra_pred)(HEVCContext *s, int x0, int y0, int log2_size, int
     enum IntraPredMode mode = c_idx ? lc->pu.intra_pred_mode_c :
                               lc->tu.cur_intra_pred_mode;
     pixel4 a;
+    uint32_t top_intra  = 0;
+    uint32_t left_intra = 0;
     pixel left_array[2 * MAX_TB_SIZE + 1];
     pixel filtered_left_array[2 * MAX_TB_SIZE + 1];
     pixel top_array[2 * MAX_TB_SIZE + 1];
@@ -201,6 +219,12 @@ static void FUNC(intra_pred)(HEVCContext *s, int x0, int y0, int log2_size, int
                 size_max_y = y0 + (( size) << vshift) < s->sps->height ?
                                                      size : (s->sps->height - y0) >> vshift;
             }
+            if (y0 > 0)
+                for (i = 0; i < size_max_x; i += 4)
+                    top_intra  |= IS_INTRA(i, -1) << (i >> 2);
+            if (x0 > 0)
+                for (i = 0; i < size_max_y; i += 4)
+                    left_intra |= IS_INTRA(-1, i) << (i >> 2);
             if (y0 > 0) {
                 a = PIXEL_SPLAT_X4(top[size_max_x-1]);
                 EXTEND_LEFT_CIP(top, size_max_x-1, size_max_x);
@@ -242,11 +266,8 @@ static void FUNC(intra_pred)(HEVCContext *s, int x0, int y0, int log2_size, int
     // Infer the unavailable samples
     if (!cand_bottom_left) {
         if (cand_left) {
-            // FIXME
-            // a = PIXEL_SPLAT_X4(left[size-1]);
-            // EXTEND(left, size, size);
-            for (i = size; i < 2 * size; i++)
-                left[i] = left[size-1];
+            a = PIXEL_SPLAT_X4(left[size-1]);
+            EXTEND(left, size, size);
         } else if (cand_up_left) {
             a = PIXEL_SPLAT_X4(left[-1]);
             EXTEND(left, 0, 2 * size);
@@ -285,11 +306,8 @@ static void FUNC(intra_pred)(HEVCContext *s, int x0, int y0, int log2_size, int
         EXTEND(top, 0, size);
     }
     if (!cand_up_right) {
-        // FIXME
-        // a = PIXEL_SPLAT_X4(top[size-1]);
-        // EXTEND(top, size, size);
-        for (i = size; i < 2 * size; i++)
-           top[i] = top[size-1];
+        a = PIXEL_SPLAT_X4(top[size-1]);
+        EXTEND(top, size, size);
     }
 
     top[-1] = left[-1];
@@ -308,25 +326,14 @@ static void FUNC(intra_pred)(HEVCContext *s, int x0, int y0, int log2_size, int
                 // We can't just overwrite values in top because it could be
                 // a pointer into src
                 filtered_top[-1] = top[-1];
-                filtered_top[63] = top[63];
-                for (i = 0; i < 63; i++)
-                    filtered_top[i] = ((64 - (i + 1)) * top[-1] +
-                                             (i + 1)  * top[63] + 32) >> 6;
-                for (i = 0; i < 63; i++)
-                    left[i] = ((64 - (i + 1)) * left[-1] +
-                                     (i + 1)  * left[63] + 32) >> 6;
+                s->hpc.ref_filter_strong((uint8_t *)filtered_top, (uint8_t *)top);
+                s->hpc.ref_filter_strong((uint8_t *)left, (uint8_t *)left);
                 top = filtered_top;
             } else {
-                filtered_left[2 * size - 1] = left[2 * size - 1];
-                filtered_top[2 * size - 1]  = top[2 * size - 1];
-                for (i = 2 * size - 2; i >= 0; i--)
-                    filtered_left[i] = (left[i + 1] + 2 * left[i] +
-                                        left[i - 1] + 2) >> 2;
+                s->hpc.ref_filter((uint8_t *)filtered_left, (uint8_t *)left, 2 * size);
+                s->hpc.ref_filter((uint8_t *)filtered_top,  (uint8_t *)top,  2 * size);
                 filtered_top[-1]  =
                 filtered_left[-1] = (left[0] + 2 * left[-1] + top[0] + 2) >> 2;
-                for (i = 2 * size - 2; i >= 0; i--)
-                    filtered_top[i] = (top[i + 1] + 2 * top[i] +
-                                       top[i - 1] + 2) >> 2;
                 left = filtered_left;
                 top  = filtered_top;
             }
@@ -350,6 +357,29 @@ static void FUNC(intra_pred)(HEVCContext *s, int x0, int y0, int log2_size, int
     }
 }
 
+static void FUNC(ref_filter)(uint8_t *_dst, const uint8_t *_src, int len)
+{
+    pixel *dst       = (pixel *)_dst;
+    const pixel *src = (const pixel *)_src;
+    int i;
+
+    for (i = 0; i < len - 1; i++)
+        dst[i] = (src[i - 1] + 2 * src[i] + src[i + 1] + 2) >> 2;
+    dst[len - 1] = src[len - 1];
+}
+
+static void FUNC(ref_filter_strong)(uint8_t *_dst, const uint8_t *_src)
+{
+    pixel *dst       = (pixel *)_dst;
+    const pixel *src = (const pixel *)_src;
+    int first        = src[-1];
+    int last         = src[63];
+    int i;
+
+    for (i = 0; i < 64; i++)
+        dst[i] = ((63 - i) * first + (i + 1) * last + 32) >> 6;
+}
+
 static av_always_inline void FUNC(pred_planar)(uint8_t *_src, const uint8_t *_top,
                               const uint8_t *_left, ptrdiff_t stride, int trafo_size)
 {
@@ -547,6 +577,8 @@ static void FUNC(pred_angular_3)(uint8_t *src, const uint8_t *top,
 #undef EXTEND_UP_CIP
 #undef EXTEND_DOWN_CIP
 #undef IS_INTRA
+#undef TOP_INTRA
+#undef LEFT_INTRA
 #undef MVF_PU
 #undef MVF
 #undef PU
@@ -79,6 +79,15 @@ typedef struct AVCodecInternal {
      */
     int allocate_progress;
 
+    /**
+     * Width of the border allocated around each plane by the default
+     * get_buffer2() when CODEC_FLAG_EMU_EDGE is not set.
+     *
+     * A decoder that extends its reference pictures into the border may
+     * raise it above EDGE_WIDTH; smaller values are ignored.
+     */
+    int edge_width;
+
     /**
      * An audio frame with less than required samples has been submitted and
      * padded with silence. Reject all subsequent frames.
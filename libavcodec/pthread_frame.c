@@ -206,6 +206,7 @@ static int update_context_from_thread(AVCodecContext *dst, AVCodecContext *src,
 
         dst->profile = src->profile;
         dst->level   = src->level;
+        dst->nb_layers = src->nb_layers;
 
         dst->bits_per_raw_sample = src->bits_per_raw_sample;
         dst->ticks_per_frame     = src->ticks_per_frame;
@@ -268,6 +269,10 @@ FF_ENABLE_DEPRECATION_WARNINGS
 
     dst->frame_number     = src->frame_number;
     dst->reordered_opaque = src->reordered_opaque;
+    dst->BL_frame         = src->BL_frame;
+    dst->BL_frame_cb      = src->BL_frame_cb;
+    dst->temporal_layers  = src->temporal_layers;
+    dst->temporal_switch  = src->temporal_switch;
     dst->thread_safe_callbacks = src->thread_safe_callbacks;
 
     if (src->slice_count && src->slice_offset) {
@@ -329,8 +329,9 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
         avcodec_align_dimensions2(avctx, &w, &h, pool->stride_align);
 
         if (!(avctx->flags & CODEC_FLAG_EMU_EDGE)) {
-            w += EDGE_WIDTH * 2;
-            h += EDGE_WIDTH * 2;
+            int edge_width = FFMAX(EDGE_WIDTH, avctx->internal->edge_width);
+            w += edge_width * 2;
+            h += edge_width * 2;
         }
 
         do {
@@ -485,9 +486,10 @@ static int video_get_buffer(AVCodecContext *s, AVFrame *pic)
         if ((s->flags & CODEC_FLAG_EMU_EDGE) || !pool->pools[2])
             pic->data[i] = pic->buf[i]->data;
         else {
+            int edge_width = FFMAX(EDGE_WIDTH, s->internal->edge_width);
             pic->data[i] = pic->buf[i]->data +
-                FFALIGN((pic->linesize[i] * EDGE_WIDTH >> v_shift) +
-                        (pixel_size * EDGE_WIDTH >> h_shift), pool->stride_align[i]);
+                FFALIGN((pic->linesize[i] * edge_width >> v_shift) +
+                        (pixel_size * edge_width >> h_shift), pool->stride_align[i]);
         }
     }
     for (; i < AV_NUM_DATA_POINTERS; i++) {
@@ -33,7 +33,7 @@ static void just_return(uint8_t *buf, ptrdiff_t stride, int h)
 {
 }
 
-void ff_videodsp_init(VideoDSPContext *ctx, int bpc)
+void ff_videodsp_init(VideoDSPContext *ctx, int bpc, int cpu_flags)
 {
     ctx->prefetch = just_return;
     if (bpc <= 8) {
@@ -42,5 +42,5 @@ void ff_videodsp_init(VideoDSPContext *ctx, int bpc)
         ctx->emulated_edge_mc = ff_emulated_edge_mc_16;
     }
     if (ARCH_X86)
-        ff_videodsp_init_x86(ctx, bpc);
+        ff_videodsp_init_x86(ctx, bpc, cpu_flags);
 }
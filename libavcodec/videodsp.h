@@ -61,11 +61,14 @@ typedef struct VideoDSPContext {
     void (*prefetch)(uint8_t *buf, ptrdiff_t stride, int h);
 } VideoDSPContext;
 
-void ff_videodsp_init(VideoDSPContext *ctx, int bpc);
+/**
+ * @param cpu_flags the AV_CPU_FLAG_* the functions may use
+ */
+void ff_videodsp_init(VideoDSPContext *ctx, int bpc, int cpu_flags);
 
 /* for internal use only (i.e. called by ff_videodsp_init() */
-void ff_videodsp_init_arm(VideoDSPContext *ctx, int bpc);
-void ff_videodsp_init_ppc(VideoDSPContext *ctx, int bpc);
-void ff_videodsp_init_x86(VideoDSPContext *ctx, int bpc);
+void ff_videodsp_init_arm(VideoDSPContext *ctx, int bpc, int cpu_flags);
+void ff_videodsp_init_ppc(VideoDSPContext *ctx, int bpc, int cpu_flags);
+void ff_videodsp_init_x86(VideoDSPContext *ctx, int bpc, int cpu_flags);
 
 #endif /* AVCODEC_VIDEODSP_H */
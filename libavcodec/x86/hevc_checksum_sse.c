@@ -0,0 +1,89 @@
+/*
+ * Provide SSE picture checksum functions for HEVC decoding
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavcodec/hevcdsp.h"
+#include "libavcodec/x86/hevcdsp.h"
+
+#include <emmintrin.h>
+
+/*
+ * The picture checksum adds up every sample byte xor'ed with a mask
+ * derived from the sample position:
+ *     mask = (x & 0xff) ^ (y & 0xff) ^ (x >> 8) ^ (y >> 8)
+ * For a run of 16 (8-bit) or 8 (16-bit) samples starting on an aligned x,
+ * only the low bits of the mask change inside the run, so the mask is a
+ * constant vector xor'ed with a per-row scalar, and the byte sums are
+ * accumulated with psadbw.
+ */
+
+uint32_t ff_hevc_picture_checksum_8_sse(const uint8_t *src, ptrdiff_t stride,
+                                        int width, int height)
+{
+    const __m128i ramp = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                                       8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc        = _mm_setzero_si128();
+    uint32_t sum       = 0;
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        int ymask = (y & 0xff) ^ (y >> 8);
+        for (x = 0; x + 16 <= width; x += 16) {
+            __m128i mask = _mm_xor_si128(_mm_set1_epi8((x & 0xf0) ^ (x >> 8) ^ ymask), ramp);
+            __m128i v    = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[x]), mask);
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+        }
+        for (; x < width; x++)
+            sum += src[x] ^ ((x & 0xff) ^ (x >> 8) ^ ymask);
+        src += stride;
+    }
+    acc = _mm_add_epi64(acc, _mm_srli_si128(acc, 8));
+    return sum + _mm_cvtsi128_si32(acc);
+}
+
+uint32_t ff_hevc_picture_checksum_10_sse(const uint8_t *_src, ptrdiff_t _stride,
+                                         int width, int height)
+{
+    const uint16_t *src = (const uint16_t *)_src;
+    ptrdiff_t stride    = _stride >> 1;
+    const __m128i ramp  = _mm_setr_epi8(0, 0, 1, 1, 2, 2, 3, 3,
+                                        4, 4, 5, 5, 6, 6, 7, 7);
+    const __m128i zero  = _mm_setzero_si128();
+    __m128i acc         = _mm_setzero_si128();
+    uint32_t sum        = 0;
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        int ymask = (y & 0xff) ^ (y >> 8);
+        for (x = 0; x + 8 <= width; x += 8) {
+            __m128i mask = _mm_xor_si128(_mm_set1_epi8((x & 0xf8) ^ (x >> 8) ^ ymask), ramp);
+            __m128i v    = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&src[x]), mask);
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+        }
+        for (; x < width; x++) {
+            int mask = (x & 0xff) ^ (x >> 8) ^ ymask;
+            sum += ((src[x] & 0xff) ^ mask) + ((src[x] >> 8) ^ mask);
+        }
+        src += stride;
+    }
+    acc = _mm_add_epi64(acc, _mm_srli_si128(acc, 8));
+    return sum + _mm_cvtsi128_si32(acc);
+}
@@ -0,0 +1,538 @@
+/*
+ * HEVC inverse transforms with AVX2
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavcodec/hevcdsp.h"
+#include "libavcodec/x86/hevcdsp.h"
+
+#include <immintrin.h>
+
+/*
+ * All functions are bit-exact with the C versions in hevcdsp_template.c:
+ * the first (vertical) pass rounds with a shift of 7 and saturates to
+ * 16 bits, the second (horizontal) pass rounds with a shift of
+ * 20 - bit_depth, saturates to 16 bits and is added to the destination
+ * with a clip to the pixel range.
+ *
+ * 4x4 and 8x8 blocks are computed as matrix products, two 8x8 rows or a
+ * whole 4x4 block per ymm register. 16x16 and 32x32 blocks use the
+ * even/odd butterfly on strips of 16 columns; each strip is transposed
+ * in registers on its way out, so the second pass reads the first pass
+ * output as rows and its own output goes straight into the picture.
+ */
+
+static const int8_t transform[32][32] = {
+    { 64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,
+      64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64 },
+    { 90,  90,  88,  85,  82,  78,  73,  67,  61,  54,  46,  38,  31,  22,  13,   4,
+      -4, -13, -22, -31, -38, -46, -54, -61, -67, -73, -78, -82, -85, -88, -90, -90 },
+    { 90,  87,  80,  70,  57,  43,  25,   9,  -9, -25, -43, -57, -70, -80, -87, -90,
+     -90, -87, -80, -70, -57, -43, -25,  -9,   9,  25,  43,  57,  70,  80,  87,  90 },
+    { 90,  82,  67,  46,  22,  -4, -31, -54, -73, -85, -90, -88, -78, -61, -38, -13,
+      13,  38,  61,  78,  88,  90,  85,  73,  54,  31,   4, -22, -46, -67, -82, -90 },
+    { 89,  75,  50,  18, -18, -50, -75, -89, -89, -75, -50, -18,  18,  50,  75,  89,
+      89,  75,  50,  18, -18, -50, -75, -89, -89, -75, -50, -18,  18,  50,  75,  89 },
+    { 88,  67,  31, -13, -54, -82, -90, -78, -46, -4,   38,  73,  90,  85,  61,  22,
+     -22, -61, -85, -90, -73, -38,   4,  46,  78,  90,  82,  54,  13, -31, -67, -88 },
+    { 87,  57,   9, -43, -80, -90, -70, -25,  25,  70,  90,  80,  43,  -9, -57, -87,
+     -87, -57,  -9,  43,  80,  90,  70,  25, -25, -70, -90, -80, -43,   9,  57,  87 },
+    { 85,  46, -13, -67, -90, -73, -22,  38,  82,  88,  54,  -4, -61, -90, -78, -31,
+      31,  78,  90,  61,   4, -54, -88, -82, -38,  22,  73,  90,  67,  13, -46, -85 },
+    { 83,  36, -36, -83, -83, -36,  36,  83,  83,  36, -36, -83, -83, -36,  36,  83,
+      83,  36, -36, -83, -83, -36,  36,  83,  83,  36, -36, -83, -83, -36,  36,  83 },
+    { 82,  22, -54, -90, -61,  13,  78,  85,  31, -46, -90, -67,   4,  73,  88,  38,
+     -38, -88, -73,  -4,  67,  90,  46, -31, -85, -78, -13,  61,  90,  54, -22, -82 },
+    { 80,   9, -70, -87, -25,  57,  90,  43, -43, -90, -57,  25,  87,  70,  -9, -80,
+     -80,  -9,  70,  87,  25, -57, -90, -43,  43,  90,  57, -25, -87, -70,   9,  80 },
+    { 78,  -4, -82, -73,  13,  85,  67, -22, -88, -61,  31,  90,  54, -38, -90, -46,
+      46,  90,  38, -54, -90, -31,  61,  88,  22, -67, -85, -13,  73,  82,   4, -78 },
+    { 75, -18, -89, -50,  50,  89,  18, -75, -75,  18,  89,  50, -50, -89, -18,  75,
+      75, -18, -89, -50,  50,  89,  18, -75, -75,  18,  89,  50, -50, -89, -18,  75 },
+    { 73, -31, -90, -22,  78,  67, -38, -90, -13,  82,  61, -46, -88,  -4,  85,  54,
+     -54, -85,   4,  88,  46, -61, -82,  13,  90,  38, -67, -78,  22,  90,  31, -73 },
+    { 70, -43, -87,   9,  90,  25, -80, -57,  57,  80, -25, -90,  -9,  87,  43, -70,
+     -70,  43,  87,  -9, -90, -25,  80,  57, -57, -80,  25,  90,   9, -87, -43,  70 },
+    { 67, -54, -78,  38,  85, -22, -90,   4,  90,  13, -88, -31,  82,  46, -73, -61,
+      61,  73, -46, -82,  31,  88, -13, -90,  -4,  90,  22, -85, -38,  78,  54, -67 },
+    { 64, -64, -64,  64,  64, -64, -64,  64,  64, -64, -64,  64,  64, -64, -64,  64,
+      64, -64, -64,  64,  64, -64, -64,  64,  64, -64, -64,  64,  64, -64, -64,  64 },
+    { 61, -73, -46,  82,  31, -88, -13,  90,  -4, -90,  22,  85, -38, -78,  54,  67,
+     -67, -54,  78,  38, -85, -22,  90,   4, -90,  13,  88, -31, -82,  46,  73, -61 },
+    { 57, -80, -25,  90,  -9, -87,  43,  70, -70, -43,  87,   9, -90,  25,  80, -57,
+     -57,  80,  25, -90,   9,  87, -43, -70,  70,  43, -87,  -9,  90, -25, -80,  57 },
+    { 54, -85,  -4,  88, -46, -61,  82,  13, -90,  38,  67, -78, -22,  90, -31, -73,
+      73,  31, -90,  22,  78, -67, -38,  90, -13, -82,  61,  46, -88,   4,  85, -54 },
+    { 50, -89,  18,  75, -75, -18,  89, -50, -50,  89, -18, -75,  75,  18, -89,  50,
+      50, -89,  18,  75, -75, -18,  89, -50, -50,  89, -18, -75,  75,  18, -89,  50 },
+    { 46, -90,  38,  54, -90,  31,  61, -88,  22,  67, -85,  13,  73, -82,   4,  78,
+     -78,  -4,  82, -73, -13,  85, -67, -22,  88, -61, -31,  90, -54, -38,  90, -46 },
+    { 43, -90,  57,  25, -87,  70,   9, -80,  80,  -9, -70,  87, -25, -57,  90, -43,
+     -43,  90, -57, -25,  87, -70,  -9,  80, -80,   9,  70, -87,  25,  57, -90,  43 },
+    { 38, -88,  73,  -4, -67,  90, -46, -31,  85, -78,  13,  61, -90,  54,  22, -82,
+      82, -22, -54,  90, -61, -13,  78, -85,  31,  46, -90,  67,   4, -73,  88, -38 },
+    { 36, -83,  83, -36, -36,  83, -83,  36,  36, -83,  83, -36, -36,  83, -83,  36,
+      36, -83,  83, -36, -36,  83, -83,  36,  36, -83,  83, -36, -36,  83, -83,  36 },
+    { 31, -78,  90, -61,   4,  54, -88,  82, -38, -22,  73, -90,  67, -13, -46,  85,
+     -85,  46,  13, -67,  90, -73,  22,  38, -82,  88, -54,  -4,  61, -90,  78, -31 },
+    { 25, -70,  90, -80,  43,   9, -57,  87, -87,  57,  -9, -43,  80, -90,  70, -25,
+     -25,  70, -90,  80, -43,  -9,  57, -87,  87, -57,   9,  43, -80,  90, -70,  25 },
+    { 22, -61,  85, -90,  73, -38,  -4,  46, -78,  90, -82,  54, -13, -31,  67, -88,
+      88, -67,  31,  13, -54,  82, -90,  78, -46,   4,  38, -73,  90, -85,  61, -22 },
+    { 18, -50,  75, -89,  89, -75,  50, -18, -18,  50, -75,  89, -89,  75, -50,  18,
+      18, -50,  75, -89,  89, -75,  50, -18, -18,  50, -75,  89, -89,  75, -50,  18 },
+    { 13, -38,  61, -78,  88, -90,  85, -73,  54, -31,   4,  22, -46,  67, -82,  90,
+     -90,  82, -67,  46, -22,  -4,  31, -54,  73, -85,  90, -88,  78, -61,  38, -13 },
+    {  9, -25,  43, -57,  70, -80,  87, -90,  90, -87,  80, -70,  57, -43,  25, -9,
+      -9,  25, -43,  57, -70,  80, -87,  90, -90,  87, -80,  70, -57,  43, -25,   9 },
+    {  4, -13,  22, -31,  38, -46,  54, -61,  67, -73,  78, -82,  85, -88,  90, -90,
+      90, -90,  88, -85,  82, -78,  73, -67,  61, -54,  46, -38,  31, -22,  13,  -4 },
+};
+
+/* 4x4 DST, stored like transform[][] (input index first) */
+static const int8_t transform4x4_luma[4][4] = {
+    { 29,  55,  74,  84 },
+    { 74,  74,   0, -74 },
+    { 84, -29, -74,  55 },
+    { 55, -84,  74, -29 },
+};
+
+static const int8_t transform4x4[4][4] = {
+    { 64,  64,  64,  64 },
+    { 83,  36, -36, -83 },
+    { 64, -64, -64,  64 },
+    { 36, -83,  83, -36 },
+};
+
+/* two 16-bit coefficients to be multiplied with interleaved samples by pmaddwd */
+static av_always_inline int coef_pair(int a, int b)
+{
+    return (uint16_t)a | ((unsigned)(uint16_t)b << 16);
+}
+
+static av_always_inline __m256i coef_lanes(int lo, int hi)
+{
+    return _mm256_setr_epi32(lo, lo, lo, lo, hi, hi, hi, hi);
+}
+
+static av_always_inline __m256i round_pack(__m256i lo, __m256i hi, int shift)
+{
+    const __m256i add = _mm256_set1_epi32(1 << (shift - 1));
+
+    lo = _mm256_srai_epi32(_mm256_add_epi32(lo, add), shift);
+    hi = _mm256_srai_epi32(_mm256_add_epi32(hi, add), shift);
+    return _mm256_packs_epi32(lo, hi);
+}
+
+/*
+ * Load 16 destination samples as 16-bit words: 4 rows of a 4-wide block,
+ * 2 rows of an 8-wide block or 1 row of a 16-wide block.
+ */
+static av_always_inline __m256i load_pixels(const uint8_t *dst, ptrdiff_t stride,
+                                            int w, int bit_depth)
+{
+    __m128i lo, hi;
+
+    if (bit_depth == 8) {
+        if (w == 4)
+            lo = _mm_setr_epi32(AV_RN32(dst),              AV_RN32(dst +     stride),
+                                AV_RN32(dst + 2 * stride), AV_RN32(dst + 3 * stride));
+        else if (w == 8)
+            lo = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)dst),
+                                    _mm_loadl_epi64((const __m128i *)(dst + stride)));
+        else
+            lo = _mm_loadu_si128((const __m128i *)dst);
+        return _mm256_cvtepu8_epi16(lo);
+    }
+    if (w == 16)
+        return _mm256_loadu_si256((const __m256i *)dst);
+    if (w == 4) {
+        lo = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)dst),
+                                _mm_loadl_epi64((const __m128i *)(dst + stride)));
+        hi = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(dst + 2 * stride)),
+                                _mm_loadl_epi64((const __m128i *)(dst + 3 * stride)));
+    } else {
+        lo = _mm_loadu_si128((const __m128i *)dst);
+        hi = _mm_loadu_si128((const __m128i *)(dst + stride));
+    }
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+/* Store 16 samples laid out as in load_pixels(), clipping them if asked to. */
+static av_always_inline void store_pixels(uint8_t *dst, ptrdiff_t stride, __m256i v,
+                                          int w, int bit_depth, int clip)
+{
+    __m128i lo, hi;
+
+    if (bit_depth == 8) {
+        lo = _mm_packus_epi16(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        if (w == 4) {
+            AV_WN32(dst,              _mm_cvtsi128_si32(lo));
+            AV_WN32(dst +     stride, _mm_extract_epi32(lo, 1));
+            AV_WN32(dst + 2 * stride, _mm_extract_epi32(lo, 2));
+            AV_WN32(dst + 3 * stride, _mm_extract_epi32(lo, 3));
+        } else if (w == 8) {
+            _mm_storel_epi64((__m128i *)dst,            lo);
+            _mm_storel_epi64((__m128i *)(dst + stride), _mm_srli_si128(lo, 8));
+        } else {
+            _mm_storeu_si128((__m128i *)dst, lo);
+        }
+        return;
+    }
+    if (clip) {
+        v = _mm256_max_epi16(v, _mm256_setzero_si256());
+        v = _mm256_min_epi16(v, _mm256_set1_epi16((1 << bit_depth) - 1));
+    }
+    if (w == 16) {
+        _mm256_storeu_si256((__m256i *)dst, v);
+        return;
+    }
+    lo = _mm256_castsi256_si128(v);
+    hi = _mm256_extracti128_si256(v, 1);
+    if (w == 4) {
+        _mm_storel_epi64((__m128i *)dst,                  lo);
+        _mm_storel_epi64((__m128i *)(dst +     stride),   _mm_srli_si128(lo, 8));
+        _mm_storel_epi64((__m128i *)(dst + 2 * stride),   hi);
+        _mm_storel_epi64((__m128i *)(dst + 3 * stride),   _mm_srli_si128(hi, 8));
+    } else {
+        _mm_storeu_si128((__m128i *)dst,            lo);
+        _mm_storeu_si128((__m128i *)(dst + stride), hi);
+    }
+}
+
+static av_always_inline void add_residual(uint8_t *dst, ptrdiff_t stride, __m256i res,
+                                          int w, int bit_depth)
+{
+    __m256i v = _mm256_adds_epi16(load_pixels(dst, stride, w, bit_depth), res);
+    store_pixels(dst, stride, v, w, bit_depth, 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+static av_always_inline void transquant_bypass(uint8_t *dst, int16_t *coeffs,
+                                               ptrdiff_t stride, int size, int bit_depth)
+{
+    int w    = FFMIN(size, 16);
+    int rows = 16 / w;
+    int x, y;
+
+    for (y = 0; y < size; y += rows) {
+        for (x = 0; x < size; x += w) {
+            __m256i c = _mm256_loadu_si256((const __m256i *)&coeffs[y * size + x]);
+            uint8_t *d = dst + y * stride + x * ((bit_depth + 7) >> 3);
+            __m256i v  = _mm256_add_epi16(load_pixels(d, stride, w, bit_depth), c);
+            if (bit_depth == 8)
+                v = _mm256_and_si256(v, _mm256_set1_epi16(0xff));
+            store_pixels(d, stride, v, w, bit_depth, 0);
+        }
+    }
+}
+
+static av_always_inline void transform_skip(uint8_t *dst, int16_t *coeffs,
+                                            ptrdiff_t stride, int bit_depth)
+{
+    const int shift = 13 - bit_depth;
+    /* pmulhrsw by 1 << (15 - shift) is (c + (1 << (shift - 1))) >> shift
+     * without the 16-bit overflow of the addition */
+    __m256i c = _mm256_loadu_si256((const __m256i *)coeffs);
+    c = _mm256_mulhrs_epi16(c, _mm256_set1_epi16(1 << (15 - shift)));
+    add_residual(dst, stride, c, 4, bit_depth);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+static av_always_inline void transform_4x4_add(uint8_t *dst, int16_t *coeffs,
+                                               ptrdiff_t stride,
+                                               const int8_t m[4][4], int bit_depth)
+{
+    __m128i x01 = _mm_loadu_si128((const __m128i *)coeffs);
+    __m128i x23 = _mm_loadu_si128((const __m128i *)&coeffs[8]);
+    /* interleaved rows (0, 1) and (2, 3), duplicated in both lanes */
+    __m256i p01 = _mm256_broadcastsi128_si256(_mm_unpacklo_epi16(x01, _mm_srli_si128(x01, 8)));
+    __m256i p23 = _mm256_broadcastsi128_si256(_mm_unpacklo_epi16(x23, _mm_srli_si128(x23, 8)));
+    __m256i r01, r23, c01, c23;
+
+    /* first pass: output row k in the low lane, row k + 1 in the high lane */
+    r01 = _mm256_add_epi32(
+        _mm256_madd_epi16(p01, coef_lanes(coef_pair(m[0][0], m[1][0]), coef_pair(m[0][1], m[1][1]))),
+        _mm256_madd_epi16(p23, coef_lanes(coef_pair(m[2][0], m[3][0]), coef_pair(m[2][1], m[3][1]))));
+    r23 = _mm256_add_epi32(
+        _mm256_madd_epi16(p01, coef_lanes(coef_pair(m[0][2], m[1][2]), coef_pair(m[0][3], m[1][3]))),
+        _mm256_madd_epi16(p23, coef_lanes(coef_pair(m[2][2], m[3][2]), coef_pair(m[2][3], m[3][3]))));
+    /* rows 0 2 | 1 3 -> 0 1 | 2 3 */
+    r01 = _mm256_permute4x64_epi64(round_pack(r01, r23, 7), 0xd8);
+
+    /* second pass: row i dotted with the matrix columns, rows 0 and 2
+     * first then rows 1 and 3 */
+    c01 = _mm256_setr_epi32(coef_pair(m[0][0], m[1][0]), coef_pair(m[0][1], m[1][1]),
+                            coef_pair(m[0][2], m[1][2]), coef_pair(m[0][3], m[1][3]),
+                            coef_pair(m[0][0], m[1][0]), coef_pair(m[0][1], m[1][1]),
+                            coef_pair(m[0][2], m[1][2]), coef_pair(m[0][3], m[1][3]));
+    c23 = _mm256_setr_epi32(coef_pair(m[2][0], m[3][0]), coef_pair(m[2][1], m[3][1]),
+                            coef_pair(m[2][2], m[3][2]), coef_pair(m[2][3], m[3][3]),
+                            coef_pair(m[2][0], m[3][0]), coef_pair(m[2][1], m[3][1]),
+                            coef_pair(m[2][2], m[3][2]), coef_pair(m[2][3], m[3][3]));
+    r23 = _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi32(r01, 0xaa), c01),
+                           _mm256_madd_epi16(_mm256_shuffle_epi32(r01, 0xff), c23));
+    r01 = _mm256_add_epi32(_mm256_madd_epi16(_mm256_shuffle_epi32(r01, 0x00), c01),
+                           _mm256_madd_epi16(_mm256_shuffle_epi32(r01, 0x55), c23));
+
+    /* rows 0 2 and 1 3 pack back to 0 1 | 2 3 */
+    add_residual(dst, stride, round_pack(r01, r23, 20 - bit_depth), 4, bit_depth);
+}
+
+static av_always_inline void transform_8x8_add(uint8_t *dst, int16_t *coeffs,
+                                               ptrdiff_t stride, int bit_depth)
+{
+    __m256i p[4], r[4], lo[8];
+    int i, j, k;
+
+    /* first pass: interleave rows (0, 2), (4, 6), (1, 3) and (5, 7) */
+    for (i = 0; i < 4; i++) {
+        int a = (i & 1) * 4 + (i >> 1);
+        __m128i x = _mm_loadu_si128((const __m128i *)&coeffs[ a      * 8]);
+        __m128i y = _mm_loadu_si128((const __m128i *)&coeffs[(a + 2) * 8]);
+        p[i] = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16(x, y)),
+                                       _mm_unpackhi_epi16(x, y), 1);
+    }
+    for (k = 0; k < 4; k++) {
+        __m256i e = _mm256_add_epi32(
+            _mm256_madd_epi16(p[0], _mm256_set1_epi32(coef_pair(transform[ 0][k], transform[ 8][k]))),
+            _mm256_madd_epi16(p[1], _mm256_set1_epi32(coef_pair(transform[16][k], transform[24][k]))));
+        __m256i o = _mm256_add_epi32(
+            _mm256_madd_epi16(p[2], _mm256_set1_epi32(coef_pair(transform[ 4][k], transform[12][k]))),
+            _mm256_madd_epi16(p[3], _mm256_set1_epi32(coef_pair(transform[20][k], transform[28][k]))));
+        lo[k]     = _mm256_add_epi32(e, o);
+        lo[7 - k] = _mm256_sub_epi32(e, o);
+    }
+    /* two rows per register */
+    for (i = 0; i < 4; i++)
+        r[i] = _mm256_permute4x64_epi64(round_pack(lo[2 * i], lo[2 * i + 1], 7), 0xd8);
+
+    /* second pass: broadcast each pair of samples of a row and multiply it
+     * by the matching two rows of the matrix */
+    for (i = 0; i < 8; i++) {
+        __m256i row = (i & 1) ? _mm256_permute4x64_epi64(r[i >> 1], 0xee)
+                              : _mm256_permute4x64_epi64(r[i >> 1], 0x44);
+        __m256i sum = _mm256_setzero_si256();
+        for (j = 0; j < 4; j++) {
+            __m256i c = _mm256_setr_epi32(coef_pair(transform[8 * j][0], transform[8 * j + 4][0]),
+                                          coef_pair(transform[8 * j][1], transform[8 * j + 4][1]),
+                                          coef_pair(transform[8 * j][2], transform[8 * j + 4][2]),
+                                          coef_pair(transform[8 * j][3], transform[8 * j + 4][3]),
+                                          coef_pair(transform[8 * j][4], transform[8 * j + 4][4]),
+                                          coef_pair(transform[8 * j][5], transform[8 * j + 4][5]),
+                                          coef_pair(transform[8 * j][6], transform[8 * j + 4][6]),
+                                          coef_pair(transform[8 * j][7], transform[8 * j + 4][7]));
+            __m256i s;
+            switch (j) {
+            case 0:  s = _mm256_shuffle_epi32(row, 0x00); break;
+            case 1:  s = _mm256_shuffle_epi32(row, 0x55); break;
+            case 2:  s = _mm256_shuffle_epi32(row, 0xaa); break;
+            default: s = _mm256_shuffle_epi32(row, 0xff); break;
+            }
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(s, c));
+        }
+        lo[i] = sum;
+    }
+    for (i = 0; i < 8; i += 2) {
+        __m256i res = _mm256_permute4x64_epi64(round_pack(lo[i], lo[i + 1], 20 - bit_depth), 0xd8);
+        add_residual(dst + i * stride, stride, res, 8, bit_depth);
+    }
+}
+
+/* in-lane transpose of two 8x8 blocks of 16-bit words */
+static av_always_inline void transpose_8x8_lanes(__m256i *r)
+{
+    __m256i t[8], u[8];
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        t[2 * i]     = _mm256_unpacklo_epi16(r[2 * i], r[2 * i + 1]);
+        t[2 * i + 1] = _mm256_unpackhi_epi16(r[2 * i], r[2 * i + 1]);
+    }
+    for (i = 0; i < 2; i++) {
+        u[4 * i]     = _mm256_unpacklo_epi32(t[4 * i],     t[4 * i + 2]);
+        u[4 * i + 1] = _mm256_unpackhi_epi32(t[4 * i],     t[4 * i + 2]);
+        u[4 * i + 2] = _mm256_unpacklo_epi32(t[4 * i + 1], t[4 * i + 3]);
+        u[4 * i + 3] = _mm256_unpackhi_epi32(t[4 * i + 1], t[4 * i + 3]);
+    }
+    for (i = 0; i < 4; i++) {
+        r[2 * i]     = _mm256_unpacklo_epi64(u[i], u[i + 4]);
+        r[2 * i + 1] = _mm256_unpackhi_epi64(u[i], u[i + 4]);
+    }
+}
+
+static av_always_inline void transpose_16x16(__m256i *r)
+{
+    int i;
+
+    transpose_8x8_lanes(r);
+    transpose_8x8_lanes(r + 8);
+    for (i = 0; i < 8; i++) {
+        __m256i t = r[i];
+        r[i]     = _mm256_permute2x128_si256(t, r[i + 8], 0x20);
+        r[i + 8] = _mm256_permute2x128_si256(t, r[i + 8], 0x31);
+    }
+}
+
+/*
+ * One pass of the n-point transform (n = 16 or 32) over a strip of 16
+ * columns of src (row stride n). The result is transposed on the way out:
+ * column c of the strip becomes row c, written to tmp (row stride n) or,
+ * when tmp is NULL, added to row c of dst.
+ */
+static av_always_inline void transform_strip(const int16_t *src, int n, int shift,
+                                             int16_t *tmp, uint8_t *dst,
+                                             ptrdiff_t stride, int bit_depth)
+{
+    __m256i x[32], lo[2][32], hi[2][32], pl[8], ph[8], r[16];
+    int cur = 0, i, k, m;
+
+    for (i = 0; i < n; i++)
+        x[i] = _mm256_loadu_si256((const __m256i *)&src[i * n]);
+
+    /* 2-point core on rows 0 and n / 2 */
+    pl[0] = _mm256_unpacklo_epi16(x[0], x[n / 2]);
+    ph[0] = _mm256_unpackhi_epi16(x[0], x[n / 2]);
+    lo[0][0] = _mm256_madd_epi16(pl[0], _mm256_set1_epi32(coef_pair(64,  64)));
+    hi[0][0] = _mm256_madd_epi16(ph[0], _mm256_set1_epi32(coef_pair(64,  64)));
+    lo[0][1] = _mm256_madd_epi16(pl[0], _mm256_set1_epi32(coef_pair(64, -64)));
+    hi[0][1] = _mm256_madd_epi16(ph[0], _mm256_set1_epi32(coef_pair(64, -64)));
+
+    /* each stage doubles the size: the previous stage is the even part,
+     * the odd rows of this stage give the odd part */
+    for (m = 4; m <= n; m <<= 1) {
+        const int step = n / m;
+
+        for (i = 0; i < m / 4; i++) {
+            pl[i] = _mm256_unpacklo_epi16(x[(4 * i + 1) * step], x[(4 * i + 3) * step]);
+            ph[i] = _mm256_unpackhi_epi16(x[(4 * i + 1) * step], x[(4 * i + 3) * step]);
+        }
+        for (k = 0; k < m / 2; k++) {
+            __m256i ol = _mm256_setzero_si256();
+            __m256i oh = _mm256_setzero_si256();
+            for (i = 0; i < m / 4; i++) {
+                __m256i c = _mm256_set1_epi32(coef_pair(transform[(4 * i + 1) * 32 / m][k],
+                                                        transform[(4 * i + 3) * 32 / m][k]));
+                ol = _mm256_add_epi32(ol, _mm256_madd_epi16(pl[i], c));
+                oh = _mm256_add_epi32(oh, _mm256_madd_epi16(ph[i], c));
+            }
+            lo[!cur][k]         = _mm256_add_epi32(lo[cur][k], ol);
+            hi[!cur][k]         = _mm256_add_epi32(hi[cur][k], oh);
+            lo[!cur][m - 1 - k] = _mm256_sub_epi32(lo[cur][k], ol);
+            hi[!cur][m - 1 - k] = _mm256_sub_epi32(hi[cur][k], oh);
+        }
+        cur = !cur;
+    }
+
+    for (k = 0; k < n; k += 16) {
+        for (i = 0; i < 16; i++)
+            r[i] = round_pack(lo[cur][k + i], hi[cur][k + i], shift);
+        transpose_16x16(r);
+        for (i = 0; i < 16; i++) {
+            if (tmp)
+                _mm256_storeu_si256((__m256i *)&tmp[i * n + k], r[i]);
+            else
+                add_residual(dst + i * stride + k * ((bit_depth + 7) >> 3), stride,
+                             r[i], 16, bit_depth);
+        }
+    }
+}
+
+static av_always_inline void transform_nxn_add(uint8_t *dst, int16_t *coeffs,
+                                               ptrdiff_t stride, int n, int bit_depth)
+{
+    DECLARE_ALIGNED(32, int16_t, tmp)[32 * 32];
+    int i;
+
+    /* tmp receives the transposed first pass, so both passes read rows */
+    for (i = 0; i < n; i += 16)
+        transform_strip(coeffs + i, n, 7, tmp + i * n, NULL, 0, bit_depth);
+    for (i = 0; i < n; i += 16)
+        transform_strip(tmp + i, n, 20 - bit_depth, NULL, dst + i * stride,
+                        stride, bit_depth);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+////////////////////////////////////////////////////////////////////////////////
+#define TRANSFORM_AVX2(D)                                                      \
+void ff_hevc_transform_4x4_luma_add_ ## D ## _avx2(uint8_t *dst,              \
+                                                   int16_t *coeffs,           \
+                                                   ptrdiff_t stride)          \
+{                                                                              \
+    transform_4x4_add(dst, coeffs, stride, transform4x4_luma, D);              \
+}                                                                              \
+void ff_hevc_transform_4x4_add_ ## D ## _avx2(uint8_t *dst, int16_t *coeffs,   \
+                                              ptrdiff_t stride)                \
+{                                                                              \
+    transform_4x4_add(dst, coeffs, stride, transform4x4, D);                   \
+}                                                                              \
+void ff_hevc_transform_8x8_add_ ## D ## _avx2(uint8_t *dst, int16_t *coeffs,   \
+                                              ptrdiff_t stride)                \
+{                                                                              \
+    transform_8x8_add(dst, coeffs, stride, D);                                 \
+}                                                                              \
+void ff_hevc_transform_16x16_add_ ## D ## _avx2(uint8_t *dst, int16_t *coeffs, \
+                                                ptrdiff_t stride)              \
+{                                                                              \
+    transform_nxn_add(dst, coeffs, stride, 16, D);                             \
+}                                                                              \
+void ff_hevc_transform_32x32_add_ ## D ## _avx2(uint8_t *dst, int16_t *coeffs, \
+                                                ptrdiff_t stride)              \
+{                                                                              \
+    transform_nxn_add(dst, coeffs, stride, 32, D);                             \
+}                                                                              \
+void ff_hevc_transform_skip_ ## D ## _avx2(uint8_t *dst, int16_t *coeffs,      \
+                                           ptrdiff_t stride)                   \
+{                                                                              \
+    transform_skip(dst, coeffs, stride, D);                                    \
+}                                                                              \
+void ff_hevc_transquant_bypass4x4_ ## D ## _avx2(uint8_t *dst,                \
+                                                 int16_t *coeffs,             \
+                                                 ptrdiff_t stride)            \
+{                                                                              \
+    transquant_bypass(dst, coeffs, stride, 4, D);                              \
+}                                                                              \
+void ff_hevc_transquant_bypass8x8_ ## D ## _avx2(uint8_t *dst,                \
+                                                 int16_t *coeffs,             \
+                                                 ptrdiff_t stride)            \
+{                                                                              \
+    transquant_bypass(dst, coeffs, stride, 8, D);                              \
+}                                                                              \
+void ff_hevc_transquant_bypass16x16_ ## D ## _avx2(uint8_t *dst,              \
+                                                   int16_t *coeffs,           \
+                                                   ptrdiff_t stride)          \
+{                                                                              \
+    transquant_bypass(dst, coeffs, stride, 16, D);                             \
+}                                                                              \
+void ff_hevc_transquant_bypass32x32_ ## D ## _avx2(uint8_t *dst,              \
+                                                   int16_t *coeffs,           \
+                                                   ptrdiff_t stride)          \
+{                                                                              \
+    transquant_bypass(dst, coeffs, stride, 32, D);                             \
+}
+
+TRANSFORM_AVX2( 8)
+TRANSFORM_AVX2(10)
@@ -0,0 +1,228 @@
+/*
+ * Provide the AVX-512 32x32 inverse transform for HEVC decoding
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavcodec/hevcdsp.h"
+#include "libavcodec/x86/hevcdsp.h"
+
+#include <immintrin.h>
+
+/*
+ * A whole row of 32 coefficients fits in one register, so each butterfly
+ * stage works on all columns at once and the two passes are joined by a
+ * 32x32 word transpose.
+ */
+
+static const int8_t transform[32][32] = {
+    { 64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,
+      64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64,  64 },
+    { 90,  90,  88,  85,  82,  78,  73,  67,  61,  54,  46,  38,  31,  22,  13,   4,
+      -4, -13, -22, -31, -38, -46, -54, -61, -67, -73, -78, -82, -85, -88, -90, -90 },
+    { 90,  87,  80,  70,  57,  43,  25,   9,  -9, -25, -43, -57, -70, -80, -87, -90,
+     -90, -87, -80, -70, -57, -43, -25,  -9,   9,  25,  43,  57,  70,  80,  87,  90 },
+    { 90,  82,  67,  46,  22,  -4, -31, -54, -73, -85, -90, -88, -78, -61, -38, -13,
+      13,  38,  61,  78,  88,  90,  85,  73,  54,  31,   4, -22, -46, -67, -82, -90 },
+    { 89,  75,  50,  18, -18, -50, -75, -89, -89, -75, -50, -18,  18,  50,  75,  89,
+      89,  75,  50,  18, -18, -50, -75, -89, -89, -75, -50, -18,  18,  50,  75,  89 },
+    { 88,  67,  31, -13, -54, -82, -90, -78, -46, -4,   38,  73,  90,  85,  61,  22,
+     -22, -61, -85, -90, -73, -38,   4,  46,  78,  90,  82,  54,  13, -31, -67, -88 },
+    { 87,  57,   9, -43, -80, -90, -70, -25,  25,  70,  90,  80,  43,  -9, -57, -87,
+     -87, -57,  -9,  43,  80,  90,  70,  25, -25, -70, -90, -80, -43,   9,  57,  87 },
+    { 85,  46, -13, -67, -90, -73, -22,  38,  82,  88,  54,  -4, -61, -90, -78, -31,
+      31,  78,  90,  61,   4, -54, -88, -82, -38,  22,  73,  90,  67,  13, -46, -85 },
+    { 83,  36, -36, -83, -83, -36,  36,  83,  83,  36, -36, -83, -83, -36,  36,  83,
+      83,  36, -36, -83, -83, -36,  36,  83,  83,  36, -36, -83, -83, -36,  36,  83 },
+    { 82,  22, -54, -90, -61,  13,  78,  85,  31, -46, -90, -67,   4,  73,  88,  38,
+     -38, -88, -73,  -4,  67,  90,  46, -31, -85, -78, -13,  61,  90,  54, -22, -82 },
+    { 80,   9, -70, -87, -25,  57,  90,  43, -43, -90, -57,  25,  87,  70,  -9, -80,
+     -80,  -9,  70,  87,  25, -57, -90, -43,  43,  90,  57, -25, -87, -70,   9,  80 },
+    { 78,  -4, -82, -73,  13,  85,  67, -22, -88, -61,  31,  90,  54, -38, -90, -46,
+      46,  90,  38, -54, -90, -31,  61,  88,  22, -67, -85, -13,  73,  82,   4, -78 },
+    { 75, -18, -89, -50,  50,  89,  18, -75, -75,  18,  89,  50, -50, -89, -18,  75,
+      75, -18, -89, -50,  50,  89,  18, -75, -75,  18,  89,  50, -50, -89, -18,  75 },
+    { 73, -31, -90, -22,  78,  67, -38, -90, -13,  82,  61, -46, -88,  -4,  85,  54,
+     -54, -85,   4,  88,  46, -61, -82,  13,  90,  38, -67, -78,  22,  90,  31, -73 },
+    { 70, -43, -87,   9,  90,  25, -80, -57,  57,  80, -25, -90,  -9,  87,  43, -70,
+     -70,  43,  87,  -9, -90, -25,  80,  57, -57, -80,  25,  90,   9, -87, -43,  70 },
+    { 67, -54, -78,  38,  85, -22, -90,   4,  90,  13, -88, -31,  82,  46, -73, -61,
+      61,  73, -46, -82,  31,  88, -13, -90,  -4,  90,  22, -85, -38,  78,  54, -67 },
+    { 64, -64, -64,  64,  64, -64, -64,  64,  64, -64, -64,  64,  64, -64, -64,  64,
+      64, -64, -64,  64,  64, -64, -64,  64,  64, -64, -64,  64,  64, -64, -64,  64 },
+    { 61, -73, -46,  82,  31, -88, -13,  90,  -4, -90,  22,  85, -38, -78,  54,  67,
+     -67, -54,  78,  38, -85, -22,  90,   4, -90,  13,  88, -31, -82,  46,  73, -61 },
+    { 57, -80, -25,  90,  -9, -87,  43,  70, -70, -43,  87,   9, -90,  25,  80, -57,
+     -57,  80,  25, -90,   9,  87, -43, -70,  70,  43, -87,  -9,  90, -25, -80,  57 },
+    { 54, -85,  -4,  88, -46, -61,  82,  13, -90,  38,  67, -78, -22,  90, -31, -73,
+      73,  31, -90,  22,  78, -67, -38,  90, -13, -82,  61,  46, -88,   4,  85, -54 },
+    { 50, -89,  18,  75, -75, -18,  89, -50, -50,  89, -18, -75,  75,  18, -89,  50,
+      50, -89,  18,  75, -75, -18,  89, -50, -50,  89, -18, -75,  75,  18, -89,  50 },
+    { 46, -90,  38,  54, -90,  31,  61, -88,  22,  67, -85,  13,  73, -82,   4,  78,
+     -78,  -4,  82, -73, -13,  85, -67, -22,  88, -61, -31,  90, -54, -38,  90, -46 },
+    { 43, -90,  57,  25, -87,  70,   9, -80,  80,  -9, -70,  87, -25, -57,  90, -43,
+     -43,  90, -57, -25,  87, -70,  -9,  80, -80,   9,  70, -87,  25,  57, -90,  43 },
+    { 38, -88,  73,  -4, -67,  90, -46, -31,  85, -78,  13,  61, -90,  54,  22, -82,
+      82, -22, -54,  90, -61, -13,  78, -85,  31,  46, -90,  67,   4, -73,  88, -38 },
+    { 36, -83,  83, -36, -36,  83, -83,  36,  36, -83,  83, -36, -36,  83, -83,  36,
+      36, -83,  83, -36, -36,  83, -83,  36,  36, -83,  83, -36, -36,  83, -83,  36 },
+    { 31, -78,  90, -61,   4,  54, -88,  82, -38, -22,  73, -90,  67, -13, -46,  85,
+     -85,  46,  13, -67,  90, -73,  22,  38, -82,  88, -54,  -4,  61, -90,  78, -31 },
+    { 25, -70,  90, -80,  43,   9, -57,  87, -87,  57,  -9, -43,  80, -90,  70, -25,
+     -25,  70, -90,  80, -43,  -9,  57, -87,  87, -57,   9,  43, -80,  90, -70,  25 },
+    { 22, -61,  85, -90,  73, -38,  -4,  46, -78,  90, -82,  54, -13, -31,  67, -88,
+      88, -67,  31,  13, -54,  82, -90,  78, -46,   4,  38, -73,  90, -85,  61, -22 },
+    { 18, -50,  75, -89,  89, -75,  50, -18, -18,  50, -75,  89, -89,  75, -50,  18,
+      18, -50,  75, -89,  89, -75,  50, -18, -18,  50, -75,  89, -89,  75, -50,  18 },
+    { 13, -38,  61, -78,  88, -90,  85, -73,  54, -31,   4,  22, -46,  67, -82,  90,
+     -90,  82, -67,  46, -22,  -4,  31, -54,  73, -85,  90, -88,  78, -61,  38, -13 },
+    {  9, -25,  43, -57,  70, -80,  87, -90,  90, -87,  80, -70,  57, -43,  25, -9,
+      -9,  25, -43,  57, -70,  80, -87,  90, -90,  87, -80,  70, -57,  43, -25,   9 },
+    {  4, -13,  22, -31,  38, -46,  54, -61,  67, -73,  78, -82,  85, -88,  90, -90,
+      90, -90,  88, -85,  82, -78,  73, -67,  61, -54,  46, -38,  31, -22,  13,  -4 },
+};
+
+static av_always_inline int coef_pair(int a, int b)
+{
+    return (uint16_t)a | ((unsigned)(uint16_t)b << 16);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// 32x32 inverse transform
+////////////////////////////////////////////////////////////////////////////////
+/* in-lane transpose of four 8x8 blocks of 16-bit words */
+static av_always_inline void transpose_8x8_lanes(__m512i *r)
+{
+    __m512i t[8], u[8];
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        t[2 * i]     = _mm512_unpacklo_epi16(r[2 * i], r[2 * i + 1]);
+        t[2 * i + 1] = _mm512_unpackhi_epi16(r[2 * i], r[2 * i + 1]);
+    }
+    for (i = 0; i < 2; i++) {
+        u[4 * i]     = _mm512_unpacklo_epi32(t[4 * i],     t[4 * i + 2]);
+        u[4 * i + 1] = _mm512_unpackhi_epi32(t[4 * i],     t[4 * i + 2]);
+        u[4 * i + 2] = _mm512_unpacklo_epi32(t[4 * i + 1], t[4 * i + 3]);
+        u[4 * i + 3] = _mm512_unpackhi_epi32(t[4 * i + 1], t[4 * i + 3]);
+    }
+    for (i = 0; i < 4; i++) {
+        r[2 * i]     = _mm512_unpacklo_epi64(u[i], u[i + 4]);
+        r[2 * i + 1] = _mm512_unpackhi_epi64(u[i], u[i + 4]);
+    }
+}
+
+/* after the in-lane transposes, lane l of r[8 * g + i] holds the 8 words
+ * that go to lane g of row 8 * l + i: transpose the 4x4 grid of lanes */
+static av_always_inline void transpose_32x32(__m512i *r)
+{
+    int g, i;
+
+    for (g = 0; g < 4; g++)
+        transpose_8x8_lanes(r + 8 * g);
+    for (i = 0; i < 8; i++) {
+        __m512i t0 = _mm512_shuffle_i64x2(r[i],      r[i + 8],  0x44);
+        __m512i t1 = _mm512_shuffle_i64x2(r[i],      r[i + 8],  0xee);
+        __m512i t2 = _mm512_shuffle_i64x2(r[i + 16], r[i + 24], 0x44);
+        __m512i t3 = _mm512_shuffle_i64x2(r[i + 16], r[i + 24], 0xee);
+        r[i]      = _mm512_shuffle_i64x2(t0, t2, 0x88);
+        r[i + 8]  = _mm512_shuffle_i64x2(t0, t2, 0xdd);
+        r[i + 16] = _mm512_shuffle_i64x2(t1, t3, 0x88);
+        r[i + 24] = _mm512_shuffle_i64x2(t1, t3, 0xdd);
+    }
+}
+
+/* one 32-point pass over all 32 columns, transposed on the way out */
+static av_always_inline void idct32_pass(__m512i *x, int shift)
+{
+    const __m512i add = _mm512_set1_epi32(1 << (shift - 1));
+    __m512i lo[2][32], hi[2][32], pl[8], ph[8];
+    int cur = 0, i, k, m;
+
+    pl[0] = _mm512_unpacklo_epi16(x[0], x[16]);
+    ph[0] = _mm512_unpackhi_epi16(x[0], x[16]);
+    lo[0][0] = _mm512_madd_epi16(pl[0], _mm512_set1_epi32(coef_pair(64,  64)));
+    hi[0][0] = _mm512_madd_epi16(ph[0], _mm512_set1_epi32(coef_pair(64,  64)));
+    lo[0][1] = _mm512_madd_epi16(pl[0], _mm512_set1_epi32(coef_pair(64, -64)));
+    hi[0][1] = _mm512_madd_epi16(ph[0], _mm512_set1_epi32(coef_pair(64, -64)));
+
+    for (m = 4; m <= 32; m <<= 1) {
+        const int step = 32 / m;
+
+        for (i = 0; i < m / 4; i++) {
+            pl[i] = _mm512_unpacklo_epi16(x[(4 * i + 1) * step], x[(4 * i + 3) * step]);
+            ph[i] = _mm512_unpackhi_epi16(x[(4 * i + 1) * step], x[(4 * i + 3) * step]);
+        }
+        for (k = 0; k < m / 2; k++) {
+            __m512i ol = _mm512_setzero_si512();
+            __m512i oh = _mm512_setzero_si512();
+            for (i = 0; i < m / 4; i++) {
+                __m512i c = _mm512_set1_epi32(coef_pair(transform[(4 * i + 1) * step][k],
+                                                        transform[(4 * i + 3) * step][k]));
+                ol = _mm512_add_epi32(ol, _mm512_madd_epi16(pl[i], c));
+                oh = _mm512_add_epi32(oh, _mm512_madd_epi16(ph[i], c));
+            }
+            lo[!cur][k]         = _mm512_add_epi32(lo[cur][k], ol);
+            hi[!cur][k]         = _mm512_add_epi32(hi[cur][k], oh);
+            lo[!cur][m - 1 - k] = _mm512_sub_epi32(lo[cur][k], ol);
+            hi[!cur][m - 1 - k] = _mm512_sub_epi32(hi[cur][k], oh);
+        }
+        cur = !cur;
+    }
+
+    for (k = 0; k < 32; k++)
+        x[k] = _mm512_packs_epi32(_mm512_srai_epi32(_mm512_add_epi32(lo[cur][k], add), shift),
+                                  _mm512_srai_epi32(_mm512_add_epi32(hi[cur][k], add), shift));
+    transpose_32x32(x);
+}
+
+static av_always_inline void transform_32x32_add(uint8_t *dst, int16_t *coeffs,
+                                                 ptrdiff_t stride, int bit_depth)
+{
+    __m512i x[32];
+    int i;
+
+    for (i = 0; i < 32; i++)
+        x[i] = _mm512_loadu_si512(&coeffs[32 * i]);
+    idct32_pass(x, 7);
+    idct32_pass(x, 20 - bit_depth);
+    for (i = 0; i < 32; i++, dst += stride) {
+        if (bit_depth == 8) {
+            __m512i r = _mm512_cvtepu8_epi16(_mm256_loadu_si256((__m256i *)dst));
+            r = _mm512_max_epi16(_mm512_adds_epi16(r, x[i]), _mm512_setzero_si512());
+            _mm256_storeu_si256((__m256i *)dst, _mm512_cvtusepi16_epi8(r));
+        } else {
+            __m512i r = _mm512_adds_epi16(_mm512_loadu_si512(dst), x[i]);
+            r = _mm512_max_epi16(r, _mm512_setzero_si512());
+            r = _mm512_min_epi16(r, _mm512_set1_epi16((1 << bit_depth) - 1));
+            _mm512_storeu_si512(dst, r);
+        }
+    }
+}
+
+void ff_hevc_transform_32x32_add_8_avx512(uint8_t *dst, int16_t *coeffs,
+                                          ptrdiff_t stride)
+{
+    transform_32x32_add(dst, coeffs, stride, 8);
+}
+
+void ff_hevc_transform_32x32_add_10_avx512(uint8_t *dst, int16_t *coeffs,
+                                           ptrdiff_t stride)
+{
+    transform_32x32_add(dst, coeffs, stride, 10);
+}
@@ -0,0 +1,399 @@
+/*
+ * SHVC inter-layer upsampling with AVX2
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavutil/mem.h"
+#include "libavcodec/hevc.h"
+#include "libavcodec/x86/hevcdsp.h"
+#include "libavcodec/hevc_up_sample_filter.h"
+
+#include <immintrin.h>
+
+/*
+ * All functions are bit-exact with the C versions in hevcdsp_template.c.
+ *
+ * The reference column and the phase of an output column do not depend on
+ * the row, so the horizontal pass derives them once per call for chunks of
+ * 64 columns, whatever the ratio, and then filters every row of the chunk
+ * with the same tables. At 8 bits, the 8 outputs of a 128-bit lane read at
+ * most 16 consecutive samples as long as the enhancement layer is not
+ * smaller than the base layer, so each lane loads them once and gathers the
+ * taps of its columns with pshufb; pmaddubsw applies the per-column
+ * coefficients and two (luma) or one (chroma) phaddw finish the sums, in
+ * column order. Above 8 bits the taps of each column are loaded on their
+ * own and reduced with pmaddwd and phaddd.
+ * The vertical pass filters 16 columns at a time with the single phase of
+ * the row. Columns that need a clipped tap are filtered in C.
+ */
+
+#define CHUNK 64
+
+static av_always_inline void h_columns(int *ref, int *phase, int x, int n,
+                                       int left, int right, int scale, int add,
+                                       int ntaps)
+{
+    int k;
+
+    for (k = 0; k < n; k++) {
+        int pos16 = ((av_clip(x + k, left, right) - left) * scale + add) >> 12;
+        ref[k]    = (pos16 >> 4) - (ntaps >> 1) + 1;
+        phase[k]  = pos16 & 15;
+    }
+}
+
+static av_always_inline int h_filter_c(const uint8_t *src, int ref,
+                                       const int32_t *coeff, int ntaps,
+                                       int bl_width, int bit_depth)
+{
+    int sum = 0, k;
+
+    for (k = 0; k < ntaps; k++) {
+        int i = av_clip(ref + k, 0, bl_width - 1);
+        sum  += (bit_depth > 8 ? ((const uint16_t *)src)[i] : src[i]) * coeff[k];
+    }
+    return sum >> (bit_depth - 8);
+}
+
+static av_always_inline void store_columns(int16_t *dst, __m128i v, int n)
+{
+    if (n == 8) {
+        _mm_storeu_si128((__m128i *)dst, v);
+    } else {
+        DECLARE_ALIGNED(16, int16_t, tmp)[8];
+        _mm_store_si128((__m128i *)tmp, v);
+        memcpy(dst, tmp, n * sizeof(*dst));
+    }
+}
+
+void ff_upsample_h_base_layer_rows_8_avx2(int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                          const uint8_t *src, ptrdiff_t src_stride,
+                                          int bl_width, int el_width,
+                                          const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                          const int32_t up_sample_filter_luma[16][8],
+                                          const int32_t up_sample_filter_chroma[16][4],
+                                          int c_idx, int x0, int x1, int y0, int y1)
+{
+    int shift = !!c_idx;
+    int ntaps = c_idx ? NTAPS_CHROMA : NTAPS_LUMA;
+    int scale = c_idx ? up_info->scaleXCr : up_info->scaleXLum;
+    int add   = c_idx ? up_info->addXCr   : up_info->addXLum;
+    int left  = win->left_offset >> shift;
+    int right = el_width - (win->right_offset >> shift) - shift;
+    // columns of a lane held by one shuffle
+    int per_reg = 16 / ntaps;
+    DECLARE_ALIGNED(32, int8_t, mask)[CHUNK / 16][4][32];
+    DECLARE_ALIGNED(32, int8_t, coef)[CHUNK / 16][4][32];
+    int ref[CHUNK], phase[CHUNK], fast[CHUNK / 16];
+    int xc, g, x, y, k;
+
+    for (xc = x0; xc < x1; xc += CHUNK) {
+        int nc      = FFMIN(CHUNK, x1 - xc);
+        int ngroups = (nc + 15) >> 4;
+
+        h_columns(ref, phase, xc, nc, left, right, scale, add, ntaps);
+        // the last group is completed with copies of the last column
+        for (k = nc; k < ngroups << 4; k++) {
+            ref[k]   = ref[nc - 1];
+            phase[k] = phase[nc - 1];
+        }
+        for (g = 0; g < ngroups; g++) {
+            const int *r = ref + 16 * g;
+
+            // the reference positions grow with x
+            fast[g] = r[0] >= 0 && r[8] + 16 <= bl_width &&
+                      r[7] - r[0] + ntaps <= 16 && r[15] - r[8] + ntaps <= 16;
+            if (!fast[g])
+                continue;
+            for (k = 0; k < 16; k++) {
+                const int32_t *c = c_idx ? up_sample_filter_chroma[phase[16 * g + k]] :
+                                           up_sample_filter_luma[phase[16 * g + k]];
+                int lane = k >> 3;
+                int i    = k & 7;
+                int reg  = i / per_reg;
+                int pos  = lane * 16 + (i % per_reg) * ntaps;
+                for (x = 0; x < ntaps; x++) {
+                    mask[g][reg][pos + x] = r[k] - r[lane * 8] + x;
+                    coef[g][reg][pos + x] = c[x];
+                }
+            }
+        }
+
+        for (y = y0; y < y1; y++) {
+            const uint8_t *s = src + y * src_stride;
+            int16_t *dst     = stripe + (y % stripe_rows) * stripe_stride + xc;
+
+            for (g = 0; g < ngroups; g++) {
+                const int *r = ref + 16 * g;
+                int n        = FFMIN(16, nc - 16 * g);
+                int16_t *d   = dst + 16 * g;
+
+                if (fast[g]) {
+                    __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)&s[r[0]])),
+                                                        _mm_loadu_si128((const __m128i *)&s[r[8]]), 1);
+                    __m256i m[4];
+
+                    for (k = 0; k < 8 / per_reg; k++)
+                        m[k] = _mm256_maddubs_epi16(_mm256_shuffle_epi8(v, _mm256_load_si256((const __m256i *)mask[g][k])),
+                                                    _mm256_load_si256((const __m256i *)coef[g][k]));
+                    if (ntaps == NTAPS_LUMA)
+                        v = _mm256_hadd_epi16(_mm256_hadd_epi16(m[0], m[1]),
+                                              _mm256_hadd_epi16(m[2], m[3]));
+                    else
+                        v = _mm256_hadd_epi16(m[0], m[1]);
+                    store_columns(d,     _mm256_castsi256_si128(v),      FFMIN(n, 8));
+                    if (n > 8)
+                        store_columns(d + 8, _mm256_extracti128_si256(v, 1), n - 8);
+                } else {
+                    for (k = 0; k < n; k++) {
+                        const int32_t *c = c_idx ? up_sample_filter_chroma[phase[16 * g + k]] :
+                                                   up_sample_filter_luma[phase[16 * g + k]];
+                        d[k] = h_filter_c(s, r[k], c, ntaps, bl_width, 8);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static av_always_inline __m128i h_taps_16(const uint16_t *s, int ref, __m128i coeff,
+                                          int ntaps)
+{
+    __m128i v = ntaps == NTAPS_LUMA ? _mm_loadu_si128((const __m128i *)&s[ref]) :
+                                      _mm_loadl_epi64((const __m128i *)&s[ref]);
+    return _mm_madd_epi16(v, coeff);
+}
+
+static av_always_inline __m256i pair(__m128i lo, __m128i hi)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+void ff_upsample_h_base_layer_rows_10_avx2(int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                           const uint8_t *_src, ptrdiff_t _src_stride,
+                                           int bl_width, int el_width,
+                                           const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                           const int32_t up_sample_filter_luma[16][8],
+                                           const int32_t up_sample_filter_chroma[16][4],
+                                           int c_idx, int x0, int x1, int y0, int y1)
+{
+    const uint16_t *src  = (const uint16_t *)_src;
+    ptrdiff_t src_stride = _src_stride / sizeof(uint16_t);
+    int shift = !!c_idx;
+    int ntaps = c_idx ? NTAPS_CHROMA : NTAPS_LUMA;
+    int scale = c_idx ? up_info->scaleXCr : up_info->scaleXLum;
+    int add   = c_idx ? up_info->addXCr   : up_info->addXLum;
+    int left  = win->left_offset >> shift;
+    int right = el_width - (win->right_offset >> shift) - shift;
+    __m128i coeffs[16];
+    int ref[CHUNK], phase[CHUNK], fast[CHUNK / 8];
+    int xc, g, y, k;
+
+    for (k = 0; k < 16; k++) {
+        if (c_idx)
+            coeffs[k] = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)up_sample_filter_chroma[k]),
+                                        _mm_setzero_si128());
+        else
+            coeffs[k] = _mm_packs_epi32(_mm_loadu_si128((const __m128i *)&up_sample_filter_luma[k][0]),
+                                        _mm_loadu_si128((const __m128i *)&up_sample_filter_luma[k][4]));
+    }
+
+    for (xc = x0; xc < x1; xc += CHUNK) {
+        int nc      = FFMIN(CHUNK, x1 - xc);
+        int ngroups = (nc + 7) >> 3;
+
+        h_columns(ref, phase, xc, nc, left, right, scale, add, ntaps);
+        for (k = nc; k < ngroups << 3; k++) {
+            ref[k]   = ref[nc - 1];
+            phase[k] = phase[nc - 1];
+        }
+        for (g = 0; g < ngroups; g++)
+            fast[g] = ref[8 * g] >= 0 && ref[8 * g + 7] + ntaps <= bl_width;
+
+        for (y = y0; y < y1; y++) {
+            const uint16_t *s = src + y * src_stride;
+            int16_t *dst      = stripe + (y % stripe_rows) * stripe_stride + xc;
+
+            for (g = 0; g < ngroups; g++) {
+                const int *r = ref   + 8 * g;
+                const int *p = phase + 8 * g;
+                int n        = FFMIN(8, nc - 8 * g);
+                int16_t *d   = dst + 8 * g;
+
+                if (fast[g]) {
+                    __m256i t;
+
+                    if (ntaps == NTAPS_LUMA) {
+                        __m256i a = pair(h_taps_16(s, r[0], coeffs[p[0]], ntaps),
+                                         h_taps_16(s, r[4], coeffs[p[4]], ntaps));
+                        __m256i b = pair(h_taps_16(s, r[1], coeffs[p[1]], ntaps),
+                                         h_taps_16(s, r[5], coeffs[p[5]], ntaps));
+                        __m256i c = pair(h_taps_16(s, r[2], coeffs[p[2]], ntaps),
+                                         h_taps_16(s, r[6], coeffs[p[6]], ntaps));
+                        __m256i e = pair(h_taps_16(s, r[3], coeffs[p[3]], ntaps),
+                                         h_taps_16(s, r[7], coeffs[p[7]], ntaps));
+                        t = _mm256_hadd_epi32(_mm256_hadd_epi32(a, b),
+                                              _mm256_hadd_epi32(c, e));
+                    } else {
+                        __m256i a = pair(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)&s[r[0]]),
+                                                            _mm_loadl_epi64((const __m128i *)&s[r[1]])),
+                                         _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)&s[r[4]]),
+                                                            _mm_loadl_epi64((const __m128i *)&s[r[5]])));
+                        __m256i b = pair(_mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)&s[r[2]]),
+                                                            _mm_loadl_epi64((const __m128i *)&s[r[3]])),
+                                         _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)&s[r[6]]),
+                                                            _mm_loadl_epi64((const __m128i *)&s[r[7]])));
+                        __m256i ca = pair(_mm_unpacklo_epi64(coeffs[p[0]], coeffs[p[1]]),
+                                          _mm_unpacklo_epi64(coeffs[p[4]], coeffs[p[5]]));
+                        __m256i cb = pair(_mm_unpacklo_epi64(coeffs[p[2]], coeffs[p[3]]),
+                                          _mm_unpacklo_epi64(coeffs[p[6]], coeffs[p[7]]));
+                        t = _mm256_hadd_epi32(_mm256_madd_epi16(a, ca),
+                                              _mm256_madd_epi16(b, cb));
+                    }
+                    t = _mm256_srai_epi32(t, 2);
+                    t = _mm256_permute4x64_epi64(_mm256_packs_epi32(t, t), 0x08);
+                    store_columns(d, _mm256_castsi256_si128(t), n);
+                } else {
+                    for (k = 0; k < n; k++) {
+                        const int32_t *c = c_idx ? up_sample_filter_chroma[p[k]] :
+                                                   up_sample_filter_luma[p[k]];
+                        d[k] = h_filter_c((const uint8_t *)s, r[k], c, ntaps, bl_width, 10);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static av_always_inline int v_filter_c(const int16_t *src[NTAPS_LUMA], int col,
+                                       const int32_t *coeff, int ntaps, int bit_depth)
+{
+    const int nshift = US_FILTER_PREC * 2 - (bit_depth - 8);
+    int sum = 0, k;
+
+    for (k = 0; k < ntaps; k++)
+        sum += src[k][col] * coeff[k];
+    return av_clip_uintp2((sum + (1 << (nshift - 1))) >> nshift, bit_depth);
+}
+
+static av_always_inline void v_filter_16(uint8_t *dst, const int16_t *src[NTAPS_LUMA],
+                                         int col, const __m256i *coeffs, int ntaps,
+                                         int bit_depth)
+{
+    const int nshift = US_FILTER_PREC * 2 - (bit_depth - 8);
+    __m256i lo = _mm256_set1_epi32(1 << (nshift - 1));
+    __m256i hi = lo;
+    int k;
+
+    for (k = 0; k < ntaps; k += 2) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)&src[k][col]);
+        __m256i b = _mm256_loadu_si256((const __m256i *)&src[k + 1][col]);
+        lo = _mm256_add_epi32(lo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), coeffs[k >> 1]));
+        hi = _mm256_add_epi32(hi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), coeffs[k >> 1]));
+    }
+    // the in-lane unpacks and pack leave the columns in order
+    lo = _mm256_packs_epi32(_mm256_srai_epi32(lo, nshift), _mm256_srai_epi32(hi, nshift));
+    if (bit_depth == 8) {
+        lo = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, lo), 0x08);
+        _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(lo));
+    } else {
+        lo = _mm256_max_epi16(lo, _mm256_setzero_si256());
+        lo = _mm256_min_epi16(lo, _mm256_set1_epi16((1 << bit_depth) - 1));
+        _mm256_storeu_si256((__m256i *)dst, lo);
+    }
+}
+
+static av_always_inline void put_pixel(uint8_t *dst, int x, int v, int bit_depth)
+{
+    if (bit_depth > 8)
+        ((uint16_t *)dst)[x] = v;
+    else
+        dst[x] = v;
+}
+
+static av_always_inline void upsample_v(uint8_t *dst, ptrdiff_t dst_stride,
+                                        const int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                        int bl_height, int el_width, int el_height,
+                                        const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                        const int32_t up_sample_filter_luma[16][8],
+                                        const int32_t up_sample_filter_chroma[16][4],
+                                        int c_idx, int x0, int x1, int y0, int y1,
+                                        int bit_depth)
+{
+    const int ps = bit_depth > 8 ? 2 : 1;
+    int shift = !!c_idx;
+    int ntaps = c_idx ? NTAPS_CHROMA : NTAPS_LUMA;
+    int left  = win->left_offset >> shift;
+    int right = el_width - (win->right_offset >> shift);
+    // columns inside the window
+    int xl    = FFMAX(x0, left);
+    int xr    = FFMIN(x1, right);
+    const int16_t *src[NTAPS_LUMA];
+    __m256i coeffs[NTAPS_LUMA / 2];
+    int x, y, k;
+
+    for (y = y0; y < y1; y++) {
+        int pos16 = ff_hevc_il_ref_pos16_y(win, up_info, c_idx, el_height, y);
+        int ref   = (pos16 >> 4) - (ntaps >> 1) + 1;
+        const int32_t *coeff = c_idx ? up_sample_filter_chroma[pos16 & 15] :
+                                       up_sample_filter_luma[pos16 & 15];
+        uint8_t *d = dst + y * dst_stride;
+
+        for (k = 0; k < ntaps; k++)
+            src[k] = stripe + (av_clip(ref + k, 0, bl_height - 1) % stripe_rows) * stripe_stride;
+        for (k = 0; k < ntaps; k += 2)
+            coeffs[k >> 1] = _mm256_set1_epi32((coeff[k + 1] << 16) | (coeff[k] & 0xffff));
+
+        x = x0;
+        if (xr - xl >= 16) {
+            // the last chunk overlaps the previous one, which writes the same values
+            for (x = xl; x < xr; x += 16) {
+                int xs = FFMIN(x, xr - 16);
+                v_filter_16(d + xs * ps, src, xs - left, coeffs, ntaps, bit_depth);
+            }
+            for (x = x0; x < xl; x++)
+                put_pixel(d, x, v_filter_c(src, 0, coeff, ntaps, bit_depth), bit_depth);
+            x = xr;
+        }
+        // outside the window, the edge columns of the window are repeated
+        for (; x < x1; x++)
+            put_pixel(d, x, v_filter_c(src, av_clip(x - left, 0, right - 1 - left),
+                                       coeff, ntaps, bit_depth), bit_depth);
+    }
+}
+
+#define UPSAMPLE_V(D)                                                                                  \
+void ff_upsample_v_base_layer_rows_ ## D ## _avx2(uint8_t *dst, ptrdiff_t dst_stride,                  \
+                                                  const int16_t *stripe, ptrdiff_t stripe_stride,      \
+                                                  int stripe_rows, int bl_height,                      \
+                                                  int el_width, int el_height,                         \
+                                                  const struct HEVCWindow *win,                        \
+                                                  const struct UpsamplInf *up_info,                    \
+                                                  const int32_t up_sample_filter_luma[16][8],          \
+                                                  const int32_t up_sample_filter_chroma[16][4],        \
+                                                  int c_idx, int x0, int x1, int y0, int y1)           \
+{                                                                                                      \
+    upsample_v(dst, dst_stride, stripe, stripe_stride, stripe_rows, bl_height, el_width, el_height,   \
+               win, up_info, up_sample_filter_luma, up_sample_filter_chroma,                          \
+               c_idx, x0, x1, y0, y1, D);                                                             \
+}
+
+UPSAMPLE_V( 8)
+UPSAMPLE_V(10)
@@ -699,3 +699,47 @@ void pred_angular_3_8_sse(uint8_t *_src, const uint8_t *_top, const uint8_t *_le
         TRANSPOSE32x32B(src_tmp, size, _src, _stride);
     }
 }
+
+void ref_filter_8_sse(uint8_t *dst, const uint8_t *src, int len)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i add  = _mm_set1_epi16(2);
+    int last = src[len - 1];
+    int x;
+
+    for (x = 0; x < len; x += 8) {
+        __m128i r1 = _mm_loadl_epi64((const __m128i *)&src[x]);
+        __m128i r0 = _mm_loadl_epi64((const __m128i *)&src[x - 1]);
+        // src[len] is not part of the reference array, shift it in instead
+        __m128i r2 = x + 8 < len ? _mm_loadl_epi64((const __m128i *)&src[x + 1]) :
+                                   _mm_srli_si128(r1, 1);
+        r0 = _mm_unpacklo_epi8(r0, zero);
+        r1 = _mm_unpacklo_epi8(r1, zero);
+        r2 = _mm_unpacklo_epi8(r2, zero);
+        r0 = _mm_add_epi16(_mm_add_epi16(r0, r2), _mm_add_epi16(r1, r1));
+        r0 = _mm_srli_epi16(_mm_add_epi16(r0, add), 2);
+        _mm_storel_epi64((__m128i *)&dst[x], _mm_packus_epi16(r0, r0));
+    }
+    dst[len - 1] = last;
+}
+
+void ref_filter_strong_8_sse(uint8_t *dst, const uint8_t *src)
+{
+    // (63 - i) * first + (i + 1) * last == 64 * first + (i + 1) * (last - first)
+    const __m128i base = _mm_set1_epi16((src[-1] << 6) + 32);
+    const __m128i diff = _mm_set1_epi16(src[63] - src[-1]);
+    const __m128i step = _mm_set1_epi16(8);
+    __m128i w = _mm_setr_epi16(1, 2, 3, 4, 5, 6, 7, 8);
+    int x;
+
+    for (x = 0; x < 64; x += 16) {
+        __m128i r0 = _mm_add_epi16(base, _mm_mullo_epi16(w, diff));
+        __m128i r1;
+        w  = _mm_add_epi16(w, step);
+        r1 = _mm_add_epi16(base, _mm_mullo_epi16(w, diff));
+        w  = _mm_add_epi16(w, step);
+        r0 = _mm_srai_epi16(r0, 6);
+        r1 = _mm_srai_epi16(r1, 6);
+        _mm_storeu_si128((__m128i *)&dst[x], _mm_packus_epi16(r0, r1));
+    }
+}
@@ -0,0 +1,138 @@
+/*
+ * Provide AVX2 weighted prediction functions for HEVC decoding
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavcodec/hevc.h"
+#include "libavcodec/hevcdsp.h"
+#include "libavcodec/x86/hevcdsp.h"
+
+#include <immintrin.h>
+
+/*
+ * Explicit weighted prediction, 16 samples at a time, with the HEVCWeight
+ * records of the slice. As in the SSE4 versions, (sample, 1) pairs are
+ * multiplied by (weight, round) and (src1, src2) pairs by (w0, w1) with
+ * pmaddwd, then packed with signed saturation. The unpacks and packs both
+ * work within 128-bit lanes, so the samples come back in order. Columns
+ * past the last multiple of 16 go to the SSE4 functions.
+ */
+
+/* clip 16 words to the pixel range and store them */
+static av_always_inline void store16(uint8_t *dst, __m256i v, int bit_depth)
+{
+    if (bit_depth == 8) {
+        _mm_storeu_si128((__m128i *)dst,
+                         _mm_packus_epi16(_mm256_castsi256_si128(v),
+                                          _mm256_extracti128_si256(v, 1)));
+        return;
+    }
+    v = _mm256_max_epi16(_mm256_min_epi16(v, _mm256_set1_epi16((1 << bit_depth) - 1)),
+                         _mm256_setzero_si256());
+    _mm256_storeu_si256((__m256i *)dst, v);
+}
+
+static av_always_inline void weighted_pred(const HEVCWeight *wp,
+                                           uint8_t *dst, ptrdiff_t dststride,
+                                           int16_t *src, ptrdiff_t srcstride,
+                                           int width, int height, int bit_depth)
+{
+    const int shift   = wp->shift;
+    const __m256i m1  = _mm256_set1_epi32((wp->round << 16) | (wp->weight & 0xffff));
+    const __m256i add = _mm256_set1_epi32(wp->offset);
+    const __m256i one = _mm256_set1_epi16(1);
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 16) {
+            __m256i s  = _mm256_loadu_si256((const __m256i *)&src[x]);
+            __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(s, one), m1);
+            __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(s, one), m1);
+            lo = _mm256_add_epi32(_mm256_srai_epi32(lo, shift), add);
+            hi = _mm256_add_epi32(_mm256_srai_epi32(hi, shift), add);
+            store16(dst + x * (bit_depth > 8 ? 2 : 1), _mm256_packs_epi32(lo, hi), bit_depth);
+        }
+        dst += dststride;
+        src += srcstride;
+    }
+}
+
+static av_always_inline void weighted_pred_avg(const HEVCWeight *wp0, const HEVCWeight *wp1,
+                                               uint8_t *dst, ptrdiff_t dststride,
+                                               int16_t *src1, int16_t *src2,
+                                               ptrdiff_t srcstride,
+                                               int width, int height, int bit_depth)
+{
+    const int log2Wd = wp0->shift;
+    const __m256i m1 = _mm256_set1_epi32((wp1->weight << 16) | (wp0->weight & 0xffff));
+    const __m256i m3 = _mm256_set1_epi32((wp0->offset + wp1->offset + 1) << log2Wd);
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 16) {
+            __m256i a  = _mm256_loadu_si256((const __m256i *)&src1[x]);
+            __m256i b  = _mm256_loadu_si256((const __m256i *)&src2[x]);
+            __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), m1);
+            __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), m1);
+            lo = _mm256_srai_epi32(_mm256_add_epi32(lo, m3), log2Wd + 1);
+            hi = _mm256_srai_epi32(_mm256_add_epi32(hi, m3), log2Wd + 1);
+            store16(dst + x * (bit_depth > 8 ? 2 : 1), _mm256_packs_epi32(lo, hi), bit_depth);
+        }
+        dst  += dststride;
+        src1 += srcstride;
+        src2 += srcstride;
+    }
+}
+
+#define WEIGHTED_PRED_AVX2(D)                                                  \
+void ff_hevc_weighted_pred_ ## D ## _avx2(const HEVCWeight *wp,                \
+                                          uint8_t *dst, ptrdiff_t dststride,   \
+                                          int16_t *src, ptrdiff_t srcstride,   \
+                                          int width, int height)               \
+{                                                                              \
+    int w16 = width & ~15;                                                     \
+                                                                               \
+    weighted_pred(wp, dst, dststride, src, srcstride, w16, height, D);         \
+    if (width > w16)                                                           \
+        ff_hevc_weighted_pred_ ## D ## _sse(wp, dst + w16 * ((D + 7) >> 3),    \
+                                            dststride, src + w16, srcstride,   \
+                                            width - w16, height);              \
+}                                                                              \
+                                                                               \
+void ff_hevc_weighted_pred_avg_ ## D ## _avx2(const HEVCWeight *wp0,           \
+                                              const HEVCWeight *wp1,           \
+                                              uint8_t *dst, ptrdiff_t dststride, \
+                                              int16_t *src1, int16_t *src2,    \
+                                              ptrdiff_t srcstride,             \
+                                              int width, int height)           \
+{                                                                              \
+    int w16 = width & ~15;                                                     \
+                                                                               \
+    weighted_pred_avg(wp0, wp1, dst, dststride, src1, src2, srcstride,         \
+                      w16, height, D);                                         \
+    if (width > w16)                                                           \
+        ff_hevc_weighted_pred_avg_ ## D ## _sse(wp0, wp1,                      \
+                                                dst + w16 * ((D + 7) >> 3),    \
+                                                dststride, src1 + w16,         \
+                                                src2 + w16, srcstride,         \
+                                                width - w16, height);          \
+}
+
+WEIGHTED_PRED_AVX2( 8)
+WEIGHTED_PRED_AVX2(10)
@@ -0,0 +1,379 @@
+/*
+ * Provide AVX-512 luma MC functions for HEVC decoding
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/mem.h"
+#include "libavcodec/hevc.h"
+#include "libavcodec/hevcdsp.h"
+#include "libavcodec/x86/hevcdsp.h"
+
+#include <immintrin.h>
+
+/*
+ * Luma interpolation for 32 and 64 wide prediction blocks and the
+ * bi-prediction average. Samples are processed as 32 16-bit words per
+ * register at both bit depths; row tails use masked loads and stores.
+ * The results are bit-exact with hevcdsp_template.c.
+ */
+
+static const int8_t qpel_filters[3][8] = {
+    { -1,  4, -10, 58, 17,  -5,  1,  0 },
+    { -1,  4, -11, 40, 40, -11,  4, -1 },
+    {  0,  1,  -5, 17, 58, -10,  4, -1 },
+};
+
+static av_always_inline int coef_pair(int a, int b)
+{
+    return (uint16_t)a | ((unsigned)(uint16_t)b << 16);
+}
+
+static av_always_inline __mmask32 tail_mask(int n)
+{
+    return n >= 32 ? 0xffffffff : (1U << n) - 1;
+}
+
+/* n (at most 32) samples as 16-bit words */
+static av_always_inline __m512i load_pixels(const uint8_t *src, int n, int bit_depth)
+{
+    if (bit_depth == 8) {
+        if (n >= 32)
+            return _mm512_cvtepu8_epi16(_mm256_loadu_si256((const __m256i *)src));
+        return _mm512_cvtepu8_epi16(_mm256_maskz_loadu_epi8(tail_mask(n), src));
+    }
+    if (n >= 32)
+        return _mm512_loadu_si512(src);
+    return _mm512_maskz_loadu_epi16(tail_mask(n), src);
+}
+
+/* clip n (at most 32) words to the pixel range and store them */
+static av_always_inline void store_pixels(uint8_t *dst, __m512i v, int n, int bit_depth)
+{
+    v = _mm512_max_epi16(v, _mm512_setzero_si512());
+    if (bit_depth == 8) {
+        __m256i p = _mm512_cvtusepi16_epi8(v);
+        if (n >= 32)
+            _mm256_storeu_si256((__m256i *)dst, p);
+        else
+            _mm256_mask_storeu_epi8(dst, tail_mask(n), p);
+        return;
+    }
+    v = _mm512_min_epi16(v, _mm512_set1_epi16((1 << bit_depth) - 1));
+    if (n >= 32)
+        _mm512_storeu_si512(dst, v);
+    else
+        _mm512_mask_storeu_epi16(dst, tail_mask(n), v);
+}
+
+/*
+ * 32-bit results are kept as the pair of unpacklo/unpackhi halves of the
+ * 16-bit words; packing them back restores the sample order.
+ */
+static av_always_inline void widen(__m512i v, __m512i *lo, __m512i *hi)
+{
+    *lo = _mm512_srai_epi32(_mm512_unpacklo_epi16(_mm512_setzero_si512(), v), 16);
+    *hi = _mm512_srai_epi32(_mm512_unpackhi_epi16(_mm512_setzero_si512(), v), 16);
+}
+
+/* pack with the wrap-around of a store to int16_t */
+static av_always_inline __m512i pack_trunc(__m512i lo, __m512i hi)
+{
+    const __m512i mask = _mm512_set1_epi32(0xffff);
+    return _mm512_packus_epi32(_mm512_and_si512(lo, mask), _mm512_and_si512(hi, mask));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// luma interpolation
+////////////////////////////////////////////////////////////////////////////////
+/*
+ * 8-tap filter f (1 to 3) over the taps s[], 32-bit result. Only the taps
+ * read by the C filter are used: filter 1 does not use the last one and
+ * filter 3 not the first one.
+ */
+static av_always_inline void qpel_filter(const __m512i *s, int f,
+                                         __m512i *lo, __m512i *hi)
+{
+    const int8_t *c = qpel_filters[f - 1];
+    int first = f == 3;
+    int last  = f == 1 ? 6 : 7;
+    __m512i l = _mm512_setzero_si512();
+    __m512i h = _mm512_setzero_si512();
+    int t;
+
+    for (t = first; t <= last; t += 2) {
+        __m512i b = t < last ? s[t + 1] : s[t];
+        __m512i k = _mm512_set1_epi32(coef_pair(c[t], t < last ? c[t + 1] : 0));
+        l = _mm512_add_epi32(l, _mm512_madd_epi16(_mm512_unpacklo_epi16(s[t], b), k));
+        h = _mm512_add_epi32(h, _mm512_madd_epi16(_mm512_unpackhi_epi16(s[t], b), k));
+    }
+    *lo = l;
+    *hi = h;
+}
+
+static av_always_inline void load_taps_h(__m512i *s, const uint8_t *src, int f, int bit_depth)
+{
+    const int ps = (bit_depth + 7) >> 3;
+    int t;
+
+    for (t = f == 3; t <= (f == 1 ? 6 : 7); t++)
+        s[t] = load_pixels(src + (t - 3) * ps, 32, bit_depth);
+}
+
+static av_always_inline void qpel_h(int16_t *dst, ptrdiff_t dststride,
+                                    const uint8_t *src, ptrdiff_t srcstride,
+                                    int width, int height, int f, int bit_depth)
+{
+    const int ps = (bit_depth + 7) >> 3;
+    __m512i s[8], lo, hi;
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 32) {
+            load_taps_h(s, src + x * ps, f, bit_depth);
+            qpel_filter(s, f, &lo, &hi);
+            lo = _mm512_srai_epi32(lo, bit_depth - 8);
+            hi = _mm512_srai_epi32(hi, bit_depth - 8);
+            _mm512_storeu_si512(&dst[x], pack_trunc(lo, hi));
+        }
+        src += srcstride;
+        dst += dststride;
+    }
+}
+
+/*
+ * Vertical filter over rows of samples (bit_depth 8 or 10) or of 16-bit
+ * intermediates (bit_depth 14), with a sliding window of taps.
+ */
+static av_always_inline void qpel_v(int16_t *dst, ptrdiff_t dststride,
+                                    const uint8_t *src, ptrdiff_t srcstride,
+                                    int width, int height, int f, int bit_depth)
+{
+    const int ps    = (bit_depth + 7) >> 3 > 1 ? 2 : 1;
+    const int shift = bit_depth == 14 ? 6 : bit_depth - 8;
+    const int first = f == 3;
+    const int last  = f == 1 ? 6 : 7;
+    __m512i s[8], lo, hi;
+    int x, y, t;
+
+    for (x = 0; x < width; x += 32) {
+        const uint8_t *p = src + x * ps + (first - 3) * srcstride;
+        int16_t *d       = dst + x;
+
+        for (t = first; t < last; t++, p += srcstride)
+            s[t] = load_pixels(p, 32, bit_depth == 8 ? 8 : 16);
+        for (y = 0; y < height; y++, p += srcstride, d += dststride) {
+            s[last] = load_pixels(p, 32, bit_depth == 8 ? 8 : 16);
+            qpel_filter(s, f, &lo, &hi);
+            lo = _mm512_srai_epi32(lo, shift);
+            hi = _mm512_srai_epi32(hi, shift);
+            _mm512_storeu_si512(d, pack_trunc(lo, hi));
+            for (t = first; t < last; t++)
+                s[t] = s[t + 1];
+        }
+    }
+}
+
+static av_always_inline void qpel_pixels(int16_t *dst, ptrdiff_t dststride,
+                                         const uint8_t *src, ptrdiff_t srcstride,
+                                         int width, int height, int bit_depth)
+{
+    const int ps = (bit_depth + 7) >> 3;
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 32)
+            _mm512_storeu_si512(&dst[x], _mm512_slli_epi16(load_pixels(src + x * ps, 32, bit_depth),
+                                                           14 - bit_depth));
+        src += srcstride;
+        dst += dststride;
+    }
+}
+
+/*
+ * Fused interpolation and rounding into the picture, averaged with src2
+ * for bi-prediction, as put_hevc_qpel_fused() in the template.
+ */
+static av_always_inline void qpel_fused(uint8_t *dst, ptrdiff_t dststride,
+                                        const uint8_t *src, ptrdiff_t srcstride,
+                                        const int16_t *src2, ptrdiff_t src2stride,
+                                        int width, int height, int mx, int my,
+                                        int bi, int bit_depth)
+{
+    DECLARE_ALIGNED(64, int16_t, tmp_array)[(MAX_PB_SIZE + 7) * MAX_PB_SIZE];
+    const int ps     = (bit_depth + 7) >> 3;
+    const int shift  = 14 - bit_depth + bi;
+    const __m512i offset = _mm512_set1_epi32(1 << (shift - 1));
+    const int16_t *tmp = tmp_array;
+    __m512i s[8], lo, hi;
+    int x, y, t;
+
+    if (mx && my) {
+        int before = ff_hevc_qpel_extra_before[my];
+        qpel_h(tmp_array, MAX_PB_SIZE, src - before * srcstride, srcstride,
+               width, height + ff_hevc_qpel_extra[my], mx, bit_depth);
+        tmp = tmp_array + before * MAX_PB_SIZE;
+    }
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 32) {
+            if (mx && my) {
+                for (t = my == 3; t <= (my == 1 ? 6 : 7); t++)
+                    s[t] = _mm512_loadu_si512(&tmp[x + (t - 3) * MAX_PB_SIZE]);
+                qpel_filter(s, my, &lo, &hi);
+                lo = _mm512_srai_epi32(lo, 6);
+                hi = _mm512_srai_epi32(hi, 6);
+            } else if (mx || my) {
+                const int f = mx ? mx : my;
+                for (t = f == 3; t <= (f == 1 ? 6 : 7); t++)
+                    s[t] = load_pixels(src + x * ps + (t - 3) * (mx ? ps : srcstride),
+                                       32, bit_depth);
+                qpel_filter(s, f, &lo, &hi);
+                lo = _mm512_srai_epi32(lo, bit_depth - 8);
+                hi = _mm512_srai_epi32(hi, bit_depth - 8);
+            } else {
+                widen(_mm512_slli_epi16(load_pixels(src + x * ps, 32, bit_depth), 14 - bit_depth),
+                      &lo, &hi);
+            }
+            if (bi) {
+                __m512i l2, h2;
+                widen(_mm512_loadu_si512(&src2[x]), &l2, &h2);
+                lo = _mm512_add_epi32(lo, l2);
+                hi = _mm512_add_epi32(hi, h2);
+            }
+            lo = _mm512_srai_epi32(_mm512_add_epi32(lo, offset), shift);
+            hi = _mm512_srai_epi32(_mm512_add_epi32(hi, offset), shift);
+            store_pixels(dst + x * ps, _mm512_packs_epi32(lo, hi), 32, bit_depth);
+        }
+        src  += srcstride;
+        tmp  += MAX_PB_SIZE;
+        dst  += dststride;
+        src2 += src2stride;
+    }
+}
+
+#define QPEL_H_V(D, F)                                                         \
+void ff_hevc_put_hevc_qpel_h_ ## F ## _ ## D ## _avx512(int16_t *dst,          \
+                                                      ptrdiff_t dststride,     \
+                                                      uint8_t *src,            \
+                                                      ptrdiff_t srcstride,     \
+                                                      int width, int height)   \
+{                                                                              \
+    qpel_h(dst, dststride, src, srcstride, width, height, F, D);               \
+}                                                                              \
+void ff_hevc_put_hevc_qpel_v_ ## F ## _ ## D ## _avx512(int16_t *dst,          \
+                                                      ptrdiff_t dststride,     \
+                                                      uint8_t *src,            \
+                                                      ptrdiff_t srcstride,     \
+                                                      int width, int height)   \
+{                                                                              \
+    qpel_v(dst, dststride, src, srcstride, width, height, F, D);               \
+}
+
+#define QPEL_V_14(F)                                                           \
+void ff_hevc_put_hevc_qpel_v_14_ ## F ## _avx512(int16_t *dst,                 \
+                                               ptrdiff_t dststride,            \
+                                               uint8_t *src,                   \
+                                               ptrdiff_t srcstride,            \
+                                               int width, int height)          \
+{                                                                              \
+    qpel_v(dst, dststride, src, srcstride, width, height, F, 14);              \
+}
+
+#define QPEL_FUSED(D, V, H)                                                    \
+void ff_hevc_put_hevc_qpel_uni_h ## H ## v ## V ## _ ## D ## _avx512(          \
+    uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride,      \
+    int width, int height)                                                     \
+{                                                                              \
+    qpel_fused(dst, dststride, src, srcstride, NULL, 0,                        \
+               width, height, H, V, 0, D);                                     \
+}                                                                              \
+void ff_hevc_put_hevc_qpel_bi_h ## H ## v ## V ## _ ## D ## _avx512(           \
+    uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride,      \
+    int16_t *src2, ptrdiff_t src2stride, int width, int height)                \
+{                                                                              \
+    qpel_fused(dst, dststride, src, srcstride, src2, src2stride,               \
+               width, height, H, V, 1, D);                                     \
+}
+
+#define QPEL_FUNCS(D)                                                          \
+void ff_hevc_put_hevc_qpel_pixels_ ## D ## _avx512(int16_t *dst,               \
+                                                 ptrdiff_t dststride,          \
+                                                 uint8_t *src,                 \
+                                                 ptrdiff_t srcstride,          \
+                                                 int width, int height)        \
+{                                                                              \
+    qpel_pixels(dst, dststride, src, srcstride, width, height, D);             \
+}                                                                              \
+QPEL_H_V(D, 1) QPEL_H_V(D, 2) QPEL_H_V(D, 3)                                   \
+QPEL_FUSED(D, 0, 0) QPEL_FUSED(D, 0, 1) QPEL_FUSED(D, 0, 2) QPEL_FUSED(D, 0, 3) \
+QPEL_FUSED(D, 1, 0) QPEL_FUSED(D, 1, 1) QPEL_FUSED(D, 1, 2) QPEL_FUSED(D, 1, 3) \
+QPEL_FUSED(D, 2, 0) QPEL_FUSED(D, 2, 1) QPEL_FUSED(D, 2, 2) QPEL_FUSED(D, 2, 3) \
+QPEL_FUSED(D, 3, 0) QPEL_FUSED(D, 3, 1) QPEL_FUSED(D, 3, 2) QPEL_FUSED(D, 3, 3)
+
+QPEL_FUNCS( 8)
+QPEL_FUNCS(10)
+QPEL_V_14(1)
+QPEL_V_14(2)
+QPEL_V_14(3)
+
+////////////////////////////////////////////////////////////////////////////////
+// bi-prediction average
+////////////////////////////////////////////////////////////////////////////////
+static av_always_inline void weighted_pred_avg(uint8_t *dst, ptrdiff_t dststride,
+                                               const int16_t *src1, const int16_t *src2,
+                                               ptrdiff_t srcstride,
+                                               int width, int height, int bit_depth)
+{
+    const int ps    = (bit_depth + 7) >> 3;
+    const int shift = 15 - bit_depth;
+    const __m512i offset = _mm512_set1_epi32(1 << (shift - 1));
+    const __m512i ones   = _mm512_set1_epi16(1);
+    int x, y;
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 32) {
+            __mmask32 m = tail_mask(width - x);
+            __m512i a   = _mm512_maskz_loadu_epi16(m, &src1[x]);
+            __m512i b   = _mm512_maskz_loadu_epi16(m, &src2[x]);
+            /* the sum of two predictions needs 17 bits */
+            __m512i lo  = _mm512_madd_epi16(_mm512_unpacklo_epi16(a, b), ones);
+            __m512i hi  = _mm512_madd_epi16(_mm512_unpackhi_epi16(a, b), ones);
+            lo = _mm512_srai_epi32(_mm512_add_epi32(lo, offset), shift);
+            hi = _mm512_srai_epi32(_mm512_add_epi32(hi, offset), shift);
+            store_pixels(dst + x * ps, _mm512_packs_epi32(lo, hi), width - x, bit_depth);
+        }
+        dst  += dststride;
+        src1 += srcstride;
+        src2 += srcstride;
+    }
+}
+
+void ff_hevc_put_weighted_pred_avg_8_avx512(uint8_t *dst, ptrdiff_t dststride,
+                                            int16_t *src1, int16_t *src2,
+                                            ptrdiff_t srcstride, int width, int height)
+{
+    weighted_pred_avg(dst, dststride, src1, src2, srcstride, width, height, 8);
+}
+
+void ff_hevc_put_weighted_pred_avg_10_avx512(uint8_t *dst, ptrdiff_t dststride,
+                                             int16_t *src1, int16_t *src2,
+                                             ptrdiff_t srcstride, int width, int height)
+{
+    weighted_pred_avg(dst, dststride, src1, src2, srcstride, width, height, 10);
+}
@@ -22,6 +22,7 @@
 
 #include "config.h"
 #include "libavutil/avassert.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/pixdesc.h"
 #include "libavcodec/get_bits.h"
 #include "libavcodec/hevc.h"
@@ -396,6 +397,20 @@ static const uint8_t qpel_h_filter_3_8[16] = {  0, 1, -5, 17, 58,-10, 4, -1,  0,
 #define WEIGHTED_STORE4_14() PEL_STORE4(dst);
 #define WEIGHTED_STORE8_14() PEL_STORE8(dst);
 
+// the weighted results are packed to int16 with signed saturation, 8-bit
+// stores clip with packus
+#define WEIGHTED_CLIP_8()
+#define WEIGHTED_CLIP_10()                                                     \
+    r1 = _mm_max_epi16(_mm_min_epi16(r1, _mm_set1_epi16((1 << 10) - 1)),       \
+                       _mm_setzero_si128())
+
+#define WEIGHTED_DST_8()                                                       \
+    uint8_t *dst        = _dst;                                                \
+    ptrdiff_t dststride = _dststride
+#define WEIGHTED_DST_10()                                                      \
+    uint16_t *dst       = (uint16_t *)_dst;                                    \
+    ptrdiff_t dststride = _dststride >> 1
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 ////////////////////////////////////////////////////////////////////////////////
@@ -414,25 +429,24 @@ static const uint8_t qpel_h_filter_3_8[16] = {  0, 1, -5, 17, 58,-10, 4, -1,  0,
     const __m128i m1 = _mm_setzero_si128()
 
 #define WEIGHTED_INIT_1(H, D)                                                  \
-    const int shift2     = denom + 14 - D;                                     \
-    const __m128i add   = _mm_set1_epi32(olxFlag << (D - 8));                  \
-    const __m128i add2  = _mm_set1_epi32(1 << (shift2-1));                     \
-    const __m128i m1    = _mm_set1_epi16(wlxFlag);                             \
-    __m128i s1, s2, s3
+    const int shift2    = wp->shift;                                           \
+    const __m128i add   = _mm_set1_epi32(wp->offset);                          \
+    const __m128i one   = _mm_set1_epi16(1);                                   \
+    const __m128i m1    = _mm_set1_epi32((wp->round << 16) |                   \
+                                         (wp->weight & 0xffff));               \
+    __m128i s3
 
 #define WEIGHTED_INIT_2(H, D)                                                  \
     const int shift2 = 14 + 1 - D;                                             \
     const __m128i m1 = _mm_set1_epi16(1 << (14 - D))
 
 #define WEIGHTED_INIT_3(H, D)                                                  \
-    const int log2Wd = denom + 14 - D;                                         \
-    const int shift2  = log2Wd + 1;                                            \
-    const int o0     = olxFlag << (D - 8);                                     \
-    const int o1     = ol1Flag << (D - 8);                                     \
-    const __m128i m1 = _mm_set1_epi16(wlxFlag);                                \
-    const __m128i m2 = _mm_set1_epi16(wl1Flag);                                \
-    const __m128i m3 = _mm_set1_epi32((o0 + o1 + 1) << log2Wd);                \
-    __m128i s1, s2, s3, s4, s5, s6
+    const int log2Wd = wp0->shift;                                             \
+    const int shift2 = log2Wd + 1;                                             \
+    const __m128i m1 = _mm_set1_epi32((wp1->weight << 16) |                    \
+                                      (wp0->weight & 0xffff));                 \
+    const __m128i m3 = _mm_set1_epi32((wp0->offset + wp1->offset + 1) << log2Wd); \
+    __m128i s1, s2
 
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -453,16 +467,15 @@ static const uint8_t qpel_h_filter_3_8[16] = {  0, 1, -5, 17, 58,-10, 4, -1,  0,
 #define WEIGHTED_COMPUTE32_0()
 
 
+// (src, 1) pairs multiplied by (weight, round)
 #define WEIGHTED_COMPUTE_1(reg1)                                               \
-    s1   = _mm_mullo_epi16(reg1, m1);                                          \
-    s2   = _mm_mulhi_epi16(reg1, m1);                                          \
-    s3   = _mm_unpackhi_epi16(s1, s2);                                         \
-    reg1 = _mm_unpacklo_epi16(s1, s2);                                         \
-    reg1 = _mm_srai_epi32(_mm_add_epi32(reg1, add2), shift2);                  \
-    s3   = _mm_srai_epi32(_mm_add_epi32(s3  , add2), shift2);                  \
+    s3   = _mm_madd_epi16(_mm_unpackhi_epi16(reg1, one), m1);                  \
+    reg1 = _mm_madd_epi16(_mm_unpacklo_epi16(reg1, one), m1);                  \
+    reg1 = _mm_srai_epi32(reg1, shift2);                                       \
+    s3   = _mm_srai_epi32(s3  , shift2);                                       \
     reg1 = _mm_add_epi32(reg1, add);                                           \
     s3   = _mm_add_epi32(s3  , add);                                           \
-    reg1 = _mm_packus_epi32(reg1, s3)
+    reg1 = _mm_packs_epi32(reg1, s3)
 #define WEIGHTED_COMPUTE2_1()                                                  \
     WEIGHTED_COMPUTE_1(r1)
 #define WEIGHTED_COMPUTE4_1()                                                  \
@@ -495,20 +508,13 @@ static const uint8_t qpel_h_filter_3_8[16] = {  0, 1, -5, 17, 58,-10, 4, -1,  0,
     WEIGHTED_COMPUTE_2(r3, r1);                                                \
     WEIGHTED_COMPUTE_2(r4, r2)
 
+// (src1, src) pairs multiplied by (w0, w1)
 #define WEIGHTED_COMPUTE_3(reg1, reg2)                                         \
-    s1   = _mm_mullo_epi16(reg1, m1);                                          \
-    s2   = _mm_mulhi_epi16(reg1, m1);                                          \
-    s3   = _mm_mullo_epi16(reg2, m2);                                          \
-    s4   = _mm_mulhi_epi16(reg2, m2);                                          \
-    s5   = _mm_unpacklo_epi16(s1, s2);                                         \
-    s6   = _mm_unpacklo_epi16(s3, s4);                                         \
-    reg1 = _mm_unpackhi_epi16(s1, s2);                                         \
-    reg2 = _mm_unpackhi_epi16(s3, s4);                                         \
-    reg1 = _mm_add_epi32(reg1, reg2);                                          \
-    reg2 = _mm_add_epi32(s5, s6);                                              \
-    reg1 = _mm_srai_epi32(_mm_add_epi32(reg1, m3), shift2);                    \
-    reg2 = _mm_srai_epi32(_mm_add_epi32(reg2, m3), shift2);                    \
-    reg2 = _mm_packus_epi32(reg2, reg1)
+    s1   = _mm_madd_epi16(_mm_unpacklo_epi16(reg1, reg2), m1);                 \
+    s2   = _mm_madd_epi16(_mm_unpackhi_epi16(reg1, reg2), m1);                 \
+    s1   = _mm_srai_epi32(_mm_add_epi32(s1, m3), shift2);                      \
+    s2   = _mm_srai_epi32(_mm_add_epi32(s2, m3), shift2);                      \
+    reg2 = _mm_packs_epi32(s1, s2)
 #define WEIGHTED_COMPUTE2_3()                                                  \
     WEIGHTED_LOAD2_1();                                                        \
     WEIGHTED_COMPUTE_3(r3, r1)
@@ -1105,20 +1111,20 @@ void ff_hevc_put_weighted_pred_avg_8_sse(
 ////////////////////////////////////////////////////////////////////////////////
 
 #define WEIGHTED_PRED(H, D)                                                    \
-static void weighted_pred ## H ## _ ## D ##_sse(                                      \
-                                    uint8_t denom,                             \
-                                    int16_t wlxFlag, int16_t olxFlag,          \
-                                    uint8_t *dst, ptrdiff_t dststride,         \
+static void weighted_pred ## H ## _ ## D ##_sse(const HEVCWeight *wp,          \
+                                    uint8_t *_dst, ptrdiff_t _dststride,       \
                                     int16_t *src, ptrdiff_t srcstride,         \
                                     int width, int height) {                   \
     int x, y;                                                                  \
     __m128i r1, r2;                                                            \
-    WEIGHTED_INIT_1(H, D);                                             \
+    WEIGHTED_DST_ ## D();                                                      \
+    WEIGHTED_INIT_1(H, D);                                                     \
     for (y = 0; y < height; y++) {                                             \
         _mm_prefetch((char *)src, _MM_HINT_T0);                                \
         for (x = 0; x < width; x += H) {                                       \
             WEIGHTED_LOAD ## H();                                              \
             WEIGHTED_COMPUTE ## H ## _1();                                     \
+            WEIGHTED_CLIP_ ## D();                                             \
             WEIGHTED_STORE ## H ## _ ## D();                                   \
         }                                                                      \
         dst += dststride;                                                      \
@@ -1129,44 +1135,54 @@ WEIGHTED_PRED(2, 8)
 WEIGHTED_PRED(4, 8)
 WEIGHTED_PRED(8, 8)
 WEIGHTED_PRED(16, 8)
+WEIGHTED_PRED(2, 10)
+WEIGHTED_PRED(4, 10)
+WEIGHTED_PRED(8, 10)
 
-void ff_hevc_weighted_pred_8_sse(
-                                 uint8_t denom,
-                                 int16_t wlxFlag, int16_t olxFlag,
+void ff_hevc_weighted_pred_8_sse(const HEVCWeight *wp,
                                  uint8_t *dst, ptrdiff_t dststride,
                                  int16_t *src, ptrdiff_t srcstride,
                                  int width, int height) {
     if(!(width & 15))
-        weighted_pred16_8_sse(denom, wlxFlag, olxFlag,
-                dst, dststride, src, srcstride, width, height);
+        weighted_pred16_8_sse(wp, dst, dststride, src, srcstride, width, height);
     else if(!(width & 7))
-        weighted_pred8_8_sse(denom, wlxFlag, olxFlag,
-                dst, dststride, src, srcstride, width, height);
+        weighted_pred8_8_sse(wp, dst, dststride, src, srcstride, width, height);
     else if(!(width & 3))
-        weighted_pred4_8_sse(denom, wlxFlag, olxFlag,
-                dst, dststride, src, srcstride, width, height);
+        weighted_pred4_8_sse(wp, dst, dststride, src, srcstride, width, height);
     else
-        weighted_pred2_8_sse(denom, wlxFlag, olxFlag,
-                dst, dststride, src, srcstride, width, height);
+        weighted_pred2_8_sse(wp, dst, dststride, src, srcstride, width, height);
 }
 
-#define WEIGHTED_PRED_AVG(H, D)                                                   \
-static void weighted_pred_avg ## H ## _ ## D ##_sse(                                  \
-                                    uint8_t denom,                             \
-                                    int16_t wlxFlag, int16_t wl1Flag,          \
-                                    int16_t olxFlag, int16_t ol1Flag,          \
-                                    uint8_t *dst, ptrdiff_t dststride,         \
+void ff_hevc_weighted_pred_10_sse(const HEVCWeight *wp,
+                                  uint8_t *dst, ptrdiff_t dststride,
+                                  int16_t *src, ptrdiff_t srcstride,
+                                  int width, int height) {
+    if(!(width & 7))
+        weighted_pred8_10_sse(wp, dst, dststride, src, srcstride, width, height);
+    else if(!(width & 3))
+        weighted_pred4_10_sse(wp, dst, dststride, src, srcstride, width, height);
+    else
+        weighted_pred2_10_sse(wp, dst, dststride, src, srcstride, width, height);
+}
+
+#define WEIGHTED_PRED_AVG(H, D)                                                \
+static void weighted_pred_avg ## H ## _ ## D ##_sse(                           \
+                                    const HEVCWeight *wp0,                     \
+                                    const HEVCWeight *wp1,                     \
+                                    uint8_t *_dst, ptrdiff_t _dststride,       \
                                     int16_t *src1, int16_t *src,               \
                                     ptrdiff_t srcstride,                       \
                                     int width, int height) {                   \
     int x, y;                                                                  \
     __m128i r1, r2, r3, r4;                                                    \
-    WEIGHTED_INIT_3(H, D);                                             \
+    WEIGHTED_DST_ ## D();                                                      \
+    WEIGHTED_INIT_3(H, D);                                                     \
     for (y = 0; y < height; y++) {                                             \
         _mm_prefetch((char *)src, _MM_HINT_T0);                                \
         for (x = 0; x < width; x += H) {                                       \
             WEIGHTED_LOAD ## H();                                              \
             WEIGHTED_COMPUTE ## H ## _3();                                     \
+            WEIGHTED_CLIP_ ## D();                                             \
             WEIGHTED_STORE ## H ## _ ## D();                                   \
         }                                                                      \
         dst  += dststride;                                                     \
@@ -1178,27 +1194,43 @@ WEIGHTED_PRED_AVG(2, 8)
 WEIGHTED_PRED_AVG(4, 8)
 WEIGHTED_PRED_AVG(8, 8)
 WEIGHTED_PRED_AVG(16, 8)
-
-void ff_hevc_weighted_pred_avg_8_sse(
-                                 uint8_t denom,
-                                 int16_t wl0Flag, int16_t wl1Flag,
-                                 int16_t ol0Flag, int16_t ol1Flag,
-                                 uint8_t *dst, ptrdiff_t dststride,
-                                 int16_t *src1, int16_t *src2,
-                                 ptrdiff_t srcstride,
-                                 int width, int height) {
+WEIGHTED_PRED_AVG(2, 10)
+WEIGHTED_PRED_AVG(4, 10)
+WEIGHTED_PRED_AVG(8, 10)
+
+void ff_hevc_weighted_pred_avg_8_sse(const HEVCWeight *wp0, const HEVCWeight *wp1,
+                                     uint8_t *dst, ptrdiff_t dststride,
+                                     int16_t *src1, int16_t *src2,
+                                     ptrdiff_t srcstride,
+                                     int width, int height) {
     if(!(width & 15))
-        weighted_pred_avg16_8_sse(denom, wl0Flag, wl1Flag, ol0Flag, ol1Flag,
-                dst, dststride, src1, src2, srcstride, width, height);
+        weighted_pred_avg16_8_sse(wp0, wp1, dst, dststride,
+                                  src1, src2, srcstride, width, height);
     else if(!(width & 7))
-        weighted_pred_avg8_8_sse(denom, wl0Flag, wl1Flag, ol0Flag, ol1Flag,
-                dst, dststride, src1, src2, srcstride, width, height);
+        weighted_pred_avg8_8_sse(wp0, wp1, dst, dststride,
+                                 src1, src2, srcstride, width, height);
     else if(!(width & 3))
-        weighted_pred_avg4_8_sse(denom, wl0Flag, wl1Flag, ol0Flag, ol1Flag,
-                dst, dststride, src1, src2, srcstride, width, height);
+        weighted_pred_avg4_8_sse(wp0, wp1, dst, dststride,
+                                 src1, src2, srcstride, width, height);
     else
-        weighted_pred_avg2_8_sse(denom, wl0Flag, wl1Flag, ol0Flag, ol1Flag,
-                dst, dststride, src1, src2, srcstride, width, height);
+        weighted_pred_avg2_8_sse(wp0, wp1, dst, dststride,
+                                 src1, src2, srcstride, width, height);
+}
+
+void ff_hevc_weighted_pred_avg_10_sse(const HEVCWeight *wp0, const HEVCWeight *wp1,
+                                      uint8_t *dst, ptrdiff_t dststride,
+                                      int16_t *src1, int16_t *src2,
+                                      ptrdiff_t srcstride,
+                                      int width, int height) {
+    if(!(width & 7))
+        weighted_pred_avg8_10_sse(wp0, wp1, dst, dststride,
+                                  src1, src2, srcstride, width, height);
+    else if(!(width & 3))
+        weighted_pred_avg4_10_sse(wp0, wp1, dst, dststride,
+                                  src1, src2, srcstride, width, height);
+    else
+        weighted_pred_avg2_10_sse(wp0, wp1, dst, dststride,
+                                  src1, src2, srcstride, width, height);
 }
 
 
@@ -1367,3 +1399,521 @@ QPEL_FUNC( PUT_HEVC_QPEL_V,  4, 1, 10)
         dst += dststride;
     }
 }*/
+
+////////////////////////////////////////////////////////////////////////////////
+// fused interpolation and pixel store, 8 bit
+//
+// The interpolated samples keep their 14-bit intermediate precision only in
+// registers: uni-prediction rounds them straight to pixels, bi-prediction
+// adds the int16 prediction of the first list and rounds the sum. The
+// intermediate is within int16 range, and the saturating adds of the
+// rounding steps only saturate for sums that clip to 0 or 255 anyway.
+////////////////////////////////////////////////////////////////////////////////
+DECLARE_ALIGNED(16, static const int8_t, qpel_fused_filters[3][16]) = {
+    { -1, 4,-10, 58, 17, -5,  1,  0, -1, 4,-10, 58, 17, -5,  1,  0 },
+    { -1, 4,-11, 40, 40,-11,  4, -1, -1, 4,-11, 40, 40,-11,  4, -1 },
+    {  0, 1, -5, 17, 58,-10,  4, -1,  0, 1, -5, 17, 58,-10,  4, -1 },
+};
+
+static av_always_inline void store_pel_8(uint8_t *dst, __m128i v, int n)
+{
+    if (n >= 8) {
+        _mm_storel_epi64((__m128i *) dst, v);
+        return;
+    }
+    if (n & 4) {
+        AV_WN32(dst, _mm_cvtsi128_si32(v));
+        dst += 4;
+        v    = _mm_srli_si128(v, 4);
+    }
+    if (n & 2)
+        AV_WN16(dst, _mm_extract_epi16(v, 0));
+}
+
+/* store 8 intermediate samples as pixels, averaging with src2 when bi */
+static av_always_inline void store_fused_8(uint8_t *dst, __m128i v,
+                                           const int16_t *src2, int bi, int n)
+{
+    if (bi) {
+        v = _mm_adds_epi16(v, _mm_loadu_si128((const __m128i *) src2));
+        v = _mm_srai_epi16(_mm_adds_epi16(v, _mm_set1_epi16(64)), 7);
+    } else {
+        v = _mm_srai_epi16(_mm_adds_epi16(v, _mm_set1_epi16(32)), 6);
+    }
+    store_pel_8(dst, _mm_packus_epi16(v, v), n);
+}
+
+static av_always_inline void store_int16_8(int16_t *dst, __m128i v, int n)
+{
+    if (n >= 8) {
+        _mm_storeu_si128((__m128i *) dst, v);
+        return;
+    }
+    if (n & 4) {
+        _mm_storel_epi64((__m128i *) dst, v);
+        dst += 4;
+        v    = _mm_srli_si128(v, 8);
+    }
+    if (n & 2)
+        AV_WN32(dst, _mm_cvtsi128_si32(v));
+}
+
+/* 8 horizontally filtered samples from src[-3] .. src[12] */
+static av_always_inline __m128i qpel_h8_8(const uint8_t *src, __m128i filter)
+{
+    const __m128i shuf = _mm_loadu_si128((const __m128i *) qpel_h_filter_shuffle_8);
+    __m128i x  = _mm_loadu_si128((const __m128i *) &src[-3]);
+    __m128i t0 = _mm_maddubs_epi16(_mm_shuffle_epi8(x, shuf), filter);
+    __m128i t1 = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_srli_si128(x, 2), shuf), filter);
+    __m128i t2 = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_srli_si128(x, 4), shuf), filter);
+    __m128i t3 = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_srli_si128(x, 6), shuf), filter);
+    return _mm_hadd_epi16(_mm_hadd_epi16(t0, t1), _mm_hadd_epi16(t2, t3));
+}
+
+/* 8 horizontally filtered samples from src[-1] .. src[10] */
+static av_always_inline __m128i epel_h8_8(const uint8_t *src, __m128i filter)
+{
+    const __m128i shuf = _mm_loadu_si128((const __m128i *) epel_h_filter_shuffle_8);
+    __m128i x  = _mm_loadu_si128((const __m128i *) &src[-1]);
+    __m128i t0 = _mm_maddubs_epi16(_mm_shuffle_epi8(x, shuf), filter);
+    __m128i t1 = _mm_maddubs_epi16(_mm_shuffle_epi8(_mm_srli_si128(x, 4), shuf), filter);
+    return _mm_hadd_epi16(t0, t1);
+}
+
+static av_always_inline __m128i pel_pair_8(const uint8_t *a, const uint8_t *b)
+{
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) a),
+                             _mm_loadl_epi64((const __m128i *) b));
+}
+
+static av_always_inline __m128i coef_pair_8(int c0, int c1)
+{
+    return _mm_set1_epi16((c0 & 0xff) | (c1 << 8));
+}
+
+static av_always_inline __m128i coef_pair_16(int c0, int c1)
+{
+    return _mm_set1_epi32((c0 & 0xffff) | (c1 << 16));
+}
+
+/* sum of c[i] * (a[i], b[i]) products over 8 int16 samples, >> 6 */
+static av_always_inline void madd_pair_16(__m128i *lo, __m128i *hi,
+                                          const int16_t *a, const int16_t *b,
+                                          __m128i c)
+{
+    __m128i x = _mm_loadu_si128((const __m128i *) a);
+    __m128i y = _mm_loadu_si128((const __m128i *) b);
+    *lo = _mm_add_epi32(*lo, _mm_madd_epi16(_mm_unpacklo_epi16(x, y), c));
+    *hi = _mm_add_epi32(*hi, _mm_madd_epi16(_mm_unpackhi_epi16(x, y), c));
+}
+
+/*
+ * Taps with a zero coefficient may sit outside the rows made available by
+ * the caller (qpel filters 1 and 3), so their pair reuses an in-range row.
+ */
+static av_always_inline void put_hevc_qpel_fused_8_sse(uint8_t *dst, ptrdiff_t dststride,
+                                                       uint8_t *src, ptrdiff_t srcstride,
+                                                       int16_t *src2, ptrdiff_t src2stride,
+                                                       int width, int height,
+                                                       int mx, int my, int bi)
+{
+    DECLARE_ALIGNED(16, int16_t, tmp_array[(MAX_PB_SIZE + 7) * MAX_PB_SIZE]);
+    const int8_t *fv = qpel_fused_filters[FFMAX(my, 1) - 1];
+    int first        = my == 3 ? -2 : -3;
+    int last         = my == 1 ?  3 :  4;
+    __m128i fh       = _mm_setzero_si128();
+    __m128i c0, c1, c2, c3;
+    int x, y;
+
+    if (mx)
+        fh = _mm_load_si128((const __m128i *) qpel_fused_filters[mx - 1]);
+
+    if (mx && my) {
+        int16_t *tmp = tmp_array;
+        src -= ff_hevc_qpel_extra_before[my] * srcstride;
+        for (y = 0; y < height + ff_hevc_qpel_extra[my]; y++) {
+            for (x = 0; x < width; x += 8)
+                _mm_store_si128((__m128i *) &tmp[x], qpel_h8_8(&src[x], fh));
+            src += srcstride;
+            tmp += MAX_PB_SIZE;
+        }
+        tmp = tmp_array + ff_hevc_qpel_extra_before[my] * MAX_PB_SIZE;
+
+        c0 = coef_pair_16(fv[0], fv[1]);
+        c1 = coef_pair_16(fv[2], fv[3]);
+        c2 = coef_pair_16(fv[4], fv[5]);
+        c3 = coef_pair_16(fv[6], fv[7]);
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x += 8) {
+                const int16_t *t = &tmp[x];
+                __m128i lo = _mm_setzero_si128();
+                __m128i hi = _mm_setzero_si128();
+                madd_pair_16(&lo, &hi, t + first * MAX_PB_SIZE, t - 2 * MAX_PB_SIZE, c0);
+                madd_pair_16(&lo, &hi, t - MAX_PB_SIZE, t, c1);
+                madd_pair_16(&lo, &hi, t + MAX_PB_SIZE, t + 2 * MAX_PB_SIZE, c2);
+                madd_pair_16(&lo, &hi, t + 3 * MAX_PB_SIZE, t + last * MAX_PB_SIZE, c3);
+                lo = _mm_packs_epi32(_mm_srai_epi32(lo, 6), _mm_srai_epi32(hi, 6));
+                store_fused_8(&dst[x], lo, &src2[x], bi, width - x);
+            }
+            tmp  += MAX_PB_SIZE;
+            dst  += dststride;
+            src2 += src2stride;
+        }
+        return;
+    }
+
+    c0 = coef_pair_8(fv[0], fv[1]);
+    c1 = coef_pair_8(fv[2], fv[3]);
+    c2 = coef_pair_8(fv[4], fv[5]);
+    c3 = coef_pair_8(fv[6], fv[7]);
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 8) {
+            const uint8_t *s = &src[x];
+            __m128i v;
+            if (mx) {
+                v = qpel_h8_8(s, fh);
+            } else if (my) {
+                v = _mm_maddubs_epi16(pel_pair_8(s + first * srcstride, s - 2 * srcstride), c0);
+                v = _mm_add_epi16(v, _mm_maddubs_epi16(pel_pair_8(s - srcstride, s), c1));
+                v = _mm_add_epi16(v, _mm_maddubs_epi16(pel_pair_8(s + srcstride, s + 2 * srcstride), c2));
+                v = _mm_add_epi16(v, _mm_maddubs_epi16(pel_pair_8(s + 3 * srcstride, s + last * srcstride), c3));
+            } else {
+                v = _mm_slli_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) s)), 6);
+            }
+            store_fused_8(&dst[x], v, &src2[x], bi, width - x);
+        }
+        src  += srcstride;
+        dst  += dststride;
+        src2 += src2stride;
+    }
+}
+
+/* with dst16 set, the samples are stored at intermediate precision instead */
+static av_always_inline void put_hevc_epel_fused_8_sse(uint8_t *dst, int16_t *dst16,
+                                                       ptrdiff_t dststride,
+                                                       uint8_t *src, ptrdiff_t srcstride,
+                                                       int16_t *src2, ptrdiff_t src2stride,
+                                                       int width, int height, int mx, int my,
+                                                       int hfilter, int vfilter, int bi)
+{
+    DECLARE_ALIGNED(16, int16_t, tmp_array[(MAX_PB_SIZE + 3) * MAX_PB_SIZE]);
+    const int8_t *fv = ff_hevc_epel_filters[FFMAX(my, 1) - 1];
+    __m128i fh       = _mm_setzero_si128();
+    __m128i c0, c1;
+    int x, y;
+
+    if (hfilter)
+        fh = _mm_set1_epi32(AV_RN32(ff_hevc_epel_filters[mx - 1]));
+
+    if (hfilter && vfilter) {
+        int16_t *tmp = tmp_array;
+        src -= EPEL_EXTRA_BEFORE * srcstride;
+        for (y = 0; y < height + EPEL_EXTRA; y++) {
+            for (x = 0; x < width; x += 8)
+                _mm_store_si128((__m128i *) &tmp[x], epel_h8_8(&src[x], fh));
+            src += srcstride;
+            tmp += MAX_PB_SIZE;
+        }
+        tmp = tmp_array + EPEL_EXTRA_BEFORE * MAX_PB_SIZE;
+
+        c0 = coef_pair_16(fv[0], fv[1]);
+        c1 = coef_pair_16(fv[2], fv[3]);
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x += 8) {
+                const int16_t *t = &tmp[x];
+                __m128i lo = _mm_setzero_si128();
+                __m128i hi = _mm_setzero_si128();
+                madd_pair_16(&lo, &hi, t - MAX_PB_SIZE, t, c0);
+                madd_pair_16(&lo, &hi, t + MAX_PB_SIZE, t + 2 * MAX_PB_SIZE, c1);
+                lo = _mm_packs_epi32(_mm_srai_epi32(lo, 6), _mm_srai_epi32(hi, 6));
+                if (dst16)
+                    store_int16_8(&dst16[x], lo, width - x);
+                else
+                    store_fused_8(&dst[x], lo, &src2[x], bi, width - x);
+            }
+            tmp  += MAX_PB_SIZE;
+            if (dst16)
+                dst16 += dststride;
+            else
+                dst   += dststride;
+            src2 += src2stride;
+        }
+        return;
+    }
+
+    c0 = coef_pair_8(fv[0], fv[1]);
+    c1 = coef_pair_8(fv[2], fv[3]);
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 8) {
+            const uint8_t *s = &src[x];
+            __m128i v;
+            if (hfilter) {
+                v = epel_h8_8(s, fh);
+            } else if (vfilter) {
+                v = _mm_maddubs_epi16(pel_pair_8(s - srcstride, s), c0);
+                v = _mm_add_epi16(v, _mm_maddubs_epi16(pel_pair_8(s + srcstride, s + 2 * srcstride), c1));
+            } else {
+                v = _mm_slli_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i *) s)), 6);
+            }
+            if (dst16)
+                store_int16_8(&dst16[x], v, width - x);
+            else
+                store_fused_8(&dst[x], v, &src2[x], bi, width - x);
+        }
+        src  += srcstride;
+        if (dst16)
+            dst16 += dststride;
+        else
+            dst   += dststride;
+        src2 += src2stride;
+    }
+}
+
+/*
+ * Joint Cb/Cr chroma MC. The 2- and 4-wide blocks that make up most of the
+ * 4:2:0 chroma prediction would leave a register half empty per plane, so
+ * they are filtered with the Cb row in the low and the Cr row in the high
+ * half: [u0 u1 u2 u3 v0 v1 v2 v3]. Wider blocks run the 8-wide kernel per
+ * plane.
+ */
+static av_always_inline __m128i epel_h4_uv_8(const uint8_t *src1, const uint8_t *src2,
+                                             __m128i filter)
+{
+    const __m128i shuf = _mm_loadu_si128((const __m128i *) epel_h_filter_shuffle_8);
+    __m128i t0 = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i *) &src1[-1]), shuf);
+    __m128i t1 = _mm_shuffle_epi8(_mm_loadl_epi64((const __m128i *) &src2[-1]), shuf);
+    return _mm_hadd_epi16(_mm_maddubs_epi16(t0, filter), _mm_maddubs_epi16(t1, filter));
+}
+
+static av_always_inline __m128i pel_row_uv_8(const uint8_t *src1, const uint8_t *src2)
+{
+    return _mm_unpacklo_epi32(_mm_cvtsi32_si128(AV_RN32(src1)),
+                              _mm_cvtsi32_si128(AV_RN32(src2)));
+}
+
+static av_always_inline void store_uv_8(uint8_t *dst1, uint8_t *dst2,
+                                        int16_t *dst16_1, int16_t *dst16_2,
+                                        __m128i v, const int16_t *src21,
+                                        const int16_t *src22, int bi, int width)
+{
+    if (dst16_1) {
+        if (width == 4) {
+            _mm_storel_epi64((__m128i *) dst16_1, v);
+            _mm_storel_epi64((__m128i *) dst16_2, _mm_srli_si128(v, 8));
+        } else {
+            AV_WN32(dst16_1, _mm_cvtsi128_si32(v));
+            AV_WN32(dst16_2, _mm_cvtsi128_si32(_mm_srli_si128(v, 8)));
+        }
+        return;
+    }
+    if (bi) {
+        __m128i t = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *) src21),
+                                       _mm_loadl_epi64((const __m128i *) src22));
+        v = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(v, t), _mm_set1_epi16(64)), 7);
+    } else {
+        v = _mm_srai_epi16(_mm_adds_epi16(v, _mm_set1_epi16(32)), 6);
+    }
+    v = _mm_packus_epi16(v, v);
+    if (width == 4) {
+        AV_WN32(dst1, _mm_cvtsi128_si32(v));
+        AV_WN32(dst2, _mm_cvtsi128_si32(_mm_srli_si128(v, 4)));
+    } else {
+        AV_WN16(dst1, _mm_extract_epi16(v, 0));
+        AV_WN16(dst2, _mm_extract_epi16(v, 2));
+    }
+}
+
+static av_always_inline void put_hevc_epel_uv_8_sse(uint8_t *dst1, uint8_t *dst2,
+                                                    int16_t *dst16_1, int16_t *dst16_2,
+                                                    ptrdiff_t dststride,
+                                                    uint8_t *src1, uint8_t *src2,
+                                                    ptrdiff_t srcstride,
+                                                    int16_t *src21, int16_t *src22,
+                                                    ptrdiff_t src2stride,
+                                                    int width, int height, int mx, int my,
+                                                    int hfilter, int vfilter, int bi)
+{
+    DECLARE_ALIGNED(16, int16_t, tmp_array[(MAX_PB_SIZE + 3) * 8]);
+    const int8_t *fv = ff_hevc_epel_filters[FFMAX(my, 1) - 1];
+    __m128i fh       = _mm_setzero_si128();
+    __m128i c0, c1;
+    int y;
+
+    if (width > 4) {
+        put_hevc_epel_fused_8_sse(dst1, dst16_1, dststride, src1, srcstride,
+                                  src21, src2stride, width, height,
+                                  mx, my, hfilter, vfilter, bi);
+        put_hevc_epel_fused_8_sse(dst2, dst16_2, dststride, src2, srcstride,
+                                  src22, src2stride, width, height,
+                                  mx, my, hfilter, vfilter, bi);
+        return;
+    }
+
+    if (hfilter)
+        fh = _mm_set1_epi32(AV_RN32(ff_hevc_epel_filters[mx - 1]));
+
+    if (hfilter && vfilter) {
+        int16_t *tmp = tmp_array;
+        src1 -= EPEL_EXTRA_BEFORE * srcstride;
+        src2 -= EPEL_EXTRA_BEFORE * srcstride;
+        for (y = 0; y < height + EPEL_EXTRA; y++) {
+            _mm_store_si128((__m128i *) tmp, epel_h4_uv_8(src1, src2, fh));
+            src1 += srcstride;
+            src2 += srcstride;
+            tmp  += 8;
+        }
+        tmp = tmp_array + EPEL_EXTRA_BEFORE * 8;
+
+        c0 = coef_pair_16(fv[0], fv[1]);
+        c1 = coef_pair_16(fv[2], fv[3]);
+        for (y = 0; y < height; y++) {
+            __m128i lo = _mm_setzero_si128();
+            __m128i hi = _mm_setzero_si128();
+            madd_pair_16(&lo, &hi, tmp - 8, tmp, c0);
+            madd_pair_16(&lo, &hi, tmp + 8, tmp + 16, c1);
+            lo = _mm_packs_epi32(_mm_srai_epi32(lo, 6), _mm_srai_epi32(hi, 6));
+            store_uv_8(dst1, dst2, dst16_1, dst16_2, lo, src21, src22, bi, width);
+            tmp += 8;
+            if (dst16_1) {
+                dst16_1 += dststride;
+                dst16_2 += dststride;
+            } else {
+                dst1 += dststride;
+                dst2 += dststride;
+            }
+            src21 += src2stride;
+            src22 += src2stride;
+        }
+        return;
+    }
+
+    c0 = coef_pair_8(fv[0], fv[1]);
+    c1 = coef_pair_8(fv[2], fv[3]);
+    for (y = 0; y < height; y++) {
+        __m128i v;
+        if (hfilter) {
+            v = epel_h4_uv_8(src1, src2, fh);
+        } else if (vfilter) {
+            __m128i r0 = pel_row_uv_8(src1 - srcstride,     src2 - srcstride);
+            __m128i r1 = pel_row_uv_8(src1,                 src2);
+            __m128i r2 = pel_row_uv_8(src1 + srcstride,     src2 + srcstride);
+            __m128i r3 = pel_row_uv_8(src1 + 2 * srcstride, src2 + 2 * srcstride);
+            v = _mm_add_epi16(_mm_maddubs_epi16(_mm_unpacklo_epi8(r0, r1), c0),
+                              _mm_maddubs_epi16(_mm_unpacklo_epi8(r2, r3), c1));
+        } else {
+            v = _mm_slli_epi16(_mm_cvtepu8_epi16(pel_row_uv_8(src1, src2)), 6);
+        }
+        store_uv_8(dst1, dst2, dst16_1, dst16_2, v, src21, src22, bi, width);
+        src1 += srcstride;
+        src2 += srcstride;
+        if (dst16_1) {
+            dst16_1 += dststride;
+            dst16_2 += dststride;
+        } else {
+            dst1 += dststride;
+            dst2 += dststride;
+        }
+        src21 += src2stride;
+        src22 += src2stride;
+    }
+}
+
+#define PUT_HEVC_QPEL_FUSED_SSE(H, V)                                          \
+void ff_hevc_put_hevc_qpel_uni_h ## H ## v ## V ## _8_sse(uint8_t *dst, ptrdiff_t dststride, \
+                                                          uint8_t *src, ptrdiff_t srcstride, \
+                                                          int width, int height) \
+{                                                                              \
+    put_hevc_qpel_fused_8_sse(dst, dststride, src, srcstride, NULL, 0,         \
+                              width, height, H, V, 0);                         \
+}                                                                              \
+void ff_hevc_put_hevc_qpel_bi_h ## H ## v ## V ## _8_sse(uint8_t *dst, ptrdiff_t dststride, \
+                                                         uint8_t *src, ptrdiff_t srcstride, \
+                                                         int16_t *src2, ptrdiff_t src2stride, \
+                                                         int width, int height) \
+{                                                                              \
+    put_hevc_qpel_fused_8_sse(dst, dststride, src, srcstride, src2, src2stride,\
+                              width, height, H, V, 1);                         \
+}
+
+#define PUT_HEVC_EPEL_FUSED_SSE(H, V)                                          \
+void ff_hevc_put_hevc_epel_uni_h ## H ## v ## V ## _8_sse(uint8_t *dst, ptrdiff_t dststride, \
+                                                          uint8_t *src, ptrdiff_t srcstride, \
+                                                          int width, int height, \
+                                                          int mx, int my)      \
+{                                                                              \
+    put_hevc_epel_fused_8_sse(dst, NULL, dststride, src, srcstride, NULL, 0,   \
+                              width, height, mx, my, H, V, 0);                 \
+}                                                                              \
+void ff_hevc_put_hevc_epel_bi_h ## H ## v ## V ## _8_sse(uint8_t *dst, ptrdiff_t dststride, \
+                                                         uint8_t *src, ptrdiff_t srcstride, \
+                                                         int16_t *src2, ptrdiff_t src2stride, \
+                                                         int width, int height, \
+                                                         int mx, int my)       \
+{                                                                              \
+    put_hevc_epel_fused_8_sse(dst, NULL, dststride, src, srcstride,            \
+                              src2, src2stride, width, height, mx, my, H, V, 1);\
+}
+
+#define PUT_HEVC_EPEL_UV_SSE(H, V)                                             \
+void ff_hevc_put_hevc_epel_uv_h ## H ## v ## V ## _8_sse(int16_t *dst1, int16_t *dst2,        \
+                                                         ptrdiff_t dststride,   \
+                                                         uint8_t *src1, uint8_t *src2,        \
+                                                         ptrdiff_t srcstride,   \
+                                                         int width, int height, \
+                                                         int mx, int my)        \
+{                                                                              \
+    put_hevc_epel_uv_8_sse(NULL, NULL, dst1, dst2, dststride, src1, src2,      \
+                           srcstride, NULL, NULL, 0, width, height,            \
+                           mx, my, H, V, 0);                                   \
+}                                                                              \
+void ff_hevc_put_hevc_epel_uni_uv_h ## H ## v ## V ## _8_sse(uint8_t *dst1, uint8_t *dst2,    \
+                                                             ptrdiff_t dststride, \
+                                                             uint8_t *src1, uint8_t *src2,    \
+                                                             ptrdiff_t srcstride, \
+                                                             int width, int height, \
+                                                             int mx, int my)    \
+{                                                                              \
+    put_hevc_epel_uv_8_sse(dst1, dst2, NULL, NULL, dststride, src1, src2,      \
+                           srcstride, NULL, NULL, 0, width, height,            \
+                           mx, my, H, V, 0);                                   \
+}                                                                              \
+void ff_hevc_put_hevc_epel_bi_uv_h ## H ## v ## V ## _8_sse(uint8_t *dst1, uint8_t *dst2,     \
+                                                            ptrdiff_t dststride, \
+                                                            uint8_t *src1, uint8_t *src2,     \
+                                                            ptrdiff_t srcstride, \
+                                                            int16_t *src21, int16_t *src22,   \
+                                                            ptrdiff_t src2stride, \
+                                                            int width, int height, \
+                                                            int mx, int my)     \
+{                                                                              \
+    put_hevc_epel_uv_8_sse(dst1, dst2, NULL, NULL, dststride, src1, src2,      \
+                           srcstride, src21, src22, src2stride, width, height, \
+                           mx, my, H, V, 1);                                   \
+}
+
+PUT_HEVC_QPEL_FUSED_SSE(0, 0)
+PUT_HEVC_QPEL_FUSED_SSE(0, 1)
+PUT_HEVC_QPEL_FUSED_SSE(0, 2)
+PUT_HEVC_QPEL_FUSED_SSE(0, 3)
+PUT_HEVC_QPEL_FUSED_SSE(1, 0)
+PUT_HEVC_QPEL_FUSED_SSE(1, 1)
+PUT_HEVC_QPEL_FUSED_SSE(1, 2)
+PUT_HEVC_QPEL_FUSED_SSE(1, 3)
+PUT_HEVC_QPEL_FUSED_SSE(2, 0)
+PUT_HEVC_QPEL_FUSED_SSE(2, 1)
+PUT_HEVC_QPEL_FUSED_SSE(2, 2)
+PUT_HEVC_QPEL_FUSED_SSE(2, 3)
+PUT_HEVC_QPEL_FUSED_SSE(3, 0)
+PUT_HEVC_QPEL_FUSED_SSE(3, 1)
+PUT_HEVC_QPEL_FUSED_SSE(3, 2)
+PUT_HEVC_QPEL_FUSED_SSE(3, 3)
+
+PUT_HEVC_EPEL_FUSED_SSE(0, 0)
+PUT_HEVC_EPEL_FUSED_SSE(0, 1)
+PUT_HEVC_EPEL_FUSED_SSE(1, 0)
+PUT_HEVC_EPEL_FUSED_SSE(1, 1)
+
+PUT_HEVC_EPEL_UV_SSE(0, 0)
+PUT_HEVC_EPEL_UV_SSE(0, 1)
+PUT_HEVC_EPEL_UV_SSE(1, 0)
+PUT_HEVC_EPEL_UV_SSE(1, 1)
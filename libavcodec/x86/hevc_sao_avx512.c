@@ -0,0 +1,198 @@
+/*
+ * Provide AVX-512 sao functions for HEVC decoding
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+#include "libavutil/common.h"
+#include "libavcodec/hevc.h"
+#include "libavcodec/hevcdsp.h"
+#include "libavcodec/x86/hevcdsp.h"
+
+#include <immintrin.h>
+
+/*
+ * A CTB row is filtered CTB by CTB, each with its own parameters, 32
+ * samples per register. Both filters look their offset up with a word
+ * permute: the band table has exactly 32 entries and the edge table is
+ * indexed by 2 + sign(a) + sign(b). Row tails use masked loads and stores,
+ * and the samples next to an edge that is not filtered across are kept by
+ * a mask blend; their neighbours are masked out of the loads, so nothing
+ * outside the picture is read.
+ */
+
+static av_always_inline __mmask32 tail_mask(int n)
+{
+    return n >= 32 ? 0xffffffff : (1U << n) - 1;
+}
+
+static av_always_inline __m512i load_pixels(const uint8_t *src, __mmask32 m, int bit_depth)
+{
+    if (bit_depth == 8)
+        return _mm512_cvtepu8_epi16(_mm256_maskz_loadu_epi8(m, src));
+    return _mm512_maskz_loadu_epi16(m, src);
+}
+
+static av_always_inline void store_pixels(uint8_t *dst, __m512i v, __mmask32 m, int bit_depth)
+{
+    v = _mm512_max_epi16(v, _mm512_setzero_si512());
+    if (bit_depth == 8) {
+        _mm256_mask_storeu_epi8(dst, m, _mm512_cvtusepi16_epi8(v));
+    } else {
+        v = _mm512_min_epi16(v, _mm512_set1_epi16((1 << bit_depth) - 1));
+        _mm512_mask_storeu_epi16(dst, m, v);
+    }
+}
+
+static av_always_inline void sao_band_ctb(uint8_t *dst, uint8_t *src,
+                                          ptrdiff_t stride, SAOParams *sao,
+                                          int width, int height, int c_idx,
+                                          int bit_depth)
+{
+    const int ps        = (bit_depth + 7) >> 3;
+    int *sao_offset_val = sao->offset_val[c_idx];
+    int16_t offset_table[32] = { 0 };
+    __m512i table;
+    int k, x, y;
+
+    for (k = 0; k < 4; k++)
+        offset_table[(k + sao->band_position[c_idx]) & 31] = sao_offset_val[k + 1];
+    table = _mm512_loadu_si512(offset_table);
+
+    for (y = 0; y < height; y++) {
+        for (x = 0; x < width; x += 32) {
+            __mmask32 m = tail_mask(width - x);
+            __m512i v   = load_pixels(src + x * ps, m, bit_depth);
+            __m512i off = _mm512_permutexvar_epi16(_mm512_srli_epi16(v, bit_depth - 5), table);
+            store_pixels(dst + x * ps, _mm512_add_epi16(v, off), m, bit_depth);
+        }
+        dst += stride;
+        src += stride;
+    }
+}
+
+static av_always_inline void sao_edge_ctb(uint8_t *dst, uint8_t *src,
+                                          ptrdiff_t stride, SAOParams *sao,
+                                          int no_filter, int width, int height,
+                                          int c_idx, int bit_depth)
+{
+    static const uint8_t edge_idx[] = { 1, 2, 0, 3, 4 };
+    static const int8_t pos[4][2][2] = {
+        { { -1,  0 }, {  1, 0 } }, // horizontal
+        { {  0, -1 }, {  0, 1 } }, // vertical
+        { { -1, -1 }, {  1, 1 } }, // 45 degree
+        { {  1, -1 }, { -1, 1 } }, // 135 degree
+    };
+    const int ps        = (bit_depth + 7) >> 3;
+    const __m512i one   = _mm512_set1_epi16(1);
+    int *sao_offset_val = sao->offset_val[c_idx];
+    int sao_eo_class    = sao->eo_class[c_idx];
+    int a_x = pos[sao_eo_class][0][0], a_y = pos[sao_eo_class][0][1];
+    int b_x = pos[sao_eo_class][1][0], b_y = pos[sao_eo_class][1][1];
+    ptrdiff_t a_off = a_x * ps + a_y * stride;
+    ptrdiff_t b_off = b_x * ps + b_y * stride;
+    int16_t offset_table[32] = { 0 };
+    __m512i table;
+    int k, x, y;
+
+    for (k = 0; k < 5; k++)
+        offset_table[k] = sao_offset_val[edge_idx[k]];
+    table = _mm512_loadu_si512(offset_table);
+
+    for (y = 0; y < height; y++) {
+        int keep_first = no_filter & (SAO_NO_FILTER_AT(a_x, y + a_y, width, height) |
+                                      SAO_NO_FILTER_AT(b_x, y + b_y, width, height));
+        int keep_mid   = no_filter & (SAO_NO_FILTER_AT(0, y + a_y, width, height) |
+                                      SAO_NO_FILTER_AT(0, y + b_y, width, height));
+        int keep_last  = no_filter & (SAO_NO_FILTER_AT(width - 1 + a_x, y + a_y, width, height) |
+                                      SAO_NO_FILTER_AT(width - 1 + b_x, y + b_y, width, height));
+
+        if (keep_first && keep_mid && keep_last) {
+            memcpy(dst, src, width * ps);
+        } else {
+            for (x = 0; x < width; x += 32) {
+                const uint8_t *p = src + x * ps;
+                __mmask32 m     = tail_mask(width - x);
+                __mmask32 first = !x ? 1 : 0;
+                __mmask32 last  = width - 1 - x < 32 ? 1U << (width - 1 - x) : 0;
+                __mmask32 keep  = (keep_first ? first : 0) | (keep_last ? last : 0) |
+                                  (keep_mid ? m & ~(first | last) : 0);
+                __m512i c   = load_pixels(p,         m,         bit_depth);
+                __m512i a   = load_pixels(p + a_off, m & ~keep, bit_depth);
+                __m512i b   = load_pixels(p + b_off, m & ~keep, bit_depth);
+                __m512i idx = _mm512_set1_epi16(2);
+                idx = _mm512_mask_add_epi16(idx, _mm512_cmpgt_epi16_mask(c, a), idx, one);
+                idx = _mm512_mask_sub_epi16(idx, _mm512_cmplt_epi16_mask(c, a), idx, one);
+                idx = _mm512_mask_add_epi16(idx, _mm512_cmpgt_epi16_mask(c, b), idx, one);
+                idx = _mm512_mask_sub_epi16(idx, _mm512_cmplt_epi16_mask(c, b), idx, one);
+                store_pixels(dst + x * ps,
+                             _mm512_mask_blend_epi16(keep,
+                                                     _mm512_add_epi16(c, _mm512_permutexvar_epi16(idx, table)),
+                                                     c),
+                             m, bit_depth);
+            }
+        }
+        dst += stride;
+        src += stride;
+    }
+}
+
+static av_always_inline void sao_filter_ctb_row(uint8_t *dst, uint8_t *src,
+                                                ptrdiff_t stride, SAOParams *sao,
+                                                const uint16_t *no_filter,
+                                                int ctb_size, int width,
+                                                int height, int c_idx,
+                                                int bit_depth)
+{
+    const int ps = (bit_depth + 7) >> 3;
+    int x0, y;
+
+    for (x0 = 0; x0 < width; x0 += ctb_size, sao++, no_filter++) {
+        int w = FFMIN(ctb_size, width - x0);
+
+        switch (sao->type_idx[c_idx]) {
+        case SAO_BAND:
+            sao_band_ctb(dst + x0 * ps, src + x0 * ps, stride, sao,
+                         w, height, c_idx, bit_depth);
+            break;
+        case SAO_EDGE:
+            sao_edge_ctb(dst + x0 * ps, src + x0 * ps, stride, sao,
+                         *no_filter, w, height, c_idx, bit_depth);
+            break;
+        default:
+            for (y = 0; y < height; y++)
+                memcpy(dst + x0 * ps + y * stride, src + x0 * ps + y * stride, w * ps);
+            break;
+        }
+    }
+}
+
+#define SAO_FILTER_CTB_ROW(D)                                                  \
+void ff_hevc_sao_filter_ctb_row_ ## D ## _avx512(uint8_t *dst, uint8_t *src,   \
+                                                ptrdiff_t stride,              \
+                                                struct SAOParams *sao,         \
+                                                const uint16_t *no_filter,     \
+                                                int ctb_size, int width,       \
+                                                int height, int c_idx)         \
+{                                                                              \
+    sao_filter_ctb_row(dst, src, stride, sao, no_filter, ctb_size, width,      \
+                       height, c_idx, D);                                      \
+}
+
+SAO_FILTER_CTB_ROW( 8)
+SAO_FILTER_CTB_ROW(10)
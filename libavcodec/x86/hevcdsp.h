@@ -83,13 +83,45 @@ void ff_hevc_transform_16x16_add_10_sse4(uint8_t *_dst, int16_t *coeffs, ptrdiff
 void ff_hevc_transform_32x32_add_8_sse4(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
 void ff_hevc_transform_32x32_add_10_sse4(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
 
+void ff_hevc_transform_4x4_luma_add_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_4x4_add_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_8x8_add_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_16x16_add_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_32x32_add_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_skip_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transquant_bypass4x4_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transquant_bypass8x8_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transquant_bypass16x16_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transquant_bypass32x32_8_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+
+void ff_hevc_transform_4x4_luma_add_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_4x4_add_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_8x8_add_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_16x16_add_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_32x32_add_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_skip_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transquant_bypass4x4_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transquant_bypass8x8_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transquant_bypass16x16_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transquant_bypass32x32_10_avx2(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+
+void ff_hevc_transform_32x32_add_8_avx512(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+void ff_hevc_transform_32x32_add_10_avx512(uint8_t *_dst, int16_t *coeffs, ptrdiff_t _stride);
+
 // MC functions
 void ff_hevc_put_unweighted_pred_8_sse(uint8_t *_dst, ptrdiff_t _dststride,int16_t *src, ptrdiff_t srcstride,int width, int height);
 
-void ff_hevc_weighted_pred_8_sse(uint8_t denom, int16_t wlxFlag, int16_t olxFlag,uint8_t *_dst, ptrdiff_t _dststride,int16_t *src, ptrdiff_t srcstride,int width, int height);
+void ff_hevc_weighted_pred_8_sse(const HEVCWeight *wp, uint8_t *_dst, ptrdiff_t _dststride,int16_t *src, ptrdiff_t srcstride,int width, int height);
+void ff_hevc_weighted_pred_10_sse(const HEVCWeight *wp, uint8_t *_dst, ptrdiff_t _dststride,int16_t *src, ptrdiff_t srcstride,int width, int height);
 void ff_hevc_put_weighted_pred_avg_8_sse(uint8_t *_dst, ptrdiff_t _dststride,int16_t *src1, int16_t *src2, ptrdiff_t srcstride,int width, int height);
 
-void ff_hevc_weighted_pred_avg_8_sse(uint8_t denom, int16_t wl0Flag, int16_t wl1Flag,int16_t ol0Flag, int16_t ol1Flag, uint8_t *_dst, ptrdiff_t _dststride,int16_t *src1, int16_t *src2, ptrdiff_t srcstride,int width, int height);
+void ff_hevc_weighted_pred_avg_8_sse(const HEVCWeight *wp0, const HEVCWeight *wp1, uint8_t *_dst, ptrdiff_t _dststride,int16_t *src1, int16_t *src2, ptrdiff_t srcstride,int width, int height);
+void ff_hevc_weighted_pred_avg_10_sse(const HEVCWeight *wp0, const HEVCWeight *wp1, uint8_t *_dst, ptrdiff_t _dststride,int16_t *src1, int16_t *src2, ptrdiff_t srcstride,int width, int height);
+
+void ff_hevc_weighted_pred_8_avx2(const HEVCWeight *wp, uint8_t *_dst, ptrdiff_t _dststride, int16_t *src, ptrdiff_t srcstride, int width, int height);
+void ff_hevc_weighted_pred_10_avx2(const HEVCWeight *wp, uint8_t *_dst, ptrdiff_t _dststride, int16_t *src, ptrdiff_t srcstride, int width, int height);
+void ff_hevc_weighted_pred_avg_8_avx2(const HEVCWeight *wp0, const HEVCWeight *wp1, uint8_t *_dst, ptrdiff_t _dststride, int16_t *src1, int16_t *src2, ptrdiff_t srcstride, int width, int height);
+void ff_hevc_weighted_pred_avg_10_avx2(const HEVCWeight *wp0, const HEVCWeight *wp1, uint8_t *_dst, ptrdiff_t _dststride, int16_t *src1, int16_t *src2, ptrdiff_t srcstride, int width, int height);
 
 ///////////////////////////////////////////////////////////////////////////////
 //
@@ -169,22 +201,134 @@ QPEL_PROTOTYPE_SSE(h2_2 , 10);
 //QPEL_PROTOTYPE_SSE(v4_3 , 10);
 
 
+// fused interpolation and pixel store
+#define QPEL_FUSED_PROTOTYPES(H, V) \
+void ff_hevc_put_hevc_qpel_uni_h ## H ## v ## V ## _8_sse(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride, int width, int height); \
+void ff_hevc_put_hevc_qpel_bi_h ## H ## v ## V ## _8_sse(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride, int16_t *src2, ptrdiff_t src2stride, int width, int height);
+
+#define EPEL_FUSED_PROTOTYPES(H, V) \
+void ff_hevc_put_hevc_epel_uni_h ## H ## v ## V ## _8_sse(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride, int width, int height, int mx, int my); \
+void ff_hevc_put_hevc_epel_bi_h ## H ## v ## V ## _8_sse(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride, int16_t *src2, ptrdiff_t src2stride, int width, int height, int mx, int my);
+
+QPEL_FUSED_PROTOTYPES(0, 0)
+QPEL_FUSED_PROTOTYPES(0, 1)
+QPEL_FUSED_PROTOTYPES(0, 2)
+QPEL_FUSED_PROTOTYPES(0, 3)
+QPEL_FUSED_PROTOTYPES(1, 0)
+QPEL_FUSED_PROTOTYPES(1, 1)
+QPEL_FUSED_PROTOTYPES(1, 2)
+QPEL_FUSED_PROTOTYPES(1, 3)
+QPEL_FUSED_PROTOTYPES(2, 0)
+QPEL_FUSED_PROTOTYPES(2, 1)
+QPEL_FUSED_PROTOTYPES(2, 2)
+QPEL_FUSED_PROTOTYPES(2, 3)
+QPEL_FUSED_PROTOTYPES(3, 0)
+QPEL_FUSED_PROTOTYPES(3, 1)
+QPEL_FUSED_PROTOTYPES(3, 2)
+QPEL_FUSED_PROTOTYPES(3, 3)
+
+// AVX-512 luma interpolation, for 32 and 64 wide blocks only
+#define QPEL_PROTOTYPES_AVX512(D) \
+void ff_hevc_put_hevc_qpel_pixels_ ## D ## _avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height); \
+void ff_hevc_put_hevc_qpel_h_1_ ## D ## _avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height); \
+void ff_hevc_put_hevc_qpel_h_2_ ## D ## _avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height); \
+void ff_hevc_put_hevc_qpel_h_3_ ## D ## _avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height); \
+void ff_hevc_put_hevc_qpel_v_1_ ## D ## _avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height); \
+void ff_hevc_put_hevc_qpel_v_2_ ## D ## _avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height); \
+void ff_hevc_put_hevc_qpel_v_3_ ## D ## _avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height); \
+void ff_hevc_put_weighted_pred_avg_ ## D ## _avx512(uint8_t *_dst, ptrdiff_t _dststride, int16_t *src1, int16_t *src2, ptrdiff_t srcstride, int width, int height);
+
+#define QPEL_FUSED_PROTOTYPES_AVX512(D, H, V) \
+void ff_hevc_put_hevc_qpel_uni_h ## H ## v ## V ## _ ## D ## _avx512(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride, int width, int height); \
+void ff_hevc_put_hevc_qpel_bi_h ## H ## v ## V ## _ ## D ## _avx512(uint8_t *dst, ptrdiff_t dststride, uint8_t *src, ptrdiff_t srcstride, int16_t *src2, ptrdiff_t src2stride, int width, int height);
+
+#define QPEL_ALL_PROTOTYPES_AVX512(D) \
+QPEL_PROTOTYPES_AVX512(D) \
+QPEL_FUSED_PROTOTYPES_AVX512(D, 0, 0) QPEL_FUSED_PROTOTYPES_AVX512(D, 0, 1) \
+QPEL_FUSED_PROTOTYPES_AVX512(D, 0, 2) QPEL_FUSED_PROTOTYPES_AVX512(D, 0, 3) \
+QPEL_FUSED_PROTOTYPES_AVX512(D, 1, 0) QPEL_FUSED_PROTOTYPES_AVX512(D, 1, 1) \
+QPEL_FUSED_PROTOTYPES_AVX512(D, 1, 2) QPEL_FUSED_PROTOTYPES_AVX512(D, 1, 3) \
+QPEL_FUSED_PROTOTYPES_AVX512(D, 2, 0) QPEL_FUSED_PROTOTYPES_AVX512(D, 2, 1) \
+QPEL_FUSED_PROTOTYPES_AVX512(D, 2, 2) QPEL_FUSED_PROTOTYPES_AVX512(D, 2, 3) \
+QPEL_FUSED_PROTOTYPES_AVX512(D, 3, 0) QPEL_FUSED_PROTOTYPES_AVX512(D, 3, 1) \
+QPEL_FUSED_PROTOTYPES_AVX512(D, 3, 2) QPEL_FUSED_PROTOTYPES_AVX512(D, 3, 3)
+
+QPEL_ALL_PROTOTYPES_AVX512( 8)
+QPEL_ALL_PROTOTYPES_AVX512(10)
+
+void ff_hevc_put_hevc_qpel_v_14_1_avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height);
+void ff_hevc_put_hevc_qpel_v_14_2_avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height);
+void ff_hevc_put_hevc_qpel_v_14_3_avx512(int16_t *dst, ptrdiff_t dststride, uint8_t *_src, ptrdiff_t _srcstride, int width, int height);
+
+EPEL_FUSED_PROTOTYPES(0, 0)
+EPEL_FUSED_PROTOTYPES(0, 1)
+EPEL_FUSED_PROTOTYPES(1, 0)
+EPEL_FUSED_PROTOTYPES(1, 1)
+
+#define EPEL_UV_PROTOTYPES(H, V) \
+void ff_hevc_put_hevc_epel_uv_h ## H ## v ## V ## _8_sse(int16_t *dst1, int16_t *dst2, ptrdiff_t dststride, uint8_t *src1, uint8_t *src2, ptrdiff_t srcstride, int width, int height, int mx, int my); \
+void ff_hevc_put_hevc_epel_uni_uv_h ## H ## v ## V ## _8_sse(uint8_t *dst1, uint8_t *dst2, ptrdiff_t dststride, uint8_t *src1, uint8_t *src2, ptrdiff_t srcstride, int width, int height, int mx, int my); \
+void ff_hevc_put_hevc_epel_bi_uv_h ## H ## v ## V ## _8_sse(uint8_t *dst1, uint8_t *dst2, ptrdiff_t dststride, uint8_t *src1, uint8_t *src2, ptrdiff_t srcstride, int16_t *src21, int16_t *src22, ptrdiff_t src2stride, int width, int height, int mx, int my);
+
+EPEL_UV_PROTOTYPES(0, 0)
+EPEL_UV_PROTOTYPES(0, 1)
+EPEL_UV_PROTOTYPES(1, 0)
+EPEL_UV_PROTOTYPES(1, 1)
+
+
 // SAO functions
 
-void ff_hevc_sao_edge_filter_0_8_sse(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao,int *borders, int _width, int _height, int c_idx, uint8_t vert_edge, uint8_t horiz_edge, uint8_t diag_edge);
-void ff_hevc_sao_edge_filter_1_8_sse(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao,int *borders, int _width, int _height, int c_idx, uint8_t vert_edge, uint8_t horiz_edge, uint8_t diag_edge);
-void ff_hevc_sao_edge_filter_2_8_sse(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao,int *borders, int _width, int _height, int c_idx, uint8_t vert_edge, uint8_t horiz_edge, uint8_t diag_edge);
-void ff_hevc_sao_edge_filter_3_8_sse(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao,int *borders, int _width, int _height, int c_idx, uint8_t vert_edge, uint8_t horiz_edge, uint8_t diag_edge);
-
-void ff_hevc_sao_band_filter_0_8_sse(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao, int *borders, int width, int height, int c_idx);
-void ff_hevc_sao_band_filter_1_8_sse(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao, int *borders, int width, int height, int c_idx);
-void ff_hevc_sao_band_filter_2_8_sse(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao, int *borders, int width, int height, int c_idx);
-void ff_hevc_sao_band_filter_3_8_sse(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao, int *borders, int width, int height, int c_idx);
-
-//#ifdef SVC_EXTENSION
-void ff_upsample_base_layer_frame_sse(struct AVFrame *FrameEL, struct AVFrame *FrameBL, short *Buffer[3], const int32_t enabled_up_sample_filter_luma[16][8], const int32_t enabled_up_sample_filter_chroma[16][4], struct HEVCWindow *Enhscal, struct UpsamplInf *up_info, int channel);
-void ff_upsample_base_layer_frame_sse_v(struct AVFrame *FrameEL, struct AVFrame *FrameBL, short *Buffer[3], const int32_t enabled_up_sample_filter_luma[16][8], const int32_t enabled_up_sample_filter_chroma[16][4], struct HEVCWindow *Enhscal, struct UpsamplInf *up_info, int channel);
-void ff_upsample_base_layer_frame_sse_h(struct AVFrame *FrameEL, struct AVFrame *FrameBL, short *Buffer[3], const int32_t enabled_up_sample_filter_luma[16][8], const int32_t enabled_up_sample_filter_chroma[16][4], struct HEVCWindow *Enhscal, struct UpsamplInf *up_info, int channel);
-//#endif
+void ff_hevc_sao_filter_ctb_row_8_sse(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao, const uint16_t *no_filter, int ctb_size, int width, int height, int c_idx);
+
+void ff_hevc_sao_filter_ctb_row_8_avx512(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao, const uint16_t *no_filter, int ctb_size, int width, int height, int c_idx);
+void ff_hevc_sao_filter_ctb_row_10_avx512(uint8_t *_dst, uint8_t *_src, ptrdiff_t _stride, struct SAOParams *sao, const uint16_t *no_filter, int ctb_size, int width, int height, int c_idx);
+
+// picture hash functions
+
+uint32_t ff_hevc_picture_checksum_8_sse(const uint8_t *src, ptrdiff_t stride, int width, int height);
+uint32_t ff_hevc_picture_checksum_10_sse(const uint8_t *src, ptrdiff_t stride, int width, int height);
+
+void ff_upsample_h_base_layer_rows_8_sse(int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                         const uint8_t *src, ptrdiff_t src_stride,
+                                         int bl_width, int el_width,
+                                         const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                         const int32_t up_sample_filter_luma[16][8],
+                                         const int32_t up_sample_filter_chroma[16][4],
+                                         int c_idx, int x0, int x1, int y0, int y1);
+void ff_upsample_v_base_layer_rows_8_sse(uint8_t *dst, ptrdiff_t dst_stride,
+                                         const int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                         int bl_height, int el_width, int el_height,
+                                         const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                         const int32_t up_sample_filter_luma[16][8],
+                                         const int32_t up_sample_filter_chroma[16][4],
+                                         int c_idx, int x0, int x1, int y0, int y1);
+void ff_upsample_h_base_layer_rows_8_avx2(int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                          const uint8_t *src, ptrdiff_t src_stride,
+                                          int bl_width, int el_width,
+                                          const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                          const int32_t up_sample_filter_luma[16][8],
+                                          const int32_t up_sample_filter_chroma[16][4],
+                                          int c_idx, int x0, int x1, int y0, int y1);
+void ff_upsample_h_base_layer_rows_10_avx2(int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                           const uint8_t *src, ptrdiff_t src_stride,
+                                           int bl_width, int el_width,
+                                           const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                           const int32_t up_sample_filter_luma[16][8],
+                                           const int32_t up_sample_filter_chroma[16][4],
+                                           int c_idx, int x0, int x1, int y0, int y1);
+void ff_upsample_v_base_layer_rows_8_avx2(uint8_t *dst, ptrdiff_t dst_stride,
+                                          const int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                          int bl_height, int el_width, int el_height,
+                                          const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                          const int32_t up_sample_filter_luma[16][8],
+                                          const int32_t up_sample_filter_chroma[16][4],
+                                          int c_idx, int x0, int x1, int y0, int y1);
+void ff_upsample_v_base_layer_rows_10_avx2(uint8_t *dst, ptrdiff_t dst_stride,
+                                           const int16_t *stripe, ptrdiff_t stripe_stride, int stripe_rows,
+                                           int bl_height, int el_width, int el_height,
+                                           const struct HEVCWindow *win, const struct UpsamplInf *up_info,
+                                           const int32_t up_sample_filter_luma[16][8],
+                                           const int32_t up_sample_filter_chroma[16][4],
+                                           int c_idx, int x0, int x1, int y0, int y1);
 
 #endif // AVCODEC_X86_HEVCDSP_H
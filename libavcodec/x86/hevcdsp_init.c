@@ -65,10 +65,62 @@ LFL_FUNCS(uint8_t,   8)
 
 //LF_FUNCS(uint16_t, 10)
 
+/* the AVX-512 luma kernels only cover the 32 and 64 wide blocks */
+#define QPEL_LINK_AVX512(c, D)                                                 \
+    for (i = 3; i < 5; i++) {                                                  \
+        c->put_hevc_qpel[i][0][0] = ff_hevc_put_hevc_qpel_pixels_ ## D ## _avx512; \
+        c->put_hevc_qpel[i][0][1] = ff_hevc_put_hevc_qpel_h_1_ ## D ## _avx512; \
+        c->put_hevc_qpel[i][0][2] = ff_hevc_put_hevc_qpel_h_2_ ## D ## _avx512; \
+        c->put_hevc_qpel[i][0][3] = ff_hevc_put_hevc_qpel_h_3_ ## D ## _avx512; \
+        c->put_hevc_qpel[i][1][0] = ff_hevc_put_hevc_qpel_v_1_ ## D ## _avx512; \
+        c->put_hevc_qpel[i][2][0] = ff_hevc_put_hevc_qpel_v_2_ ## D ## _avx512; \
+        c->put_hevc_qpel[i][3][0] = ff_hevc_put_hevc_qpel_v_3_ ## D ## _avx512; \
+        c->put_hevc_qpel_v_14[i][1] = ff_hevc_put_hevc_qpel_v_14_1_avx512;    \
+        c->put_hevc_qpel_v_14[i][2] = ff_hevc_put_hevc_qpel_v_14_2_avx512;    \
+        c->put_hevc_qpel_v_14[i][3] = ff_hevc_put_hevc_qpel_v_14_3_avx512;    \
+    }
+#define QPEL_FUSED_LINK_AVX512(c, D, H, V)                                     \
+    for (i = 3; i < 5; i++) {                                                  \
+        c->put_hevc_qpel_uni[i][V][H] = ff_hevc_put_hevc_qpel_uni_h ## H ## v ## V ## _ ## D ## _avx512; \
+        c->put_hevc_qpel_bi [i][V][H] = ff_hevc_put_hevc_qpel_bi_h  ## H ## v ## V ## _ ## D ## _avx512; \
+    }
+#define AVX512_LINK(c, D)                                                      \
+    do {                                                                       \
+        QPEL_LINK_AVX512(c, D);                                                \
+        QPEL_FUSED_LINK_AVX512(c, D, 0, 0); QPEL_FUSED_LINK_AVX512(c, D, 0, 1); \
+        QPEL_FUSED_LINK_AVX512(c, D, 0, 2); QPEL_FUSED_LINK_AVX512(c, D, 0, 3); \
+        QPEL_FUSED_LINK_AVX512(c, D, 1, 0); QPEL_FUSED_LINK_AVX512(c, D, 1, 1); \
+        QPEL_FUSED_LINK_AVX512(c, D, 1, 2); QPEL_FUSED_LINK_AVX512(c, D, 1, 3); \
+        QPEL_FUSED_LINK_AVX512(c, D, 2, 0); QPEL_FUSED_LINK_AVX512(c, D, 2, 1); \
+        QPEL_FUSED_LINK_AVX512(c, D, 2, 2); QPEL_FUSED_LINK_AVX512(c, D, 2, 3); \
+        QPEL_FUSED_LINK_AVX512(c, D, 3, 0); QPEL_FUSED_LINK_AVX512(c, D, 3, 1); \
+        QPEL_FUSED_LINK_AVX512(c, D, 3, 2); QPEL_FUSED_LINK_AVX512(c, D, 3, 3); \
+        c->put_weighted_pred_avg = ff_hevc_put_weighted_pred_avg_ ## D ## _avx512; \
+        c->transform_add[3]      = ff_hevc_transform_32x32_add_ ## D ## _avx512; \
+        c->sao_filter_ctb_row    = ff_hevc_sao_filter_ctb_row_ ## D ## _avx512; \
+    } while (0)
+
+#define QPEL_FUSED_LINK(c, H, V)                                               \
+    for (i = 0; i < 5; i++) {                                                  \
+        c->put_hevc_qpel_uni[i][V][H] = ff_hevc_put_hevc_qpel_uni_h ## H ## v ## V ## _8_sse; \
+        c->put_hevc_qpel_bi [i][V][H] = ff_hevc_put_hevc_qpel_bi_h  ## H ## v ## V ## _8_sse; \
+    }
+#define EPEL_FUSED_LINK(c, H, V)                                               \
+    for (i = 0; i < 5; i++) {                                                  \
+        c->put_hevc_epel_uni[i][V][H] = ff_hevc_put_hevc_epel_uni_h ## H ## v ## V ## _8_sse; \
+        c->put_hevc_epel_bi [i][V][H] = ff_hevc_put_hevc_epel_bi_h  ## H ## v ## V ## _8_sse; \
+    }
+#define EPEL_UV_LINK(c, H, V)                                                  \
+    for (i = 0; i < 5; i++) {                                                  \
+        c->put_hevc_epel_uv    [i][V][H] = ff_hevc_put_hevc_epel_uv_h     ## H ## v ## V ## _8_sse; \
+        c->put_hevc_epel_uni_uv[i][V][H] = ff_hevc_put_hevc_epel_uni_uv_h ## H ## v ## V ## _8_sse; \
+        c->put_hevc_epel_bi_uv [i][V][H] = ff_hevc_put_hevc_epel_bi_uv_h  ## H ## v ## V ## _8_sse; \
+    }
+
 
-void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth)
+void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth, int mm_flags)
 {
-    int mm_flags = av_get_cpu_flags();
+    int i;
 
     if (bit_depth == 8) {
         if (EXTERNAL_MMX(mm_flags)) {
@@ -83,6 +135,7 @@ void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth)
                 if (EXTERNAL_SSE2(mm_flags)) {
                     c->hevc_v_loop_filter_chroma = ff_hevc_v_loop_filter_chroma_8_sse2;
                     c->hevc_h_loop_filter_chroma = ff_hevc_h_loop_filter_chroma_8_sse2;
+                    c->picture_checksum          = ff_hevc_picture_checksum_8_sse;
                 }
                 if (EXTERNAL_SSSE3(mm_flags)) {
 
@@ -136,6 +189,23 @@ void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth)
                     PEL_LINK(c->put_hevc_qpel, 3, 3, 0, qpel_v8_3 ,  8);
                     PEL_LINK(c->put_hevc_qpel, 4, 3, 0, qpel_v8_3 ,  8);
 
+                    QPEL_FUSED_LINK(c, 0, 0);
+                    QPEL_FUSED_LINK(c, 0, 1);
+                    QPEL_FUSED_LINK(c, 0, 2);
+                    QPEL_FUSED_LINK(c, 0, 3);
+                    QPEL_FUSED_LINK(c, 1, 0);
+                    QPEL_FUSED_LINK(c, 1, 1);
+                    QPEL_FUSED_LINK(c, 1, 2);
+                    QPEL_FUSED_LINK(c, 1, 3);
+                    QPEL_FUSED_LINK(c, 2, 0);
+                    QPEL_FUSED_LINK(c, 2, 1);
+                    QPEL_FUSED_LINK(c, 2, 2);
+                    QPEL_FUSED_LINK(c, 2, 3);
+                    QPEL_FUSED_LINK(c, 3, 0);
+                    QPEL_FUSED_LINK(c, 3, 1);
+                    QPEL_FUSED_LINK(c, 3, 2);
+                    QPEL_FUSED_LINK(c, 3, 3);
+
 #if ARCH_X86_64
                     c->hevc_v_loop_filter_luma = ff_hevc_v_loop_filter_luma_8_ssse3;
                     c->hevc_h_loop_filter_luma = ff_hevc_h_loop_filter_luma_8_ssse3;
@@ -164,6 +234,16 @@ void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth)
                     PEL_LINK(c->put_hevc_epel, 3, 1, 0, epel_v16, 8);
                     PEL_LINK(c->put_hevc_epel, 4, 1, 0, epel_v16, 8);
 
+                    EPEL_FUSED_LINK(c, 0, 0);
+                    EPEL_FUSED_LINK(c, 0, 1);
+                    EPEL_FUSED_LINK(c, 1, 0);
+                    EPEL_FUSED_LINK(c, 1, 1);
+
+                    EPEL_UV_LINK(c, 0, 0);
+                    EPEL_UV_LINK(c, 0, 1);
+                    EPEL_UV_LINK(c, 1, 0);
+                    EPEL_UV_LINK(c, 1, 1);
+
                     c->put_hevc_epel_v_14[0] = ff_hevc_put_hevc_epel_v2_14_sse;
                     c->put_hevc_epel_v_14[1] = ff_hevc_put_hevc_epel_v4_14_sse;
                     c->put_hevc_epel_v_14[2] = ff_hevc_put_hevc_epel_v8_14_sse;
@@ -188,26 +268,34 @@ void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth)
                     c->put_hevc_qpel_v_14[4][3] = ff_hevc_put_hevc_qpel_v8_3_14_sse;
 
                     c->transform_skip     = ff_hevc_transform_skip_8_sse;
-                    c->sao_edge_filter[0] = ff_hevc_sao_edge_filter_0_8_sse;
-                    c->sao_edge_filter[1] = ff_hevc_sao_edge_filter_1_8_sse;
-                    c->sao_edge_filter[2] = ff_hevc_sao_edge_filter_2_8_sse;
-                    c->sao_edge_filter[3] = ff_hevc_sao_edge_filter_3_8_sse;
-
-                    c->sao_band_filter[0] = ff_hevc_sao_band_filter_0_8_sse;
-                    c->sao_band_filter[1] = ff_hevc_sao_band_filter_1_8_sse;
-                    c->sao_band_filter[2] = ff_hevc_sao_band_filter_2_8_sse;
-                    c->sao_band_filter[3] = ff_hevc_sao_band_filter_3_8_sse;
-
-#ifdef SVC_EXTENSION
-                    c->upsample_base_layer_frame = ff_upsample_base_layer_frame_sse;
-                    c->upsample_h_base_layer_frame = ff_upsample_base_layer_frame_sse_h;
-                    c->upsample_v_base_layer_frame = ff_upsample_base_layer_frame_sse_v;
-#endif
+                    c->sao_filter_ctb_row = ff_hevc_sao_filter_ctb_row_8_sse;
+
+                    c->upsample_h_base_layer_rows = ff_upsample_h_base_layer_rows_8_sse;
+                    c->upsample_v_base_layer_rows = ff_upsample_v_base_layer_rows_8_sse;
 
 
                 }
                 if (EXTERNAL_AVX(mm_flags)) {
                 }
+                if (EXTERNAL_AVX2(mm_flags)) {
+                    c->transform_4x4_luma_add = ff_hevc_transform_4x4_luma_add_8_avx2;
+                    c->transform_add[0]       = ff_hevc_transform_4x4_add_8_avx2;
+                    c->transform_add[1]       = ff_hevc_transform_8x8_add_8_avx2;
+                    c->transform_add[2]       = ff_hevc_transform_16x16_add_8_avx2;
+                    c->transform_add[3]       = ff_hevc_transform_32x32_add_8_avx2;
+                    c->transform_skip         = ff_hevc_transform_skip_8_avx2;
+                    c->transquant_bypass[0]   = ff_hevc_transquant_bypass4x4_8_avx2;
+                    c->transquant_bypass[1]   = ff_hevc_transquant_bypass8x8_8_avx2;
+                    c->transquant_bypass[2]   = ff_hevc_transquant_bypass16x16_8_avx2;
+                    c->transquant_bypass[3]   = ff_hevc_transquant_bypass32x32_8_avx2;
+                    c->upsample_h_base_layer_rows = ff_upsample_h_base_layer_rows_8_avx2;
+                    c->upsample_v_base_layer_rows = ff_upsample_v_base_layer_rows_8_avx2;
+                    c->weighted_pred          = ff_hevc_weighted_pred_8_avx2;
+                    c->weighted_pred_avg      = ff_hevc_weighted_pred_avg_8_avx2;
+                }
+                if (EXTERNAL_AVX512(mm_flags)) {
+                    AVX512_LINK(c, 8);
+                }
             }
         }
     } else if (bit_depth == 10) {
@@ -219,6 +307,7 @@ void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth)
 #if HAVE_ALIGNED_STACK
                     /*stuff that requires aligned stack */
 #endif /* HAVE_ALIGNED_STACK */
+                    c->picture_checksum = ff_hevc_picture_checksum_10_sse;
                 }
                 if (EXTERNAL_SSE4(mm_flags)) {
                     c->transform_4x4_luma_add = ff_hevc_transform_4x4_luma_add_10_sse4;
@@ -228,6 +317,8 @@ void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth)
                     c->transform_add[2] = ff_hevc_transform_16x16_add_10_sse4;
                     c->transform_add[3] = ff_hevc_transform_32x32_add_10_sse4;
 
+                    c->weighted_pred     = ff_hevc_weighted_pred_10_sse;
+                    c->weighted_pred_avg = ff_hevc_weighted_pred_avg_10_sse;
 
                     c->put_hevc_epel_v_14[0] = ff_hevc_put_hevc_epel_v2_14_sse;
                     c->put_hevc_epel_v_14[1] = ff_hevc_put_hevc_epel_v4_14_sse;
@@ -316,6 +407,25 @@ void ff_hevcdsp_init_x86(HEVCDSPContext *c, const int bit_depth)
                 }
                 if (EXTERNAL_AVX(mm_flags)) {
                 }
+                if (EXTERNAL_AVX2(mm_flags)) {
+                    c->transform_4x4_luma_add = ff_hevc_transform_4x4_luma_add_10_avx2;
+                    c->transform_add[0]       = ff_hevc_transform_4x4_add_10_avx2;
+                    c->transform_add[1]       = ff_hevc_transform_8x8_add_10_avx2;
+                    c->transform_add[2]       = ff_hevc_transform_16x16_add_10_avx2;
+                    c->transform_add[3]       = ff_hevc_transform_32x32_add_10_avx2;
+                    c->transform_skip         = ff_hevc_transform_skip_10_avx2;
+                    c->transquant_bypass[0]   = ff_hevc_transquant_bypass4x4_10_avx2;
+                    c->transquant_bypass[1]   = ff_hevc_transquant_bypass8x8_10_avx2;
+                    c->transquant_bypass[2]   = ff_hevc_transquant_bypass16x16_10_avx2;
+                    c->transquant_bypass[3]   = ff_hevc_transquant_bypass32x32_10_avx2;
+                    c->upsample_h_base_layer_rows = ff_upsample_h_base_layer_rows_10_avx2;
+                    c->upsample_v_base_layer_rows = ff_upsample_v_base_layer_rows_10_avx2;
+                    c->weighted_pred          = ff_hevc_weighted_pred_10_avx2;
+                    c->weighted_pred_avg      = ff_hevc_weighted_pred_avg_10_avx2;
+                }
+                if (EXTERNAL_AVX512(mm_flags)) {
+                    AVX512_LINK(c, 10);
+                }
             }
         }
     }
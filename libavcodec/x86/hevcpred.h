@@ -11,4 +11,7 @@ void pred_angular_1_8_sse(uint8_t *_src, const uint8_t *_top, const uint8_t *_le
 void pred_angular_2_8_sse(uint8_t *_src, const uint8_t *_top, const uint8_t *_left, ptrdiff_t stride, int c_idx, int mode);
 void pred_angular_3_8_sse(uint8_t *_src, const uint8_t *_top, const uint8_t *_left, ptrdiff_t stride, int c_idx, int mode);
 
+void ref_filter_8_sse(uint8_t *dst, const uint8_t *src, int len);
+void ref_filter_strong_8_sse(uint8_t *dst, const uint8_t *src);
+
 #endif // AVCODEC_X86_HEVCPRED_H
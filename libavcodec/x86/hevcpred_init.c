@@ -8,9 +8,8 @@
 
 //function declaration
 
-void ff_hevcpred_init_x86(HEVCPredContext *c, const int bit_depth)
+void ff_hevcpred_init_x86(HEVCPredContext *c, const int bit_depth, int mm_flags)
 {
-    int mm_flags = av_get_cpu_flags();
 
     if (bit_depth == 8) {
         if (EXTERNAL_MMX(mm_flags)) {
@@ -35,6 +34,9 @@ void ff_hevcpred_init_x86(HEVCPredContext *c, const int bit_depth)
                      c->pred_angular[1]= pred_angular_1_8_sse;
                      c->pred_angular[2]= pred_angular_2_8_sse;
                      c->pred_angular[3]= pred_angular_3_8_sse;
+
+                     c->ref_filter        = ref_filter_8_sse;
+                     c->ref_filter_strong = ref_filter_strong_8_sse;
                 }
                 if (EXTERNAL_AVX(mm_flags)) {
 
@@ -98,11 +98,9 @@ static av_noinline void emulated_edge_mc_sse(uint8_t *buf, const uint8_t *src,
 void ff_prefetch_mmxext(uint8_t *buf, ptrdiff_t stride, int h);
 void ff_prefetch_3dnow(uint8_t *buf, ptrdiff_t stride, int h);
 
-av_cold void ff_videodsp_init_x86(VideoDSPContext *ctx, int bpc)
+av_cold void ff_videodsp_init_x86(VideoDSPContext *ctx, int bpc, int cpu_flags)
 {
 #if HAVE_YASM
-    int cpu_flags = av_get_cpu_flags();
-
 #if ARCH_X86_32
     if (EXTERNAL_MMX(cpu_flags) && bpc <= 8) {
 //        ctx->emulated_edge_mc = emulated_edge_mc_mmx;
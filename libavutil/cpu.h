@@ -46,6 +46,8 @@
 #define AV_CPU_FLAG_XOP          0x0400 ///< Bulldozer XOP functions
 #define AV_CPU_FLAG_FMA4         0x0800 ///< Bulldozer FMA4 functions
 #define AV_CPU_FLAG_CMOV         0x1000 ///< i686 cmov
+#define AV_CPU_FLAG_AVX2         0x8000 ///< AVX2 functions: requires OS support even if YMM registers aren't used
+#define AV_CPU_FLAG_AVX512     0x100000 ///< AVX-512 F/BW/DQ/CD/VL functions: requires OS support for the ZMM and opmask state
 
 #define AV_CPU_FLAG_ALTIVEC      0x0001 ///< standard
 
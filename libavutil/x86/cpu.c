@@ -95,6 +95,7 @@ int ff_get_cpu_flags_x86(void)
     int eax, ebx, ecx, edx;
     int max_std_level, max_ext_level, std_caps = 0, ext_caps = 0;
     int family = 0, model = 0;
+    int xcr0 = 0;
     union { int i[3]; char c[12]; } vendor;
 
     if (!cpuid_test())
@@ -130,6 +131,7 @@ int ff_get_cpu_flags_x86(void)
         if ((ecx & 0x18000000) == 0x18000000) {
             /* Check for OS support */
             xgetbv(0, eax, edx);
+            xcr0 = eax;
             if ((eax & 0x6) == 0x6)
                 rval |= AV_CPU_FLAG_AVX;
         }
@@ -137,6 +139,23 @@ int ff_get_cpu_flags_x86(void)
 #endif /* HAVE_SSE */
     }
 
+#if HAVE_AVX2
+    /* AVX2 is reported in the structured extended feature leaf and, like
+     * AVX, needs the OS to save the YMM state. */
+    if (max_std_level >= 7 && (rval & AV_CPU_FLAG_AVX)) {
+        cpuid(7, eax, ebx, ecx, edx);
+        if (ebx & 0x00000020)
+            rval |= AV_CPU_FLAG_AVX2;
+#if HAVE_AVX512
+        /* F, DQ, CD, BW and VL, with the opmask and both halves of the
+         * ZMM register file enabled in XCR0 */
+        if ((rval & AV_CPU_FLAG_AVX2) && (ebx & 0xd0030000) == 0xd0030000 &&
+            (xcr0 & 0xe0) == 0xe0)
+            rval |= AV_CPU_FLAG_AVX512;
+#endif /* HAVE_AVX512 */
+    }
+#endif /* HAVE_AVX2 */
+
     cpuid(0x80000000, max_ext_level, ebx, ecx, edx);
 
     if (max_ext_level >= 0x80000001) {
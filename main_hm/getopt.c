@@ -56,9 +56,11 @@ void print_usage() {
     printf("     -n : no display\n");
     printf("     -o <output file>\n");
     printf("     -p <number of threads> \n");
-    printf("     -t <temporal layer id>\n");
+    printf("     -t <highest temporal layer id to decode> (0 to 6, default: 6)\n");
     printf("     -w : Do not apply cropping windows\n");
     printf("     -l <Quality layer id> \n");
+    printf("     -s <max SIMD tier> (0: C, 1: SSE4, 2: AVX2, 3: AVX-512)\n");
+    printf("     -k <key frames> (1: IRAP pictures only, 2: also without in-loop filters)\n");
 }
 
 /*
@@ -130,7 +132,7 @@ int getopt(int nargc, char * const *nargv, const char *ostr) {
 void init_main(int argc, char *argv[]) {
     // every command line option must be followed by ':' if it takes an
     // argument, and '::' if this argument is optional
-    const char *ostr = "achi:no:p:f:t:wl:";
+    const char *ostr = "achi:no:p:f:t:wl:s:k:";
 
     int c;
     check_md5_flags   = ENABLE;
@@ -139,9 +141,11 @@ void init_main(int argc, char *argv[]) {
     display_flags     = ENABLE;
     output_file       = NULL;
     nb_pthreads       = 1;
-    temporal_layer_id = 7;
+    temporal_layer_id = 6; // all the temporal sub-layers
     no_cropping       = DISABLE;
     quality_layer_id  = 0; // Base layer
+    simd_tier         = 3; // everything the CPU supports
+    keyframes_only    = 0; // all the pictures
 
     program           = argv[0];
     
@@ -182,6 +186,12 @@ void init_main(int argc, char *argv[]) {
         case 'l':
             quality_layer_id = atoi(optarg);
             break;
+        case 's':
+            simd_tier = atoi(optarg);
+            break;
+        case 'k':
+            keyframes_only = atoi(optarg);
+            break;
         default:
             print_usage();
             exit(1);
@@ -51,6 +51,8 @@ int nb_pthreads;
 int temporal_layer_id;
 int quality_layer_id;
 int no_cropping;
+int simd_tier;
+int keyframes_only;
 
 // initialize APR and parse command-line options
 void init_main(int argc, char *argv[]);
@@ -75,13 +75,15 @@ static void video_decode_example(const char *filename)
     OpenHevc_Handle    openHevcHandle;
 
     openHevcHandle = libOpenHevcInit(nb_pthreads, thread_type/*, pFormatCtx*/);
-    libOpenHevcSetCheckMD5(openHevcHandle, check_md5_flags);
-    libOpenHevcSetTemporalLayer_id(openHevcHandle, temporal_layer_id);
-    libOpenHevcSetActiveDecoders(openHevcHandle, quality_layer_id);
     if (!openHevcHandle) {
         fprintf(stderr, "could not open OpenHevc\n");
         exit(1);
     }
+    libOpenHevcSetCheckMD5(openHevcHandle, check_md5_flags);
+    libOpenHevcSetTemporalLayer_id(openHevcHandle, temporal_layer_id);
+    libOpenHevcSetActiveDecoders(openHevcHandle, quality_layer_id);
+    libOpenHevcSetMaxSimdTier(openHevcHandle, simd_tier);
+    libOpenHevcSetKeyframesOnly(openHevcHandle, keyframes_only);
     av_register_all();
     pFormatCtx = avformat_alloc_context();
     file_iformat = av_guess_format(NULL, filename, NULL);
@@ -0,0 +1,144 @@
+/*
+ * Check that frame threading decodes the same pictures as a single thread
+ *
+ * This file is part of openhevc.
+ *
+ * openHevc is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * openhevc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with openhevc; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavformat/avformat.h"
+#include "libavutil/md5.h"
+#include "openHevcWrapper.h"
+
+/*
+ * The stream has 4 temporal sub-layers; the decoder options, such as the
+ * highest temporal id to decode, must reach the frame thread copies too.
+ */
+
+typedef struct DecodeResult {
+    int     nb_frames;
+    uint8_t md5[16];
+} DecodeResult;
+
+static int write_frame(OpenHevc_Handle openHevcHandle, struct AVMD5 *md5)
+{
+    OpenHevc_Frame_cpy frame;
+    int size, ret;
+
+    libOpenHevcGetPictureInfo(openHevcHandle, &frame.frameInfo);
+    size = frame.frameInfo.nWidth * frame.frameInfo.nHeight *
+           (frame.frameInfo.nBitDepth == 8 ? 1 : 2);
+    frame.pvY = malloc(size);
+    frame.pvU = malloc(size / 4);
+    frame.pvV = malloc(size / 4);
+    ret = frame.pvY && frame.pvU && frame.pvV ? 0 : -1;
+    if (!ret) {
+        libOpenHevcGetOutputCpy(openHevcHandle, 1, &frame);
+        av_md5_update(md5, frame.pvY, size);
+        av_md5_update(md5, frame.pvU, size / 4);
+        av_md5_update(md5, frame.pvV, size / 4);
+    }
+    free(frame.pvY);
+    free(frame.pvU);
+    free(frame.pvV);
+    return ret;
+}
+
+static int decode(const char *filename, int nb_pthreads, int temporal_layer_id,
+                  DecodeResult *res)
+{
+    AVFormatContext *pFormatCtx = NULL;
+    OpenHevc_Handle openHevcHandle;
+    struct AVMD5 *md5;
+    AVPacket packet;
+    int got_picture, ret = 0;
+
+    memset(res, 0, sizeof(*res));
+    if (avformat_open_input(&pFormatCtx, filename, NULL, NULL) < 0) {
+        fprintf(stderr, "could not open %s\n", filename);
+        return -1;
+    }
+    md5            = av_md5_alloc();
+    openHevcHandle = libOpenHevcInit(nb_pthreads, 1);
+    if (!md5 || !openHevcHandle) {
+        avformat_close_input(&pFormatCtx);
+        av_free(md5);
+        return -1;
+    }
+    av_md5_init(md5);
+    if (temporal_layer_id >= 0)
+        libOpenHevcSetTemporalLayer_id(openHevcHandle, temporal_layer_id);
+    libOpenHevcStartDecoder(openHevcHandle);
+
+    while (!ret && av_read_frame(pFormatCtx, &packet) >= 0) {
+        got_picture = libOpenHevcDecode(openHevcHandle, packet.data, packet.size, packet.pts);
+        if (got_picture > 0) {
+            ret = write_frame(openHevcHandle, md5);
+            res->nb_frames++;
+        }
+        av_free_packet(&packet);
+    }
+    while (!ret && libOpenHevcDecode(openHevcHandle, NULL, 0, 0) > 0) {
+        ret = write_frame(openHevcHandle, md5);
+        res->nb_frames++;
+    }
+    av_md5_final(md5, res->md5);
+
+    libOpenHevcClose(openHevcHandle);
+    avformat_close_input(&pFormatCtx);
+    av_free(md5);
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    static const int temporal_layer_ids[] = { -1, 0 };
+    DecodeResult ref[2], res;
+    int i, nb_pthreads, failed = 0;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s stream.bit\n", argv[0]);
+        return 1;
+    }
+    av_register_all();
+
+    for (i = 0; i < 2; i++) {
+        if (decode(argv[1], 1, temporal_layer_ids[i], &ref[i]) < 0 || !ref[i].nb_frames)
+            return 1;
+        for (nb_pthreads = 2; nb_pthreads <= 4; nb_pthreads++) {
+            if (decode(argv[1], nb_pthreads, temporal_layer_ids[i], &res) < 0)
+                return 1;
+            if (res.nb_frames != ref[i].nb_frames ||
+                memcmp(res.md5, ref[i].md5, sizeof(res.md5))) {
+                fprintf(stderr, "temporal id %d, %d frame threads: %d frames, "
+                        "%d with a single thread%s\n",
+                        temporal_layer_ids[i], nb_pthreads, res.nb_frames,
+                        ref[i].nb_frames,
+                        res.nb_frames == ref[i].nb_frames ? ", different output" : "");
+                failed = 1;
+            }
+        }
+    }
+    if (ref[1].nb_frames >= ref[0].nb_frames) {
+        fprintf(stderr, "temporal id 0 gave %d frames, all the sub-layers %d\n",
+                ref[1].nb_frames, ref[0].nb_frames);
+        failed = 1;
+    }
+    return failed;
+}
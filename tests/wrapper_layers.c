@@ -0,0 +1,71 @@
+/*
+ * Check when the wrapper starts, drops and resumes enhancement layers
+ *
+ * This file is part of openhevc.
+ *
+ * openHevc is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * openhevc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with openhevc; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/* the layer switching helpers are static */
+#include "openHevcWrapper.c"
+
+#define CHECK(layer, what)                                                    \
+    do {                                                                      \
+        if (openHevcContexts->active_layer != (layer)) {                      \
+            fprintf(stderr, "%s: active layer %d instead of %d\n", what,      \
+                    openHevcContexts->active_layer, layer);                   \
+            failed = 1;                                                       \
+        }                                                                     \
+    } while (0)
+
+int main(void)
+{
+    /* start code and NAL unit header of layer 1, temporal id 0 */
+    static const uint8_t el_trail[] = { 0, 0, 1,  1 << 1, 1 << 3 | 1, 0x80 };
+    static const uint8_t el_cra[]   = { 0, 0, 1, 21 << 1, 1 << 3 | 1, 0x80 };
+    /* an IRAP picture of the base layer does not resume layer 1 */
+    static const uint8_t bl_cra[]   = { 0, 0, 1, 21 << 1,          1, 0x80 };
+    OpenHevcWrapperContexts *openHevcContexts;
+    int failed = 0;
+
+    openHevcContexts = libOpenHevcInit(1, 1);
+    if (!openHevcContexts)
+        return 1;
+    libOpenHevcSetActiveDecoders(openHevcContexts, 1);
+    if (!libOpenHevcStartDecoder(openHevcContexts))
+        return 1;
+
+    /* as if the base layer decoder had just parsed a VPS with 2 layers */
+    openHevcContexts->wraper[0]->c->nb_layers = 2;
+    update_layers(openHevcContexts);
+    if (openHevcContexts->nb_decoders != 2)
+        return 1;
+    CHECK(1, "announced");
+
+    openHevcContexts->layer_cap = 0;
+    drop_layers(openHevcContexts);
+    CHECK(0, "dropped");
+
+    openHevcContexts->layer_cap = 1;
+    resume_layers(openHevcContexts, el_trail, sizeof(el_trail));
+    CHECK(0, "non-IRAP picture");
+    resume_layers(openHevcContexts, bl_cra, sizeof(bl_cra));
+    CHECK(0, "base layer IRAP picture");
+    resume_layers(openHevcContexts, el_cra, sizeof(el_cra));
+    CHECK(1, "IRAP picture");
+
+    libOpenHevcClose(openHevcContexts);
+    return failed;
+}